@@ -74,6 +74,30 @@ typedef struct
 
 PRECALC_DATA * precalc;
 
+/*
+Sharp representation of the glass beads (bead_mode 1). Instead of being voxelized into the glass phase field,
+the beads are embedded in the grid as exact spheres: BeadCutCells() precalculates the glass volume fraction of
+each cell and the glass fractions of its faces (i.e. the complements of the face apertures) once from the bead
+list. In the right hand side, the conductivity of a face is the area-weighted combination of the glass and the
+water/ice conductivities, the heat capacity of a cell is weighted by the volume fraction and the phase field
+only diffuses through the water part of the faces (which imposes the zero Neumann condition on the bead surface
+without resolving it). The phase field is not evolved in cells (almost) covered by glass. The glass phase field
+then only holds the rest of the glass given by the initial condition (the container walls).
+*/
+typedef struct
+{
+	FLOAT vol;		/* glass volume fraction of the cell */
+	FLOAT face[6];		/* glass fractions of the faces, in the order -X, +X, -Y, +Y, -Z, +Z */
+} CUT_CELL;
+
+enum { CUT_MX, CUT_PX, CUT_MY, CUT_PY, CUT_MZ, CUT_PZ };
+
+/* cells with a smaller water fraction are treated as glass by the phase field (the small cell problem) */
+#define CUTCELL_MIN_FRACTION	0.05
+
+CUT_CELL * cut_cell = NULL;			/* allocated in bead_mode 1 only, with the same layout as 'precalc' */
+static const FLOAT no_cut_faces[6] = { 0.0 };	/* the face fractions used when there are no cut cells */
+
 /* auxiliary global variables precalculated in PrecalculateData() */
 static FLOAT xi_2_inv_a;		/* a/(xi^2) */
 static FLOAT xi_inv_b_sqrt_a2;		/* b * sqrtF(0.5*a) / xi */
@@ -104,35 +128,26 @@ WITH RESPECT TO THE WHOLE GRID WITHOUT THE AUXILIARY NODES.
 	/*
 	FLOAT x = L1 * (0.5+i) / n1;
 	FLOAT y = L2 * (0.5+j) / n2;
-	FLOAT z = L3 * (0.5+k) / total_n3;
+	FLOAT z = Z_NODE(k);
 	*/
 
 	return(t<param[phase_switch_time] ? param[top_temp1] : param[top_temp2]);
 }
 
-void bcond_setup_Combined(FLOAT t, FLOAT * w, FLOAT (*Dirichlet_cond)(FLOAT,int,int,int))
+void bcond_setup_lateral(FLOAT * w)
 /*
-set up the combined Neumann / Dirichlet boundary condition for the solution w
-
-At the top of the domain, the Dirichlet boundary condition is set, taking the actual thickness
-of the boundary condition layer into account. The values of the B.C. are given by the
-Dirichlet_cond() function, which must return the correct result based on time t and the
-node index triple. The node indices  passed to Dirichlet_cond() are given with respect
-to the WHOLE GRID WITHOUT THE AUXILIARY NODES. Negative node indices therefore occur.
-
-Elsewhere, the Neumann boundary condition is set.
+set up the boundary conditions in the X,Y-plane for all rows of the block (in the Z direction)
+except the auxiliary ones. The zero Neumann boundary condition is set by mirroring the node values
+with respect to the boundary. In the directions selected by 'periodic', the auxiliary nodes are
+copied from the opposite side of the domain instead. Each rank holds whole X,Y-planes, so no
+communication is needed. The X edges are set first, so that the corners are correct in all cases.
 */
 {
 	int i,j,k;
 
 	FLOAT * w_ptr, * w_ptr1, * w_ptr2, * w_ptr1m, * w_ptr2m;	/* "m" stands for "mirror" */
 
-	/*
-	Neumann boundary condition setup (in the X,Y-plane, except the front and the rear of the block,
-	which will be either added later or received from the neighbor rank).
-
-	Begin at the first row after the boundary condition (in the Z direction).
-	*/
+	/* Begin at the first row after the boundary condition (in the Z direction). */
 	#pragma omp for schedule(runtime)
 	for(k=0;k<n3;k++) {
 
@@ -143,22 +158,78 @@ Elsewhere, the Neumann boundary condition is set.
 		for(j=0;j<n2;j++) {
 			w_ptr1m = w_ptr1 = w_ptr + (bcond_thickness+j)*N1 + bcond_thickness;
 			w_ptr2m = w_ptr2 = w_ptr1 + n1 - 1;
-			for(i=0;i<bcond_thickness;i++) {
-				*(--w_ptr1m) = *(w_ptr1++);	/* left edge */
-				*(++w_ptr2m) = *(w_ptr2--);	/* right edge */
-			}
+			if(periodic & PERIODIC_X)
+				for(i=0;i<bcond_thickness;i++) {
+					*(--w_ptr1m) = *(w_ptr2--);	/* left edge */
+					*(++w_ptr2m) = *(w_ptr1++);	/* right edge */
+				}
+			else
+				for(i=0;i<bcond_thickness;i++) {
+					*(--w_ptr1m) = *(w_ptr1++);	/* left edge */
+					*(++w_ptr2m) = *(w_ptr2--);	/* right edge */
+				}
 		}
 
 		/* the top and the bottom boundary layer of the X,Y plane */
 		for(j=0;j<bcond_thickness;j++) {
-			w_ptr1 = w_ptr + (bcond_thickness+j)*N1;	w_ptr1m = w_ptr + (bcond_thickness-j-1)*N1;
-			w_ptr2 = w_ptr + (bcond_thickness+n2-j-1)*N1;	w_ptr2m = w_ptr + (bcond_thickness+n2+j)*N1;
+			if(periodic & PERIODIC_Y) {
+				w_ptr1 = w_ptr + (bcond_thickness+n2-j-1)*N1;	w_ptr1m = w_ptr + (bcond_thickness-j-1)*N1;
+				w_ptr2 = w_ptr + (bcond_thickness+j)*N1;	w_ptr2m = w_ptr + (bcond_thickness+n2+j)*N1;
+			} else {
+				w_ptr1 = w_ptr + (bcond_thickness+j)*N1;	w_ptr1m = w_ptr + (bcond_thickness-j-1)*N1;
+				w_ptr2 = w_ptr + (bcond_thickness+n2-j-1)*N1;	w_ptr2m = w_ptr + (bcond_thickness+n2+j)*N1;
+			}
 			for(i=0;i<N1;i++) {
 				*(w_ptr1m++) = *(w_ptr1++);	/* bottom layer */
 				*(w_ptr2m++) = *(w_ptr2++);	/* top layer */
 			}
 		}
 	}
+}
+
+static void Dirichlet_closure4(int k, FLOAT * c)
+/*
+computes the coefficients of the fourth order Dirichlet closure for the k-th auxiliary row (counted from the
+boundary): the value there is c[0]*g + c[1]*w[-1] + c[2]*w[-2] + c[3]*w[-3], where g is the boundary value
+and w[-m] is the m-th grid row inside the domain. This is the cubic through the boundary value at the face
+and the last 3 nodes (at the distances 1/2, 3/2, 5/2 of the grid step), extrapolated to the distance k+1/2.
+*/
+{
+	const FLOAT s[4] = { 0.0, -0.5, -1.5, -2.5 };
+	FLOAT x = 0.5+k;
+	int m,l;
+
+	for(m=0;m<4;m++)
+		for(c[m]=1.0,l=0;l<4;l++) if(l!=m) c[m] *= (x-s[l])/(s[m]-s[l]);
+}
+
+void bcond_setup_Combined(FLOAT t, FLOAT * w, FLOAT (*Dirichlet_cond)(FLOAT,int,int,int))
+/*
+set up the combined Neumann / Dirichlet boundary condition for the solution w
+
+At the top of the domain, the Dirichlet boundary condition is set, taking the actual thickness
+of the boundary condition layer into account. The values of the B.C. are given by the
+Dirichlet_cond() function, which must return the correct result based on time t and the
+node index triple. The node indices  passed to Dirichlet_cond() are given with respect
+to the WHOLE GRID WITHOUT THE AUXILIARY NODES. Negative node indices therefore occur.
+
+With stencil_order 4, the value of the B.C. is prescribed at the boundary itself (taken from the first
+auxiliary node) and the auxiliary nodes are extrapolated from the grid by Dirichlet_closure4(), so that
+the B.C. is approximated with the fourth order. The last rank then has to hold at least 3 rows.
+
+Elsewhere, the Neumann boundary condition is set (or the periodic one at the sides, see bcond_setup_lateral()).
+*/
+{
+	int i,j,k;
+	FLOAT c[4];
+
+	FLOAT * w_ptr, * w_ptr1, * w_ptr1m;	/* "m" stands for "mirror" */
+
+	/*
+	Neumann or periodic boundary condition setup (in the X,Y-plane, except the front and the rear of
+	the block, which will be either added later or received from the neighbor rank).
+	*/
+	bcond_setup_lateral(w);
 
 	/* Finally, set up the top and bottom layers in the Z direction (this part depends on the current rank) */
 	if(MPIrank==0) {
@@ -174,7 +245,17 @@ Elsewhere, the Neumann boundary condition is set.
 	}
 	if(MPIrank==MPIprocs-1) {
 		/* the last rank has to set up the Dirichlet boundary condition at the rear (the end of the array in the sense of the Z axis) */
-		for(k=0;k<bcond_thickness;k++)
+		if(stencil_order == 4) for(k=0;k<bcond_thickness;k++) {
+			Dirichlet_closure4(k, c);
+			#pragma omp for schedule(runtime)
+			for(j=0;j<N2;j++) {
+				w_ptr = w + subgridSize + bcond_size + k*rowsize + j*N1;
+				w_ptr1 = w + subgridSize + bcond_size - rowsize + j*N1;
+				for(i=0;i<N1;i++,w_ptr1++)
+					*(w_ptr++) = c[0]*Dirichlet_cond(t, i-bcond_thickness, j-bcond_thickness, total_n3)
+						+ c[1]*w_ptr1[0] + c[2]*w_ptr1[-rowsize] + c[3]*w_ptr1[-2*rowsize];
+			}
+		} else for(k=0;k<bcond_thickness;k++)
 			#pragma omp for schedule(runtime)
 			for(j=0;j<N2;j++) {
 				w_ptr = w + subgridSize + bcond_size + k*rowsize + j*N1;
@@ -196,45 +277,18 @@ For the FVM method, the boundary lies between the nodes and thence the first mir
 phantom node has the same value as its immediate neighbor
 
 The actual thickness of the phantom node layer layer is taken into account and the b.c.
-is approximated with the order 2*bcond_thickness.
+is approximated with the order 2*bcond_thickness. The sides may be periodic (see bcond_setup_lateral()).
 */
 {
 	int i,j,k;
 
-	FLOAT * w_ptr, * w_ptr1, * w_ptr2, * w_ptr1m, * w_ptr2m;	/* "m" stands for "mirror" */
+	FLOAT * w_ptr1, * w_ptr1m;	/* "m" stands for "mirror" */
 
 	/*
-	Neumann boundary condition setup (in the X,Y-plane, except the front and the rear of the block,
-	which will be either added later or received from the neighbor rank).
-
-	Begin at the first row after the boundary condition (in the Z direction).
+	Neumann or periodic boundary condition setup (in the X,Y-plane, except the front and the rear of
+	the block, which will be either added later or received from the neighbor rank).
 	*/
-	#pragma omp for schedule(runtime)
-	for(k=0;k<n3;k++) {
-
-		/* w_ptr indicates the beginning of the processed X-Y plane */
-		w_ptr = w + (bcond_thickness+k)*rowsize;
-
-		/* first we set up the side edges along the X,Y plane */
-		for(j=0;j<n2;j++) {
-			w_ptr1m = w_ptr1 = w_ptr + (bcond_thickness+j)*N1 + bcond_thickness;
-			w_ptr2m = w_ptr2 = w_ptr1 + n1 - 1;
-			for(i=0;i<bcond_thickness;i++) {
-				*(--w_ptr1m) = *(w_ptr1++);	/* left edge */
-				*(++w_ptr2m) = *(w_ptr2--);	/* right edge */
-			}
-		}
-
-		/* the top and the bottom boundary layer of the X,Y plane */
-		for(j=0;j<bcond_thickness;j++) {
-			w_ptr1 = w_ptr + (bcond_thickness+j)*N1;	w_ptr1m = w_ptr + (bcond_thickness-j-1)*N1;
-			w_ptr2 = w_ptr + (bcond_thickness+n2-j-1)*N1;	w_ptr2m = w_ptr + (bcond_thickness+n2+j)*N1;
-			for(i=0;i<N1;i++) {
-				*(w_ptr1m++) = *(w_ptr1++);	/* bottom layer */
-				*(w_ptr2m++) = *(w_ptr2++);	/* top layer */
-			}
-		}
-	}
+	bcond_setup_lateral(w);
 
 	/* Finally, set up the top and bottom layers in the Z direction (this part depends on the current rank) */
 	if(MPIrank==0) {
@@ -338,21 +392,36 @@ static inline FLOAT euclidean_norm(FLOAT v1, FLOAT v2, FLOAT v3)
 /* ------------------ */
 
 
-static inline FLOAT rho(FLOAT p, FLOAT gl)
+/*
+The material laws below can be replaced by formulas from the parameter file ('law' command). The formulas
+are compiled into a shared object at startup (see MaterialLawSource()) and its functions are bound to
+the pointers below. A NULL pointer means that the built-in law is used. The test of the pointer always
+has the same outcome during the calculation, so it costs nothing compared to the indirect call itself.
+*/
+typedef FLOAT (*MATERIAL_LAW)(FLOAT u, FLOAT p, FLOAT gl, const FLOAT * param);
+typedef FLOAT (*FREEZING_CURVE)(FLOAT u, const FLOAT * param);
+
+static MATERIAL_LAW user_rho=NULL, user_cp=NULL, user_lambda=NULL;
+static FREEZING_CURVE user_phf=NULL, user_dphf_du=NULL;
+
+static inline FLOAT rho(FLOAT u, FLOAT p, FLOAT gl)
 /* calculate density of the material with the given composition */
 {
+	if(user_rho) return(user_rho(u,p,gl,param));
 	return (gl*param[glass_rho] + (1.0-gl)*(p*param[ice_rho]+(1.0-p)*param[water_rho]));
 }
 
-static inline FLOAT cp(FLOAT p, FLOAT gl)
+static inline FLOAT cp(FLOAT u, FLOAT p, FLOAT gl)
 /* calculate density of the material with the given composition */
 {
+	if(user_cp) return(user_cp(u,p,gl,param));
 	return (gl*param[glass_cp] + (1.0-gl)*(p*param[ice_cp]+(1.0-p)*param[water_cp]));
 }
 
-static inline FLOAT lambda(FLOAT p, FLOAT gl)
+static inline FLOAT lambda(FLOAT u, FLOAT p, FLOAT gl)
 /* calculate density of the material with the given composition */
 {
+	if(user_lambda) return(user_lambda(u,p,gl,param));
 	return (gl*param[glass_lambda] + (1.0-gl)*(p*param[ice_lambda]+(1.0-p)*param[water_lambda]));
 }
 
@@ -404,7 +473,8 @@ For this to be done, du_dt needs to be calculated first (see f_generic_model2())
 
 	/* My own smooth version (uses the parameter gamma differently, but with a similar effect: the larger gamma, the quicker the phase transition) */
 
-	return ( 0.5* (1.0 - tanhF( param[gamma]*(u-param[u_star]))) );
+	if(user_phf) return(user_phf(u,param));
+	return ( 0.5* (1.0 - vtanhF( param[gamma]*(u-param[u_star]))) );
 }
 
 static inline FLOAT dphf_du(FLOAT u)
@@ -416,10 +486,104 @@ static inline FLOAT dphf_du(FLOAT u)
 	else return (- param[gamma]*powF(param[u_D]/(param[u_star]-u), gamma+1)/param[u_D]);
 	*/
 	/* My own version - see phf() */
-	FLOAT aux = coshF( param[gamma]*(u-param[u_star]) );
+	FLOAT aux;
+	if(user_dphf_du) return(user_dphf_du(u,param));
+	aux = coshF( param[gamma]*(u-param[u_star]) );
 	return( -0.5*param[gamma]/(aux*aux) );
 }
 
+static inline FLOAT face_lambda(FLOAT u, FLOAT p, FLOAT gl, FLOAT glass_fraction)
+/* thermal conductivity of a face partly covered by a sharp glass bead (see CUT_CELL) */
+{
+	if(glass_fraction == 0.0) return(lambda(u,p,gl));
+	return( glass_fraction*lambda(u,p,1.0) + (1.0-glass_fraction)*lambda(u,p,gl) );
+}
+
+/*
+Fourth order heat fluxes (stencil_order 4). The node values are treated as cell averages and the face value and
+the normal derivative of the temperature are reconstructed from the 4 nearest nodes along the normal, which fits
+into 2 layers of auxiliary nodes. For a constant conductivity, the divergence of the fluxes equals the classical
+fourth order 5-point difference. The conductivity is evaluated at the fourth order face value of the temperature,
+but at the second order face values of the phase fields, which are not smooth.
+*/
+
+static inline FLOAT face_flux4(const FLOAT * u, const FLOAT * p, const FLOAT * gl, int d, FLOAT glass_fraction)
+/* returns the heat flux (multiplied by the grid step) through the face between u[0] and u[d] */
+{
+	return( face_lambda((-u[-d] + 7.0*(u[0]+u[d]) - u[2*d]) / 12.0, 0.5*(p[0]+p[d]), 0.5*(gl[0]+gl[d]), glass_fraction)
+		* (u[-d] - 15.0*(u[0]-u[d]) - u[2*d]) / 12.0 );
+}
+
+static inline FLOAT heat_flux_div4(const FLOAT * u, const FLOAT * p, const FLOAT * gl, const FLOAT * gf, FLOAT h1_2, FLOAT h2_2, FLOAT h3_2)
+/* returns div(lambda*grad(u)) in the cell u[0] (see the second order formula in the right hand side). The grid must be uniform. */
+{
+	return(	h1_2 * ( face_flux4(u,p,gl,1,gf[CUT_PX]) - face_flux4(u-1,p-1,gl-1,1,gf[CUT_MX]) ) +
+		h2_2 * ( face_flux4(u,p,gl,N1,gf[CUT_PY]) - face_flux4(u-N1,p-N1,gl-N1,N1,gf[CUT_MY]) ) +
+		h3_2 * ( face_flux4(u,p,gl,rowsize,gf[CUT_PZ]) - face_flux4(u-rowsize,p-rowsize,gl-rowsize,rowsize,gf[CUT_MZ]) ) );
+}
+
+/* ------------------ */
+
+int MaterialLawSource(_string_ src, int size, char formula[][4096])
+/*
+generates the C source code of the material laws given by the formulas (C expressions) in 'formula'
+(empty formulas are skipped, i.e. the built-in laws are used instead). The formulas may use the
+arguments of the respective law (see law_info in model.c), the model parameters by their names and
+the functions from math.h. If a freezing curve is given without its derivative, the derivative is
+evaluated by the central difference. The functions are called law_<name>.
+Returns nonzero if the source does not fit into 'size' characters.
+*/
+{
+	int q, l=0, r;
+
+	#define EMIT(...)	{ r=snprintf(src+l, size-l, __VA_ARGS__); if(r<0 || r>=size-l) return(1); l+=r; }
+
+	EMIT("/* intertrack material laws generated from the parameter file */\n\n#include <math.h>\n\n");
+#if _DEFAULT_FP_PRECISION == FP_FLOAT
+	EMIT("typedef float FLOAT;\n\n");
+#elif _DEFAULT_FP_PRECISION == FP_LONG_DOUBLE
+	EMIT("typedef long double FLOAT;\n\n");
+#else
+	EMIT("typedef double FLOAT;\n\n");
+#endif
+
+	for(q=0;q<PARAM_INFO_SIZE;q++)
+		if(param_info[q].index >= 0) EMIT("#define %s (param[%d])\n", param_info[q].name, param_info[q].index);
+
+	for(q=0;q<LAW_COUNT;q++) {
+		if(!*formula[q]) continue;
+		EMIT("\nFLOAT law_%s(FLOAT %s, const FLOAT * param)\n{\n#line 1 \"law %s\"\n\treturn( %s );\n}\n",
+			law_info[q].name, q<law_phf ? "u, FLOAT p, FLOAT gl" : "u", law_info[q].name, formula[q]);
+	}
+
+	if(*formula[law_phf] && !*formula[law_dphf_du])
+		EMIT("\nFLOAT law_dphf_du(FLOAT u, const FLOAT * param)\n{\n"
+			"\tconst FLOAT h = 6e-6*(1.0+fabs(u));\t/* approx. cbrt(DBL_EPSILON) relative to u */\n"
+			"\treturn( (law_phf(u+h,param) - law_phf(u-h,param)) / (2.0*h) );\n}\n");
+
+	#undef EMIT
+
+	return(0);
+}
+
+void BindMaterialLaws(void * lib)
+/*
+binds the material laws defined in the shared object 'lib' compiled from MaterialLawSource().
+If 'lib' is NULL, the built-in laws are restored.
+*/
+{
+	/* ISO C does not allow a direct conversion of 'void *' to a function pointer */
+	#define BIND(ptr,name)	{ void * sym = cjit_symbol(lib, name); memcpy(&ptr, &sym, sizeof(ptr)); }
+
+	BIND(user_rho, "law_rho");
+	BIND(user_cp, "law_cp");
+	BIND(user_lambda, "law_lambda");
+	BIND(user_phf, "law_phf");
+	BIND(user_dphf_du, "law_dphf_du");
+
+	#undef BIND
+}
+
 
 /* ==================================================================================================== */
 
@@ -427,13 +591,114 @@ static inline FLOAT dphf_du(FLOAT u)
 int AllocPrecalcData(void)
 {
 	precalc = (PRECALC_DATA *)malloc(sizeof(PRECALC_DATA)*n1*n2*n3);
+	if(bead_mode) cut_cell = (CUT_CELL *)calloc(n1*n2*n3, sizeof(CUT_CELL));
 
-	return ( precalc == NULL );
+	return ( precalc == NULL || (bead_mode && cut_cell == NULL) );
 }
 
 void FreePrecalcData(void)
 {
 	free(precalc);
+	free(cut_cell);
+}
+
+static FLOAT chord_overlap(FLOAT c, FLOAT rr, FLOAT lo, FLOAT hi)
+/* returns the length of the part of [lo,hi] covered by the chord of squared half-length rr centered at c */
+{
+	FLOAT h;
+	if(rr <= 0.0) return(0.0);
+	h = sqrtF(rr);
+	return( fmaxF(0.0, fminF(hi, c+h) - fmaxF(lo, c-h)) );
+}
+
+static FLOAT disc_fraction(FLOAT rr, FLOAT c1, FLOAT lo1, FLOAT hi1, FLOAT c2, FLOAT lo2, FLOAT hi2, int strips)
+/*
+returns the fraction of the rectangle [lo1,hi1] x [lo2,hi2] covered by the disc of squared radius rr centered
+at (c1,c2). The rectangle is cut into 'strips' strips along the first coordinate and the chord of the disc
+along the midline of each strip is exact, so only the curvature across the strips is approximated.
+*/
+{
+	FLOAT s, sum = 0.0, h2 = (hi2-lo2) / strips;
+	int q;
+
+	if(rr <= 0.0) return(0.0);
+	for(q=0;q<strips;q++) {
+		s = lo2 + (0.5+q)*h2 - c2;
+		sum += chord_overlap(c1, rr - s*s, lo1, hi1);
+	}
+	return( sum / (strips*(hi1-lo1)) );
+}
+
+void BeadCutCells(int ball_count, const FLOAT * bx, const FLOAT * by, const FLOAT * bz, const FLOAT * br)
+/*
+precalculates the cut cell data (see CUT_CELL) of the block of the current rank from the bead centers and radii. Each bead
+only visits the cells of its bounding box (and those of its periodic images). The contributions of the beads are
+summed up, so the beads are assumed not to overlap (the fractions are only clipped to 1). The volume fraction
+is integrated over 'cutcell_samples' slices of the cell, each of them evaluated like a face.
+*/
+{
+	int i,j,k,q,s,ix,iy,i0,i1,j0,j1,k0,k1;
+	FLOAT h1 = L1/n1, h2 = L2/n2, h3;
+	FLOAT rb, r2;
+	FLOAT cx,cy,cz,x0,y0,z0,x1,y1,z1,zs,vol;
+	FLOAT glass_volume = 0.0, total_volume, beads_volume = 0.0;
+	CUT_CELL * cc;
+
+	for(q=0;q<ball_count;q++) beads_volume += 4.0/3.0*(4.0*atanF(1.0))*br[q]*br[q]*br[q];
+
+	for(q=0;q<ball_count;q++)
+	for(ix=-1;ix<=1;ix++)
+	for(iy=-1;iy<=1;iy++) {
+		/* the periodic images are taken from the center wrapped into the domain */
+		cx = bx[q]; cy = by[q]; cz = bz[q];
+		rb = br[q]; r2 = rb*rb;
+		if(periodic & PERIODIC_X) cx += L1*(ix - floorF(cx/L1));
+		else if(ix) continue;
+		if(periodic & PERIODIC_Y) cy += L2*(iy - floorF(cy/L2));
+		else if(iy) continue;
+
+		/* the bounding box in terms of the cells (the Z range is local to the block and the spacing may vary) */
+		i0 = (int)fmaxF(0.0, floorF((cx-rb)/h1));
+		i1 = (int)fminF(n1-1, floorF((cx+rb)/h1));
+		j0 = (int)fmaxF(0.0, floorF((cy-rb)/h2));
+		j1 = (int)fminF(n2-1, floorF((cy+rb)/h2));
+		for(k0=first_row; k0<first_row+n3 && Z_FACE(k0+1) <= cz-rb; k0++);
+		for(k1=first_row+n3-1; k1>=k0 && Z_FACE(k1) >= cz+rb; k1--);
+
+		for(k=k0;k<=k1;k++)
+		for(j=j0;j<=j1;j++)
+		for(i=i0;i<=i1;i++) {
+			x0 = i*h1; x1 = x0+h1;
+			y0 = j*h2; y1 = y0+h2;
+			z0 = Z_FACE(k); z1 = Z_FACE(k+1); h3 = z1-z0;
+			cc = cut_cell + ((k-first_row)*n2 + j)*n1 + i;
+
+			for(vol=0.0,s=0;s<cutcell_samples;s++) {
+				zs = z0 + (0.5+s)*h3/cutcell_samples - cz;
+				vol += disc_fraction(r2 - zs*zs, cx, x0, x1, cy, y0, y1, cutcell_samples);
+			}
+			cc->vol += vol / cutcell_samples;
+
+			cc->face[CUT_MX] += disc_fraction(r2 - (x0-cx)*(x0-cx), cy, y0, y1, cz, z0, z1, cutcell_samples);
+			cc->face[CUT_PX] += disc_fraction(r2 - (x1-cx)*(x1-cx), cy, y0, y1, cz, z0, z1, cutcell_samples);
+			cc->face[CUT_MY] += disc_fraction(r2 - (y0-cy)*(y0-cy), cx, x0, x1, cz, z0, z1, cutcell_samples);
+			cc->face[CUT_PY] += disc_fraction(r2 - (y1-cy)*(y1-cy), cx, x0, x1, cz, z0, z1, cutcell_samples);
+			cc->face[CUT_MZ] += disc_fraction(r2 - (z0-cz)*(z0-cz), cx, x0, x1, cy, y0, y1, cutcell_samples);
+			cc->face[CUT_PZ] += disc_fraction(r2 - (z1-cz)*(z1-cz), cx, x0, x1, cy, y0, y1, cutcell_samples);
+		}
+	}
+
+	for(cc=cut_cell,k=0;k<n3;k++)
+		for(i=0;i<n1*n2;i++,cc++) {
+			cc->vol = fminF(cc->vol, 1.0);
+			for(q=0;q<6;q++) cc->face[q] = fminF(cc->face[q], 1.0);
+			glass_volume += cc->vol * h1*h2*(Z_FACE(first_row+k+1) - Z_FACE(first_row+k));
+		}
+
+	/* report the glass volume captured by the grid (clipped by the domain boundary and by the overlaps) */
+	MPI_Reduce(&glass_volume, &total_volume, 1, MPI__FLOAT, MPI_SUM, MPIrankmap[0], MPI_COMM_WORLD);
+	Mmprintf(logfile, "Cut cells: glass volume %" FTC_g " of %d beads with the total volume %" FTC_g ".\n\n",
+		total_volume, ball_count, beads_volume);
 }
 
 int PrecalculateData(FLOAT * var_eps_mult)
@@ -459,11 +724,13 @@ int PrecalculateData(FLOAT * var_eps_mult)
 	{
 		int i,j,k,q;
 		FLOAT x,y,z;
+		FLOAT dx,dy;
 		FLOAT glass_phf;
 		FLOAT * ptr;
 		FILE * ball_positions;
-		FLOAT bx[MAX_BALLS_COUNT+1], by[MAX_BALLS_COUNT+1], bz[MAX_BALLS_COUNT+1];
+		FLOAT bx[MAX_BALLS_COUNT+1], by[MAX_BALLS_COUNT+1], bz[MAX_BALLS_COUNT+1], br[MAX_BALLS_COUNT+1];
 		int ball_count;
+		char line[1024];
 
 		char * Glass_balls_errors[]=	{
 							"Reading glass balls positions failed.",
@@ -471,15 +738,20 @@ int PrecalculateData(FLOAT * var_eps_mult)
 
 		int error_code = 0;
 
-		/* read the ball centers coordinates from file */
+		/*
+		read the ball centers coordinates from file, one ball per line. The optional 4th number is the radius of
+		the ball (in the units of the coordinates, e.g. from sphere-collider), otherwise ball_radius applies.
+		*/
 		if(MPIrank==0) {
 			ball_positions = fopen(ball_positions_file,"r");
 			if(ball_positions != NULL) {
-				for(ball_count=0;ball_count<MAX_BALLS_COUNT;ball_count++) {
-					if(fscanf(ball_positions, "%" iFTC_g " %" iFTC_g " %" iFTC_g, bx+ball_count, by+ball_count, bz+ball_count) < 3) break;
+				for(ball_count=0;ball_count<MAX_BALLS_COUNT && fgets(line, sizeof(line), ball_positions) != NULL;ball_count++) {
+					q = sscanf(line, "%" iFTC_g " %" iFTC_g " %" iFTC_g " %" iFTC_g, bx+ball_count, by+ball_count, bz+ball_count, br+ball_count);
+					if(q < 3) break;
 					bx[ball_count] = bx[ball_count] * param[beads_scaling] + param[beads_offset_x];
 					by[ball_count] = by[ball_count] * param[beads_scaling] + param[beads_offset_y];
 					bz[ball_count] = bz[ball_count] * param[beads_scaling] + param[beads_offset_z];
+					br[ball_count] = q > 3 ? br[ball_count] * param[beads_scaling] : param[ball_radius];
 				}
 				fclose(ball_positions);
 
@@ -503,29 +775,41 @@ int PrecalculateData(FLOAT * var_eps_mult)
 		MPI_Bcast(bx, ball_count, MPI__FLOAT, MPIrankmap[0], MPI_COMM_WORLD);
 		MPI_Bcast(by, ball_count, MPI__FLOAT, MPIrankmap[0], MPI_COMM_WORLD);
 		MPI_Bcast(bz, ball_count, MPI__FLOAT, MPIrankmap[0], MPI_COMM_WORLD);
-
-		/* initialize the glass phase field */
-		ptr = VAR(solution,glass_field) + bcond_size;
-		for(k=0;k<n3;k++) {
-			z = L3* (0.5+k+first_row) / total_n3;
-			ptr += bcond_thickness*N1;
-			for(j=0;j<n2;j++) {
-				y = L2 * (0.5+j) / n2;
-				ptr += bcond_thickness;
-				for(i=0;i<n1;i++) {
-					x = L1 * (0.5+i) / n1;
-					for(q=0;q<ball_count;q++) {
-						/* sharp identification (1 or 0) */
-//						if(euclidean_norm(x-bx[q],y-by[q],z-bz[q]) <= param[ball_radius]) *ptr = 1.0;
-						/* phase field profile similar to that of the solution (requires initial condition set to zero in the parameters file) */
-						glass_phf = 0.5*(1.0 - tanh(0.5/param[xi_gl]*(euclidean_norm(x-bx[q],y-by[q],z-bz[q]) - param[ball_radius])));
-						if(*ptr < glass_phf)  *ptr = glass_phf;
+		MPI_Bcast(br, ball_count, MPI__FLOAT, MPIrankmap[0], MPI_COMM_WORLD);
+
+		/* embed the beads in the grid as cut cells, or voxelize them into the glass phase field */
+		if(bead_mode) BeadCutCells(ball_count, bx, by, bz, br);
+		else {
+			ptr = VAR(solution,glass_field) + bcond_size;
+			for(k=0;k<n3;k++) {
+				z = Z_NODE(k+first_row);
+				ptr += bcond_thickness*N1;
+				for(j=0;j<n2;j++) {
+					y = L2 * (0.5+j) / n2;
+					ptr += bcond_thickness;
+					for(i=0;i<n1;i++) {
+						x = L1 * (0.5+i) / n1;
+						for(q=0;q<ball_count;q++) {
+							/*
+							in the periodic directions, the nearest periodic image of the ball is taken. The phase field
+							decreases with the distance, so its maximum over all images is attained there.
+							*/
+							dx = x-bx[q];
+							dy = y-by[q];
+							if(periodic & PERIODIC_X) dx -= L1*floorF(dx/L1+0.5);
+							if(periodic & PERIODIC_Y) dy -= L2*floorF(dy/L2+0.5);
+							/* sharp identification (1 or 0) */
+//							if(euclidean_norm(dx,dy,z-bz[q]) <= br[q]) *ptr = 1.0;
+							/* phase field profile similar to that of the solution (requires initial condition set to zero in the parameters file) */
+							glass_phf = 0.5*(1.0 - vtanhF(0.5/param[xi_gl]*(euclidean_norm(dx,dy,z-bz[q]) - br[q])));
+							if(*ptr < glass_phf)  *ptr = glass_phf;
+						}
+						ptr++;
 					}
-					ptr++;
+					ptr += bcond_thickness;
 				}
-				ptr += bcond_thickness;
+				ptr += bcond_thickness*N1;
 			}
-			ptr += bcond_thickness*N1;
 		}
 	}
 
@@ -599,17 +883,37 @@ void f_generic_model01(FLOAT t,const FLOAT * const_w,FLOAT * dw_dt)
 	FLOAT * u, *p, *gl, *du_dt, *dp_dt, *dgl_dt;
 	PRECALC_DATA * pr;
 
+	/* the cut cell data (see CUT_CELL): glass fractions of the faces and of the volume */
+	CUT_CELL * cc = NULL;
+	const FLOAT * gf = no_cut_faces;
+	FLOAT vf = 0.0;
+
 	FLOAT this_rho, this_cp, this_lambda;
+	FLOAT heat_capacity, heat_flux;
 
-	/* $1 \over h_{1}$ , $1 \over h_{2}$ and $1 \over h_{3}$ */
+	/* $1 \over h_{1}$ and $1 \over h_{2}$ */
 	FLOAT h1 = ((FLOAT)n1) / L1;
 	FLOAT h2 = ((FLOAT)n2) / L2;
-	FLOAT h3 = ((FLOAT)total_n3) / L3;
 
-	/* squares and multiples of h1,h2,h3 used in the difference quotients */
+	/* squares and multiples of h1,h2 used in the difference quotients */
 	FLOAT h1_2 = h1*h1, h1_div_2 = 0.5*h1;
 	FLOAT h2_2 = h2*h2, h2_div_2 = 0.5*h2;
-	FLOAT h3_2 = h3*h3, h3_div_2 = 0.5*h3;
+
+	/*
+	the grid spacing along Z may vary (see Z_FACE() and Z_NODE() in intertrack.c). The counterparts of h3_2
+	for the lower and the upper face and of h3_div_2 are calculated for each row.
+	*/
+	FLOAT h3_m2, h3_p2, h3_div_2;
+
+	/*
+	the offsets of the neighbors used in the stencil: with fused_bcond, the auxiliary nodes at the physical boundaries
+	are not set up at all. The offsets then address the mirrored node (zero Neumann b.c.) or the node at the opposite
+	side of the domain (periodic b.c.) directly, and u_zp holds the Dirichlet value above the top row. Only the rows
+	received from the neighbor ranks remain as auxiliary data. Otherwise, the offsets equal the basic ones.
+	*/
+	int nm__ = m__, np__ = p__, n_m_ = _m_, n_p_ = _p_, n__m = __m, n__p = __p;
+	char dirichlet_top = 0;
+	FLOAT u_zp;
 
 	/*
 	The input array uu is modifed in some places of this function, which requires explicit removal
@@ -621,11 +925,23 @@ void f_generic_model01(FLOAT t,const FLOAT * const_w,FLOAT * dw_dt)
 	*/
 	FLOAT * w = (FLOAT *)const_w;
 
-	bcond_setup(t, w);
+	if(!fused_bcond) bcond_setup(t, w);
 
 	sync_solution(w);
 
 	for(k=0;k<n3;k++) {
+		/* 1 / (the row width * the distance of the nodes across the face) and 1 / (the distance of the neighbor nodes) */
+		h3_m2 = 1.0 / ((Z_FACE(first_row+k+1) - Z_FACE(first_row+k)) * (Z_NODE(first_row+k) - Z_NODE(first_row+k-1)));
+		h3_p2 = 1.0 / ((Z_FACE(first_row+k+1) - Z_FACE(first_row+k)) * (Z_NODE(first_row+k+1) - Z_NODE(first_row+k)));
+		h3_div_2 = 1.0 / (Z_NODE(first_row+k+1) - Z_NODE(first_row+k-1));
+
+		/* the first rank holds the bottom and the last rank the top of the domain */
+		if(fused_bcond) {
+			n__m = (k>0 || MPIrank>0) ? __m : ___;
+			n__p = (k<n3-1 || MPIrank<MPIprocs-1) ? __p : ___;
+			dirichlet_top = (n__p == ___);
+		}
+
 		/*
 		the parallel loop iteration scheduling policy is set to 'runtime'.
 		It is therefore controlled by the value of the OMP_SCHEDULE environment variable
@@ -637,36 +953,53 @@ void f_generic_model01(FLOAT t,const FLOAT * const_w,FLOAT * dw_dt)
 			p = VAR(w,phase_field) + offset;
 			gl = VAR(w,glass_field) + offset;
 			pr = precalc + (k*n2 + j)*n1;
+			if(cut_cell) cc = cut_cell + (k*n2 + j)*n1;
 
 			du_dt = VAR(dw_dt,temperature_field) + offset;
 			dp_dt = VAR(dw_dt,phase_field) + offset;
 			dgl_dt = VAR(dw_dt,glass_field) + offset;
 
+			if(fused_bcond) {
+				n_m_ = j>0 ? _m_ : ((periodic & PERIODIC_Y) ? (n2-1)*N1 : ___);
+				n_p_ = j<n2-1 ? _p_ : ((periodic & PERIODIC_Y) ? -(n2-1)*N1 : ___);
+			}
+
 			for(i=0;i<n1;i++) {
+				if(fused_bcond) {
+					nm__ = i>0 ? m__ : ((periodic & PERIODIC_X) ? n1-1 : ___);
+					np__ = i<n1-1 ? p__ : ((periodic & PERIODIC_X) ? 1-n1 : ___);
+				}
 
 				/* THE RIGHT HAND SIDE FORMULA using finite volume method to discretize div(grad(p)) and div(D(grad(p))) */
 				/* ----------------------------------------------------------------------------------------------------- */
 
-				this_rho = rho(p[___],gl[___]);
-				this_cp = cp(p[___],gl[___]);
-				this_lambda = lambda(p[___],gl[___]);
+				this_rho = rho(u[___],p[___],gl[___]);
+				this_cp = cp(u[___],p[___],gl[___]);
+				this_lambda = lambda(u[___],p[___],gl[___]);
+
+				/* in bead_mode 1, the glass beads take the fraction vf of the cell */
+				if(cut_cell) {
+					gf = cc->face;
+					vf = cc->vol;
+					cc++;
+				}
 
 				/*
 				A. gradually compute the right hand side of the Allen-Cahn equation (divided by $\alpha \xi^{2}$):
 				--------------------------------------------------------------------------------------------------
 				*/
-				/* div(lambda*grad(u)) */
+				/* div(grad(p)), with the fluxes only through the water part of the faces of the cut cells */
 				*dp_dt =  (
-					/* YZ planes */	  h1_2 * (	- ( - p[m__] + p[___] )
-									+ ( - p[___] + p[p__] )
+					/* YZ planes */	  h1_2 * (	- (1.0-gf[CUT_MX]) * ( - p[nm__] + p[___] )
+									+ (1.0-gf[CUT_PX]) * ( - p[___] + p[np__] )
 							            ) +
-					/* XZ planes */	  h2_2 * (	- ( - p[_m_] + p[___] )
-									+ ( - p[___] + p[_p_] )
+					/* XZ planes */	  h2_2 * (	- (1.0-gf[CUT_MY]) * ( - p[n_m_] + p[___] )
+									+ (1.0-gf[CUT_PY]) * ( - p[___] + p[n_p_] )
 							            ) +
-					/* XY planes */	  h3_2 * (	- ( - p[__m] + p[___] )
-									+ ( - p[___] + p[__p] )
+					/* XY planes */	  	 (	- h3_m2 * (1.0-gf[CUT_MZ]) * ( - p[n__m] + p[___] )
+									+ h3_p2 * (1.0-gf[CUT_PZ]) * ( - p[___] + p[n__p] )
 							            )
-					);
+					) / fmaxF(1.0-vf, CUTCELL_MIN_FRACTION);
 
 				/* source term */
 				switch(calc_mode) {
@@ -675,9 +1008,9 @@ void f_generic_model01(FLOAT t,const FLOAT * const_w,FLOAT * dw_dt)
 						/* GradP model */
 						*dp_dt += f_GradP(u[___]+pr->u_noise, p[___],
 							euclidean_norm(
-										h1_div_2 * ( - p[m__] + p[p__] ),
-										h2_div_2 * ( - p[_m_] + p[_p_] ),
-										h3_div_2 * ( - p[__m] + p[__p] )
+										h1_div_2 * ( - p[nm__] + p[np__] ),
+										h2_div_2 * ( - p[n_m_] + p[n_p_] ),
+										h3_div_2 * ( - p[n__m] + p[n__p] )
 									)
 								);
 						break;
@@ -692,6 +1025,7 @@ void f_generic_model01(FLOAT t,const FLOAT * const_w,FLOAT * dw_dt)
 
 				/* evolve the phase field only outside the glass balls */
 				*dp_dt *= water_indicator(gl[___]);
+				if(vf > 1.0-CUTCELL_MIN_FRACTION) *dp_dt = 0.0;
 				
 				/*
 				B. compute the right hand side of the heat equation in one formula:
@@ -699,7 +1033,8 @@ void f_generic_model01(FLOAT t,const FLOAT * const_w,FLOAT * dw_dt)
 				The first 'hi' in the square of 'hi' (hi_2) is in fact 1 / the volume of the cell
 				(h1*h2*h3 = $1\over{h_{1}h_{2}h_{3}}$) multiplied by the area of the face
 				(e.g. h_{2}h_{3} on the first line).
-				The second 'hi' belongs to the respective difference quotient.
+				The second 'hi' belongs to the respective difference quotient. Along Z, h3_m2 and h3_p2
+				take the variable grid spacing into account.
 				*/
 				switch(calc_mode) {
 					case 10:
@@ -708,19 +1043,26 @@ void f_generic_model01(FLOAT t,const FLOAT * const_w,FLOAT * dw_dt)
 						*du_dt = 0.0;
 						break;
 					default:
-						*du_dt =	(	(
-							/* YZ planes */	  h1_2 * (	- lambda(0.5*(p[m__]+p[___]),0.5*(gl[m__]+gl[___])) * ( - u[m__] + u[___] )
-											+ lambda(0.5*(p[___]+p[p__]),0.5*(gl[___]+gl[p__])) * ( - u[___] + u[p__] )
+						/* the volumetric heat capacity of the cell (the latent heat is only released in the water part) */
+						heat_capacity = (1.0-vf)*this_rho*this_cp;
+						if(vf > 0.0) heat_capacity += vf*rho(u[___],p[___],1.0)*cp(u[___],p[___],1.0);
+
+						/* div(lambda*grad(u)) */
+						u_zp = dirichlet_top ? temperature_Dirichlet_B_C(t, i, j, total_n3) : u[n__p];
+						if(stencil_order == 4) heat_flux = heat_flux_div4(u, p, gl, gf, h1_2, h2_2, h3_p2);
+						else heat_flux =	(
+							/* YZ planes */	  h1_2 * (	- face_lambda(0.5*(u[nm__]+u[___]),0.5*(p[nm__]+p[___]),0.5*(gl[nm__]+gl[___]),gf[CUT_MX]) * ( - u[nm__] + u[___] )
+											+ face_lambda(0.5*(u[___]+u[np__]),0.5*(p[___]+p[np__]),0.5*(gl[___]+gl[np__]),gf[CUT_PX]) * ( - u[___] + u[np__] )
 										) +
-							/* XZ planes */	  h2_2 * (	- lambda(0.5*(p[_m_]+p[___]),0.5*(gl[_m_]+gl[___])) * ( - u[_m_] + u[___] )
-											+ lambda(0.5*(p[___]+p[_p_]),0.5*(gl[___]+gl[_p_])) * ( - u[___] + u[_p_] )
+							/* XZ planes */	  h2_2 * (	- face_lambda(0.5*(u[n_m_]+u[___]),0.5*(p[n_m_]+p[___]),0.5*(gl[n_m_]+gl[___]),gf[CUT_MY]) * ( - u[n_m_] + u[___] )
+											+ face_lambda(0.5*(u[___]+u[n_p_]),0.5*(p[___]+p[n_p_]),0.5*(gl[___]+gl[n_p_]),gf[CUT_PY]) * ( - u[___] + u[n_p_] )
 										) +
-							/* XY planes */	  h3_2 * (	- lambda(0.5*(p[__m]+p[___]),0.5*(gl[__m]+gl[___])) * ( - u[__m] + u[___] )
-											+ lambda(0.5*(p[___]+p[__p]),0.5*(gl[___]+gl[__p])) * ( - u[___] + u[__p] )
+							/* XY planes */	  	 (	- h3_m2 * face_lambda(0.5*(u[n__m]+u[___]),0.5*(p[n__m]+p[___]),0.5*(gl[n__m]+gl[___]),gf[CUT_MZ]) * ( - u[n__m] + u[___] )
+											+ h3_p2 * face_lambda(0.5*(u[___]+u_zp),0.5*(p[___]+p[n__p]),0.5*(gl[___]+gl[n__p]),gf[CUT_PZ]) * ( - u[___] + u_zp )
 										)
-										) / this_rho	
-										+ param[L] * (*dp_dt)
-									) / this_cp;
+										);
+
+						*du_dt = ( heat_flux + (1.0-vf)*this_rho*param[L] * (*dp_dt) ) / heat_capacity;
 				}
 
 				/*
@@ -778,18 +1120,33 @@ void f_generic_model2(FLOAT t,const FLOAT * const_w,FLOAT * dw_dt)
 	FLOAT * u, *p, *gl, *du_dt, *dp_dt, *dgl_dt;
 	PRECALC_DATA * pr;
 
+	/* the cut cell data (see CUT_CELL): glass fractions of the faces and of the volume */
+	CUT_CELL * cc = NULL;
+	const FLOAT * gf = no_cut_faces;
+	FLOAT vf = 0.0;
+
 	FLOAT this_rho, this_cp, this_lambda;
+	FLOAT heat_capacity, heat_flux;
 	FLOAT dp_du;
 
-	/* $1 \over h_{1}$ , $1 \over h_{2}$ and $1 \over h_{3}$ */
+	/* $1 \over h_{1}$ and $1 \over h_{2}$ */
 	FLOAT h1 = ((FLOAT)n1) / L1;
 	FLOAT h2 = ((FLOAT)n2) / L2;
-	FLOAT h3 = ((FLOAT)total_n3) / L3;
 
-	/* squares and multiples of h1,h2,h3 used in the difference quotients */
+	/* squares and multiples of h1,h2 used in the difference quotients */
 	FLOAT h1_2 = h1*h1, h1_div_2 = 0.5*h1;
 	FLOAT h2_2 = h2*h2, h2_div_2 = 0.5*h2;
-	FLOAT h3_2 = h3*h3, h3_div_2 = 0.5*h3;
+
+	/*
+	the grid spacing along Z may vary (see Z_FACE() and Z_NODE() in intertrack.c). The counterparts of h3_2
+	for the lower and the upper face are calculated for each row.
+	*/
+	FLOAT h3_m2, h3_p2;
+
+	/* the offsets of the neighbors and the Dirichlet value above the top row (see f_generic_model01()) */
+	int nm__ = m__, np__ = p__, n_m_ = _m_, n_p_ = _p_, n__m = __m, n__p = __p;
+	char dirichlet_top = 0;
+	FLOAT u_zp;
 
 	/*
 	The input array uu is modifed in some places of this function, which requires explicit removal
@@ -801,11 +1158,22 @@ void f_generic_model2(FLOAT t,const FLOAT * const_w,FLOAT * dw_dt)
 	*/
 	FLOAT * w = (FLOAT *)const_w;
 
-	bcond_setup(t, w);
+	if(!fused_bcond) bcond_setup(t, w);
 
 	sync_solution(w);
 
 	for(k=0;k<n3;k++) {
+		/* 1 / (the row width * the distance of the nodes across the face) */
+		h3_m2 = 1.0 / ((Z_FACE(first_row+k+1) - Z_FACE(first_row+k)) * (Z_NODE(first_row+k) - Z_NODE(first_row+k-1)));
+		h3_p2 = 1.0 / ((Z_FACE(first_row+k+1) - Z_FACE(first_row+k)) * (Z_NODE(first_row+k+1) - Z_NODE(first_row+k)));
+
+		/* the first rank holds the bottom and the last rank the top of the domain */
+		if(fused_bcond) {
+			n__m = (k>0 || MPIrank>0) ? __m : ___;
+			n__p = (k<n3-1 || MPIrank<MPIprocs-1) ? __p : ___;
+			dirichlet_top = (n__p == ___);
+		}
+
 		/*
 		the parallel loop iteration scheduling policy is set to 'runtime'.
 		It is therefore controlled by the value of the OMP_SCHEDULE environment variable
@@ -817,12 +1185,22 @@ void f_generic_model2(FLOAT t,const FLOAT * const_w,FLOAT * dw_dt)
 			p = VAR(w,phase_field) + offset;
 			gl = VAR(w,glass_field) + offset;
 			pr = precalc + (k*n2 + j)*n1;
+			if(cut_cell) cc = cut_cell + (k*n2 + j)*n1;
 
 			du_dt = VAR(dw_dt,temperature_field) + offset;
 			dp_dt = VAR(dw_dt,phase_field) + offset;
 			dgl_dt = VAR(dw_dt,glass_field) + offset;
 
+			if(fused_bcond) {
+				n_m_ = j>0 ? _m_ : ((periodic & PERIODIC_Y) ? (n2-1)*N1 : ___);
+				n_p_ = j<n2-1 ? _p_ : ((periodic & PERIODIC_Y) ? -(n2-1)*N1 : ___);
+			}
+
 			for(i=0;i<n1;i++) {
+				if(fused_bcond) {
+					nm__ = i>0 ? m__ : ((periodic & PERIODIC_X) ? n1-1 : ___);
+					np__ = i<n1-1 ? p__ : ((periodic & PERIODIC_X) ? 1-n1 : ___);
+				}
 
 				/* THE RIGHT HAND SIDE FORMULA using finite volume method to discretize div(grad(p)) and div(D(grad(p))) */
 				/* ----------------------------------------------------------------------------------------------------- */
@@ -832,12 +1210,24 @@ void f_generic_model2(FLOAT t,const FLOAT * const_w,FLOAT * dw_dt)
 				from the known value of its derivative, so it can be used here
 				*/
 
-				this_rho = rho(p[___],gl[___]);
-				this_cp = cp(p[___],gl[___]);
-				this_lambda = lambda(p[___],gl[___]);
+				this_rho = rho(u[___],p[___],gl[___]);
+				this_cp = cp(u[___],p[___],gl[___]);
+				this_lambda = lambda(u[___],p[___],gl[___]);
+
+				/* in bead_mode 1, the glass beads take the fraction vf of the cell */
+				if(cut_cell) {
+					gf = cc->face;
+					vf = cc->vol;
+					cc++;
+				}
 
 				/* evolve the phase field only outside the glass balls */
 				dp_du = dphf_du(u[___]) * water_indicator(gl[___]);
+				if(vf > 1.0-CUTCELL_MIN_FRACTION) dp_du = 0.0;
+
+				/* the volumetric heat capacity of the cell including the latent heat (released in the water part only) */
+				heat_capacity = (1.0-vf)*this_rho*(this_cp - param[L]*dp_du);
+				if(vf > 0.0) heat_capacity += vf*rho(u[___],p[___],1.0)*cp(u[___],p[___],1.0);
 				
 				/*
 				B. first compute the right hand side of the heat equation in one formula:
@@ -845,19 +1235,24 @@ void f_generic_model2(FLOAT t,const FLOAT * const_w,FLOAT * dw_dt)
 				The first 'hi' in the square of 'hi' (hi_2) is in fact 1 / the volume of the cell
 				(h1*h2*h3 = $1\over{h_{1}h_{2}h_{3}}$) multiplied by the area of the face
 				(e.g. h_{2}h_{3} on the first line).
-				The second 'hi' belongs to the respective difference quotient.
+				The second 'hi' belongs to the respective difference quotient. Along Z, h3_m2 and h3_p2
+				take the variable grid spacing into account.
 				*/
-				*du_dt =	(
-					/* YZ planes */	  h1_2 * (	- lambda(0.5*(p[m__]+p[___]),0.5*(gl[m__]+gl[___])) * ( - u[m__] + u[___] )
-									+ lambda(0.5*(p[___]+p[p__]),0.5*(gl[___]+gl[p__])) * ( - u[___] + u[p__] )
+				u_zp = dirichlet_top ? temperature_Dirichlet_B_C(t, i, j, total_n3) : u[n__p];
+				if(stencil_order == 4) heat_flux = heat_flux_div4(u, p, gl, gf, h1_2, h2_2, h3_p2);
+				else heat_flux =	(
+					/* YZ planes */	  h1_2 * (	- face_lambda(0.5*(u[nm__]+u[___]),0.5*(p[nm__]+p[___]),0.5*(gl[nm__]+gl[___]),gf[CUT_MX]) * ( - u[nm__] + u[___] )
+									+ face_lambda(0.5*(u[___]+u[np__]),0.5*(p[___]+p[np__]),0.5*(gl[___]+gl[np__]),gf[CUT_PX]) * ( - u[___] + u[np__] )
 							            ) +
-					/* XZ planes */	  h2_2 * (	- lambda(0.5*(p[_m_]+p[___]),0.5*(gl[_m_]+gl[___])) * ( - u[_m_] + u[___] )
-									+ lambda(0.5*(p[___]+p[_p_]),0.5*(gl[___]+gl[_p_])) * ( - u[___] + u[_p_] )
+					/* XZ planes */	  h2_2 * (	- face_lambda(0.5*(u[n_m_]+u[___]),0.5*(p[n_m_]+p[___]),0.5*(gl[n_m_]+gl[___]),gf[CUT_MY]) * ( - u[n_m_] + u[___] )
+									+ face_lambda(0.5*(u[___]+u[n_p_]),0.5*(p[___]+p[n_p_]),0.5*(gl[___]+gl[n_p_]),gf[CUT_PY]) * ( - u[___] + u[n_p_] )
 							            ) +
-					/* XY planes */	  h3_2 * (	- lambda(0.5*(p[__m]+p[___]),0.5*(gl[__m]+gl[___])) * ( - u[__m] + u[___] )
-									+ lambda(0.5*(p[___]+p[__p]),0.5*(gl[___]+gl[__p])) * ( - u[___] + u[__p] )
+					/* XY planes */	  	 (	- h3_m2 * face_lambda(0.5*(u[n__m]+u[___]),0.5*(p[n__m]+p[___]),0.5*(gl[n__m]+gl[___]),gf[CUT_MZ]) * ( - u[n__m] + u[___] )
+									+ h3_p2 * face_lambda(0.5*(u[___]+u_zp),0.5*(p[___]+p[n__p]),0.5*(gl[___]+gl[n__p]),gf[CUT_PZ]) * ( - u[___] + u_zp )
 							            )
-						) / ( this_rho * (this_cp - param[L]*dp_du) );
+						);
+
+				*du_dt = heat_flux / heat_capacity;
 				
 				/*
 				A. compute the derivative of the phase field locally so that it evolves according to phf(u[___]),
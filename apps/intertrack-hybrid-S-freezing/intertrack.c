@@ -58,8 +58,11 @@ master rank (master process) .. the process that controls the calculation. It lo
 				can make its own ordering of the (virtual) ranks, irrespective of the actual
 				rank ordering provided by MPI. The permutation must be known to all ranks before
 				any MPI communication occurs. The rank of the master process is therefore
-				specified on the command line. Currently, the permutation just swaps rank 0 and
-				the master rank specified on the command line.
+				specified on the command line. The permutation maps the virtual rank 0 to
+				the master rank specified on the command line and keeps the ranks of each
+				node (and within a node, the ranks of each socket) together, so that the
+				neighbouring blocks exchange their boundary data locally where possible
+				(see MPI_topology.h).
 				The RK solver does not have to be aware of the permutation, as the RK solver
 				itself does not rely on rank ordering in any manner. However, it allows one to
 				choose the master process rank, which is necessary if the calculation
@@ -107,6 +110,8 @@ This macro affects the GNU C library and the HP-UX C library, and possibly other
 #include "mprintf.h"
 
 #include "RK_MPI_SAsolver.h"	/* this also includes mpi.h */
+#include "MPI_topology.h"
+#include "cjit.h"
 
 #include <netcdf.h>
 
@@ -124,7 +129,9 @@ This macro affects the GNU C library and the HP-UX C library, and possibly other
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <limits.h>
 #include "mathspec.h"
 
 /*
@@ -206,8 +213,9 @@ if the time since the last commit is at least MIN_LOG_COMMIT_INTERVAL.
 /* message tags (types) */
 #define MPIMSG_SOLUTION	100	/* solution gathering or initial condition deployment (add q for the q-th variable) */
 #define MPIMSG_BOUNDARY	200	/* boundary grid nodes exchange (add q for the q-th variable) */
+#define MPIMSG_ISOSURFACE	300	/* the first row of the phase field sent to the previous rank (see isosurface()) */
 
-#define MPIMSG_PROCNAME		400	/* processor name gathering */
+#define MPIMSG_PROCNAME		400	/* processor name and thread binding gathering */
 #define MPIMSG_CUSTOM		500	/* please index custom transfer tags in equation.c by MPIMSG_CUSTOM+i where i>=0 */
 
 /*
@@ -220,7 +228,8 @@ typedef enum
 	MPICMD_HALT,
 	MPICMD_NEXT,
 	MPICMD_SOLVE,
-	MPICMD_SNAPSHOT
+	MPICMD_SNAPSHOT,
+	MPICMD_ISOSURFACE
 } MPI_Command;
 
 /* all commands are passed only through this variable */
@@ -240,6 +249,10 @@ static int * MPIrankmap;	/* the rank permutation array. All MPI communication in
 				   use as a master rank and intertrack will establish a rank permutation that will map
 				   the virtual master rank 0 to the desired rank.
 				*/
+static MPI_TOPOLOGY MPItopology;	/* the placement of this process (node, socket) */
+static char MPIbinding[512];		/* the description of the OpenMP thread binding of this process */
+static char bind_threads=1;		/* pin the OpenMP threads to CPUs (see MPI_topology_bind_threads()) */
+static char threads_bound=0;		/* nonzero once the binding has been decided (in the first batch iteration) */
 
 static int MPIrank;		/* the VIRTUAL rank of this process */
 static int MPIprocs;		/* the total number of ranks in the MPI universe */
@@ -302,9 +315,29 @@ typedef struct
 	int calc_mode;
 	char icond_mode;
 	char grid_IO_mode;
+	char periodic;
+	char bead_mode;
+	int cutcell_samples;
+	int stencil_order;
+	char fused_bcond;
+	char out_local;
+	FLOAT iso_level;
+	char bind_threads;
+
+	int autotune_iterations;
+	int plan_iterations;
+	int stiffness_mode;
+
+	int error_norm;
+	FLOAT rms_atol, rms_rtol;
+	FLOAT var_atol[VAR_COUNT], var_rtol[VAR_COUNT];
 
 	FLOAT model_parameters[PARAM_COUNT];
 	char icond_formula[VAR_COUNT][4096];
+
+	char law_formula[LAW_COUNT][4096];
+	char law_compiler[4096];
+	char law_cache[4096];
 } MPI_Calculation;
 
 static FLOAT final_time;
@@ -316,10 +349,54 @@ static FLOAT starting_time;		/* this can be overriden by the continue_series opt
 static char out_file[4096]="";		/* output files path template*/
 static char out_file_suffix[256]="";	/* suffix added to each snapshot pathname (possibly empty) */
 
+/* time series output */
+static char out_series=0;		/* if nonzero, the ordinary snapshots are appended as records along the unlimited
+					   dimension 't' of a single dataset named <out_file><out_file_suffix> instead of
+					   being saved to separate files. The record index is the snapshot number, so that
+					   a continued series overwrites the records following the starting snapshot.
+					   On-demand snapshots are still saved to separate files. */
+static char out_local=0;		/* if nonzero, each rank saves its block of the grid (without the auxiliary nodes)
+					   to its own dataset <snapshot file name>.r<rank><out_file_suffix> instead of
+					   sending it to the master. The position of the block is stored in the attributes
+					   first_row and global_dims. The datasets are merged by the snapmerge utility. */
+
+/* in-situ isosurface output */
+static int iso_every=0;			/* the isosurface p=iso_level of the phase field is saved as a triangle mesh (binary PLY)
+					   <out_file>.<snapshot>.ply with every iso_every-th ordinary snapshot (0 = never).
+					   The interface area is appended to <out_file>.area as a by-product. */
+static FLOAT iso_level=0.5;
+static char iso_only=0;			/* if nonzero, only the last NetCDF snapshot is saved (the isosurfaces replace the others) */
+
+static int series_chunk_t=1;		/* the number of records in one chunk of the series variables */
+static int series_deflate=0;		/* the deflate level of the series variables (0 = no compression) */
+static int icond_record=-1;		/* the record of the initial conditions dataset to be loaded (-1 if the
+					   dataset is not a time series) */
+
+/* batch iteration result cache */
+static char result_cache=0;		/* if nonzero, each batch iteration records the hash of its fully evaluated parameters
+					   and the last saved snapshot in the file <base_name><loopVarString>.result in its
+					   output directory. An iteration whose results are complete is then skipped and an
+					   interrupted one is resumed from its last snapshot (see parameters_hash()). */
+static char result_file[4096];		/* the result file of the current iteration */
+static unsigned long long result_hash;	/* the parameters hash of the current iteration */
+static char result_resumed=0;		/* nonzero if the initial conditions settings below have been overridden in order to
+					   resume an interrupted iteration. They are restored before the next iteration. */
+static char saved_icond_mode, saved_continue_series, saved_skip_icond;
+static char saved_icond_file[4096];
+
 /* initial conditions specifications (either math formulae or a path to the dataset containing the initial condition) */
 static char icond_formula[VAR_COUNT][4096];	/* initial conditions formulas for all variables */
 static char icond_file[4096]="";		/* initial conditions dataset file name (contains both u and p) */
 
+/* natively compiled material laws (see SetupMaterialLaws()) */
+static char law_formula[LAW_COUNT][4096];	/* C expressions replacing the built-in material laws (empty = built-in) */
+static char law_compiler[4096]="";		/* the compiler command (default "cc") */
+static char law_cache[4096]="";			/* the directory where the compiled laws are cached (default ".") */
+static void * law_lib=NULL;			/* the shared object with the compiled laws bound to the right hand side */
+
+/* reference solution formulas (empty = none). The error of the solution is reported with each snapshot. */
+static char reference_formula[VAR_COUNT][4096];
+
 /* debug log / snapshot trigger */
 static char debug_logging=0;		/* if nonzero, one line will be written to the debug log after each successful
 					   time step of the RK solver. Information about the solution progress
@@ -334,6 +411,31 @@ static char snapshot_trigger=0;		/* if nonzero, immediate on-demand snapshot gen
 					   the 'touch' command. */
 static char snapshot_trigger_file[4096];
 
+/* RK solver autotuning */
+static int autotune_iterations=0;	/* the number of right hand side evaluations timed for each candidate OpenMP work
+					   sharing setup of the RK solver (0 = no autotuning, the default setup is used) */
+static char autotune_cache[4096]="";	/* the file where the selected setups are stored for later runs with the same
+					   grid dimensions, number of ranks and threads, host and calculation mode */
+
+/* resource planner */
+static int plan_iterations=0;		/* the resource planner dry run (see PlanResources()): the number of right hand side
+					   evaluations timed for each candidate setup in the calibration (0 = normal run) */
+static int plan_n3;			/* the actual grid depth (total_n3 is replaced by that of the calibration grid) */
+static int plan_ranks, plan_threads;	/* the rank and thread layout to be reported */
+static FLOAT plan_wall_time;		/* the target wall time (0 = none) */
+static FLOAT plan_memory;		/* the memory available per core [bytes] (0 = unlimited) */
+static FLOAT plan_steps;		/* the expected number of RK steps */
+
+/* RK solver stiffness detection */
+static int stiffness_mode=RK_STIFF_OFF;	/* RK_STIFF_OFF, RK_STIFF_DETECT (report h*rho in the logs) or RK_STIFF_SWITCH
+					   (moreover, switch to the Rosenbrock method while the problem is stiff) */
+
+/* RK solver error norm */
+static int error_norm=RK_NORM_MAX;	/* RK_NORM_MAX or RK_NORM_RMS (weighted root mean square) */
+static FLOAT rms_atol=0.0, rms_rtol=0.0;	/* the default tolerances of RK_NORM_RMS */
+static FLOAT var_atol[VAR_COUNT];	/* the tolerances of the individual variables (RK_NORM_RMS only) */
+static FLOAT var_rtol[VAR_COUNT];
+
 static char pproc_script[4096]="";	/* the path to the post-processing script */
 
 static char pproc_nofail=0;	/* if set to nonzero, intertrack will terminate in case the post-processing
@@ -405,7 +507,10 @@ static char continue_series=0;	/* if nonzero and the initial conditions are load
 				   the final time or if the starting snapshot number is greater or equal to the total
 				   number of snapshots. Other changes of parameters (with respect to the calculation the
 				   initial conditions came from) will be accepted. The remaining time period is
-				   always uniformly divided between the remaining number of snapshots to be taken. */
+				   always uniformly divided between the remaining number of snapshots to be taken.
+				   If the initial conditions dataset is a time series (see out_series), its last
+				   complete record is used and, in the time series output mode, the output series
+				   is reopened and continued rather than overwritten. */
 static int __snapshot;		/* global variable holding the number of the currently computed snapshot. It is used
 				   by the RK slover debug logging from within the RKService() callback (see further on) */
 
@@ -413,6 +518,34 @@ static char grid_IO_mode=1;	/* grid input/output mode: 0 = full grid with auxili
 							   1 = inner grid (covering Omega) only */
 static char icond_mode=0;	/* initial conditions mode: 0 = formulae, 1 = from file */
 
+#define PERIODIC_X	1
+#define PERIODIC_Y	2
+static char periodic=0;		/* the lateral directions with periodic boundary conditions (PERIODIC_X | PERIODIC_Y).
+				   The auxiliary nodes are copied from the opposite side of the grid instead of being
+				   mirrored (see bcond_setup_lateral() in equation.c) and the glass beads near a periodic
+				   boundary also appear at the opposite side. */
+static char bead_mode=0;	/* glass beads representation: 0 = voxelized into the glass phase field (diffuse interface),
+				   1 = embedded spheres with cut cells (see BeadCutCells() in equation.c) */
+static int cutcell_samples=8;	/* the number of strips per cell edge used to integrate the cut cell fractions */
+static int stencil_order=2;	/* the order of the heat flux discretization (2 or 4, see heat_flux_div4() in equation.c) */
+static char fused_bcond=0;	/* nonzero if the right hand side takes the physical boundary conditions into account
+				   directly in the stencil instead of filling the auxiliary nodes by bcond_setup()
+				   (see the neighbor offsets in f_generic_model01() in equation.c) */
+
+/* grid spacing along the Z axis (see z_grid_faces()) */
+static char z_spacing[4096]="";		/* the relative grid spacing as a formula of z (empty = uniform) */
+static char z_spacing_table[4096]="";	/* ... or as a table of pairs "z w" interpolated linearly */
+static char z_uniform=1;		/* nonzero if the grid spacing along Z is uniform */
+static FLOAT * z_face=NULL;		/* the Z coordinates of the faces between the grid rows, see Z_FACE() */
+static FLOAT * z_node=NULL;		/* the Z coordinates of the grid nodes, see Z_NODE() */
+
+/*
+the Z coordinate of the node of the global grid row k and of the face between the rows k-1 and k. The auxiliary
+rows are included (k<0 or k>=total_n3), so bcond_thickness (defined in equation.c) is expanded at the point of use.
+*/
+#define Z_NODE(k)	(z_node[bcond_thickness+(k)])
+#define Z_FACE(k)	(z_face[bcond_thickness+(k)])
+
 static char comment[100]="";	/* a comment saved as a string attribute to the resulting NetCDF datasets */
 
 /* =========================================================================== */
@@ -482,7 +615,7 @@ Note that this proposition holds only if the parameters file does not change dur
 void BuildRankMap(int master_rank)
 /*
 Fills the rank permutation array and maps the virtual rank 0 to the specified
-master rank
+master rank (this is the fallback if the topology-aware permutation cannot be built)
 */
 {
 	int i;
@@ -648,6 +781,201 @@ void PrecalcData_with_check(FLOAT * var_eps_mult)
 				);
 }
 
+/* =========================================================================== */
+/* natively compiled material laws */
+
+#define LAW_SOURCE_SIZE	(LAW_COUNT*4096 + PARAM_COUNT*64 + 4096)
+
+void SetupMaterialLaws(void)
+/*
+compiles the material laws given in the parameter file by the 'law' command (if any) into a shared
+object and binds them to the right hand side (see MaterialLawSource() and BindMaterialLaws() in
+equation.c). The shared object is cached by the hash of the generated source (see cjit.h), so the
+compiler runs only once for each set of formulas. The master rank compiles first, the other ranks
+then find the shared object in the cache (or compile it themselves if the cache directory is not
+shared). If anything fails in any rank, a warning is issued and all ranks use the built-in laws.
+*/
+{
+	char * src;
+	char so_path[4096];
+	int q, n_laws=0, result=0, failed=0, any_failed;
+
+	for(q=0;q<LAW_COUNT;q++) if(*law_formula[q]) n_laws++;
+	if(!n_laws) return;
+
+	src = (char *)malloc(LAW_SOURCE_SIZE);
+	if(src==NULL || MaterialLawSource(src, LAW_SOURCE_SIZE, law_formula)) result=-1;
+	else if(MPIrank==0) result=cjit_build(src, law_compiler, law_cache, so_path, sizeof(so_path));
+
+	/* the other ranks wait for the master to fill the cache */
+	if(MPIrank==0) {
+		switch(result) {
+			case 0:		Mmprintf(logfile, "Material laws compiled: %s\n", so_path); break;
+			case 1:		Mmprintf(logfile, "Material laws found in the cache: %s\n", so_path); break;
+			case -1:	Mmprintf(logfile, "Warning: Material laws: invalid cache directory or formulas too long.\n"); break;
+			case -2:	Mmprintf(logfile, "Warning: Material laws: cannot write to the cache directory %s\n", *law_cache ? law_cache : "."); break;
+			case -3:	Mmprintf(logfile, "Warning: Material laws: command processor not available, cannot run the compiler.\n"); break;
+			default:	Mmprintf(logfile, "Warning: Material laws: compilation failed, see the .log file next to %s\n", so_path);
+		}
+	}
+	MPI_Bcast(&result, 1, MPI_INT, MPIrankmap[0], MPI_COMM_WORLD);
+	if(MPIrank!=0 && result>=0)
+		if((result=cjit_build(src, law_compiler, law_cache, so_path, sizeof(so_path))) < 0)
+			printf("Warning: Material laws: virtual rank %d failed to compile the formulas (code %d).\n", MPIrank, result);
+	free(src);
+
+	if(result<0) failed=1;
+	else if((law_lib=cjit_open(so_path))==NULL) {
+		printf("Warning: Material laws: virtual rank %d cannot load %s: %s\n", MPIrank, so_path, cjit_error());
+		failed=1;
+	}
+
+	MPI_Allreduce(&failed, &any_failed, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+	if(any_failed) {
+		cjit_close(law_lib);
+		law_lib=NULL;
+		Mmprintf(logfile, "Warning: Falling back to the built-in material laws.\n");
+		return;
+	}
+
+	BindMaterialLaws(law_lib);
+	for(q=0;q<LAW_COUNT;q++)
+		if(*law_formula[q]) Mmprintf(logfile, "Material law %s(%s) replaced by the compiled formula.\n", law_info[q].name, law_info[q].arguments);
+}
+
+void ReleaseMaterialLaws(void)
+/* restores the built-in material laws and unloads the compiled ones */
+{
+	BindMaterialLaws(NULL);
+	cjit_close(law_lib);
+	law_lib=NULL;
+}
+
+/* =========================================================================== */
+/* RK solver autotuning */
+
+static _conststring_ tuning_strategy_name(int threading)
+{
+	switch(threading) {
+		case RK_THREADS_NONE:		return("none");
+		case RK_THREADS_INNER:		return("inner (hybrid)");
+		case RK_THREADS_OUTER:		return("outer (hybrid2)");
+		case RK_THREADS_COLLAPSED:	return("collapsed (hybrid3)");
+		default:			return("unknown");
+	}
+}
+
+static _conststring_ tuning_schedule_name(int schedule)
+{
+	#ifdef _OPENMP
+	switch(schedule) {
+		case 0:			return("default");
+		case omp_sched_static:	return("static");
+		case omp_sched_dynamic:	return("dynamic");
+		case omp_sched_guided:	return("guided");
+		case omp_sched_auto:	return("auto");
+	}
+	#endif
+	return(schedule ? "unknown" : "default");
+}
+
+void AutotuneSolver(RK_MPI_S_SOLUTION * system, int threads)
+/*
+This is called by all ranks after the RK solver has been initialized. If autotuning is requested
+(autotune_iterations>0), the OpenMP work sharing setup of the RK solver (strategy, loop schedule and chunk size)
+is selected: If the autotuning cache file contains a record for the current grid dimensions, number of ranks
+and threads, master host name and calculation mode, the stored setup is applied. Otherwise, all candidate setups
+are measured by RK_MPI_SA_autotune(), the fastest one is applied and it is appended to the cache file.
+The last matching record in the cache file is used. The setup remains in effect until it is changed again,
+i.e. also in the subsequent iterations of the batch mode.
+*/
+{
+	RK_TUNING tuning;
+	int cache_hit=0;
+
+	if(autotune_iterations<=0) return;
+
+/* ####### B E G I N >>> MASTER <<< ####### */ if(MPIrank==0) {
+
+	FILE * cache;
+	char line[1024];
+	char host[256];
+	int c_n1, c_n2, c_n3, c_procs, c_threads, c_calc_mode;
+	RK_TUNING t;
+
+	if(*autotune_cache && (cache=fopen(autotune_cache, "r")) != NULL) {
+		while(fgets(line, sizeof(line), cache) != NULL)
+			if(
+				sscanf(line, "%d %d %d %d %d %255s %d %d %d %d %lf",
+					&c_n1, &c_n2, &c_n3, &c_procs, &c_threads, host, &c_calc_mode,
+					&t.threading, &t.schedule, &t.chunk, &t.time) == 11
+			&&	c_n1==n1 && c_n2==n2 && c_n3==total_n3 && c_procs==MPIprocs && c_threads==threads
+			&&	c_calc_mode==calc_mode && match(host, MPIprocname)
+			) {
+				tuning=t;
+				cache_hit=1;
+			}
+		fclose(cache);
+	}
+
+/* ####### E N D >>> MASTER <<< ####### */ }
+
+	MPI_Bcast(&cache_hit, 1, MPI_INT, MPIrankmap[0], MPI_COMM_WORLD);
+
+	if(cache_hit) {
+		MPI_Bcast(&tuning, sizeof(tuning), MPI_BYTE, MPIrankmap[0], MPI_COMM_WORLD);
+		/* all ranks run the same binary, so they all succeed or fail together */
+		if(RK_MPI_SA_set_tuning(&tuning) == 0) {
+			if(MPIrank==0)
+				Mmprintf(logfile, "\nRK solver setup loaded from the autotuning cache: %s, schedule %s, chunk %d (%.3e s per evaluation)\n",
+					tuning_strategy_name(tuning.threading), tuning_schedule_name(tuning.schedule), tuning.chunk, tuning.time);
+			return;
+		}
+		if(MPIrank==0)
+			Mmprintf(logfile, "\nWarning: The cached RK solver setup is not supported by this build. Autotuning again.\n");
+	}
+
+	{
+		RK_TUNING all[RK_TUNING_MAX_CANDIDATES];
+		int n_all=0, c;
+		char * RK_autotune_errors[]= {	"RK_MPI_SA_autotune: Not enough memory.",
+						"RK_MPI_SA_autotune: Invalid system specification.",
+						"RK_MPI_SA_autotune: unitialized.",
+						"",
+						"RK_MPI_SA_autotune: chunks out of memory",
+						"RK_MPI_SA_autotune: failed in another rank"
+					};
+
+		if(MPIrank==0) {
+			Mmprintf(logfile, "\nAutotuning the RK solver (%d right hand side evaluations per setup) ...\n", autotune_iterations);
+			commit_logfile(1);
+		}
+
+		CheckErrorAcrossRanks( -RK_MPI_SA_autotune(system, autotune_iterations, &tuning, all, &n_all), 1, RK_autotune_errors);
+
+/* ####### B E G I N >>> MASTER <<< ####### */ if(MPIrank==0) {
+
+		FILE * cache;
+
+		for(c=0;c<n_all;c++)
+			Mmprintf(logfile, "  %-20s schedule %-8s chunk %-3d : %.3e s\n",
+				tuning_strategy_name(all[c].threading), tuning_schedule_name(all[c].schedule), all[c].chunk, all[c].time);
+		Mmprintf(logfile, "Selected: %s, schedule %s, chunk %d\n",
+			tuning_strategy_name(tuning.threading), tuning_schedule_name(tuning.schedule), tuning.chunk);
+
+		if(*autotune_cache) {
+			if((cache=fopen(autotune_cache, "a")) != NULL) {
+				fprintf(cache, "%d %d %d %d %d %s %d %d %d %d %.6e\n",
+					n1, n2, total_n3, MPIprocs, threads, MPIprocname, calc_mode,
+					tuning.threading, tuning.schedule, tuning.chunk, tuning.time);
+				fclose(cache);
+			} else Mmprintf(logfile, "Warning: Cannot write to the autotuning cache file: %s\n", autotune_cache);
+		}
+
+/* ####### E N D >>> MASTER <<< ####### */ }
+	}
+}
+
 /* =========================================================================== */
 /* auxiliary expression evaluation functions */
 
@@ -731,6 +1059,51 @@ CP_STAT set_icond_formula(int cmd, int opt, _conststring_ value)
 	return(CP_SUCCESS);
 }
 
+CP_STAT set_reference_formula(int cmd, int opt, _conststring_ value)
+{
+	set(reference_formula[opt], value);
+	if(*value) Mmprintf(logfile, "Reference solution for %s (%s) set: %s\n", variable[opt].name, variable[opt].description, value);
+	return(CP_SUCCESS);
+}
+
+/* material laws settings */
+
+CP_STAT set_law_formula(int cmd, int opt, _conststring_ value)
+{
+	set(law_formula[opt], value);
+	if(*value) Mmprintf(logfile, "Material law %s(%s) (%s) set: %s\n", law_info[opt].name, law_info[opt].arguments, law_info[opt].description, value);
+	else Mmprintf(logfile, "Material law %s(%s) (%s) reset to the built-in law.\n", law_info[opt].name, law_info[opt].arguments, law_info[opt].description);
+	return(CP_SUCCESS);
+}
+
+CP_STAT set_law_compiler(int cmd, int opt, _conststring_ value)
+{
+	set(law_compiler, value);
+	Mmprintf(logfile, "Material laws compiler set: %s\n", value);
+	return(CP_SUCCESS);
+}
+
+CP_STAT set_law_cache(int cmd, int opt, _conststring_ value)
+{
+	return(generic_set_path(law_cache, value, "Material laws cache directory set: %s\n"));
+}
+
+/* grid spacing settings */
+
+CP_STAT set_z_spacing(int cmd, int opt, _conststring_ value)
+{
+	set(z_spacing, value);
+	if(*value) Mmprintf(logfile, "Relative grid spacing along Z set: %s\n", value);
+	return(CP_SUCCESS);
+}
+
+CP_STAT set_z_spacing_table(int cmd, int opt, _conststring_ value)
+{
+	set(z_spacing_table, value);
+	if(*value) Mmprintf(logfile, "Relative grid spacing table along Z set: %s\n", value);
+	return(CP_SUCCESS);
+}
+
 CP_STAT set_icond_file(int cmd, int opt, _conststring_ value)
 {
 	icond_mode=1;
@@ -747,6 +1120,27 @@ CP_STAT set_skip_icond(int cmd, int opt, _conststring_ value)
 	return(CP_SUCCESS);
 }
 
+CP_STAT set_out_series(int cmd, int opt, _conststring_ value)
+{
+	out_series=1;
+	Mmprintf(logfile, "Time series output mode ON (snapshots are appended to a single dataset).\n");
+	return(CP_SUCCESS);
+}
+
+CP_STAT set_out_local(int cmd, int opt, _conststring_ value)
+{
+	out_local=1;
+	Mmprintf(logfile, "Rank-local output mode ON (each rank saves its block of the grid to its own dataset).\n");
+	return(CP_SUCCESS);
+}
+
+CP_STAT set_iso_only(int cmd, int opt, _conststring_ value)
+{
+	iso_only=1;
+	Mmprintf(logfile, "Isosurface only mode ON (only the last snapshot is saved to a NetCDF dataset).\n");
+	return(CP_SUCCESS);
+}
+
 CP_STAT set_continue_series(int cmd, int opt, _conststring_ value)
 {
 	continue_series=1;
@@ -775,6 +1169,13 @@ CP_STAT set_snapshot_trigger(int cmd, int opt, _conststring_ value)
 	return(generic_set_path(snapshot_trigger_file, value, "On-demand snapshot generation ON. Snapshot will be triggered by file: %s\n"));
 }
 
+/* RK solver autotuning cache */
+
+CP_STAT set_autotune_cache(int cmd, int opt, _conststring_ value)
+{
+	return(generic_set_path(autotune_cache, value, "RK solver autotuning cache file set: %s\n"));
+}
+
 /* grid output mode setting */
 
 CP_STAT grid_output(int cmd, int opt, _conststring_ value)
@@ -837,6 +1238,17 @@ CP_STAT set_pproc_waitfirst(int cmd, int opt, _conststring_ value)
 	return(CP_SUCCESS);
 }
 
+CP_STAT set_result_cache(int cmd, int opt, _conststring_ value)
+{
+	if(!loopN)
+		batch_mode_warning("set result_cache");
+	else {
+		result_cache=1;
+		Mmprintf(logfile, "Batch iteration result cache ON (complete iterations are skipped, interrupted ones resumed).\n");
+	}
+	return(CP_SUCCESS);
+}
+
 _conststring_ mnemonic(CP_CURRENT_COMMAND * c, _conststring_ opts)
 /*
 loads the string of space-delimited mnemonic names for the given loop control variable.
@@ -926,6 +1338,9 @@ CP_OPTION cmd_set [] =		{
 					{ "comment", CP_REQUIRED, set_comment },
 					{ "out_file", CP_REQUIRED, set_out_file },
 					{ "out_file_suffix", CP_REQUIRED, set_out_file_suffix },
+					{ "out_series", CP_NONE, set_out_series },
+					{ "out_local", CP_NONE, set_out_local },
+					{ "iso_only", CP_NONE, set_iso_only },
 					{ "icond_file", CP_REQUIRED, set_icond_file },
 					{ "skip_icond", CP_NONE, set_skip_icond },
 					{ "continue_series", CP_NONE, set_continue_series },
@@ -933,11 +1348,17 @@ CP_OPTION cmd_set [] =		{
 					{ "logfile", CP_REQUIRED, set_logfile },
 					{ "debug_logfile", CP_REQUIRED, set_debug_logfile },
 					{ "snapshot_trigger", CP_REQUIRED, set_snapshot_trigger },
+					{ "autotune_cache", CP_REQUIRED, set_autotune_cache },
+					{ "law_compiler", CP_REQUIRED, set_law_compiler },
+					{ "law_cache", CP_REQUIRED, set_law_cache },
+					{ "z_spacing", CP_REQUIRED, set_z_spacing },
+					{ "z_spacing_table", CP_REQUIRED, set_z_spacing_table },
 
 					{ "pproc_script", CP_REQUIRED, set_pproc_script },
 					{ "pproc_nofail", CP_NONE, set_pproc_nofail },
 					{ "pproc_nowait", CP_NONE, set_pproc_nowait },
 					{ "pproc_waitfirst", CP_NONE, set_pproc_waitfirst },
+					{ "result_cache", CP_NONE, set_result_cache },
 
 					{ "slice_outfile", CP_REQUIRED, skip_set_option },
 					{ "slice_input_dataset", CP_REQUIRED, skip_set_option },
@@ -948,14 +1369,19 @@ CP_OPTION cmd_set [] =		{
 			  	};
 
 CP_OPTION cmd_icond [VAR_COUNT+1];
+CP_OPTION cmd_reference [VAR_COUNT+1];
+CP_OPTION cmd_law [LAW_COUNT+1];
 
 /*
-the content of the cmd_icond structure is created dynamically by means of initialize_cparser_structs()
+the content of the cmd_icond, cmd_reference and cmd_law structures is created dynamically by means of
+initialize_cparser_structs()
 */
 
 void initialize_cparser_structs(void)
 {
 	CP_OPTION cmd_icond_template = { NULL, CP_REQUIRED, set_icond_formula };
+	CP_OPTION cmd_reference_template = { NULL, CP_REQUIRED, set_reference_formula };
+	CP_OPTION cmd_law_template = { NULL, CP_REQUIRED, set_law_formula };
 	CP_OPTION stopper = { NULL, CP_NONE, NULL };
 
 	int q;
@@ -965,6 +1391,18 @@ void initialize_cparser_structs(void)
 		cmd_icond[q].name = variable[q].name;
 	}
 	cmd_icond[VAR_COUNT] = stopper;
+
+	for(q=0;q<VAR_COUNT;q++) {
+		cmd_reference[q] = cmd_reference_template;
+		cmd_reference[q].name = variable[q].name;
+	}
+	cmd_reference[VAR_COUNT] = stopper;
+
+	for(q=0;q<LAW_COUNT;q++) {
+		cmd_law[q] = cmd_law_template;
+		cmd_law[q].name = law_info[q].name;
+	}
+	cmd_law[LAW_COUNT] = stopper;
 }
 
 
@@ -980,6 +1418,8 @@ CP_OPTION cmd_grid [] =		{
 CP_COMMAND commands [] =	{
 					{ "set", cmd_set, NULL, NULL },
 					{ "icond", cmd_icond, NULL, NULL },
+					{ "reference", cmd_reference, NULL, NULL },
+					{ "law", cmd_law, NULL, NULL },
 					{ "grid", cmd_grid, NULL, NULL },
 
 					/* the mnemonic command */
@@ -1078,41 +1518,1113 @@ int RKService(FLOAT final_snapshot_time, const RK_MPI_S_SOLUTION * const self)
 		/* ................................time elapsed to last snapshot save...+ time elapsed in current snapshot computation */
 		double MPIelapsed_time_to_log =	MPIelapsed_time			+ (MPI_Wtime() - MPInew_start);
 
-		double MPIestimated_time_to_next_snapshot = MPIelapsed_time_to_log * ((final_snapshot_time-starting_time) / (self->t-starting_time) - 1.);
-		double MPIestimated_time_to_completion = MPIelapsed_time_to_log * ((final_time-starting_time) / (self->t-starting_time) - 1.);
+		double MPIestimated_time_to_next_snapshot = MPIelapsed_time_to_log * ((final_snapshot_time-starting_time) / (self->t-starting_time) - 1.);
+		double MPIestimated_time_to_completion = MPIelapsed_time_to_log * ((final_time-starting_time) / (self->t-starting_time) - 1.);
+
+		time(&calendar_time);
+		br_time=localtime(&calendar_time);
+
+		fprintf(debug_logfile_ID,
+			"%s - step %08ld, t=%10.4" FTC_E ", tau=%10.4" FTC_E ", Elapsed time: %s",
+			format_date(br_time),
+			self->steps,
+			self->t,
+			self->h,
+			format_time(MPIelapsed_time_to_log)
+			);
+		/* the fprintf() call must be split as multiple calls to format_time() share the same static buffer */
+		fprintf(debug_logfile_ID,", Est. time to snapshot %d (t=%10.4" FTC_E "): %s",
+			__snapshot,
+			final_snapshot_time,
+			format_time(MPIestimated_time_to_next_snapshot)
+		);
+		/* the command must be split as multiple calls to format_time() share the same static buffer */
+		fprintf(debug_logfile_ID,", Est. time to final t=%10.4" FTC_E "): %s",
+			final_time,
+			format_time(MPIestimated_time_to_completion)
+		);
+		if(stiffness_mode) {
+			RK_STIFFNESS stiffness;
+			RK_MPI_SA_get_stiffness(&stiffness);
+			fprintf(debug_logfile_ID,", tau*rho=%10.4e%s", stiffness.h_rho, stiffness.stiff ? " (Rosenbrock)" : "");
+		}
+		fprintf(debug_logfile_ID,"\n");
+		fflush(debug_logfile_ID);
+	}
+
+	if(snapshot_trigger) {
+		struct stat s;
+		/* nonzero return value => computation will be interrupted and snapshot save action will be triggered */
+		if(!stat(snapshot_trigger_file,&s)) return(1);
+	}
+
+	return(0);
+}
+
+/* =========================================================================== */
+/* time series output (see out_series) */
+
+#define SERIES_CHUNK_BYTES	(4<<20)		/* the approximate size of one chunk of the series variables */
+
+static int define_series(int dataset_ID, int t_dim_ID)
+/* defines the record variables t, tau and snapshot of a new time series dataset. Returns a NetCDF error code. */
+{
+	int e, var_ID;
+
+	if( (e=nc_def_var(dataset_ID, "t", NC_DOUBLE, 1, &t_dim_ID, &var_ID)) != NC_NOERR) return(e);
+	if( (e=nc_def_var(dataset_ID, "tau", NC_DOUBLE, 1, &t_dim_ID, &var_ID)) != NC_NOERR) return(e);
+	return( nc_def_var(dataset_ID, "snapshot", NC_INT, 1, &t_dim_ID, &var_ID) );
+}
+
+static void series_chunk_cache(int dataset_ID, int var_ID)
+/*
+If a chunk spans several records, each record only fills a part of it. The chunk cache then has to hold
+the chunks of a whole record so that they are not evicted (and compressed) before they are complete.
+*/
+{
+	int dim_IDs[4], i;
+	size_t len, record_size=sizeof(double);
+
+	if(series_chunk_t<2) return;
+	nc_inq_vardimid(dataset_ID, var_ID, dim_IDs);
+	for(i=1;i<4;i++) {
+		nc_inq_dimlen(dataset_ID, dim_IDs[i], &len);
+		record_size *= len;
+	}
+	nc_set_var_chunk_cache(dataset_ID, var_ID, series_chunk_t*record_size, 1009, 0.75);
+}
+
+static int tune_series_var(int dataset_ID, int var_ID, const int * dim_IDs)
+/*
+sets up the chunking and compression of a series variable (t,n3,n2,n1). A chunk consists of series_chunk_t
+records of whole (n2,n1) planes, with as many planes as fit in SERIES_CHUNK_BYTES. This keeps the cost of reading
+a plane or a short time series at a point low, and the compression can exploit the similarity of the records.
+Returns a NetCDF error code.
+*/
+{
+	size_t len[4], chunk[4];
+	int e, i;
+
+	for(i=1;i<4;i++) nc_inq_dimlen(dataset_ID, dim_IDs[i], len+i);
+	chunk[0] = series_chunk_t;
+	chunk[2] = len[2];
+	chunk[3] = len[3];
+	chunk[1] = SERIES_CHUNK_BYTES / (sizeof(double)*chunk[0]*chunk[2]*chunk[3]);
+	if(chunk[1]<1) chunk[1]=1;
+	if(chunk[1]>len[1]) chunk[1]=len[1];
+
+	if( (e=nc_def_var_chunking(dataset_ID, var_ID, NC_CHUNKED, chunk)) != NC_NOERR) return(e);
+	if(series_deflate && (e=nc_def_var_deflate(dataset_ID, var_ID, 1, 1, series_deflate)) != NC_NOERR) return(e);
+	series_chunk_cache(dataset_ID, var_ID);
+	return(NC_NOERR);
+}
+
+static int open_series(_conststring_ filename, int * dataset_ID, int * u_var_ID)
+/*
+reopens an existing time series dataset for appending (continue_series) and checks that its grid matches
+the current one. Returns nonzero on error.
+*/
+{
+	_conststring_ dimensions[3] = { "n3", "n2", "n1" };
+	size_t expected[3];
+	size_t len;
+	int dim_ID, var_ID, ndims, q;
+
+	expected[0] = grid_IO_mode ? total_n3 : total_N3;
+	expected[1] = grid_IO_mode ? n2 : N2;
+	expected[2] = grid_IO_mode ? n1 : N1;
+
+	if(nc_open(filename, NC_WRITE, dataset_ID) != NC_NOERR) return(1);
+
+	for(q=0;q<3;q++)
+		if(nc_inq_dimid(*dataset_ID, dimensions[q], &dim_ID) != NC_NOERR || nc_inq_dimlen(*dataset_ID, dim_ID, &len) != NC_NOERR
+		   || len != expected[q]) { nc_close(*dataset_ID); return(1); }
+
+	if(nc_inq_varid(*dataset_ID, "t", &var_ID) != NC_NOERR || nc_inq_varid(*dataset_ID, "tau", &var_ID) != NC_NOERR
+	   || nc_inq_varid(*dataset_ID, "snapshot", &var_ID) != NC_NOERR) { nc_close(*dataset_ID); return(1); }
+
+	for(q=0;q<VAR_COUNT;q++) {
+		if(nc_inq_varid(*dataset_ID, variable[q].name, u_var_ID+q) != NC_NOERR
+		   || nc_inq_varndims(*dataset_ID, u_var_ID[q], &ndims) != NC_NOERR || ndims != 4) { nc_close(*dataset_ID); return(1); }
+		series_chunk_cache(*dataset_ID, u_var_ID[q]);
+	}
+	return(0);
+}
+
+static int finish_series_record(int dataset_ID, _conststring_ filename, int snapshot, FLOAT t, FLOAT tau)
+/*
+stores the time level, the time step and the snapshot number of the record 'snapshot' and flushes the
+dataset to the disk. The time level is written last, so that a record with a valid 't' is always complete
+(see last_series_record()). Returns nonzero on error.
+*/
+{
+	size_t rec = snapshot;
+	double t_d = t, tau_d = tau;
+	int var_ID, fd;
+
+	if(nc_inq_varid(dataset_ID, "tau", &var_ID) != NC_NOERR || nc_put_var1_double(dataset_ID, var_ID, &rec, &tau_d) != NC_NOERR) return(1);
+	if(nc_inq_varid(dataset_ID, "snapshot", &var_ID) != NC_NOERR || nc_put_var1_int(dataset_ID, var_ID, &rec, &snapshot) != NC_NOERR) return(1);
+	if(nc_inq_varid(dataset_ID, "t", &var_ID) != NC_NOERR || nc_put_var1_double(dataset_ID, var_ID, &rec, &t_d) != NC_NOERR) return(1);
+
+	/* nc_sync() empties the library buffers, fsync() then makes the record durable */
+	if(nc_sync(dataset_ID) != NC_NOERR) return(1);
+	if((fd=open(filename, O_RDONLY)) >= 0) {
+		fsync(fd);
+		close(fd);
+	}
+	return(0);
+}
+
+static int last_series_record(int dataset_ID, size_t n_records)
+/* returns the index of the last complete record of a time series dataset or -1 if there is none */
+{
+	double * t_rec;
+	int var_ID, rec=-1;
+	size_t r;
+
+	if(n_records==0 || nc_inq_varid(dataset_ID, "t", &var_ID) != NC_NOERR) return(-1);
+	if((t_rec=(double *)malloc(n_records*sizeof(double))) == NULL) return(-1);
+
+	/* unwritten records (e.g. a skipped snapshot 0 or an interrupted record) contain the fill value */
+	if(nc_get_var_double(dataset_ID, var_ID, t_rec) == NC_NOERR)
+		for(r=n_records;r>0;r--)
+			if(t_rec[r-1] != NC_FILL_DOUBLE) { rec=r-1; break; }
+
+	free(t_rec);
+	return(rec);
+}
+
+static int get_series_record(int dataset_ID, int record, int * snapshot, double * t, double * tau)
+/* reads the snapshot number, the time level and the time step of a time series record. Returns nonzero on error. */
+{
+	size_t rec = record;
+	int var_ID;
+
+	if(nc_inq_varid(dataset_ID, "snapshot", &var_ID) != NC_NOERR || nc_get_var1_int(dataset_ID, var_ID, &rec, snapshot) != NC_NOERR) return(1);
+	if(nc_inq_varid(dataset_ID, "t", &var_ID) != NC_NOERR || nc_get_var1_double(dataset_ID, var_ID, &rec, t) != NC_NOERR) return(1);
+	if(nc_inq_varid(dataset_ID, "tau", &var_ID) != NC_NOERR || nc_get_var1_double(dataset_ID, var_ID, &rec, tau) != NC_NOERR) return(1);
+	return(0);
+}
+
+/* =========================================================================== */
+/* transfers of the blocks of the computational grid */
+
+/*
+The snapshots are written and the initial conditions are read directly from and to the solution arrays, which
+are of the type FLOAT, while the datasets always use 'double'. A block of n3_ x n2_ x n1_ nodes in memory has
+consecutive nodes along X, its lines along Y are 'line' elements apart and its rows along Z 'row' elements
+apart (N1 and rowsize for a block of the solution). NetCDF converts float to double by itself, but it has no
+interface for long double, so such a grid is transferred line by line through a conversion buffer.
+*/
+
+#if _DEFAULT_FP_PRECISION == FP_FLOAT
+	#define nc_put_varm_FLOAT	nc_put_varm_float
+	#define nc_get_varm_FLOAT	nc_get_varm_float
+#elif _DEFAULT_FP_PRECISION == FP_DOUBLE
+	#define nc_put_varm_FLOAT	nc_put_varm_double
+	#define nc_get_varm_FLOAT	nc_get_varm_double
+#endif
+
+static int transfer_block(int dataset_ID, int var_ID, int ndims, const size_t * start, const size_t * count,
+	FLOAT * data, ptrdiff_t line, ptrdiff_t row, int write)
+/*
+writes (if 'write' is nonzero) or reads the block of a variable with 'ndims' dimensions (3, or 4 with the record
+dimension first) given by start and count. Returns a NetCDF error code.
+*/
+{
+#if _DEFAULT_FP_PRECISION == FP_LONG_DOUBLE
+	size_t s[4], c[4];
+	double * buffer;
+	size_t i, j, k;
+	int e=NC_NOERR, z = ndims-3;
+
+	if( (buffer=(double *)malloc(count[z+2]*sizeof(double))) == NULL) return(NC_ENOMEM);
+	memcpy(s, start, ndims*sizeof(size_t));
+	memcpy(c, count, ndims*sizeof(size_t));
+	c[z] = c[z+1] = 1;
+	for(k=0; k<count[z] && e==NC_NOERR; k++)
+		for(j=0; j<count[z+1] && e==NC_NOERR; j++) {
+			s[z] = start[z]+k;
+			s[z+1] = start[z+1]+j;
+			if(write) {
+				for(i=0;i<count[z+2];i++) buffer[i] = data[k*row + j*line + i];
+				e = nc_put_vara_double(dataset_ID, var_ID, s, c, buffer);
+			} else if( (e = nc_get_vara_double(dataset_ID, var_ID, s, c, buffer)) == NC_NOERR)
+				for(i=0;i<count[z+2];i++) data[k*row + j*line + i] = buffer[i];
+		}
+	free(buffer);
+	return(e);
+#else
+	/* the distances in memory between the nodes along each dimension (the record dimension has only one entry) */
+	ptrdiff_t imap[4] = { 0, row, line, 1 };
+
+	if(write) return( nc_put_varm_FLOAT(dataset_ID, var_ID, start, count, NULL, imap+4-ndims, data) );
+	return( nc_get_varm_FLOAT(dataset_ID, var_ID, start, count, NULL, imap+4-ndims, data) );
+#endif
+}
+
+static MPI_Datatype block_datatype(int rows, int first, int n2_, int n1_, int first_node)
+/*
+creates the MPI datatype of the block of one variable of the solution consisting of 'rows' rows of the current
+rank starting from the row 'first' (counted from the first auxiliary row), each of which has n2_ x n1_ nodes starting
+from the node [first_node][first_node], so that the block can be sent and received without a copy.
+The datatype has to be freed by MPI_Type_free().
+*/
+{
+	int sizes[3] = { N3, N2, N1 };
+	int subsizes[3] = { rows, n2_, n1_ };
+	int starts[3] = { first, first_node, first_node };
+	MPI_Datatype block;
+
+	MPI_Type_create_subarray(3, sizes, subsizes, starts, MPI_ORDER_C, MPI__FLOAT, &block);
+	MPI_Type_commit(&block);
+	return(block);
+}
+
+/* =========================================================================== */
+/* rank-local snapshot output (see out_local) */
+
+static void local_snapshot_name(char * dest, _conststring_ filename, int prefix_len, int rank)
+/*
+constructs the name of the rank-local dataset of 'rank' by inserting .r<rank> in front of the suffix
+of the snapshot file name. prefix_len is the length of the file name without out_file_suffix.
+*/
+{
+	sprintf(dest, "%.*s.r%03d%s", prefix_len, filename, rank, filename+prefix_len);
+}
+
+static int put_local_attributes(int dataset_ID)
+/*
+stores the position of the block of the current rank in the whole grid as the global attributes first_row
+(the index of the first row along n3), global_dims (total_n3, n2, n1), rank and ranks (the number of blocks).
+Returns a NetCDF error code.
+*/
+{
+	int global_dims[3] = { total_n3, n2, n1 };
+	int e;
+
+	if( (e=nc_put_att_int(dataset_ID, NC_GLOBAL, "first_row", NC_INT, 1, &first_row)) != NC_NOERR) return(e);
+	if( (e=nc_put_att_int(dataset_ID, NC_GLOBAL, "global_dims", NC_INT, 3, global_dims)) != NC_NOERR) return(e);
+	if( (e=nc_put_att_int(dataset_ID, NC_GLOBAL, "rank", NC_INT, 1, &MPIrank)) != NC_NOERR) return(e);
+	return( nc_put_att_int(dataset_ID, NC_GLOBAL, "ranks", NC_INT, 1, &MPIprocs) );
+}
+
+static int write_local_snapshot(_conststring_ filename, int snapshot, FLOAT t, FLOAT tau)
+/*
+saves the block of the grid held by the current rank (other than the master) to its own dataset (n3 x n2 x n1,
+without the auxiliary nodes). Only the attributes needed to place the block in the whole grid are stored; the
+remaining ones are found in the dataset of rank 0. Returns a NetCDF error code.
+*/
+{
+	double L1_d = L1, L2_d = L2, L3_d = L3, t_d = t, tau_d = tau;
+	double * coords;
+	int dataset_ID, dim_IDs[3], coord_IDs[3], var_ID[VAR_COUNT];
+	int e, i, q;
+
+	if( (e=nc_create(filename, NC_CLOBBER, &dataset_ID)) != NC_NOERR) return(e);
+
+	if( (e=nc_def_dim(dataset_ID, "n3", n3, dim_IDs)) != NC_NOERR) ;	/* do nothing */
+	else if( (e=nc_def_dim(dataset_ID, "n2", n2, dim_IDs+1)) != NC_NOERR) ;
+	else if( (e=nc_def_dim(dataset_ID, "n1", n1, dim_IDs+2)) != NC_NOERR) ;
+	else for(i=0;i<3;i++)
+		if( (e=nc_def_var(dataset_ID, i==0 ? "n3" : (i==1 ? "n2" : "n1"), NC_DOUBLE, 1, dim_IDs+i, coord_IDs+i)) != NC_NOERR) break;
+	if(e==NC_NOERR) for(q=0;q<VAR_COUNT;q++)
+		if( (e=nc_def_var(dataset_ID, variable[q].name, NC_DOUBLE, 3, dim_IDs, var_ID+q)) != NC_NOERR) break;
+	if(e!=NC_NOERR) { nc_close(dataset_ID); return(e); }
+
+	nc_put_att_double(dataset_ID, NC_GLOBAL, "L1", NC_DOUBLE, 1, &L1_d);
+	nc_put_att_double(dataset_ID, NC_GLOBAL, "L2", NC_DOUBLE, 1, &L2_d);
+	nc_put_att_double(dataset_ID, NC_GLOBAL, "L3", NC_DOUBLE, 1, &L3_d);
+	nc_put_att_double(dataset_ID, NC_GLOBAL, "tau", NC_DOUBLE, 1, &tau_d);
+	nc_put_att_double(dataset_ID, NC_GLOBAL, "t", NC_DOUBLE, 1, &t_d);
+	nc_put_att_int(dataset_ID, NC_GLOBAL, "snapshot", NC_INT, 1, &snapshot);
+	if( (e=put_local_attributes(dataset_ID)) != NC_NOERR || (e=nc_enddef(dataset_ID)) != NC_NOERR) { nc_close(dataset_ID); return(e); }
+
+	/* the coordinates of the grid nodes (see the snapshot saving procedure in the master) */
+	if( (coords=(double *)malloc((n3+n2+n1)*sizeof(double))) == NULL) {
+		nc_close(dataset_ID);
+		return(NC_ENOMEM);
+	}
+	for(i=0;i<n3;i++) coords[i] = Z_NODE(first_row+i);
+	for(i=0;i<n2;i++) coords[n3+i] = L2 * (0.5+i)/n2;
+	for(i=0;i<n1;i++) coords[n3+n2+i] = L1 * (0.5+i)/n1;
+	nc_put_var_double(dataset_ID, coord_IDs[0], coords);
+	nc_put_var_double(dataset_ID, coord_IDs[1], coords+n3);
+	nc_put_var_double(dataset_ID, coord_IDs[2], coords+n3+n2);
+	free(coords);
+
+	{
+		size_t nc_start[3] = { 0, 0, 0 };
+		size_t nc_count[3] = { n3, n2, n1 };
+
+		for(q=0;q<VAR_COUNT;q++)
+			if( (e=transfer_block(dataset_ID, var_ID[q], 3, nc_start, nc_count, VAR(solution,q) + bcond_thickness*(rowsize+N1+1),
+				N1, rowsize, 1)) != NC_NOERR) break;
+	}
+
+	if(e==NC_NOERR) e=nc_close(dataset_ID); else nc_close(dataset_ID);
+	return(e);
+}
+
+/* =========================================================================== */
+/* in-situ isosurface extraction (see iso_every) */
+
+typedef struct {
+	float * vertex;			/* x, y, z of each vertex */
+	int * triangle;			/* the vertex indices of each triangle */
+	int n_vertices, n_triangles;
+	int max_vertices, max_triangles;
+	double area;			/* the total area of the triangles */
+} ISO_MESH;
+
+/*
+The cube between the nodes (i,j,k) and (i+1,j+1,k+1) is split into six tetrahedra sharing its main diagonal.
+The corners of the cube are numbered by the bits x=1, y=2, z=4, so that the corners of each tetrahedron form
+a chain 0 < a < b < 7 of subsets. The isosurface is then approximated by one or two triangles in each
+tetrahedron (marching tetrahedra). Unlike marching cubes, this needs no disambiguation of the cube faces, and
+the edges of the tetrahedra of the neighboring cubes coincide, so that the surface has no cracks. Every edge
+starts at its lower corner and its direction is the bit mask of the corners it connects (1-7).
+*/
+static const int iso_tetrahedra[6][4] = {
+	{ 0, 1, 3, 7 }, { 0, 1, 5, 7 }, { 0, 2, 3, 7 }, { 0, 2, 6, 7 }, { 0, 4, 5, 7 }, { 0, 4, 6, 7 }
+};
+
+static int iso_add_vertex(ISO_MESH * mesh, double x, double y, double z)
+/* appends a vertex to the mesh. Returns its index or -1 if memory can not be allocated. */
+{
+	if(mesh->n_vertices == mesh->max_vertices) {
+		int max = mesh->max_vertices ? 2*mesh->max_vertices : 4096;
+		float * v = (float *)realloc(mesh->vertex, 3*max*sizeof(float));
+		if(v == NULL) return(-1);
+		mesh->vertex = v;
+		mesh->max_vertices = max;
+	}
+	mesh->vertex[3*mesh->n_vertices] = x;
+	mesh->vertex[3*mesh->n_vertices+1] = y;
+	mesh->vertex[3*mesh->n_vertices+2] = z;
+	return(mesh->n_vertices++);
+}
+
+static int iso_add_triangle(ISO_MESH * mesh, int a, int b, int c, const double * inside, const double * outside)
+/*
+appends the triangle a, b, c oriented so that its normal points from the centroid of the inside corners (p > iso_level)
+to the centroid of the outside ones. Returns nonzero if memory can not be allocated.
+*/
+{
+	const float * A = mesh->vertex+3*a, * B = mesh->vertex+3*b, * C = mesh->vertex+3*c;
+	double u[3], v[3], normal[3];
+	int q;
+
+	if(mesh->n_triangles == mesh->max_triangles) {
+		int max = mesh->max_triangles ? 2*mesh->max_triangles : 8192;
+		int * t = (int *)realloc(mesh->triangle, 3*max*sizeof(int));
+		if(t == NULL) return(1);
+		mesh->triangle = t;
+		mesh->max_triangles = max;
+	}
+
+	for(q=0;q<3;q++) { u[q] = B[q]-A[q]; v[q] = C[q]-A[q]; }
+	normal[0] = u[1]*v[2]-u[2]*v[1];
+	normal[1] = u[2]*v[0]-u[0]*v[2];
+	normal[2] = u[0]*v[1]-u[1]*v[0];
+	mesh->area += 0.5*sqrt(normal[0]*normal[0]+normal[1]*normal[1]+normal[2]*normal[2]);
+
+	if(normal[0]*(outside[0]-inside[0]) + normal[1]*(outside[1]-inside[1]) + normal[2]*(outside[2]-inside[2]) < 0) {
+		q = b; b = c; c = q;
+	}
+	mesh->triangle[3*mesh->n_triangles] = a;
+	mesh->triangle[3*mesh->n_triangles+1] = b;
+	mesh->triangle[3*mesh->n_triangles+2] = c;
+	mesh->n_triangles++;
+	return(0);
+}
+
+static int extract_isosurface(const FLOAT * p, const FLOAT * top, FLOAT level, ISO_MESH * mesh)
+/*
+extracts the isosurface p=level from the block of the current rank. 'top' is the first row of the next rank
+(n1 x n2), so that the cubes between the blocks are included as well. The cubes crossing the lateral boundaries
+are not (even if they are periodic). The vertices on the edges shared by several tetrahedra are created once.
+Returns nonzero if memory can not be allocated.
+*/
+{
+	int rows = n3 + (MPIrank < MPIprocs-1);	/* the rows of nodes including 'top' */
+	int plane = 7*n1*n2;
+	int * edge_vertex;			/* the vertex on each edge of two planes of nodes (-1 = not created yet) */
+	double corner[8][3];			/* the coordinates of the corners of the current cube */
+	FLOAT f[8];				/* the values of p in the corners */
+	int i, j, k, c, e, m, r;
+
+	if(rows < 2 || n2 < 2 || n1 < 2) return(0);
+	if((edge_vertex = (int *)malloc(2*plane*sizeof(int))) == NULL) return(1);
+	for(e=0;e<2*plane;e++) edge_vertex[e] = -1;
+
+	for(k=0;k<rows-1;k++) {
+		/* the plane k+1 reuses the slot of the plane k-1 */
+		for(e=0;e<plane;e++) edge_vertex[((k+1)&1)*plane+e] = -1;
+
+		for(j=0;j<n2-1;j++) for(i=0;i<n1-1;i++) {
+			char any_inside=0, any_outside=0;
+
+			for(c=0;c<8;c++) {
+				int ci = i+(c&1), cj = j+((c>>1)&1), ck = k+(c>>2);
+
+				f[c] = (ck<n3) ? p[(ck+bcond_thickness)*rowsize + (cj+bcond_thickness)*N1 + bcond_thickness + ci] : top[cj*n1+ci];
+				if(f[c] > level) any_inside=1; else any_outside=1;
+				corner[c][0] = L1 * (0.5+ci)/n1;
+				corner[c][1] = L2 * (0.5+cj)/n2;
+				corner[c][2] = Z_NODE(first_row+ck);
+			}
+			if(!any_inside || !any_outside) continue;
+
+			for(r=0;r<6;r++) {
+				const int * tet = iso_tetrahedra[r];
+				int in[4], n_in=0, vertex[4][4];
+				double inside[3]={0,0,0}, outside[3]={0,0,0};
+
+				for(m=0;m<4;m++) {
+					in[m] = f[tet[m]] > level;
+					n_in += in[m];
+					for(c=0;c<3;c++) {
+						if(in[m]) inside[c] += corner[tet[m]][c]; else outside[c] += corner[tet[m]][c];
+					}
+				}
+				if(n_in==0 || n_in==4) continue;
+				for(c=0;c<3;c++) { inside[c] /= n_in; outside[c] /= 4-n_in; }
+
+				/* the vertices on the edges crossing the isosurface (the corners on the chain are ordered) */
+				for(m=0;m<4;m++) for(c=m+1;c<4;c++) if(in[m] != in[c]) {
+					int lo = tet[m], dir = tet[c]^tet[m];
+					int *ev = edge_vertex + ((k+(lo>>2))&1)*plane + ((j+((lo>>1)&1))*n1 + i+(lo&1))*7 + dir-1;
+
+					if(*ev < 0) {
+						double s = (level-f[lo]) / (f[tet[c]]-f[lo]);
+						*ev = iso_add_vertex(mesh, corner[lo][0] + s*(corner[tet[c]][0]-corner[lo][0]),
+							corner[lo][1] + s*(corner[tet[c]][1]-corner[lo][1]), corner[lo][2] + s*(corner[tet[c]][2]-corner[lo][2]));
+						if(*ev < 0) { free(edge_vertex); return(1); }
+					}
+					vertex[m][c] = vertex[c][m] = *ev;
+				}
+
+				if(n_in==1 || n_in==3) {
+					/* a single corner on one side: one triangle around it */
+					int s=0, o[3], n_o=0;
+					for(m=0;m<4;m++) if((in[m] != 0) == (n_in==1)) s=m;
+					for(m=0;m<4;m++) if(m!=s) o[n_o++]=m;
+					if(iso_add_triangle(mesh, vertex[s][o[0]], vertex[s][o[1]], vertex[s][o[2]], inside, outside)) { free(edge_vertex); return(1); }
+				} else {
+					/* two corners on each side: the quadrilateral a-c, a-d, b-d, b-c */
+					int a=-1, b=-1, cc=-1, d=-1;
+					for(m=0;m<4;m++) {
+						if(in[m]) { if(a<0) a=m; else b=m; }
+						else { if(cc<0) cc=m; else d=m; }
+					}
+					if(iso_add_triangle(mesh, vertex[a][cc], vertex[a][d], vertex[b][d], inside, outside)
+					   || iso_add_triangle(mesh, vertex[a][cc], vertex[b][d], vertex[b][cc], inside, outside)) { free(edge_vertex); return(1); }
+				}
+			}
+		}
+	}
+
+	free(edge_vertex);
+	return(0);
+}
+
+static int isosurface(FLOAT * w, FLOAT level, ISO_MESH * mesh)
+/*
+extracts the isosurface p=level of the phase field in all ranks and gathers the triangles to 'mesh' in the master
+(the vertices on the boundaries between the blocks of the ranks appear once for each rank). The other ranks
+use 'mesh' as a temporary storage. Called by all ranks. Returns nonzero in all ranks if memory can not be allocated.
+*/
+{
+	FLOAT * send, * top;
+	int * counts_v = NULL, * counts_t = NULL, * displs_v = NULL, * displs_t = NULL;	/* indexed by the real ranks */
+	int error, any_error, i, j, l, real, offset;
+	double area;
+
+	memset(mesh, 0, sizeof(ISO_MESH));
+
+	/* get the first row of the next rank (the last rank has no cubes above its block) */
+	error = (send=(FLOAT *)malloc(2*n1*n2*sizeof(FLOAT))) == NULL;
+	MPI_Allreduce(&error, &any_error, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+	if(any_error) { free(send); return(1); }
+	top = send+n1*n2;
+	for(j=0;j<n2;j++) for(i=0;i<n1;i++)
+		send[j*n1+i] = VAR(w,phase_field)[bcond_thickness*rowsize + (j+bcond_thickness)*N1 + bcond_thickness + i];
+	MPI_Sendrecv(send, n1*n2, MPI__FLOAT, MPIrank>0 ? MPIrankmap[MPIrank-1] : MPI_PROC_NULL, MPIMSG_ISOSURFACE,
+		top, n1*n2, MPI__FLOAT, MPIrank<MPIprocs-1 ? MPIrankmap[MPIrank+1] : MPI_PROC_NULL, MPIMSG_ISOSURFACE,
+		MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+	error = extract_isosurface(VAR(w,phase_field), top, level, mesh);
+	free(send);
+	if(MPIrank==0 && !error) {
+		if( (error = (counts_v=(int *)malloc(4*MPIprocs*sizeof(int))) == NULL) == 0) {
+			counts_t = counts_v+MPIprocs;
+			displs_v = counts_t+MPIprocs;
+			displs_t = displs_v+MPIprocs;
+		}
+	}
+	MPI_Allreduce(&error, &any_error, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+
+	/* the master allocates the whole mesh */
+	if(!any_error) {
+		MPI_Reduce(&mesh->area, &area, 1, MPI_DOUBLE, MPI_SUM, MPIrankmap[0], MPI_COMM_WORLD);
+		MPI_Gather(&mesh->n_vertices, 1, MPI_INT, counts_v, 1, MPI_INT, MPIrankmap[0], MPI_COMM_WORLD);
+		MPI_Gather(&mesh->n_triangles, 1, MPI_INT, counts_t, 1, MPI_INT, MPIrankmap[0], MPI_COMM_WORLD);
+	}
+	if(MPIrank==0 && !any_error) {
+		long total_v=0, total_t=0;
+		float * v;
+		int * t;
+
+		/* the blocks are placed in the order of the virtual ranks, so that the master's own block stays in place */
+		for(l=0;l<MPIprocs;l++) {
+			real = MPIrankmap[l];
+			displs_v[real] = 3*total_v;
+			displs_t[real] = 3*total_t;
+			total_v += counts_v[real];
+			total_t += counts_t[real];
+			counts_v[real] *= 3;
+			counts_t[real] *= 3;
+		}
+		if(3*total_v > INT_MAX || 3*total_t > INT_MAX) error = 1;
+		else if((v=(float *)realloc(mesh->vertex, (3*total_v+1)*sizeof(float))) == NULL) error = 1;
+		else if((mesh->vertex=v, t=(int *)realloc(mesh->triangle, (3*total_t+1)*sizeof(int))) == NULL) error = 1;
+		else {
+			mesh->triangle = t;
+			mesh->n_vertices = mesh->max_vertices = total_v;
+			mesh->n_triangles = mesh->max_triangles = total_t;
+			mesh->area = area;
+		}
+		MPI_Bcast(&error, 1, MPI_INT, MPIrankmap[0], MPI_COMM_WORLD);
+	} else if(!any_error)
+		MPI_Bcast(&error, 1, MPI_INT, MPIrankmap[0], MPI_COMM_WORLD);
+
+	if(any_error || error) {
+		free(counts_v);
+		free(mesh->vertex);
+		free(mesh->triangle);
+		memset(mesh, 0, sizeof(ISO_MESH));
+		return(1);
+	}
+
+	/* gather the vertices and the triangles, then shift the vertex indices of each block */
+	MPI_Gatherv(MPIrank ? mesh->vertex : MPI_IN_PLACE, 3*mesh->n_vertices, MPI_FLOAT,
+		mesh->vertex, counts_v, displs_v, MPI_FLOAT, MPIrankmap[0], MPI_COMM_WORLD);
+	MPI_Gatherv(MPIrank ? mesh->triangle : MPI_IN_PLACE, 3*mesh->n_triangles, MPI_INT,
+		mesh->triangle, counts_t, displs_t, MPI_INT, MPIrankmap[0], MPI_COMM_WORLD);
+
+	if(MPIrank==0) {
+		for(l=1;l<MPIprocs;l++) {
+			real = MPIrankmap[l];
+			for(offset=displs_v[real]/3,i=displs_t[real];i<displs_t[real]+counts_t[real];i++) mesh->triangle[i] += offset;
+		}
+		free(counts_v);
+	} else {
+		free(mesh->vertex);
+		free(mesh->triangle);
+		memset(mesh, 0, sizeof(ISO_MESH));
+	}
+	return(0);
+}
+
+static int write_ply(_conststring_ filename, const ISO_MESH * mesh, FLOAT level, FLOAT t)
+/* saves the mesh as a binary PLY file in the byte order of this machine. Returns nonzero on error. */
+{
+	union { int i; char c; } byte_order = { 1 };
+	unsigned char three = 3;
+	FILE * f;
+	int q, error;
+
+	if((f=fopen(filename, "wb")) == NULL) return(1);
+	fprintf(f, "ply\nformat %s 1.0\n", byte_order.c ? "binary_little_endian" : "binary_big_endian");
+	fprintf(f, "comment Intertrack isosurface p=%g at t=%g\n", (double)level, (double)t);
+	fprintf(f, "element vertex %d\nproperty float x\nproperty float y\nproperty float z\n", mesh->n_vertices);
+	fprintf(f, "element face %d\nproperty list uchar int vertex_indices\nend_header\n", mesh->n_triangles);
+
+	fwrite(mesh->vertex, sizeof(float), 3*mesh->n_vertices, f);
+	for(q=0;q<mesh->n_triangles;q++) {
+		fwrite(&three, 1, 1, f);
+		fwrite(mesh->triangle+3*q, sizeof(int), 3, f);
+	}
+
+	error = ferror(f);
+	return(fclose(f) || error);
+}
+
+static int trim_area_file(_conststring_ filename, int first_snapshot)
+/*
+removes the rows of the snapshots from 'first_snapshot' on from the interface area history 'filename' (they were
+saved by an earlier run which is being continued from an earlier snapshot). A missing file is not an error.
+Returns nonzero on error.
+*/
+{
+	char line[256], tmp_name[4096];
+	FILE * f, * tmp;
+	int snapshot, error;
+
+	if((f=fopen(filename, "r")) == NULL) return(0);
+	snprintf(tmp_name, sizeof(tmp_name), "%s.tmp", filename);
+	if((tmp=fopen(tmp_name, "w")) == NULL) { fclose(f); return(1); }
+	while(fgets(line, sizeof(line), f) != NULL)
+		if(sscanf(line, "%d", &snapshot) == 1 && snapshot < first_snapshot) fputs(line, tmp);
+	fclose(f);
+	error = ferror(tmp);
+	if(fclose(tmp) || error || rename(tmp_name, filename)) { remove(tmp_name); return(1); }
+	return(0);
+}
+
+/* =========================================================================== */
+/* batch iteration result cache (see result_cache) */
+
+#define RESULT_HASH_INIT	0xcbf29ce484222325ULL
+
+static int z_grid_faces(FLOAT * face)
+/*
+computes the Z coordinates of the faces face[0]=0, ..., face[total_n3]=L3 between the grid rows (called by the master
+while the parameters are still defined in the expression evaluator). The local grid spacing is proportional to the
+relative spacing w(z) given by the formula 'z_spacing' or by the table 'z_spacing_table' (pairs "z w" with increasing z,
+interpolated linearly and extended by the end values), i.e. the faces are equidistant in terms of the integral of 1/w.
+The integral is evaluated by the trapezoidal rule on Z_GRID_SAMPLES subintervals per grid row. Without any of the
+settings, the grid is uniform. Returns 1 if the formula can not be parsed, 2 if the table is invalid, 3 if w is
+not positive everywhere and 4 if there is not enough memory.
+*/
+{
+	#define Z_GRID_SAMPLES	64
+	#define Z_TABLE_SIZE	256
+
+	int m, k, count=0, pos, M = Z_GRID_SAMPLES*total_n3, z_index=0;
+	double * integral, z, w, w_prev=0.0, table[2][Z_TABLE_SIZE], target;
+	_conststring_ t = z_spacing_table;
+
+	if(!*z_spacing && !*z_spacing_table) {
+		for(k=0;k<=total_n3;k++) face[k] = L3*k/total_n3;
+		return(0);
+	}
+
+	if(*z_spacing) {
+		ev_def_var("z", 0); z_index = ev_get_index("z");
+		if(ev_parse(z_spacing)) { ev_undef_var("z"); return(1); }
+	} else {
+		while(count<Z_TABLE_SIZE && sscanf(t, "%lf %lf%n", &table[0][count], &table[1][count], &pos) == 2) {
+			if(count && table[0][count] <= table[0][count-1]) return(2);
+			count++; t += pos;
+		}
+		if(!count) return(2);
+	}
+
+	if((integral = (double *)malloc((M+1)*sizeof(double))) == NULL) {
+		if(*z_spacing) ev_undef_var("z");
+		return(4);
+	}
+
+	/* the integral of 1/w from 0 to the sample points */
+	for(m=0;m<=M;m++) {
+		z = L3*m/M;
+		if(*z_spacing) {
+			ev_set_var_value(z_index, z);
+			w = ev_evaluate();
+		} else {
+			for(k=0; k<count-1 && table[0][k+1] < z; k++);
+			if(z <= table[0][0] || k == count-1) w = table[1][k];
+			else w = table[1][k] + (table[1][k+1]-table[1][k]) * (z-table[0][k]) / (table[0][k+1]-table[0][k]);
+		}
+		if(!(w > 0.0)) break;
+		integral[m] = m ? integral[m-1] + 0.5*(L3/M)*(1.0/w_prev + 1.0/w) : 0.0;
+		w_prev = w;
+	}
+	if(*z_spacing) ev_undef_var("z");
+	if(m<=M) { free(integral); return(3); }
+
+	/* place the faces at equal increments of the integral (which is strictly increasing), interpolating linearly */
+	face[0] = 0.0;
+	face[total_n3] = L3;
+	for(m=0,k=1;k<total_n3;k++) {
+		target = integral[M] * k / total_n3;
+		while(integral[m+1] < target) m++;
+		face[k] = L3/M * (m + (target-integral[m]) / (integral[m+1]-integral[m]));
+	}
+
+	free(integral);
+	return(0);
+
+	#undef Z_GRID_SAMPLES
+	#undef Z_TABLE_SIZE
+}
+
+void SetupZGrid(void)
+/*
+broadcasts the Z coordinates of the faces computed by the master (see z_grid_faces()) to all ranks and completes those
+of the auxiliary rows by mirroring the adjacent grid rows with respect to the boundary (which is consistent with the
+mirroring in the boundary conditions). The nodes are located at the centers of the rows.
+*/
+{
+	int k;
+
+	MPI_Bcast(z_face+bcond_thickness, total_n3+1, MPI__FLOAT, MPIrankmap[0], MPI_COMM_WORLD);
+
+	for(k=1;k<=bcond_thickness;k++) {
+		Z_FACE(-k) = -Z_FACE(k);
+		Z_FACE(total_n3+k) = 2.0*L3 - Z_FACE(total_n3-k);
+	}
+	for(k=-bcond_thickness;k<total_n3+bcond_thickness;k++) Z_NODE(k) = 0.5*(Z_FACE(k)+Z_FACE(k+1));
+}
+
+static int reference_errors(int q, const FLOAT * data, ptrdiff_t line, ptrdiff_t row, int rows, int first, FLOAT t, double * error)
+/*
+compares the snapshot data of the variable q in a block of the inner grid ('rows' rows beginning at the global row
+'first', with the lines and the rows 'line' and 'row' elements apart, see transfer_block()) with its reference solution
+formula evaluated at time t. The maximum and the sum of squares of the differences (weighted by the grid spacing
+along Z) are accumulated in 'error'. Returns q+1 if the formula has a syntax error, or 0. The expression evaluator
+is reset before returning.
+*/
+{
+	int i,j,k,result=0;
+	int x_index, y_index, z_index;
+	double diff, dz;
+
+	ev_def_var("L1", L1);
+	ev_def_var("L2", L2);
+	ev_def_var("L3", L3);
+	for(i=0;i<PARAM_INFO_SIZE;i++) if(param_info[i].index >= 0)
+		ev_def_var(param_info[i].name, model_parameters[param_info[i].index]);
+	ev_def_var("x", 0); x_index=ev_get_index("x");
+	ev_def_var("y", 0); y_index=ev_get_index("y");
+	ev_def_var("z", 0); z_index=ev_get_index("z");
+	ev_def_var("t", t);
+
+	if(ev_parse(reference_formula[q])) result=q+1;
+	else for(k=0;k<rows;k++) {
+		ev_set_var_value(z_index, Z_NODE(k+first));
+		dz = Z_FACE(k+first+1) - Z_FACE(k+first);
+		for(j=0;j<n2;j++) {
+			ev_set_var_value(y_index, L2*(0.5+j)/n2);
+			for(i=0;i<n1;i++) {
+				ev_set_var_value(x_index, L1*(0.5+i)/n1);
+				diff = fabs(data[k*row + j*line + i] - ev_evaluate());
+				if(diff > error[0]) error[0] = diff;
+				error[1] += diff*diff*dz;
+			}
+		}
+	}
+
+	ev_reset();
+	return(result);
+}
+
+static unsigned long long hash_bytes(unsigned long long h, const void * data, size_t size)
+/* continues the 64-bit FNV-1a hash 'h' by 'size' bytes of 'data' */
+{
+	const unsigned char * b = (const unsigned char *)data;
+
+	while(size--) {
+		h ^= *(b++);
+		h *= 0x100000001b3ULL;
+	}
+	return(h);
+}
+
+static unsigned long long hash_setting(unsigned long long h, _conststring_ name, _conststring_ value)
+/* continues the hash by the line "name=value" */
+{
+	h = hash_bytes(h, name, strlen(name));
+	h = hash_bytes(h, "=", 1);
+	h = hash_bytes(h, value, strlen(value));
+	return(hash_bytes(h, "\n", 1));
+}
+
+static unsigned long long hash_number(unsigned long long h, _conststring_ name, double value)
+/* the numbers are hashed in full precision, so that e.g. "0.03" and "3e-2" in the parameters file are the same */
+{
+	char buf[64];
+
+	sprintf(buf, "%.17g", value);
+	return(hash_setting(h, name, buf));
+}
+
+static unsigned long long hash_file(unsigned long long h, _conststring_ name, _conststring_ filename)
+/* continues the hash by the checksum of the file contents (or by "missing" if the file can't be read) */
+{
+	unsigned long long c = RESULT_HASH_INIT;
+	char buf[4096];
+	size_t n;
+	FILE * f;
+
+	if((f=fopen(filename, "rb"))==NULL) return(hash_setting(h, name, "missing"));
+	while((n=fread(buf, 1, sizeof(buf), f)) > 0) c = hash_bytes(c, buf, n);
+	fclose(f);
+	sprintf(buf, "%016llx", c);
+	return(hash_setting(h, name, buf));
+}
+
+static unsigned long long parameters_hash(FLOAT tau, FLOAT tau_min, FLOAT delta, int total_snapshots)
+/*
+returns the hash of the fully evaluated parameters of the current batch iteration: the loop variables,
+the geometry and the grid, the model parameters, the initial conditions, the material laws, the solver
+settings and the checksum of the glass beads positions file. An initial conditions dataset is identified
+by its path, size and modification time only. The settings that do not affect the results (the logs,
+autotuning, the number of ranks etc.) are not included.
+*/
+{
+	unsigned long long h = RESULT_HASH_INIT;
+	char name[64];
+	struct stat st;
+	int q;
+
+	for(q=0;q<loopN;q++) {
+		sprintf(name, "i%d", q+1);
+		h = hash_number(h, name, loopI[q]);
+	}
+
+	h = hash_number(h, "L1", L1);
+	h = hash_number(h, "L2", L2);
+	h = hash_number(h, "L3", L3);
+	h = hash_number(h, "n1", n1);
+	h = hash_number(h, "n2", n2);
+	h = hash_number(h, "n3", total_n3);
+	h = hash_number(h, "bcond_thickness", bcond_thickness);
+	h = hash_number(h, "grid_IO_mode", grid_IO_mode);
+	h = hash_number(h, "periodic", periodic);
+	h = hash_number(h, "bead_mode", bead_mode);
+	if(bead_mode) h = hash_number(h, "cutcell_samples", cutcell_samples);
+	h = hash_number(h, "stencil_order", stencil_order);
+	h = hash_setting(h, "z_spacing", z_spacing);
+	h = hash_setting(h, "z_spacing_table", z_spacing_table);
+	h = hash_number(h, "calc_mode", calc_mode);
+
+	for(q=0;q<PARAM_INFO_SIZE;q++)
+		if(param_info[q].index >= 0) h = hash_number(h, param_info[q].name, model_parameters[param_info[q].index]);
+
+	if(icond_mode) {
+		h = hash_setting(h, "icond_file", icond_file);
+		if(stat(icond_file, &st)==0) {
+			h = hash_number(h, "icond_file_size", (double)st.st_size);
+			h = hash_number(h, "icond_file_mtime", (double)st.st_mtime);
+		}
+	} else for(q=0;q<VAR_COUNT;q++) {
+		sprintf(name, "icond_%s", variable[q].name);
+		h = hash_setting(h, name, icond_formula[q]);
+	}
+	h = hash_number(h, "continue_series", continue_series);
+	h = hash_number(h, "skip_icond", skip_icond);
+
+	for(q=0;q<LAW_COUNT;q++) {
+		sprintf(name, "law_%s", law_info[q].name);
+		h = hash_setting(h, name, law_formula[q]);
+	}
+
+	h = hash_number(h, "tau", tau);
+	h = hash_number(h, "tau_min", tau_min);
+	h = hash_number(h, "delta", delta);
+	h = hash_number(h, "final_time", final_time);
+	h = hash_number(h, "saved_files", total_snapshots);
+	h = hash_number(h, "stiffness", stiffness_mode);
+	h = hash_number(h, "error_norm", error_norm);
+	if(error_norm==RK_NORM_RMS)
+		for(q=0;q<VAR_COUNT;q++) {
+			sprintf(name, "atol_%s", variable[q].name);
+			h = hash_number(h, name, var_atol[q]);
+			sprintf(name, "rtol_%s", variable[q].name);
+			h = hash_number(h, name, var_rtol[q]);
+		}
+	h = hash_number(h, "out_series", out_series);
+	h = hash_number(h, "out_local", out_local);
+	h = hash_number(h, "iso_every", iso_every);
+	h = hash_number(h, "iso_level", iso_level);
+	h = hash_number(h, "iso_only", iso_only);
+
+	return(hash_file(h, "beads", ball_positions_file));
+}
+
+static int read_result(_conststring_ filename, unsigned long long * hash, int * last_snapshot, int * complete)
+/* reads the result file of a batch iteration. Returns nonzero if there is none or if it is invalid. */
+{
+	FILE * f;
+	int ok;
+
+	if((f=fopen(filename, "r"))==NULL) return(1);
+	ok = fscanf(f, "hash %llx last_snapshot %d complete %d", hash, last_snapshot, complete)==3;
+	fclose(f);
+	return(!ok);
+}
+
+static int write_result(_conststring_ filename, unsigned long long hash, int last_snapshot, int complete)
+/*
+writes the result file of a batch iteration. The file is replaced atomically, so that an interrupted
+calculation never leaves it incomplete. Returns nonzero on error.
+*/
+{
+	char tmp[4096+16];
+	FILE * f;
+	int e;
+
+	sprintf(tmp, "%s.tmp", filename);
+	if((f=fopen(tmp, "w"))==NULL) return(1);
+	e = fprintf(f, "hash %016llx\nlast_snapshot %d\ncomplete %d\n", hash, last_snapshot, complete) < 0;
+	if(fclose(f)!=0) e=1;
+	if(e || rename(tmp, filename)!=0) {
+		remove(tmp);
+		return(1);
+	}
+	return(0);
+}
+
+/* =========================================================================== */
+/* resource planner (see 'plan' in the parameter file) */
+
+#define PLAN_ROWS	8	/* the number of grid rows per rank in the calibration grid */
+#define PLAN_RK_ARRAYS	5	/* the auxiliary arrays of the Merson scheme (K1, K3, K4, K5, aux - see RK_engine.c) */
+#define PLAN_STAGES	5	/* the right hand side evaluations per RK step */
+
+static double plan_rank_memory(int procs, double * component)
+/*
+returns the memory [bytes] needed by the largest block (the virtual rank 0, which receives the remaining
+rows) of the actual grid distributed among 'procs' ranks. If 'component' is not NULL, the amounts of
+the solution, the RK solver arrays, the precalculated data, the snapshot buffer (block_buffer, only in
+rank 0 and only with more ranks) and the chunk tables are stored there, in the order of the allocations in main().
+*/
+{
+	double c[5], rows, size;
+	int rk_arrays = PLAN_RK_ARRAYS + (stiffness_mode==RK_STIFF_SWITCH ? 8 : stiffness_mode==RK_STIFF_DETECT);
+
+	rows = plan_n3/procs + (plan_n3%procs > 0);
+	size = (double)(n1+2*bcond_thickness) * (n2+2*bcond_thickness) * (rows+2*bcond_thickness);
+
+	c[0] = VAR_COUNT * size * sizeof(FLOAT);
+	c[1] = rk_arrays * VAR_COUNT * size * sizeof(FLOAT);
+	c[2] = (double)(sizeof(PRECALC_DATA) + (bead_mode ? sizeof(CUT_CELL) : 0)) * n1 * n2 * rows;
+	if(procs==1) c[3] = 0;
+	else if(grid_IO_mode) c[3] = (double)n1 * n2 * rows * sizeof(FLOAT);
+	else c[3] = (double)(n1+2*bcond_thickness) * (n2+2*bcond_thickness) * (rows+bcond_thickness) * sizeof(FLOAT);
+	c[4] = (double)VAR_COUNT * n2 * rows * (2*sizeof(int) + 3*sizeof(FLOAT));
+
+	if(component!=NULL) memcpy(component, c, sizeof(c));
+	return(c[0]+c[1]+c[2]+c[3]+c[4]);
+}
+
+static double plan_step_time(int procs, int threads, double cell_time, double serial)
+/*
+predicts the wall time of one RK step of the actual grid on 'procs' ranks with 'threads' threads each.
+'cell_time' is the single thread cost of one stage per grid node and 'serial' is the serial fraction
+of the work of a rank (Amdahl's law).
+*/
+{
+	double rows = plan_n3/procs + (plan_n3%procs > 0);
+	return(PLAN_STAGES * cell_time * n1 * n2 * rows * (serial + (1.0-serial)/threads));
+}
+
+static int plan_fits(int procs, int threads)
+/* nonzero if the grid can be split among 'procs' ranks with 'threads' threads each within the available memory */
+{
+	if(plan_n3/procs < bcond_thickness) return(0);
+	return(plan_memory<=0 || plan_rank_memory(procs, NULL) <= threads*plan_memory);
+}
+
+void PlanResources(RK_MPI_S_SOLUTION * system, int threads)
+/*
+This is called by all ranks after the RK solver has been set up on the calibration grid (a slab of the actual
+grid with PLAN_ROWS rows per rank) in the resource planner dry run. The time of one stage of the RK solver
+(a right hand side evaluation and a stage update including the boundary exchange) is measured by
+RK_MPI_SA_autotune() with 'threads' threads per rank and with a single thread. This gives the single thread
+cost per grid node and the serial fraction of the work, from which the master predicts the time per RK step
+of the actual grid for any layout. Together with the memory needed per rank, it reports the requested layout,
+the rank counts that fit, the smallest one meeting the target wall time and the fastest rank/thread split
+of the resulting number of cores. Then the program stops.
+*/
+{
+	char * RK_autotune_errors[]= {	"RK_MPI_SA_autotune: Not enough memory.",
+					"RK_MPI_SA_autotune: Invalid system specification.",
+					"RK_MPI_SA_autotune: unitialized.",
+					"",
+					"RK_MPI_SA_autotune: chunks out of memory",
+					"RK_MPI_SA_autotune: failed in another rank"
+				};
+	RK_TUNING best, single;
+
+	if(MPIrank==0) {
+		Mmprintf(logfile, "\nResource planner: measuring the cost per grid node (%d right hand side evaluations per setup) ...\n", plan_iterations);
+		commit_logfile(1);
+	}
+
+	CheckErrorAcrossRanks( -RK_MPI_SA_autotune(system, plan_iterations, &best, NULL, NULL), 1, RK_autotune_errors);
+	single = best;
+	#ifdef _OPENMP
+	 if(threads>1) {
+		omp_set_num_threads(1);
+		CheckErrorAcrossRanks( -RK_MPI_SA_autotune(system, plan_iterations, &single, NULL, NULL), 1, RK_autotune_errors);
+		omp_set_num_threads(threads);
+	 }
+	#endif
+
+/* ####### B E G I N >>> MASTER <<< ####### */ if(MPIrank==0) {
 
-		time(&calendar_time);
-		br_time=localtime(&calendar_time);
+	double component[5];
+	double cal_cells = (double)n1 * n2 * (total_n3/MPIprocs + (total_n3%MPIprocs > 0));
+	double cell_time = single.time / cal_cells;
+	double serial = 1.0;
+	double step, steps = plan_steps;
+	int procs, t, rec_procs=0, rec_threads=0, cores;
+
+	_conststring_ component_name[5] = { "solution", "RK solver arrays", "precalculated data", "snapshot buffer", "chunk tables" };
+
+	if(threads>1) serial = (best.time/single.time - 1.0/threads) / (1.0 - 1.0/threads);
+	if(serial<0) serial=0;
+	if(serial>1) serial=1;
+
+	Mmprintf(logfile, "Calibration grid %d x %d x %d on %d rank(s): %.3e s per stage with %d thread(s), %.3e s with 1 thread\n",
+		n1, n2, total_n3, MPIprocs, best.time, threads, single.time);
+	Mmprintf(logfile, "Single thread cost per grid node and stage: %.3e s, serial fraction: %.3f\n", cell_time, serial);
+
+	/* the requested layout */
+	Mmprintf(logfile, "\nActual grid %d x %d x %d, %d rank(s) x %d thread(s):\n", n1, n2, plan_n3, plan_ranks, plan_threads);
+	if(plan_n3/plan_ranks < bcond_thickness)
+		Mmprintf(logfile, "Warning: The grid depth is too small for parallelization on %d ranks.\n", plan_ranks);
+	Mmprintf(logfile, "Memory of the largest rank: %.1f MB\n", plan_rank_memory(plan_ranks, component)/1048576.0);
+	for(t=0;t<5;t++) Mmprintf(logfile, "  %-20s %12.1f MB\n", component_name[t], component[t]/1048576.0);
+	step = plan_step_time(plan_ranks, plan_threads, cell_time, serial);
+	Mmprintf(logfile, "Time per RK step: %.3e s\n", step);
+	Mmprintf(logfile, "Predicted wall time of %.0f steps: %s\n", steps, format_time(steps*step));
+
+	/* rank counts for the requested number of threads per rank */
+	Mmprintf(logfile, "\n%8s %12s %14s %14s   %s\n", "ranks", "rows/rank", "memory/rank", "time/step", "wall time");
+	for(procs=1; plan_n3/procs >= bcond_thickness; procs*=2) {
+		int fits = plan_fits(procs, plan_threads);
+		step = plan_step_time(procs, plan_threads, cell_time, serial);
+		if(!rec_procs && fits && plan_wall_time>0 && steps*step <= plan_wall_time) rec_procs=procs;
+		Mmprintf(logfile, "%8d %12d %11.1f MB %12.3e s   %s%s\n", procs, plan_n3/procs + (plan_n3%procs > 0),
+			plan_rank_memory(procs, NULL)/1048576.0, step, format_time(steps*step), fits ? "" : " (does not fit)");
+	}
 
-		fprintf(debug_logfile_ID,
-			"%s - step %08ld, t=%10.4" FTC_E ", tau=%10.4" FTC_E ", Elapsed time: %s",
-			format_date(br_time),
-			self->steps,
-			self->t,
-			self->h,
-			format_time(MPIelapsed_time_to_log)
-			);
-		/* the fprintf() call must be split as multiple calls to format_time() share the same static buffer */
-		fprintf(debug_logfile_ID,", Est. time to snapshot %d (t=%10.4" FTC_E "): %s",
-			__snapshot,
-			final_snapshot_time,
-			format_time(MPIestimated_time_to_next_snapshot)
-		);
-		/* the command must be split as multiple calls to format_time() share the same static buffer */
-		fprintf(debug_logfile_ID,", Est. time to final t=%10.4" FTC_E "): %s\n",
-			final_time,
-			format_time(MPIestimated_time_to_completion)
-		);
-		fflush(debug_logfile_ID);
+	if(plan_wall_time<=0) rec_procs=plan_ranks;
+	else if(rec_procs)
+		Mmprintf(logfile, "Recommended: %d rank(s) x %d thread(s) to finish within %s\n", rec_procs, plan_threads, format_time(plan_wall_time));
+	else {
+		Mmprintf(logfile, "Warning: The target wall time %s can not be met with %d thread(s) per rank.\n", format_time(plan_wall_time), plan_threads);
+		rec_procs=plan_ranks;
 	}
 
-	if(snapshot_trigger) {
-		struct stat s;
-		/* nonzero return value => computation will be interrupted and snapshot save action will be triggered */
-		if(!stat(snapshot_trigger_file,&s)) return(1);
+	/* the rank/thread splits of the same number of cores (the fewest ranks win a tie within 2%) */
+	cores = rec_procs*plan_threads;
+	Mmprintf(logfile, "\nLayouts of %d cores:\n%8s %8s %14s %14s\n", cores, "ranks", "threads", "memory/rank", "time/step");
+	step = 0;
+	for(t=cores; t>=1; t--) {
+		double s;
+		if(cores%t) continue;
+		procs = cores/t;
+		if(plan_n3/procs < bcond_thickness) continue;
+		s = plan_step_time(procs, t, cell_time, serial);
+		Mmprintf(logfile, "%8d %8d %11.1f MB %12.3e s%s\n", procs, t, plan_rank_memory(procs, NULL)/1048576.0, s,
+			plan_fits(procs, t) ? "" : " (does not fit)");
+		if(plan_fits(procs, t) && (!rec_threads || s < 0.98*step)) { rec_threads=t; step=s; }
 	}
+	if(rec_threads)
+		Mmprintf(logfile, "Recommended layout: %d rank(s) x %d thread(s), %.3e s per step\n", cores/rec_threads, rec_threads, step);
+	else Mmprintf(logfile, "Warning: No layout of %d cores fits into the available memory.\n", cores);
 
-	return(0);
+	Mmprintf(logfile, "\nNOTE: The prediction neglects the snapshot output and assumes the given number of RK steps.\n"
+			"Resource planner dry run completed.\n");
+	HaltAllRanks(0);
+
+/* ####### E N D >>> MASTER <<< ####### */ }
 }
 
 /* =========================================================================== */
@@ -1129,24 +2641,26 @@ int main(int argc, char *argv[])
 	char * com_format = "Intertrack simulation (%s). Time: %" FTC_g;
 	char buf[4096];
 	char filename[4096];
+	char local_name[4096];		/* the rank-local dataset name (see out_local) */
 	_string_ base_name, path;
 
 
 	/* the sparse system distribution specification arrays for RK_MPI_SAsolver */
 	int * chunk_start, * chunk_size;
 	FLOAT * chunk_eps_mult;
+	FLOAT * chunk_atol = NULL, * chunk_rtol = NULL;
 	int n_chunks;
 
 	/*
-	solution cache (used when deploying initial conditions or collecting the data for a snapshot)
-	We use a cache for the following reasons:
-	- The computational grid can be of any floating point type but the NetCDF datasets exclusively use 'double'.
-	- The datasets do not normally contain the auxiliary grid nodes. Transcription from the dataset to
-	  the computational grid therefore happens by small chunks placed in a highly non-contiguous pattern.
-	  However, invoking a NetCDF read operation for each chunk is inefficient.
-	- With a cache, any generalization of the transcription procedure is possible.
+	the buffer for one variable of the block of another rank in the master (used when deploying initial conditions
+	or collecting the data for a snapshot). The other ranks send and receive their blocks directly from and to
+	the solution arrays (see block_datatype()) and the master reads and writes its own block in place.
 	*/
-	double * data_cache[VAR_COUNT];
+	FLOAT * block_buffer = NULL;
+
+	/* errors of the snapshot with respect to the reference solution (maximum and sum of squares), see reference_errors() */
+	double reference_error[VAR_COUNT][2];
+	int reference_syntax_error;
 
 	/*
 	messages for errors that may occur in any rank (or, more precisely, only some of them can.
@@ -1157,7 +2671,8 @@ int main(int argc, char *argv[])
 				"Not enough memory to allocate the RK chunk specification array.",
 				"Not enough memory to allocate the variables.",
 				"Not enough memory to allocate the precalculated data array.",
-				"Not enough memory to allocate the cache for variables import/export."
+				"Not enough memory to allocate the buffer for variables import/export.",
+				"Not enough memory to allocate the grid coordinates."
 				};
 
 	/* ---------- variable & parameters metadata initialization ---------- */
@@ -1224,7 +2739,8 @@ int main(int argc, char *argv[])
 
 	if(MPImaster<0 || MPImaster>=MPIprocs) MPImaster=0;	/* ignore invalid master rank specification */
 
-	BuildRankMap(MPImaster);				/* fill the rank permutation array */
+	/* fill the rank permutation array so that the consecutive blocks stay on the same node where possible */
+	if(MPI_topology_rankmap(MPI_COMM_WORLD, MPImaster, MPIrankmap, &MPItopology)) BuildRankMap(MPImaster);
 
 	/* make MPIrank denote the VIRTUAL rank of this process. (Until now, it was the real rank) */
 	for(q=0;q<MPIprocs;q++)
@@ -1248,10 +2764,12 @@ int main(int argc, char *argv[])
 		"Running %d rank%s, MASTER (virtual) rank 0 on : %s\n"
 		"OpenMP threading support is %s. Number of threads: %d\n",
 		MPIprocs, (MPIprocs>1?"s":""), MPIprocname, OMP_support ? "ON" : "OFF", OMP_threads);
+	Mmprintf(logfile, "Placement: %d node%s. Rank 0: node %d, socket %d\n",
+		MPItopology.n_nodes, (MPItopology.n_nodes>1?"s":""), MPItopology.node, MPItopology.socket);
 
 	for(q=1;q<MPIprocs;q++) {
 		/* for MPI_Recv(), we specify the maximum, not the exact number of elements to be received */
-		MPI_Recv(buf, 256, MPI_CHAR, MPIrankmap[q], MPIMSG_PROCNAME, MPI_COMM_WORLD, &MPIstat);
+		MPI_Recv(buf, sizeof(buf), MPI_CHAR, MPIrankmap[q], MPIMSG_PROCNAME, MPI_COMM_WORLD, &MPIstat);
 		Mmprintf(logfile, "Rank %d running on : %s\n", q, buf);
 	}
 
@@ -1260,8 +2778,12 @@ int main(int argc, char *argv[])
 
 /* ####### E N D >>> MASTER <<<, B E G I N >>> OTHER <<< ####### */ } else {
 
+	/* the processor name is followed by the placement of the rank */
+	sprintf(buf, "%s (REAL rank %d, node %d, socket %d)",
+		MPIprocname, MPIrankmap[MPIrank], MPItopology.node, MPItopology.socket);
+
 	/* "+1" makes the null terminator of the string be transferred as well */
-	MPI_Send(MPIprocname, MPIprocnamelength+1, MPI_CHAR, MPIrankmap[0], MPIMSG_PROCNAME, MPI_COMM_WORLD);
+	MPI_Send(buf, len(buf)+1, MPI_CHAR, MPIrankmap[0], MPIMSG_PROCNAME, MPI_COMM_WORLD);
 
 /* ####### E N D >>> OTHER <<< ####### */ }
 
@@ -1421,6 +2943,15 @@ int main(int argc, char *argv[])
 
 	/* ---------- parameters file processing ---------- */
 
+	/* undo the overrides made to resume the previous iteration (see result_cache) */
+	if(result_resumed) {
+		icond_mode = saved_icond_mode;
+		continue_series = saved_continue_series;
+		skip_icond = saved_skip_icond;
+		set(icond_file, saved_icond_file);
+		result_resumed=0;
+	}
+
 	should_break=0;
 	if(pparse(argv[1], handle_special, stdout)) HaltAllRanks(1);
 
@@ -1559,6 +3090,45 @@ int main(int argc, char *argv[])
 
 	Mmprintf(logfile, "Boundary conditions auxiliary node layer thickness: %d\n", bcond_thickness);
 
+	periodic = (ToInt(evchkD("periodic_x",0)) ? PERIODIC_X : 0) | (ToInt(evchkD("periodic_y",0)) ? PERIODIC_Y : 0);
+	Mmprintf(logfile, "Lateral boundary conditions: X %s, Y %s\n",
+		(periodic & PERIODIC_X) ? "periodic" : "Neumann", (periodic & PERIODIC_Y) ? "periodic" : "Neumann");
+
+	bead_mode = ToInt(evchkD("bead_mode",0));
+	if(bead_mode<0 || bead_mode>1) {
+		Mmprintf(logfile, "Error: Invalid bead_mode value %d.\nStop.\n", bead_mode);
+		HaltAllRanks(2);
+	}
+	if(bead_mode) {
+		cutcell_samples = ToInt(evchkD("cutcell_samples",8));
+		if(cutcell_samples<1) {
+			Mmprintf(logfile, "Error: cutcell_samples must be positive.\nStop.\n");
+			HaltAllRanks(2);
+		}
+		Mmprintf(logfile, "Glass beads: sharp (cut cells, %d strips per cell edge)\n", cutcell_samples);
+	} else Mmprintf(logfile, "Glass beads: diffuse (glass phase field)\n");
+
+	stencil_order = ToInt(evchkD("stencil_order",2));
+	if((stencil_order!=2 && stencil_order!=4) || bcond_thickness<stencil_order/2) {
+		Mmprintf(logfile, "Error: Invalid stencil_order value %d (2 or 4 with at least %d auxiliary node layers).\nStop.\n",
+			stencil_order, stencil_order/2);
+		HaltAllRanks(2);
+	}
+	Mmprintf(logfile, "Heat flux discretization order: %d\n", stencil_order);
+
+	fused_bcond = ToInt(evchkD("fused_bcond",0));
+	if(fused_bcond<0 || fused_bcond>1 || (fused_bcond && stencil_order!=2)) {
+		Mmprintf(logfile, "Error: Invalid fused_bcond value %d (0 or 1, with stencil_order 2 only).\nStop.\n", fused_bcond);
+		HaltAllRanks(2);
+	}
+	Mmprintf(logfile, "Boundary conditions: %s\n", fused_bcond ? "in the stencil" : "auxiliary nodes set up before the stencil");
+
+	bind_threads = ToInt(evchkD("bind_threads",1));
+	if(bind_threads<0 || bind_threads>1) {
+		Mmprintf(logfile, "Error: Invalid bind_threads value %d (0 or 1).\nStop.\n", bind_threads);
+		HaltAllRanks(2);
+	}
+
 	total_snapshots=ToInt(evchk("saved_files"));
 	Mmprintf(logfile, "Number of snapshots (the zeroth snapshot is the init. cond.): %d\n", total_snapshots);
 
@@ -1574,11 +3144,128 @@ int main(int argc, char *argv[])
 	tau_min=evchkD("tau_min",0.0);
 	Mmprintf(logfile, "Time step lower bound for RKM iteration to be controlled by delta : %" FTC_g "\n", tau_min);
 
+	autotune_iterations=ToInt(evchkD("autotune",0));
+	if(autotune_iterations<0) autotune_iterations=0;
+	if(autotune_iterations) Mmprintf(logfile, "RK solver autotuning: %d right hand side evaluations per candidate setup\n", autotune_iterations);
+	else Mmprintf(logfile, "RK solver autotuning: OFF\n");
+
+	stiffness_mode=ToInt(evchkD("stiffness",RK_STIFF_OFF));
+	if(stiffness_mode<RK_STIFF_OFF || stiffness_mode>RK_STIFF_SWITCH) {
+		Mmprintf(logfile, "Error: Invalid stiffness detection mode %d (0, 1 or 2 expected).\nStop.\n", stiffness_mode);
+		HaltAllRanks(2);
+	}
+	Mmprintf(logfile, "RK solver stiffness detection: %s\n",
+		stiffness_mode==RK_STIFF_SWITCH ? "ON, switching to the Rosenbrock method" : (stiffness_mode ? "ON" : "OFF"));
+
+	error_norm=ToInt(evchkD("error_norm",RK_NORM_MAX));
+	if(error_norm!=RK_NORM_MAX && error_norm!=RK_NORM_RMS) {
+		Mmprintf(logfile, "Error: Invalid RK solver error norm %d (0 or 1 expected).\nStop.\n", error_norm);
+		HaltAllRanks(2);
+	}
+	if(error_norm==RK_NORM_RMS) {
+		Mmprintf(logfile, "RK solver error norm: weighted RMS\n");
+		rms_atol=evchkD("atol",1e-6);
+		rms_rtol=evchkD("rtol",1e-3);
+		/* the variables' own tolerances (e.g. atol_u, rtol_p) override the defaults */
+		for(q=0;q<VAR_COUNT;q++) {
+			char tol_name[256];
+			sprintf(tol_name, "atol_%s", variable[q].name);
+			var_atol[q] = eval(tol_name);
+			if(ev_error()) var_atol[q] = rms_atol;
+			sprintf(tol_name, "rtol_%s", variable[q].name);
+			var_rtol[q] = eval(tol_name);
+			if(ev_error()) var_rtol[q] = rms_rtol;
+			if(var_atol[q]<0 || var_rtol[q]<0 || (var_atol[q]==0 && var_rtol[q]==0)) {
+				Mmprintf(logfile, "Error: Invalid RMS error norm tolerances of the variable '%s'.\nStop.\n", variable[q].name);
+				HaltAllRanks(2);
+			}
+			Mmprintf(logfile, "  %s: atol = %" FTC_g ", rtol = %" FTC_g "\n", variable[q].name, var_atol[q], var_rtol[q]);
+		}
+	} else Mmprintf(logfile, "RK solver error norm: maximum\n");
+
+	if(out_series) {
+		series_chunk_t=ToInt(evchkD("series_chunk_t",1));
+		series_deflate=ToInt(evchkD("series_deflate",0));
+		if(series_chunk_t<1 || series_deflate<0 || series_deflate>9) {
+			Mmprintf(logfile, "Error: Invalid time series chunking (series_chunk_t>=1) or deflate level (0-9).\nStop.\n");
+			HaltAllRanks(2);
+		}
+		Mmprintf(logfile, "Time series output: %d record(s) per chunk, deflate level %d\n", series_chunk_t, series_deflate);
+	}
+
+	if(out_local) {
+		if(out_series || !grid_IO_mode) {
+			Mmprintf(logfile, "Error: The rank-local output (out_local) can not be combined with out_series or with the full grid output.\nStop.\n");
+			HaltAllRanks(2);
+		}
+		for(q=0;q<VAR_COUNT;q++) if(*reference_formula[q]) {
+			Mmprintf(logfile, "Warning: The errors with respect to the reference solution are not evaluated with out_local.\n");
+			break;
+		}
+	}
+
+	iso_every=ToInt(evchkD("iso_every",0));
+	iso_level=evchkD("iso_level",0.5);
+	if(iso_every<0 || (iso_only && !iso_every)) {
+		Mmprintf(logfile, "Error: Invalid isosurface output interval iso_every (>=0, >0 with iso_only).\nStop.\n");
+		HaltAllRanks(2);
+	}
+	if(iso_every) Mmprintf(logfile, "Isosurface p=%" FTC_g " saved with every %d. snapshot\n", iso_level, iso_every);
+
 	Mmprintf(logfile, "Comment: %s\n", comment);
 
+	/* ---------- batch iteration result cache ---------- */
+
+	/*
+	Compare the parameters hash with the one recorded in the output directory. The results computed with
+	the same parameters are reused: A complete iteration is skipped and an interrupted one continues from
+	its last snapshot, which is loaded as the initial condition in the series continuation mode.
+	*/
+	if(result_cache) {
+		unsigned long long hash;
+		int last_snapshot, complete;
+
+		result_hash = parameters_hash(tau, tau_min, delta, total_snapshots);
+		sprintf(result_file, "%s%s/%s%s.result", path, loopVarString, base_name, loopVarString);
+		Mmprintf(logfile, "\nParameters hash: %016llx\n", result_hash);
+
+		if(read_result(result_file, &hash, &last_snapshot, &complete))
+			;	/* no previous results */
+		else if(hash != result_hash) {
+			Mmprintf(logfile, "The results in the output directory were computed with different parameters and will be replaced.\n");
+			remove(result_file);
+		} else if(complete) {
+			Mmprintf(logfile, "The results of this iteration are complete. Iteration %d skipped. Continue...\n", loopIter);
+			continue;
+		} else if(last_snapshot >= 0) {
+			if(out_series)
+				sprintf(buf, "%s%s/%s%s%s", path, loopVarString, base_name, loopVarString, out_file_suffix);
+			else
+				sprintf(buf, "%s%s/%s.%03d%s%s", path, loopVarString, base_name, last_snapshot, loopVarString, out_file_suffix);
+
+			if(access(buf, R_OK)!=0)
+				Mmprintf(logfile, "Warning: The last snapshot %s is missing. The iteration will be calculated from the beginning.\n", buf);
+			else {
+				saved_icond_mode = icond_mode;
+				saved_continue_series = continue_series;
+				saved_skip_icond = skip_icond;
+				set(saved_icond_file, icond_file);
+				result_resumed=1;
+
+				icond_mode=1;
+				set(icond_file, buf);
+				continue_series=1;
+				skip_icond=1;
+				Mmprintf(logfile, "Resuming the interrupted iteration from snapshot %d: %s\n", last_snapshot, buf);
+			}
+		}
+	}
+
 	/* ---------- Input file check and dimension adjustment ---------- */
 
+	/* a resumed iteration (see result_cache) must not pass its starting snapshot to the next one */
 	starting_time = 0;
+	starting_snapshot = 0;
 
 	/* check initial conditions dataset if initial conditions are to be loaded from file */
 	if(icond_mode) {
@@ -1639,6 +3326,20 @@ int main(int argc, char *argv[])
 			}
 			Mmprintf(logfile, ".\n");
 
+			/* a time series dataset (see out_series): use its last complete record */
+			icond_record=-1;
+			if(nc_inq_dimid(icond_dataset_ID, "t", &dim_ID) == NC_NOERR) {
+				size_t n_records=0;
+				nc_inq_dimlen(icond_dataset_ID, dim_ID, &n_records);
+				icond_record = last_series_record(icond_dataset_ID, n_records);
+				if(icond_record<0) {
+					Mmprintf(logfile, "Error: The time series dataset '%s' does not contain any complete record.\nStop.\n", icond_file);
+					nc_close(icond_dataset_ID);
+					HaltAllRanks(1);
+				}
+				Mmprintf(logfile, "Time series dataset: using record %d of %lu.\n", icond_record, (unsigned long)n_records);
+			}
+
 			if(continue_series) {	/* continue from the snapshot and time level given in the initial conditions dataset */
 				double starting_time_d;
 				double final_time_d;
@@ -1647,12 +3348,14 @@ int main(int argc, char *argv[])
 				Mmprintf(logfile,	"\nSeries continuation mode has been requested.\n"
 							"Obtaining settings from the initial condition file:\n");
 
+				/* in a time series, snapshot, t and tau are the variables of the record */
 				if(
-					( nc_get_att_int(icond_dataset_ID, NC_GLOBAL, "snapshot", &starting_snapshot) != NC_NOERR )
+					( icond_record<0 && nc_get_att_int(icond_dataset_ID, NC_GLOBAL, "snapshot", &starting_snapshot) != NC_NOERR )
+				||	( icond_record<0 && nc_get_att_double(icond_dataset_ID, NC_GLOBAL, "t", &starting_time_d) != NC_NOERR )
+				||	( icond_record<0 && nc_get_att_double(icond_dataset_ID, NC_GLOBAL, "tau", &tau_d) != NC_NOERR )
+				||	( icond_record>=0 && get_series_record(icond_dataset_ID, icond_record, &starting_snapshot, &starting_time_d, &tau_d) )
 				||	( nc_get_att_int(icond_dataset_ID, NC_GLOBAL, "total_snapshots", &total_snapshots) != NC_NOERR )
-				||	( nc_get_att_double(icond_dataset_ID, NC_GLOBAL, "t", &starting_time_d) != NC_NOERR )
 				||	( nc_get_att_double(icond_dataset_ID, NC_GLOBAL, "final_time", &final_time_d) != NC_NOERR )
-				||	( nc_get_att_double(icond_dataset_ID, NC_GLOBAL, "tau", &tau_d) != NC_NOERR )
 				) {
 					Mmprintf(logfile, 	"Error: The initial conditions file is corrupted and does not contain the required information.\n"
 								"Please remove the 'continue_series' option and restart the simulation.\nStop.");
@@ -1688,6 +3391,88 @@ int main(int argc, char *argv[])
 	} else if(continue_series)
 		Mmprintf(logfile, "Warning: continue_series is only meaningful when the initial conditions are loaded from file.\n");
 
+	/* the periodic directions can only be checked now when the grid dimensions are known */
+	if(((periodic & PERIODIC_X) && n1<bcond_thickness) || ((periodic & PERIODIC_Y) && n2<bcond_thickness)) {
+		Mmprintf(logfile, "Error: The periodic grid dimensions must not be smaller than the boundary condition layer thickness.\nStop.\n");
+		HaltAllRanks(2);
+	}
+	/* the fourth order Dirichlet closure extrapolates from the last 3 rows, which must be held by the last rank */
+	if(stencil_order==4 && total_n3/MPIprocs<3) {
+		Mmprintf(logfile, "Error: The fourth order stencil needs at least 3 grid rows per rank.\nStop.\n");
+		HaltAllRanks(2);
+	}
+	/* ---------- resource planner dry run ---------- */
+
+	/*
+	Instead of the actual grid, which is only described by the report, a slab of PLAN_ROWS rows per rank
+	with the same grid spacing is set up and measured (see PlanResources()). The initial conditions
+	are generated from the formulas (zero if not given).
+	*/
+	plan_iterations=ToInt(evchkD("plan",0));
+	if(plan_iterations<0) plan_iterations=0;
+	if(plan_iterations) {
+		int rows = (PLAN_ROWS > bcond_thickness) ? PLAN_ROWS : bcond_thickness;
+
+		plan_ranks=ToInt(evchkD("plan_ranks",MPIprocs));
+		plan_threads=ToInt(evchkD("plan_threads",OMP_threads));
+		plan_wall_time=evchkD("plan_wall_time",0);
+		plan_memory=evchkD("plan_memory",0);
+		plan_steps=evchkD("plan_steps",final_time/tau);
+		if(plan_ranks<1 || plan_threads<1 || plan_steps<0) {
+			Mmprintf(logfile, "Error: Invalid resource planner layout (plan_ranks, plan_threads >= 1) or number of steps.\nStop.\n");
+			HaltAllRanks(2);
+		}
+		Mmprintf(logfile, "\nResource planner dry run: %d rank(s) x %d thread(s), %" FTC_g " RK steps\n", plan_ranks, plan_threads, plan_steps);
+
+		plan_n3 = total_n3;
+		if(total_n3 > MPIprocs*rows) {
+			L3 *= (FLOAT)(MPIprocs*rows) / total_n3;
+			total_n3 = MPIprocs*rows;
+		}
+		icond_mode=0;
+		for(q=0;q<VAR_COUNT;q++)
+			if(!*icond_formula[q]) set(icond_formula[q], "0");
+		/* the cost per grid node does not depend on the spacing, so the calibration grid is uniform */
+		*z_spacing = *z_spacing_table = 0;
+	}
+
+	/* ---------- grid spacing along Z ---------- */
+
+	z_uniform = !*z_spacing && !*z_spacing_table;
+	if( (z_face=(FLOAT *)malloc((total_n3+1+2*bcond_thickness)*sizeof(FLOAT))) == NULL ) {
+		Mmprintf(logfile, "Error: Could not allocate the grid coordinates.\nStop.\n");
+		HaltAllRanks(1);
+	}
+	switch(z_grid_faces(z_face+bcond_thickness)) {
+		case 0:
+			break;
+		case 1:
+			Mmprintf(logfile, "Error: Syntax error in the z_spacing formula.\nStop.\n");
+			HaltAllRanks(2);
+		case 2:
+			Mmprintf(logfile, "Error: Invalid z_spacing_table (pairs \"z w\" with increasing z expected).\nStop.\n");
+			HaltAllRanks(2);
+		case 3:
+			Mmprintf(logfile, "Error: The relative grid spacing along Z must be positive.\nStop.\n");
+			HaltAllRanks(2);
+		default:
+			Mmprintf(logfile, "Error: Not enough memory to calculate the grid spacing along Z.\nStop.\n");
+			HaltAllRanks(1);
+	}
+	if(z_uniform) Mmprintf(logfile, "Grid spacing along Z: uniform\n");
+	else {
+		FLOAT h_min=L3, h_max=0.0;
+		for(q=0;q<total_n3;q++) {
+			h_min = fminF(h_min, Z_FACE(q+1)-Z_FACE(q));
+			h_max = fmaxF(h_max, Z_FACE(q+1)-Z_FACE(q));
+		}
+		Mmprintf(logfile, "Grid spacing along Z: from %" FTC_g " to %" FTC_g " (uniform: %" FTC_g ")\n", h_min, h_max, L3/total_n3);
+		if(stencil_order==4) {
+			Mmprintf(logfile, "Error: The fourth order stencil requires a uniform grid along Z.\nStop.\n");
+			HaltAllRanks(2);
+		}
+	}
+
 /* ####### E N D >>> MASTER <<< ####### */ }
 
 	/* ---------- initial error check ---------- */
@@ -1729,16 +3514,42 @@ int main(int argc, char *argv[])
 
 					calc_mode,
 					icond_mode,
-					grid_IO_mode
+					grid_IO_mode,
+					periodic,
+					bead_mode,
+					cutcell_samples,
+					stencil_order,
+					fused_bcond,
+					out_local,
+					iso_level,
+					bind_threads,
+
+					autotune_iterations,
+					plan_iterations,
+					stiffness_mode,
+
+					error_norm,
+					rms_atol, rms_rtol
 				};
 
 	/* export model parameters */
 	for(q=0;q<PARAM_COUNT;q++)	MPIcalc.model_parameters[q] = model_parameters[q];
 
+	/* export the error norm tolerances */
+	for(q=0;q<VAR_COUNT;q++) {
+		MPIcalc.var_atol[q] = var_atol[q];
+		MPIcalc.var_rtol[q] = var_rtol[q];
+	}
+
 	if(!icond_mode)
 		for(q=0;q<VAR_COUNT;q++)
 			set(MPIcalc.icond_formula[q], icond_formula[q]);
 
+	/* export the material laws settings */
+	for(q=0;q<LAW_COUNT;q++) set(MPIcalc.law_formula[q], law_formula[q]);
+	set(MPIcalc.law_compiler, law_compiler);
+	set(MPIcalc.law_cache, law_cache);
+
 	Mmprintf(logfile, 	"\nInitializing the computation:\n"
 				"-----------------------------\n");
 	AUX_time2 = MPI_Wtime();
@@ -1759,6 +3570,26 @@ int main(int argc, char *argv[])
 	calc_mode = MPIcalc.calc_mode;
 	icond_mode = MPIcalc.icond_mode;
 	grid_IO_mode = MPIcalc.grid_IO_mode;
+	periodic = MPIcalc.periodic;
+	bead_mode = MPIcalc.bead_mode;
+	cutcell_samples = MPIcalc.cutcell_samples;
+	stencil_order = MPIcalc.stencil_order;
+	fused_bcond = MPIcalc.fused_bcond;
+	out_local = MPIcalc.out_local;
+	iso_level = MPIcalc.iso_level;
+	bind_threads = MPIcalc.bind_threads;
+	autotune_iterations = MPIcalc.autotune_iterations;
+	plan_iterations = MPIcalc.plan_iterations;
+	stiffness_mode = MPIcalc.stiffness_mode;
+
+	/* restore the error norm settings */
+	error_norm = MPIcalc.error_norm;
+	rms_atol = MPIcalc.rms_atol;
+	rms_rtol = MPIcalc.rms_rtol;
+	for(q=0;q<VAR_COUNT;q++) {
+		var_atol[q] = MPIcalc.var_atol[q];
+		var_rtol[q] = MPIcalc.var_rtol[q];
+	}
 
 	/* restore model parameters */
 	for(q=0; q<PARAM_COUNT; q++)	model_parameters[q] = MPIcalc.model_parameters[q];
@@ -1767,10 +3598,39 @@ int main(int argc, char *argv[])
 		for(q=0;q<VAR_COUNT;q++)
 			set(icond_formula[q], MPIcalc.icond_formula[q]);
 
+	/* restore the material laws settings */
+	for(q=0;q<LAW_COUNT;q++) set(law_formula[q], MPIcalc.law_formula[q]);
+	set(law_compiler, MPIcalc.law_compiler);
+	set(law_cache, MPIcalc.law_cache);
+
 	tau=1;	/* the initial time step is ignored in ranks other than 0 */
 
 /* ####### E N D >>> OTHER <<< ####### */ }
 
+	/*
+	Pin the OpenMP threads of this rank compactly to the CPUs available to it before the data are allocated
+	and first touched. The binding is decided by the first batch iteration and it stays for the whole batch.
+	*/
+	if(!threads_bound) {
+		threads_bound=1;
+		if(bind_threads) MPI_topology_bind_threads(OMP_threads, &MPItopology, MPIbinding, sizeof(MPIbinding));
+		else set(MPIbinding, "threads not bound (bind_threads 0)");
+
+/* ####### B E G I N >>> MASTER <<< ####### */ if(MPIrank==0) {
+
+		Mmprintf(logfile, "Thread binding of rank 0: %s\n", MPIbinding);
+		for(q=1;q<MPIprocs;q++) {
+			MPI_Recv(buf, sizeof(buf), MPI_CHAR, MPIrankmap[q], MPIMSG_PROCNAME, MPI_COMM_WORLD, &MPIstat);
+			Mmprintf(logfile, "Thread binding of rank %d: %s\n", q, buf);
+		}
+
+/* ####### E N D >>> MASTER <<<, B E G I N >>> OTHER <<< ####### */ } else {
+
+		MPI_Send(MPIbinding, len(MPIbinding)+1, MPI_CHAR, MPIrankmap[0], MPIMSG_PROCNAME, MPI_COMM_WORLD);
+
+/* ####### E N D >>> OTHER <<< ####### */ }
+	}
+
 	/* Set the grid block information variables */
 
 	N1 = n1 + 2*bcond_thickness;
@@ -1809,21 +3669,26 @@ int main(int argc, char *argv[])
 	if( (chunk_start=(int *)malloc(n_chunks*sizeof(int))) == NULL ) alloc_error_code=1;
 	else if( (chunk_size=(int *)malloc(n_chunks*sizeof(int))) == NULL ) alloc_error_code=1;
 	else if( (chunk_eps_mult=(FLOAT *)malloc(n_chunks*sizeof(FLOAT))) == NULL ) alloc_error_code=1;
+	else if( (chunk_atol=(FLOAT *)malloc(n_chunks*sizeof(FLOAT))) == NULL ) alloc_error_code=1;
+	else if( (chunk_rtol=(FLOAT *)malloc(n_chunks*sizeof(FLOAT))) == NULL ) alloc_error_code=1;
 	/* computational grid */
 	else if( (solution=(FLOAT *)malloc(VAR_COUNT*subgridSIZE*sizeof(FLOAT))) == NULL ) alloc_error_code=2;
 	else if(AllocPrecalcData()) alloc_error_code=3;
+	/* the grid coordinates along Z (the faces have already been calculated in the master) */
+	else if( MPIrank && (z_face=(FLOAT *)malloc((total_N3+1)*sizeof(FLOAT))) == NULL ) alloc_error_code=5;
+	else if( (z_node=(FLOAT *)malloc(total_N3*sizeof(FLOAT))) == NULL ) alloc_error_code=5;
 	/*
-	for the result collection, the cache of 'subgridsize' elements is sufficient both for sending and receiving.
+	for the result collection, the buffer of 'subgridsize' elements is sufficient for the block of any other rank.
 	This is because regardless of the value of grid_IO_mode, subgridsize in the master rank is always at
 	least as large as in any other rank.
 	*/
-	else
-		for(q=0;q<VAR_COUNT;q++)
-			if( (data_cache[q] = (double *)malloc(subgridsize*sizeof(double))) == NULL) { alloc_error_code=4; break; }
+	else if( MPIrank==0 && MPIprocs>1 && (block_buffer = (FLOAT *)malloc(subgridsize*sizeof(FLOAT))) == NULL) alloc_error_code=4;
 
 	/* check for allocation errors */
 	CheckErrorAcrossRanks(alloc_error_code, 1, Common_errors);
 
+	SetupZGrid();
+
 /* #### MEMORY ALLOCATION / INITIALIZATION BLOCK  E N D #### */ }
 
 
@@ -1952,9 +3817,9 @@ int main(int argc, char *argv[])
 					var = VAR(solution,q);
 					idx = bcond_size;
 					for(k=0;k<n3;k++) {
-						_z = (0.5+k+first_row) / total_n3;
+						_z = Z_NODE(k+first_row) / L3;
 						ev_set_var_value(_z_index, _z);
-						ev_set_var_value(z_index, L3*_z);
+						ev_set_var_value(z_index, Z_NODE(k+first_row));
 						idx += bcond_thickness*N1;
 						for(j=0;j<n2;j++) {
 							_y = (0.5+j) / n2;
@@ -2054,66 +3919,44 @@ int main(int argc, char *argv[])
 				} else
 					send_first_row += total_n3%MPIprocs;
 
-				/* load the data into u_/p_cache (which may be larger than is necessary here if grid_IO_mode==0) */
+				/*
+				read the block of rank send_rank of each variable directly into the solution (rank 0) or into
+				the buffer and send it. The other ranks receive it in place (see block_datatype()).
+				*/
 				{
 					/*
 					prepare the data subgrid starting corner and dimensions, as required for the call to
-					the nc_get_vara_double() function. For more information, see the NetCDF documentation.
+					the nc_get_varm_double() function. For more information, see the NetCDF documentation.
 					*/
-					size_t nc_start[3] = { send_first_row, 0, 0 };
-					size_t nc_count[3] = { send_n3, n2, n1 };
-
-					Mmprintf(logfile, "Reading block %d ... ", q); fflush(stdout);
-					AUX_time = MPI_Wtime();
-					for(q=0;q<VAR_COUNT;q++)
-						nc_get_vara_double(icond_dataset_ID, var_ID[q], nc_start, nc_count, data_cache[q]);
-					Mmprintf(logfile, "Done in %s", format_time(MPI_Wtime()-AUX_time));
-				}
+					size_t nc_start[4] = { icond_record<0 ? 0 : icond_record, send_first_row, 0, 0 };
+					size_t nc_count[4] = { 1, send_n3, n2, n1 };
+					int skip = (icond_record<0);	/* skip the record dimension of a time series */
 
-				if(send_rank!=0) {
-					Mmprintf(logfile, ". Sending data to rank %d ... ", send_rank); fflush(stdout);
+					Mmprintf(logfile, "Reading block %d%s ... ", send_rank, send_rank ? " and sending it" : ""); fflush(stdout);
 					AUX_time = MPI_Wtime();
 					for(q=0;q<VAR_COUNT;q++)
-						MPI_Send(data_cache[q], n1*n2*send_n3, MPI_DOUBLE, MPIrankmap[send_rank], MPIMSG_SOLUTION+q, MPI_COMM_WORLD);
-					Mmprintf(logfile, "Done in %s", format_time(MPI_Wtime()-AUX_time));
+						if(send_rank) {
+							transfer_block(icond_dataset_ID, var_ID[q], 4-skip, nc_start+skip, nc_count+skip, block_buffer, n1, n1*n2, 0);
+							MPI_Send(block_buffer, n1*n2*send_n3, MPI__FLOAT, MPIrankmap[send_rank], MPIMSG_SOLUTION+q, MPI_COMM_WORLD);
+						} else
+							transfer_block(icond_dataset_ID, var_ID[q], 4-skip, nc_start+skip, nc_count+skip,
+								VAR(solution,q) + bcond_thickness*(rowsize+N1+1), N1, rowsize, 0);
+					Mmprintf(logfile, "Done in %s\n", format_time(MPI_Wtime()-AUX_time));
 				}
-
-				Mmprintf(logfile, "\n");
 			}
 
 			nc_close(icond_dataset_ID);
 
 /* ####### E N D >>> MASTER <<<, B E G I N >>> OTHER <<< ####### */ } else {
 
-			/* receive the portion of the initial condition dataset into data_cache[..] */
+			/* receive the portion of the initial condition dataset into the inner grid */
+			MPI_Datatype block = block_datatype(n3, bcond_thickness, n2, n1, bcond_thickness);
+
 			for(q=0;q<VAR_COUNT;q++)
-				MPI_Recv(data_cache[q], n1*n2*n3, MPI_DOUBLE, MPIrankmap[0], MPIMSG_SOLUTION+q, MPI_COMM_WORLD, &MPIstat);
+				MPI_Recv(VAR(solution,q), 1, block, MPIrankmap[0], MPIMSG_SOLUTION+q, MPI_COMM_WORLD, &MPIstat);
+			MPI_Type_free(&block);
 
 /* ####### E N D >>> OTHER <<< ####### */ }
-
-			/* case 1 (initial conditions from file) - final phase: transcribe data from u_/p_cache to u/p */
-			{
-				int i, j, k;
-				double * cache_ptr;
-				FLOAT * ptr;
-
-				/*
-				Transcribe the cache to the computational grid. Unlike in the snapshot saving
-				procedure in the master rank, here we always transcribe the inner grid only.
-				No more complex memory re-organization happens (see ../megiddo/megiddo.c for
-				an example of such case).
-				-----------------------------------------------------------------------------
-				*/
-				if(MPIrank==0) Mmprintf(logfile, "Initializing solution arrays.\n");
-				for(q=0;q<VAR_COUNT;q++) {
-					cache_ptr = data_cache[q];
-					for(k=0;k<n3;k++)
-						for(j=0;j<n2;j++) {
-							ptr = VAR(solution,q) + (k+bcond_thickness) * rowsize + (j+bcond_thickness) * N1 + bcond_thickness;
-							for(i=0;i<n1;i++) *(ptr++)=*(cache_ptr++);
-						}
-				}
-			}
 	} /* end switch(icond_mode) */
 
 	/* ---------- the calculation itself and snapshots saving ---------- */
@@ -2152,12 +3995,14 @@ int main(int argc, char *argv[])
 					chunk_start[c]		= q*subgridSIZE + (k+bcond_thickness)*rowsize + (j+bcond_thickness)*N1 + bcond_thickness;
 					chunk_size[c]		= n1;
 					chunk_eps_mult[c]	= 1.0;
+					chunk_atol[c]		= var_atol[q];
+					chunk_rtol[c]		= var_rtol[q];
 					c++;
 				}
 	}
 
 
-	RK_MEM_DIST mem_dist = { n_chunks, chunk_start, chunk_size, chunk_eps_mult };
+	RK_MEM_DIST mem_dist = { n_chunks, chunk_start, chunk_size, chunk_eps_mult, chunk_atol, chunk_rtol };
 
 	/* definition of the system solution structure */
 	RK_MPI_S_SOLUTION eqSystem = {
@@ -2217,9 +4062,32 @@ int main(int argc, char *argv[])
 	 */
 	PrecalcData_with_check(chunk_eps_mult);
 
+	/* replace the built-in material laws by the formulas from the parameter file (if any) */
+	SetupMaterialLaws();
+
+	/* select the fastest OpenMP work sharing setup of the RK solver (if requested) */
+	AutotuneSolver(&eqSystem, OMP_threads);
+
+	/* set up the stiffness detection (the telemetry is reset in each batch mode iteration) */
+	{
+		char * RK_stiffness_errors[]= { "RK_MPI_SA_stiffness: Not enough memory.", "RK_MPI_SA_stiffness: Invalid mode." };
+		CheckErrorAcrossRanks( -RK_MPI_SA_stiffness(stiffness_mode), 1, RK_stiffness_errors);
+	}
+
+	/* select the error norm (the tolerances of the individual variables are given in mem_dist) */
+	{
+		char * RK_norm_errors[]= { "", "RK_MPI_SA_error_norm: Invalid norm or tolerances." };
+		CheckErrorAcrossRanks( -RK_MPI_SA_error_norm(error_norm, rms_atol, rms_rtol), 1, RK_norm_errors);
+	}
+
+	/* resource planner dry run: measure the calibration grid, report and stop */
+	if(plan_iterations) PlanResources(&eqSystem, OMP_threads);
+
 /* ####### B E G I N >>> MASTER <<< ####### */ if(MPIrank==0) {
 
 	int snapshot, l;			/* other loop control variables (in addition to 'q') */
+	char area_started = 0;			/* nonzero once the interface area history has been prepared
+						   for this run (see iso_every) */
 	int on_demand_snapshot = 0;		/* the number of the on-demand snapshot. This number is part
 						   of the snapshot dataset file name and is reset to 0
 						   after the next ordinary snapshot is created */
@@ -2234,6 +4102,10 @@ int main(int argc, char *argv[])
 	int n3_var_ID, n2_var_ID, n1_var_ID;
 	int u_var_ID[VAR_COUNT];
 
+	/* time series output (see out_series) */
+	int series_ID = -1;			/* the time series dataset (kept open until the last snapshot) */
+	char series, new_dataset;		/* nonzero if the current snapshot is a series record / a new dataset is created */
+
 	Mmprintf(logfile, "All initialization procedures completed in %s\n", format_time(MPI_Wtime()-AUX_time2));
 
 	/* debug log file creation (will be created only once, even if in batch mode) */
@@ -2305,12 +4177,79 @@ int main(int argc, char *argv[])
 			/* ordinary snapshot time reached */
 			Mmprintf(logfile, "Done on %s - elapsed wall time: %s, %ld R-K steps (%ld total)\n",
 				format_date(br_time), format_time(MPIelapsed_time), eqSystem.steps, eqSystem.steps_total);
-			if(loopN)
-				sprintf(filename, "%s%s/%s.%03d%s%s",
-					path, loopVarString, base_name, snapshot, loopVarString, out_file_suffix);
-			else
-				sprintf(filename, "%s.%03d%s", path, snapshot, out_file_suffix);
-			Mmprintf(logfile, "Saving file: %s ... [", filename); fflush(stdout);
+			if(stiffness_mode) {
+				RK_STIFFNESS stiffness;
+				RK_MPI_SA_get_stiffness(&stiffness);
+				Mmprintf(logfile, "Stiffness: tau*rho=%g, %ld stiff steps, %ld Rosenbrock steps, %ld switches, "
+					"%ld linear solver iterations (%ld failures)\n",
+					stiffness.h_rho, stiffness.stiff_steps, stiffness.rosenbrock_steps, stiffness.switches,
+					stiffness.krylov_iterations, stiffness.krylov_failures);
+			}
+
+			/* in-situ isosurface extraction (see iso_every) */
+			if(iso_every && snapshot%iso_every==0 && !(snapshot==starting_snapshot && skip_icond)) {
+				ISO_MESH mesh;
+				FILE * area_file;
+
+				MPIcmd=MPICMD_ISOSURFACE;
+				MPI_Bcast(&MPIcmd, 1, MPI_INT, MPIrankmap[0], MPI_COMM_WORLD);
+
+				if(loopN)
+					sprintf(filename, "%s%s/%s.%03d%s.ply", path, loopVarString, base_name, snapshot, loopVarString);
+				else
+					sprintf(filename, "%s.%03d.ply", path, snapshot);
+
+				if(isosurface(solution, iso_level, &mesh))
+					Mmprintf(logfile, "Warning: Not enough memory to extract the isosurface.\n");
+				else {
+					if(write_ply(filename, &mesh, iso_level, eqSystem.t))
+						Mmprintf(logfile, "Warning: Could not write the isosurface file %s.\n", filename);
+					else
+						Mmprintf(logfile, "Isosurface p=%" FTC_g ": %d triangles, area %.6e m^2, saved to %s\n",
+							iso_level, mesh.n_triangles, mesh.area, filename);
+
+					/* the interface area history: snapshot, t, area, number of triangles */
+					if(loopN)
+						sprintf(filename, "%s%s/%s%s.area", path, loopVarString, base_name, loopVarString);
+					else
+						sprintf(filename, "%s.area", path);
+					/*
+					A new run starts a new history. A run continuing an existing result (continue_series,
+					also set for a resumed iteration) keeps the rows of the snapshots preceding this one.
+					*/
+					if(!area_started && continue_series && trim_area_file(filename, snapshot))
+						Mmprintf(logfile, "Warning: Could not trim the interface area file %s.\n", filename);
+					if((area_file=fopen(filename, (area_started || continue_series) ? "a" : "w")) != NULL) {
+						area_started=1;
+						fprintf(area_file, "%d %.10e %.10e %d\n", snapshot, (double)eqSystem.t, mesh.area, mesh.n_triangles);
+						fclose(area_file);
+					} else Mmprintf(logfile, "Warning: Could not write the interface area file %s.\n", filename);
+
+					free(mesh.vertex);
+					free(mesh.triangle);
+				}
+			}
+
+			/* with iso_only, the NetCDF snapshot is only saved at the end */
+			if(iso_only && snapshot<total_snapshots-1) {
+				on_demand_snapshot = 0;
+				continue;
+			}
+
+			if(out_series) {
+				if(loopN)
+					sprintf(filename, "%s%s/%s%s%s", path, loopVarString, base_name, loopVarString, out_file_suffix);
+				else
+					sprintf(filename, "%s%s", path, out_file_suffix);
+				Mmprintf(logfile, "Saving record %d to file: %s ... [", snapshot, filename); fflush(stdout);
+			} else {
+				if(loopN)
+					sprintf(filename, "%s%s/%s.%03d%s%s",
+						path, loopVarString, base_name, snapshot, loopVarString, out_file_suffix);
+				else
+					sprintf(filename, "%s.%03d%s", path, snapshot, out_file_suffix);
+				Mmprintf(logfile, "Saving file: %s ... [", filename); fflush(stdout);
+			}
 
 			if(snapshot==starting_snapshot && skip_icond) {
 				Mmprintf(logfile, "SKIPPED]\n");
@@ -2323,21 +4262,44 @@ int main(int argc, char *argv[])
 
 		AUX_time = MPI_Wtime();		/* remember the time of snapshot creation */
 
+		/*
+		In the time series mode, the dataset is created (or reopened if the series is being continued)
+		at the first ordinary snapshot only. The following records are just appended.
+		*/
+		series = out_series && !is_on_demand_snapshot;
+		new_dataset = 1;
+		if(series && series_ID>=0) {
+			dataset_ID = series_ID;
+			new_dataset = 0;
+		} else if(series && continue_series && access(filename, F_OK)==0) {
+			if(open_series(filename, &dataset_ID, u_var_ID)) {
+				Mmprintf(logfile, "NetCDF error: The time series dataset to be continued is invalid or its grid does not match.\nStop.\n");
+				HaltAllRanks(1);
+			}
+			series_ID = dataset_ID;
+			new_dataset = 0;
+		}
+
 		/* prepare the output NetCDF dataset */
-		{
+		if(new_dataset) {
 			int nc_error_code;
-			int dim_IDs[3];
+			int dim_IDs[4];		/* the record dimension 't' followed by n3, n2, n1 */
+			int skip = !series;	/* skip the record dimension unless writing a time series */
+
+			/* with out_local, the master saves only its own block, to the dataset of rank 0 */
+			if(out_local) local_snapshot_name(local_name, filename, len(filename)-len(out_file_suffix), 0);
 
-			nc_error_code = nc_create (filename, NC_CLOBBER, &dataset_ID);
+			nc_error_code = nc_create (out_local ? local_name : filename, NC_CLOBBER, &dataset_ID);
 			if(nc_error_code!=NC_NOERR) {
 				Mmprintf(logfile, "NetCDF error: %s.\n", nc_strerror(nc_error_code));
 				HaltAllRanks(1);
 			}
 
 			/* define the solution grid dimensions */
-			nc_def_dim (dataset_ID, "n3", grid_IO_mode?total_n3:total_N3, dim_IDs);
-			nc_def_dim (dataset_ID, "n2", grid_IO_mode?n2:N2, dim_IDs+1);
-			nc_def_dim (dataset_ID, "n1", grid_IO_mode?n1:N1, dim_IDs+2);
+			if(series) nc_def_dim (dataset_ID, "t", NC_UNLIMITED, dim_IDs);
+			nc_def_dim (dataset_ID, "n3", out_local ? n3 : (grid_IO_mode?total_n3:total_N3), dim_IDs+1);
+			nc_def_dim (dataset_ID, "n2", grid_IO_mode?n2:N2, dim_IDs+2);
+			nc_def_dim (dataset_ID, "n1", grid_IO_mode?n1:N1, dim_IDs+3);
 
 			/*
 			now define the NetCDF variables.
@@ -2347,11 +4309,14 @@ int main(int argc, char *argv[])
 			of code structure.
 			*/
 
-			if( (nc_error_code=nc_def_var(dataset_ID, "n3", NC_DOUBLE, 1, dim_IDs, &n3_var_ID)) != NC_NOERR) ; /* do nothing */
-			else if( (nc_error_code=nc_def_var(dataset_ID, "n2", NC_DOUBLE, 1, dim_IDs+1, &n2_var_ID)) != NC_NOERR) ;
-			else if( (nc_error_code=nc_def_var(dataset_ID, "n1", NC_DOUBLE, 1, dim_IDs+2, &n1_var_ID)) != NC_NOERR) ;
-			else for(q=0;q<VAR_COUNT;q++)
-				if( (nc_error_code=nc_def_var(dataset_ID, variable[q].name, NC_DOUBLE, 3, dim_IDs, u_var_ID+q)) != NC_NOERR) break;
+			if( (nc_error_code=nc_def_var(dataset_ID, "n3", NC_DOUBLE, 1, dim_IDs+1, &n3_var_ID)) != NC_NOERR) ; /* do nothing */
+			else if( (nc_error_code=nc_def_var(dataset_ID, "n2", NC_DOUBLE, 1, dim_IDs+2, &n2_var_ID)) != NC_NOERR) ;
+			else if( (nc_error_code=nc_def_var(dataset_ID, "n1", NC_DOUBLE, 1, dim_IDs+3, &n1_var_ID)) != NC_NOERR) ;
+			else if( series && (nc_error_code=define_series(dataset_ID, dim_IDs[0])) != NC_NOERR) ;
+			else for(q=0;q<VAR_COUNT;q++) {
+				if( (nc_error_code=nc_def_var(dataset_ID, variable[q].name, NC_DOUBLE, 4-skip, dim_IDs+skip, u_var_ID+q)) != NC_NOERR) break;
+				if( series && (nc_error_code=tune_series_var(dataset_ID, u_var_ID[q], dim_IDs)) != NC_NOERR) break;
+			}
 
 
 			/* a single error check block handles any of the above definitions */
@@ -2365,9 +4330,10 @@ int main(int argc, char *argv[])
 		/*
 		save computation parameters - these attributes may or may not be used by other postprocessing
 		software, by Intertack itself or they can be extracted by the ncdump command line utility
-		for informational purpose only.
+		for informational purpose only. In a time series, t, tau and snapshot are stored for each record
+		in the variables of the same names instead.
 		*/
-		{
+		if(new_dataset) {
 			/* construct the double precision versions of the FLOAT computation parameters */
 			double	L1_d = L1, L2_d = L2, L3_d = L3;
 			double model_parameter_d;
@@ -2393,19 +4359,24 @@ int main(int argc, char *argv[])
 			nc_put_att_int(dataset_ID, NC_GLOBAL, "calc_mode", NC_INT, 1, &calc_mode);
 
 			nc_put_att_double(dataset_ID, NC_GLOBAL, "delta", NC_DOUBLE, 1, &delta_d);
-			nc_put_att_double(dataset_ID, NC_GLOBAL, "tau", NC_DOUBLE, 1, &tau_d);
-			nc_put_att_double(dataset_ID, NC_GLOBAL, "t", NC_DOUBLE, 1, &t_d);
+			if(!series) {
+				nc_put_att_double(dataset_ID, NC_GLOBAL, "tau", NC_DOUBLE, 1, &tau_d);
+				nc_put_att_double(dataset_ID, NC_GLOBAL, "t", NC_DOUBLE, 1, &t_d);
+			}
 			nc_put_att_double(dataset_ID, NC_GLOBAL, "final_time", NC_DOUBLE, 1, &final_time_d);
 
-			nc_put_att_int(dataset_ID, NC_GLOBAL, "snapshot", NC_INT, 1, &snapshot);
+			if(!series) nc_put_att_int(dataset_ID, NC_GLOBAL, "snapshot", NC_INT, 1, &snapshot);
 			nc_put_att_int(dataset_ID, NC_GLOBAL, "total_snapshots", NC_INT, 1, &total_snapshots);
-		}
 
-		/* furthermore, save the comment as a global attribute of the NetCDF dataset */
-		sprintf(buf, com_format, comment, eqSystem.t);
-		nc_put_att_text(dataset_ID, NC_GLOBAL, "title", len(buf) , buf);
+			/* furthermore, save the comment as a global attribute of the NetCDF dataset */
+			sprintf(buf, com_format, comment, eqSystem.t);
+			nc_put_att_text(dataset_ID, NC_GLOBAL, "title", len(buf) , buf);
 
-		nc_enddef(dataset_ID);
+			/* the position of the block in the whole grid */
+			if(out_local) put_local_attributes(dataset_ID);
+
+			nc_enddef(dataset_ID);
+		}
 
 		/*
 		save auxiliary coordinate arrays to the NetCDF dataset. These arrays contain the respective z,y,x
@@ -2413,9 +4384,9 @@ int main(int argc, char *argv[])
 		n3,n2,n1 (ordered by importance), they are taken into account by the VisIt visualization software
 		in renderings of NetCDF arrays.
 		*/
-		{
+		if(new_dataset) {
 			double * x_grid_coords, * y_grid_coords, * z_grid_coords;
-			int n3_ = grid_IO_mode ? total_n3 : total_N3;
+			int n3_ = out_local ? n3 : (grid_IO_mode ? total_n3 : total_N3);
 			int n2_ = grid_IO_mode ? n2 : N2;
 			int n1_ = grid_IO_mode ? n1 : N1;
 			int bcond_thickness_ = grid_IO_mode ? 0 : bcond_thickness;
@@ -2438,7 +4409,7 @@ int main(int argc, char *argv[])
 			}
 
 			/* fill the arrays */
-			for(k=0;k<n3_;k++) z_grid_coords[k] = L3 * (0.5+k-bcond_thickness_)/total_n3;
+			for(k=0;k<n3_;k++) z_grid_coords[k] = Z_NODE(k-bcond_thickness_);
 			for(j=0;j<n2_;j++) y_grid_coords[j] = L2 * (0.5+j-bcond_thickness_)/n2;
 			for(i=0;i<n1_;i++) x_grid_coords[i] = L1 * (0.5+i-bcond_thickness_)/n1;
 
@@ -2450,6 +4421,8 @@ int main(int argc, char *argv[])
 			free(x_grid_coords);
 			free(y_grid_coords);
 			free(z_grid_coords);
+
+			if(series) series_ID = dataset_ID;
 		}
 		/*
 		dataset created successfully - gather the solution from all ranks
@@ -2459,8 +4432,25 @@ int main(int argc, char *argv[])
 		MPIcmd=MPICMD_SNAPSHOT;
 		MPI_Bcast(&MPIcmd, 1, MPI_INT, MPIrankmap[0], MPI_COMM_WORLD);
 
-		/* collect the data and save immediately. The auxiliary (boundary condition) nodes are saved if and only if grid_IO_mode==0. */
-		for(l=0;l<MPIprocs;l++) {
+		/* with out_local, the other ranks save their blocks themselves under the names derived from 'filename' */
+		if(out_local) {
+			int local_info[2];
+
+			local_info[0] = snapshot;
+			local_info[1] = len(filename)-len(out_file_suffix);
+			MPI_Bcast(local_info, 2, MPI_INT, MPIrankmap[0], MPI_COMM_WORLD);
+			MPI_Bcast(filename, sizeof(filename), MPI_CHAR, MPIrankmap[0], MPI_COMM_WORLD);
+		}
+
+		/* reset the errors with respect to the reference solution (see reference_errors()) */
+		for(q=0;q<VAR_COUNT;q++) reference_error[q][0] = reference_error[q][1] = 0.0;
+		reference_syntax_error = 0;
+
+		/*
+		collect the data and save immediately. The auxiliary (boundary condition) nodes are saved if and only if grid_IO_mode==0.
+		With out_local, only the block of the master is saved here.
+		*/
+		for(l=0;l<(out_local ? 1 : MPIprocs);l++) {
 
 			int snapshot_bnd_thickness = grid_IO_mode*bcond_thickness;	/* 0 if the whole grid should be output */
 			int n1_ = n1;
@@ -2495,65 +4485,97 @@ int main(int argc, char *argv[])
 				if(l==MPIprocs-1) n3_ += bcond_thickness;
 			}
 
-			if(l) {
-				/* subgridsize in rank 0 may be several rows greater than the actual amount of data, but that doesn't matter */
-				for(q=0;q<VAR_COUNT;q++)
-					MPI_Recv(data_cache[q], subgridsize, MPI_DOUBLE, MPIrankmap[l], MPIMSG_SOLUTION+q, MPI_COMM_WORLD, &MPIstat);
-			} else {
-				int i, j, k;
-				double * cache_ptr;
-				FLOAT * ptr;
-
-				/*
-				update the boundary conditions in the event that the auxiliary nodes are required to be saved.
-				The bcond_setup() function is defined in the file equation.c
-				*/
-				if(!grid_IO_mode) bcond_setup(eqSystem.t, solution);
-
-				/*
-				Transcribe the solution to the cache before saving (for additional information, see the same
-				procedure in the initial conditions loading part. If grid_IO_mode==1, the boundary conditions
-				in the plane X-Y are skipped here (the boundary conditions in the direction of Z are skipped
-				automatically due to the memory organization of the solution).
-				*/
-
-				for(q=0;q<VAR_COUNT;q++) {
-					cache_ptr = data_cache[q];
-					for(k=0;k<n3_;k++)
-						for(j=0;j<n2_;j++) {
-							ptr = VAR(solution,q) + (k+snapshot_bnd_thickness) * rowsize + (j+snapshot_bnd_thickness) * N1 + snapshot_bnd_thickness;
-							for(i=0;i<n1_;i++) *(cache_ptr++)=*(ptr++);
-						}
-				}
-			}
+			/*
+			update the boundary conditions in the event that the auxiliary nodes are required to be saved.
+			The bcond_setup() function is defined in the file equation.c
+			*/
+			if(!l && !grid_IO_mode) bcond_setup(eqSystem.t, solution);
 
-			/* save the block to the file */
+			/* receive the block (if l>0) and save it to the file */
 			{
 				/*
 				prepare the data subgrid starting corner and dimensions, as required for the call to
-				the nc_get_vara_double() function. For more information, see the NetCDF documentation.
+				the nc_put_varm_double() function. For more information, see the NetCDF documentation.
 				*/
-				size_t nc_start[3] = { first_row_, 0, 0 };
-				size_t nc_count[3] = { n3_, n2_, n1_ };
+				size_t nc_start[4] = { snapshot, first_row_, 0, 0 };
+				size_t nc_count[4] = { 1, n3_, n2_, n1_ };
+				int skip = !series;	/* skip the record dimension unless writing a time series */
+				FLOAT * data;
+				ptrdiff_t line, row;
 
-				for(q=0;q<VAR_COUNT;q++)
-					nc_put_vara_double(dataset_ID, u_var_ID[q], nc_start, nc_count, data_cache[q]);
+				for(q=0;q<VAR_COUNT;q++) {
+					if(l) {
+						/* the block of rank l arrives contiguous */
+						MPI_Recv(block_buffer, n1_*n2_*n3_, MPI__FLOAT, MPIrankmap[l], MPIMSG_SOLUTION+q, MPI_COMM_WORLD, &MPIstat);
+						data = block_buffer;
+						line = n1_;
+						row = n1_*n2_;
+					} else {
+						/*
+						the block of the master is saved directly from the solution. If grid_IO_mode==1, the boundary
+						conditions in the plane X-Y are skipped by the strides (the boundary conditions in the direction
+						of Z are skipped automatically due to the memory organization of the solution).
+						*/
+						data = VAR(solution,q) + snapshot_bnd_thickness*(rowsize+N1+1);
+						line = N1;
+						row = rowsize;
+					}
+					transfer_block(dataset_ID, u_var_ID[q], 4-skip, nc_start+skip, nc_count+skip, data, line, row, 1);
 
+					if(grid_IO_mode && !out_local && !reference_syntax_error && *reference_formula[q])
+						reference_syntax_error = reference_errors(q, data, line, row, n3_, first_row_, eqSystem.t, reference_error[q]);
+				}
 			}
 
 			/* move the progress meter (each star represents data collection from one process) */
 			Mmprintf(logfile, "*"); fflush(stdout);
 		}
 
-		nc_close(dataset_ID);
+		/* collect the status of the rank-local datasets (NetCDF error codes are negative) */
+		if(out_local) {
+			int nc_error_code = NC_NOERR, worst_error_code;
+
+			MPI_Reduce(&nc_error_code, &worst_error_code, 1, MPI_INT, MPI_MIN, MPIrankmap[0], MPI_COMM_WORLD);
+			if(worst_error_code != NC_NOERR) {
+				Mmprintf(logfile, "\nNetCDF error: Some ranks could not save their blocks of snapshot %d: %s.\nStop.\n",
+					snapshot, nc_strerror(worst_error_code));
+				nc_close(dataset_ID);
+				HaltAllRanks(1);
+			}
+		}
+
+		if(series) {
+			/* complete the record and make it durable before the calculation proceeds */
+			if(finish_series_record(dataset_ID, filename, snapshot, eqSystem.t, eqSystem.h)) {
+				Mmprintf(logfile, "\nNetCDF error: Could not complete the time series record %d.\nStop.\n", snapshot);
+				nc_close(dataset_ID);
+				HaltAllRanks(1);
+			}
+		} else nc_close(dataset_ID);
 		Mmprintf(logfile, "] Done in %s\n", format_time(MPI_Wtime()-AUX_time));
 
+		/* report the errors with respect to the reference solution (the discrete L2 norm is scaled by the cell volume) */
+		if(reference_syntax_error)
+			Mmprintf(logfile, "Warning: Syntax error in the reference solution formula for %s.\n", variable[reference_syntax_error-1].name);
+		else if(grid_IO_mode && !out_local) for(q=0;q<VAR_COUNT;q++) if(*reference_formula[q])
+			Mmprintf(logfile, "Reference solution error of %s at t=%" FTC_g ": max %.6e L2 %.6e\n", variable[q].name, eqSystem.t,
+				reference_error[q][0], sqrt(reference_error[q][1]*L1*L2/((double)n1*n2)));
+
+		/* record the progress of the iteration (see result_cache) */
+		if(result_cache && !is_on_demand_snapshot && write_result(result_file, result_hash, snapshot, 0))
+			Mmprintf(logfile, "Warning: Could not write the result file %s.\n", result_file);
+
 		/* delete the snapshot trigger file */
 		if(is_on_demand_snapshot) unlink(snapshot_trigger_file);
 
 		commit_logfile(0);	/* update the log file on disk (non-forced update - see commit_logfile()) */
 	}
 
+	if(series_ID>=0) nc_close(series_ID);
+
+	if(result_cache && write_result(result_file, result_hash, total_snapshots-1, 1))
+		Mmprintf(logfile, "Warning: Could not write the result file %s.\n", result_file);
+
 	/* print the total wall time spent on the actual calculation */
 	time(&calendar_time);
 	br_time=localtime(&calendar_time);
@@ -2673,11 +4695,14 @@ int main(int argc, char *argv[])
 				break;
 
 			case MPICMD_SNAPSHOT:
-				/* copy the solution grid block to the 'double' buffer and send it to the master */
+				/* send the solution grid block to the master without a copy (or save it, see out_local) */
 				{
-					int i, j, k;
-					double * cache_ptr;
-					FLOAT * ptr;
+					int local_info[2];	/* the snapshot number and the length of the file name without the suffix */
+
+					if(out_local) {
+						MPI_Bcast(local_info, 2, MPI_INT, MPIrankmap[0], MPI_COMM_WORLD);
+						MPI_Bcast(filename, sizeof(filename), MPI_CHAR, MPIrankmap[0], MPI_COMM_WORLD);
+					}
 
 					/*
 					Boundary condition (auxiliary node) layer thickness to be omitted from the output dataset.
@@ -2699,20 +4724,30 @@ int main(int argc, char *argv[])
 					*/
 					if(!grid_IO_mode) bcond_setup(eqSystem.t, solution);
 
-					/* perform transcription to the cache. For more information, see above (the same procedure in the master rank). */
-					for(q=0;q<VAR_COUNT;q++) {
-						cache_ptr = data_cache[q];
-						for(k=0;k<n3_;k++)
-							for(j=0;j<n2_;j++) {
-								ptr = VAR(solution,q) + (k+bcond_thickness) * rowsize + (j+snapshot_bnd_thickness) * N1 + snapshot_bnd_thickness;
-								for(i=0;i<n1_;i++) *(cache_ptr++)=*(ptr++);
-							}
+					if(out_local) {
+						int nc_error_code;
+
+						local_snapshot_name(local_name, filename, local_info[1], MPIrank);
+						nc_error_code = write_local_snapshot(local_name, local_info[0], eqSystem.t, eqSystem.h);
+						MPI_Reduce(&nc_error_code, NULL, 1, MPI_INT, MPI_MIN, MPIrankmap[0], MPI_COMM_WORLD);
+					} else {
+						/* the block is sent from the solution by a subarray datatype and arrives contiguous (n1_ * n2_ * n3_ nodes) */
+						MPI_Datatype block = block_datatype(n3_, bcond_thickness, n2_, n1_, snapshot_bnd_thickness);
+
+						for(q=0;q<VAR_COUNT;q++)
+							MPI_Send(VAR(solution,q), 1, block, MPIrankmap[0], MPIMSG_SOLUTION+q, MPI_COMM_WORLD);
+						MPI_Type_free(&block);
 					}
+				}
+				break;
 
-					/* subgridsize has been defined so that it is always equal to n1_ * n2_ * n3_ */
-					for(q=0;q<VAR_COUNT;q++)
-						MPI_Send(data_cache[q], subgridsize, MPI_DOUBLE, MPIrankmap[0], MPIMSG_SOLUTION+q, MPI_COMM_WORLD);
+			case MPICMD_ISOSURFACE:
+				/* extract the isosurface from the block and send it to the master */
+				{
+					ISO_MESH mesh;
+					isosurface(solution, iso_level, &mesh);
 				}
+				break;
 
 			/* NOTE: MPICMD_NO_COMMAND should not occur here. If it did, it would be ignored */
 		}
@@ -2724,13 +4759,18 @@ int main(int argc, char *argv[])
 
 	RK_MPI_SA_cleanup();
 
-	for(q=0;q<VAR_COUNT;q++) free(data_cache[q]);
+	free(block_buffer); block_buffer=NULL;
 
 	FreePrecalcData();
+	ReleaseMaterialLaws();
+	free(z_face); z_face=NULL;
+	free(z_node); z_node=NULL;
 	free(solution);
 	free(chunk_size);
 	free(chunk_start);
 	free(chunk_eps_mult);
+	free(chunk_atol);
+	free(chunk_rtol);
 
 	}	/* END OF THE BATCH PROCESSING LOOP */
 
@@ -100,7 +100,7 @@ PARAM_METADATA param_info [] = {
 
 	{ -1,			NULL,			"Glass phase field representation parameters" },
 
-	{ ball_radius,		"ball_radius",		"Radius of all glass beads [m]" },
+	{ ball_radius,		"ball_radius",		"Radius of the glass beads without a radius in the positions file [m]" },
 	{ beads_scaling,	"beads_scaling",	"Scaling of the glass beads positions" },
 	{ beads_offset_x,	"beads_offset_x",	"Glass beads position offset along the x1 axis"},
 	{ beads_offset_y,	"beads_offset_y",	"Glass beads position offset along the x2 axis"},
@@ -138,6 +138,36 @@ PARAM_METADATA param_info [] = {
 
 size_t PARAM_INFO_SIZE = sizeof(param_info) / sizeof(PARAM_METADATA);
 
+/*
+named array subscripts of the material laws that can be replaced by C expressions given in the parameter
+file by the 'law' command. The formulas are compiled at startup (see SetupMaterialLaws() in intertrack.c
+and MaterialLawSource() in equation.c). There has to be a last item called LAW_COUNT.
+*/
+enum {
+	law_rho,
+	law_cp,
+	law_lambda,
+	law_phf,
+	law_dphf_du,
+
+	/* this last line is mandatory */
+	LAW_COUNT
+};
+
+typedef struct {
+	_conststring_ name;
+	_conststring_ arguments;
+	_conststring_ description;
+} LAW_METADATA;
+
+LAW_METADATA law_info [LAW_COUNT] = {
+	[law_rho]	=	{ "rho",	"u, p, gl",	"Density of the material [kg/m^3]" },
+	[law_cp]	=	{ "cp",		"u, p, gl",	"Heat capacity of the material [J/(kg.K)]" },
+	[law_lambda]	=	{ "lambda",	"u, p, gl",	"Thermal conductivity of the material [W/(m.K)]" },
+	[law_phf]	=	{ "phf",	"u",		"Freezing curve (the equilibrium phase field in MODEL 2)" },
+	[law_dphf_du]	=	{ "dphf_du",	"u",		"Derivative of the freezing curve (numerical if not given)" },
+};
+
 void InitMetadata(void)
 /* initializes all necessary variables' and parameters' metadata (called from intertrack.c) */
 {
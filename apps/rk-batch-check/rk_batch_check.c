@@ -0,0 +1,215 @@
+/***************************************************************\
+* Verification of the batched RK-Merson solver			*
+* (C) 2026 PorousFreezeThaw contributors			*
+* file: rk_batch_check.c					*
+\***************************************************************/
+
+/*
+Integrates a batch of independent Van der Pol oscillators
+
+	x0' = x1,	x1' = mu_s*(1-x0^2)*x1 - x0,	x(t0_s) = (2,0)
+
+by RK_B_solve() and compares each of them with a reference solution computed by RK_c_solve() (the classic
+fourth order scheme with a fine fixed time step), one system at a time. The stiffness parameter mu_s grows
+geometrically from 0.1 to about 30 with the system index s, so that the systems need very different numbers
+of time steps. The systems start at different time levels t0_s. Every 50th system starts at T/2, so it is
+finished (masked) during the first of the two calls to RK_B_solve() (up to T/2 and then up to T). The number
+of systems is not divisible by RK_B_LANES, which leaves padding systems in the last batch.
+
+For each tolerance 'delta', one line is printed with the maximum and the mean (over the systems) of the maximum
+absolute difference from the reference at T, its reduction with respect to the previous tolerance, and
+the mean number of successful time steps of the non-stiff (mu_s<1) and the stiff (mu_s>10) systems:
+
+	delta max_err mean_err reduction steps_nonstiff steps_stiff
+
+Finally, the batch is solved again with one thread and the results are compared with the multi-threaded ones,
+which must be identical. The program returns 1 if this fails or if some max_err exceeds 100*delta.
+
+usage: rk_batch_check [systems]
+*/
+
+#include "common.h"
+#include "mathspec.h"
+#include "RK_Bsolver.h"
+#include "RK_csolver.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __OPENMP
+	#include <omp.h>
+#endif
+
+#define FINAL_TIME	6.0
+#define REFERENCE_STEP	1e-4		/* the time step of the reference solution */
+
+static FLOAT * mu;			/* the stiffness parameters of all systems (including the padding systems) */
+static FLOAT ref_mu;			/* the stiffness parameter of the system solved by RK_c_solve() */
+
+static void f_batch(const FLOAT * t, const FLOAT * x, FLOAT * dest, int first_system)
+/* the right hand side of one batch of the oscillators (see RK_Bsolver.h) */
+{
+	const FLOAT * m = mu + first_system;
+	int l;
+
+#if defined _OPENMP && _OPENMP >= 201307
+	#pragma omp simd
+#endif
+	for(l=0;l<RK_B_LANES;l++) {
+		dest[0*RK_B_LANES+l] = x[1*RK_B_LANES+l];
+		dest[1*RK_B_LANES+l] = m[l]*(1.0-x[0*RK_B_LANES+l]*x[0*RK_B_LANES+l])*x[1*RK_B_LANES+l] - x[0*RK_B_LANES+l];
+	}
+}
+
+static void f_single(FLOAT t, const FLOAT * x, FLOAT * dest)
+/* the right hand side of a single oscillator with the parameter ref_mu */
+{
+	dest[0] = x[1];
+	dest[1] = ref_mu*(1.0-x[0]*x[0])*x[1] - x[0];
+}
+
+static RK_RightHandSide meta_f_single()
+{
+	return(f_single);
+}
+
+static FLOAT start_time(int s)
+/* the initial time level of the system s */
+{
+	return( (s%50==49) ? 0.5*FINAL_TIME : 0.1*(s%7) );
+}
+
+static void reset_batch(RK_B_SOLUTION * system, FLOAT delta)
+/* sets the initial conditions of all systems */
+{
+	int s;
+
+	for(s=0;s<system->n_systems;s++) {
+		system->t[s] = start_time(s);
+		system->h[s] = 0.0;
+		system->steps[s] = 0;
+		system->x[RK_B_INDEX(2,s,0)] = 2.0;
+		system->x[RK_B_INDEX(2,s,1)] = 0.0;
+	}
+	system->delta = delta;
+	system->steps_total = 0;
+}
+
+static int solve_batch(RK_B_SOLUTION * system)
+/* integrates all systems up to FINAL_TIME in two calls, returns the error code of RK_B_solve() */
+{
+	int err;
+
+	if((err=RK_B_solve(0.5*FINAL_TIME, system)) != 0) return(err);
+	return(RK_B_solve(FINAL_TIME, system));
+}
+
+int main(int argc, char *argv[])
+{
+	const FLOAT deltas[] = { 1e-4, 1e-6, 1e-8 };
+	int n_systems = argc>1 ? atoi(argv[1]) : 1003;
+	RK_B_SOLUTION batch;
+	RK_SOLUTION single;
+	FLOAT * ref, * x_parallel, prev_max=0.0;
+	size_t size;
+	int s, d, steps, err, failed=0;
+
+	if(n_systems<1) {
+		fprintf(stderr, "usage: %s [systems]\n", argv[0]);
+		return(1);
+	}
+	size = RK_B_SIZE(2,n_systems);
+	mu = (FLOAT *)malloc(size/2*sizeof(FLOAT));
+	ref = (FLOAT *)malloc(2*n_systems*sizeof(FLOAT));
+	x_parallel = (FLOAT *)malloc(size*sizeof(FLOAT));
+	batch.x = (FLOAT *)malloc(size*sizeof(FLOAT));
+	batch.t = (FLOAT *)malloc(n_systems*sizeof(FLOAT));
+	batch.h = (FLOAT *)malloc(n_systems*sizeof(FLOAT));
+	batch.steps = (long *)malloc(n_systems*sizeof(long));
+	if(mu==NULL || ref==NULL || x_parallel==NULL || batch.x==NULL || batch.t==NULL || batch.h==NULL || batch.steps==NULL
+	   || RK_B_init(2) || RK_c_init(2)) {
+		fprintf(stderr, "Not enough memory.\n");
+		return(2);
+	}
+
+	for(s=0;s<(int)(size/2);s++) mu[s] = 0.1*powF(300.0, (FLOAT)s/(n_systems>1 ? n_systems-1 : 1));
+
+	/* the reference solutions, one system at a time */
+	single.n = 2;
+	single.meta_f = meta_f_single;
+	single.delta = 0.0;
+	for(s=0;s<n_systems;s++) {
+		single.t = start_time(s);
+		single.x = ref+2*s;
+		single.x[0] = 2.0; single.x[1] = 0.0;
+		steps = (int)ceilF((FINAL_TIME-single.t)/REFERENCE_STEP);
+		single.h = (FINAL_TIME-single.t)/steps;
+		ref_mu = mu[s];
+		if((err=RK_c_solve(steps, &single)) != 0) {
+			fprintf(stderr, "RK_c_solve() failed with code %d for system %d.\n", err, s);
+			return(2);
+		}
+	}
+
+	batch.n = 2;
+	batch.n_systems = n_systems;
+	batch.f = f_batch;
+	batch.h_min = 0.0;
+
+#ifdef __OPENMP
+	printf("# systems: %d, lanes: %d, threads: %d, FLOAT size: %d bytes\n", n_systems, RK_B_LANES, omp_get_max_threads(), (int)sizeof(FLOAT));
+#else
+	printf("# systems: %d, lanes: %d, FLOAT size: %d bytes\n", n_systems, RK_B_LANES, (int)sizeof(FLOAT));
+#endif
+	printf("# delta max_err mean_err reduction steps_nonstiff steps_stiff\n");
+
+	for(d=0;d<(int)(sizeof(deltas)/sizeof(deltas[0]));d++) {
+		double max_err=0.0, sum_err=0.0, steps_nonstiff=0.0, steps_stiff=0.0;
+		int n_nonstiff=0, n_stiff=0;
+
+		reset_batch(&batch, deltas[d]);
+		if((err=solve_batch(&batch)) != 0) {
+			fprintf(stderr, "RK_B_solve() failed with code %d.\n", err);
+			return(2);
+		}
+
+		for(s=0;s<n_systems;s++) {
+			double e0 = fabsF(batch.x[RK_B_INDEX(2,s,0)]-ref[2*s]), e1 = fabsF(batch.x[RK_B_INDEX(2,s,1)]-ref[2*s+1]);
+			double e = e0>e1 ? e0 : e1;
+
+			if(batch.t[s] != FINAL_TIME) e = 1e300;		/* not integrated up to the final time */
+			sum_err += e;
+			if(e > max_err) max_err = e;
+			if(mu[s] < 1.0) { steps_nonstiff += batch.steps[s]; n_nonstiff++; }
+			if(mu[s] > 10.0) { steps_stiff += batch.steps[s]; n_stiff++; }
+		}
+		if(max_err > 100.0*deltas[d]) failed=1;
+
+		printf("%g %.3e %.3e %.1f %.1f %.1f\n", (double)deltas[d], max_err, sum_err/n_systems,
+			d ? prev_max/max_err : 0.0, steps_nonstiff/(n_nonstiff ? n_nonstiff : 1), steps_stiff/(n_stiff ? n_stiff : 1));
+		prev_max = max_err;
+	}
+
+#ifdef __OPENMP
+	/* the result of each system must not depend on the thread that has integrated its batch */
+	memcpy(x_parallel, batch.x, size*sizeof(FLOAT));
+	RK_B_cleanup();
+	omp_set_num_threads(1);
+	RK_B_init(2);
+	reset_batch(&batch, deltas[d-1]);
+	solve_batch(&batch);
+	for(s=0;s<n_systems;s++)
+		if(batch.x[RK_B_INDEX(2,s,0)] != x_parallel[RK_B_INDEX(2,s,0)] || batch.x[RK_B_INDEX(2,s,1)] != x_parallel[RK_B_INDEX(2,s,1)]) break;
+	printf("# single-threaded results %s\n", s<n_systems ? "DIFFER" : "identical");
+	if(s<n_systems) failed=1;
+#endif
+
+	printf("%s\n", failed ? "FAILED" : "OK");
+
+	RK_B_cleanup();
+	RK_c_cleanup();
+	free(mu); free(ref); free(x_parallel);
+	free(batch.x); free(batch.t); free(batch.h); free(batch.steps);
+	return(failed);
+}
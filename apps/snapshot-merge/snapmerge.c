@@ -0,0 +1,288 @@
+/***************************************************************\
+* Merging of the rank-local snapshot datasets			*
+* (C) 2026 PorousFreezeThaw contributors			*
+* file: snapmerge.c						*
+\***************************************************************/
+
+/*
+With 'set out_local', each rank of Intertrack saves its block of the grid to its own dataset
+<snapshot>.r<rank><suffix>, e.g. image.005.r003.ncd. The block starts at the row 'first_row' of the whole
+grid, whose dimensions (n3, n2, n1) are stored in the attribute 'global_dims'. The dataset of rank 0 also
+holds all attributes of an ordinary snapshot.
+
+snapmerge merges each set of rank-local datasets into the single dataset with the standard layout
+(e.g. image.005.ncd), which can be used e.g. as the initial condition or to resume a batch iteration.
+The sets are given by the datasets of rank 0 and they are distributed among the MPI processes:
+
+	mpirun -np 8 snapmerge [-i] [-d] results/image.*.r000.ncd
+
+-i	instead of merging, write the NcML index <snapshot>.ncml which joins the blocks along n3, so that
+	NcML-aware readers (e.g. netCDF-Java, Panoply) can treat the set as one dataset without copying
+-d	delete the rank-local datasets after a successful merge
+
+The exit status is nonzero if any set could not be processed.
+*/
+
+#include <mpi.h>
+#include <netcdf.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_RANKS	100000
+
+/* the attributes that describe the block of one rank only */
+static const char * local_attributes[] = { "first_row", "global_dims", "rank", "ranks", NULL };
+
+static int delete_local = 0;
+
+static void rank_name(char * dest, const char * name0, int prefix_len, int rank)
+/* constructs the name of the dataset of 'rank' from the name of the dataset of rank 0 (the .r000 part starts at prefix_len) */
+{
+	sprintf(dest, "%.*s.r%03d%s", prefix_len, name0, rank, name0+prefix_len+5);
+}
+
+static int local_attribute(const char * name)
+{
+	int i;
+
+	for(i=0;local_attributes[i];i++) if(!strcmp(name, local_attributes[i])) return(1);
+	return(0);
+}
+
+static int read_block(const char * name, int rank, const int * global_dims, int * dataset_ID, int * first_row, int * rows)
+/*
+opens the dataset of 'rank' and checks that it belongs to the set given by global_dims. Returns the position
+of the block (first_row) and its number of rows. Returns nonzero on error (an error message is printed).
+*/
+{
+	int dims[3], r, dim_ID;
+	size_t len;
+
+	if(nc_open(name, NC_NOWRITE, dataset_ID) != NC_NOERR) {
+		fprintf(stderr, "snapmerge: Can not open %s.\n", name);
+		return(1);
+	}
+	if(nc_get_att_int(*dataset_ID, NC_GLOBAL, "global_dims", dims) != NC_NOERR
+	   || nc_get_att_int(*dataset_ID, NC_GLOBAL, "rank", &r) != NC_NOERR
+	   || nc_get_att_int(*dataset_ID, NC_GLOBAL, "first_row", first_row) != NC_NOERR
+	   || nc_inq_dimid(*dataset_ID, "n3", &dim_ID) != NC_NOERR || nc_inq_dimlen(*dataset_ID, dim_ID, &len) != NC_NOERR
+	   || r != rank || memcmp(dims, global_dims, sizeof(dims))) {
+		fprintf(stderr, "snapmerge: %s is not the block of rank %d of the snapshot.\n", name, rank);
+		nc_close(*dataset_ID);
+		return(1);
+	}
+	*rows = len;
+	return(0);
+}
+
+static int write_index(const char * name0, int prefix_len, int ranks, const int * global_dims)
+/* writes the NcML index <snapshot>.ncml of a set of rank-local datasets. Returns nonzero on error. */
+{
+	char name[4096], index[4096];
+	const char * base;
+	FILE * f;
+	int dataset_ID, first_row, rows, next_row=0, r, i;
+
+	sprintf(index, "%.*s.ncml", prefix_len, name0);
+	if((f=fopen(index, "w")) == NULL) {
+		fprintf(stderr, "snapmerge: Can not create %s.\n", index);
+		return(1);
+	}
+
+	fprintf(f, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+	fprintf(f, "<netcdf xmlns=\"http://www.unidata.ucar.edu/namespaces/netcdf/ncml-2.2\">\n");
+	for(i=0;local_attributes[i];i++) fprintf(f, "  <remove type=\"attribute\" name=\"%s\"/>\n", local_attributes[i]);
+	fprintf(f, "  <aggregation dimName=\"n3\" type=\"joinExisting\">\n");
+
+	for(r=0;r<ranks;r++) {
+		rank_name(name, name0, prefix_len, r);
+		if(read_block(name, r, global_dims, &dataset_ID, &first_row, &rows)) break;
+		nc_close(dataset_ID);
+		if(first_row != next_row) {
+			fprintf(stderr, "snapmerge: The block of rank %d in %s does not follow the previous one.\n", r, name);
+			break;
+		}
+		next_row += rows;
+
+		/* the locations are relative to the index, which is in the same directory */
+		base = strrchr(name, '/');
+		fprintf(f, "    <netcdf location=\"%s\" ncoords=\"%d\"/>\n", base ? base+1 : name, rows);
+	}
+
+	fprintf(f, "  </aggregation>\n</netcdf>\n");
+	if(fclose(f) || r < ranks || next_row != global_dims[0]) {
+		if(r == ranks) fprintf(stderr, "snapmerge: The blocks of %s do not cover the grid.\n", name0);
+		remove(index);
+		return(1);
+	}
+	return(0);
+}
+
+static int merge(const char * name0, int prefix_len, int ranks, const int * global_dims)
+/* merges a set of rank-local datasets into the dataset with the standard layout. Returns nonzero on error. */
+{
+	char name[4096], output[4096], att_name[NC_MAX_NAME+1], var_name[NC_MAX_NAME+1];
+	int src_ID, dst_ID, dim_ID, var_ID, n3_dim_ID;
+	int n_dims, n_vars, n_atts, var_dims, dim_IDs[NC_MAX_VAR_DIMS];
+	int first_row, rows, next_row=0, r, i, v, e=NC_NOERR;
+	size_t len, start[NC_MAX_VAR_DIMS], count[NC_MAX_VAR_DIMS], size;
+	double * buffer;
+	nc_type type;
+
+	sprintf(output, "%.*s%s", prefix_len, name0, name0+prefix_len+5);
+
+	if(read_block(name0, 0, global_dims, &src_ID, &first_row, &rows)) return(1);
+	if( (e=nc_create(output, NC_CLOBBER, &dst_ID)) != NC_NOERR) {
+		fprintf(stderr, "snapmerge: Can not create %s: %s.\n", output, nc_strerror(e));
+		nc_close(src_ID);
+		return(1);
+	}
+
+	/* the dimensions, the global attributes (except the local ones) and the variables of the dataset of rank 0 */
+	nc_inq(src_ID, &n_dims, &n_vars, &n_atts, NULL);
+	for(i=0;i<n_dims && e==NC_NOERR;i++) {
+		nc_inq_dim(src_ID, i, att_name, &len);
+		if(!strcmp(att_name, "n3")) len = global_dims[0];
+		e = nc_def_dim(dst_ID, att_name, len, &dim_ID);
+	}
+	for(i=0;i<n_atts && e==NC_NOERR;i++) {
+		nc_inq_attname(src_ID, NC_GLOBAL, i, att_name);
+		if(!local_attribute(att_name)) e = nc_copy_att(src_ID, NC_GLOBAL, att_name, dst_ID, NC_GLOBAL);
+	}
+	for(v=0;v<n_vars && e==NC_NOERR;v++) {
+		nc_inq_var(src_ID, v, var_name, &type, &var_dims, dim_IDs, NULL);
+		for(i=0;i<var_dims;i++) {
+			nc_inq_dimname(src_ID, dim_IDs[i], att_name);
+			nc_inq_dimid(dst_ID, att_name, dim_IDs+i);
+		}
+		e = nc_def_var(dst_ID, var_name, type, var_dims, dim_IDs, &var_ID);
+	}
+	if(e==NC_NOERR) e = nc_enddef(dst_ID);
+	nc_close(src_ID);
+	nc_inq_dimid(dst_ID, "n3", &n3_dim_ID);
+
+	/*
+	copy the blocks. The variables along n3 (the coordinates n3 and the solution) are placed at first_row,
+	the remaining ones (the coordinates n2, n1) are the same in all blocks and they are taken from rank 0.
+	*/
+	for(r=0;r<ranks && e==NC_NOERR;r++) {
+		rank_name(name, name0, prefix_len, r);
+		if(read_block(name, r, global_dims, &src_ID, &first_row, &rows)) { e=NC_EINVAL; break; }
+		if(first_row != next_row) {
+			fprintf(stderr, "snapmerge: The block of rank %d in %s does not follow the previous one.\n", r, name);
+			nc_close(src_ID);
+			e=NC_EINVAL;
+			break;
+		}
+		next_row += rows;
+
+		for(v=0;v<n_vars && e==NC_NOERR;v++) {
+			nc_inq_var(dst_ID, v, var_name, &type, &var_dims, dim_IDs, NULL);
+			if(var_dims==0 || (dim_IDs[0]!=n3_dim_ID && r>0)) continue;
+
+			for(size=1,i=0;i<var_dims;i++) {
+				nc_inq_dimlen(dst_ID, dim_IDs[i], count+i);
+				start[i] = 0;
+			}
+			if(dim_IDs[0]==n3_dim_ID) {
+				start[0] = first_row;
+				count[0] = rows;
+			}
+			for(i=0;i<var_dims;i++) size *= count[i];
+
+			if((buffer=(double *)malloc(size*sizeof(double))) == NULL) { e=NC_ENOMEM; break; }
+			if( (e=nc_inq_varid(src_ID, var_name, &var_ID)) == NC_NOERR
+			    && (e=nc_get_var_double(src_ID, var_ID, buffer)) == NC_NOERR)
+				e = nc_put_vara_double(dst_ID, v, start, count, buffer);
+			free(buffer);
+		}
+		nc_close(src_ID);
+	}
+
+	if(e==NC_NOERR && next_row != global_dims[0]) {
+		fprintf(stderr, "snapmerge: The blocks of %s do not cover the grid.\n", name0);
+		e=NC_EINVAL;
+	}
+	if(e==NC_NOERR) e = nc_close(dst_ID); else nc_close(dst_ID);
+	if(e!=NC_NOERR) {
+		if(e!=NC_EINVAL) fprintf(stderr, "snapmerge: Can not merge %s: %s.\n", name0, nc_strerror(e));
+		remove(output);
+		return(1);
+	}
+
+	if(delete_local)
+		for(r=0;r<ranks;r++) {
+			rank_name(name, name0, prefix_len, r);
+			remove(name);
+		}
+	return(0);
+}
+
+int main(int argc, char *argv[])
+{
+	int MPIrank, MPIprocs;
+	int index_only = 0, first_arg = 1;
+	int failures = 0, total_failures;
+	int a;
+
+	MPI_Init(&argc, &argv);
+	MPI_Comm_rank(MPI_COMM_WORLD, &MPIrank);
+	MPI_Comm_size(MPI_COMM_WORLD, &MPIprocs);
+
+	/* use the NetCDF4/HDF5 format like Intertrack itself (no size limits) */
+	if(nc_set_default_format(NC_FORMAT_NETCDF4, NULL) != NC_NOERR && MPIrank==0)
+		fprintf(stderr, "snapmerge: NetCDF4 format not available. Falling back to NetCDF classic format.\n");
+
+	for(;first_arg<argc && argv[first_arg][0]=='-';first_arg++) {
+		if(!strcmp(argv[first_arg], "-i")) index_only = 1;
+		else if(!strcmp(argv[first_arg], "-d")) delete_local = 1;
+		else break;
+	}
+	if(first_arg >= argc) {
+		if(MPIrank==0) fprintf(stderr, "usage: snapmerge [-i] [-d] <rank 0 dataset (e.g. image.005.r000.ncd)> ...\n");
+		MPI_Finalize();
+		return(1);
+	}
+
+	/* the sets are assigned to the processes cyclically */
+	for(a=first_arg;a<argc;a++) if((a-first_arg)%MPIprocs == MPIrank) {
+		const char * name0 = argv[a];
+		const char * r000 = NULL, * p;
+		int dataset_ID, ranks, global_dims[3], e;
+
+		/* the name of the set is the name of the dataset of rank 0 without the last .r000 */
+		for(p=strstr(name0, ".r000"); p; p=strstr(p+1, ".r000")) r000 = p;
+		if(r000 == NULL || strlen(name0) > 4000) {
+			fprintf(stderr, "snapmerge: %s is not the dataset of rank 0 (.r000).\n", name0);
+			failures++;
+			continue;
+		}
+
+		if(nc_open(name0, NC_NOWRITE, &dataset_ID) != NC_NOERR) {
+			fprintf(stderr, "snapmerge: Can not open %s.\n", name0);
+			failures++;
+			continue;
+		}
+		e = nc_get_att_int(dataset_ID, NC_GLOBAL, "ranks", &ranks);
+		if(e==NC_NOERR) e = nc_get_att_int(dataset_ID, NC_GLOBAL, "global_dims", global_dims);
+		nc_close(dataset_ID);
+		if(e!=NC_NOERR || ranks<1 || ranks>MAX_RANKS) {
+			fprintf(stderr, "snapmerge: %s is not a rank-local snapshot dataset.\n", name0);
+			failures++;
+			continue;
+		}
+
+		if(index_only ? write_index(name0, r000-name0, ranks, global_dims) : merge(name0, r000-name0, ranks, global_dims))
+			failures++;
+		else
+			printf("%s: %d blocks %s\n", name0, ranks, index_only ? "indexed" : "merged");
+	}
+
+	MPI_Reduce(&failures, &total_failures, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+	if(MPIrank==0 && total_failures) fprintf(stderr, "snapmerge: %d set(s) failed.\n", total_failures);
+
+	MPI_Finalize();
+	return(MPIrank==0 && total_failures ? 1 : 0);
+}
@@ -6,7 +6,7 @@ const double from[] = {0,0,0};
 const double to[] = {1,1,1};
 const int res = 100;
 
-double r=0.1;
+double r=0.1;	/* used if the snapshots have no radius column */
 double snapshots = 400;
 double snap_stride = 2;
 
@@ -21,9 +21,9 @@ int main(int argc, char *argv[])
 	int snap;
 	int sphere_count;
 	int hits;
-	double rsq = r*r;
+	char line[1024];
 		
-	double pos[1000][3];
+	double pos[1000][3], rsq[1000];
 	
 	for(snap=snap_stride;snap<=snapshots;snap+=snap_stride) {
 		sprintf(filename, filename_template, snap);
@@ -33,9 +33,12 @@ int main(int argc, char *argv[])
 			exit(1);
 		}
 		sphere_count = 0;
-		fscanf(f,"%*s\n");	// skip header
-		while(!feof(f)) {
-			fscanf(f,"%lf,%lf,%lf,%*s\n", pos[sphere_count], pos[sphere_count]+1, pos[sphere_count]+2);
+		fgets(line, sizeof(line), f);	// skip header
+		while(sphere_count < 1000 && fgets(line, sizeof(line), f) != NULL) {
+			// the radius is in the 11th column (x,y,z,vx,vy,vz,avx,avy,avz,color,r)
+			if(sscanf(line,"%lf,%lf,%lf,%*f,%*f,%*f,%*f,%*f,%*f,%*f,%lf", pos[sphere_count], pos[sphere_count]+1, pos[sphere_count]+2, rsq+sphere_count) < 4)
+				rsq[sphere_count] = r;
+			rsq[sphere_count] *= rsq[sphere_count];
 			sphere_count++;
 		}
 		fclose(f);
@@ -53,7 +56,7 @@ int main(int argc, char *argv[])
 					for(i=0;i<res;i++) {
 						x = from[0] + (to[0]-from[0])*(0.5+i)/res;
 						for(s=0;s<sphere_count;s++)
-							if((x-pos[s][0])*(x-pos[s][0]) + (y-pos[s][1])*(y-pos[s][1]) + (z-pos[s][2])*(z-pos[s][2]) <= rsq) hits++;
+							if((x-pos[s][0])*(x-pos[s][0]) + (y-pos[s][1])*(y-pos[s][1]) + (z-pos[s][2])*(z-pos[s][2]) <= rsq[s]) hits++;
 					}	// i
 				}	// j
 			}	// k
@@ -25,8 +25,12 @@ end
 function eps_s = epss(r, snapshot, from, to, res)
     % state at the given snapshot
     ww=readmatrix(sprintf('snap_%03d.csv',snapshot));
-    % extract positions only
+    % extract positions and radii (if the snapshot has the radius column)
     pos=ww(:,1:3);
+    rad=r*ones(size(ww,1),1);
+    if size(ww,2) >= 11
+        rad=ww(:,11);
+    end
     
     sphere_count = size(pos,1);
     hits = 0;
@@ -35,7 +39,7 @@ function eps_s = epss(r, snapshot, from, to, res)
         for y=from(2)+((0:res-1)+0.5)*(to(2)-from(2))/res
             for x=from(1)+((0:res-1)+0.5)*(to(1)-from(1))/res
                 for b=1:sphere_count
-                    if(norm(pos(b,:)-[x y z])<=r)
+                    if(norm(pos(b,:)-[x y z])<=rad(b))
                         hits = hits+1;
                         break;
                     end
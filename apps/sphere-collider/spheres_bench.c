@@ -0,0 +1,238 @@
+/*
+SPHERES BENCHMARK
+throughput of the force evaluation of the DEM simulator for the neighbour search strategies
+(C) 2026 PorousFreezeThaw contributors
+
+The simulator (spheres_friction_angular.c, with its configuration) is included here and one evaluation of its
+right hand side rhs() is timed for two configurations of n = 100, 1000, ... n_max spheres in the vessel:
+
+	bed	a dense bed of spheres at rest in a lattice with the spacing of the largest diameter (1% overlap in z)
+	fall	a loose cloud of falling spheres in a lattice with the spacing of 3 radii (about one interacting pair per 2 spheres)
+
+for each neighbour search strategy (all_pairs, grid, verlet, symmetric, see neighbour_search) and for 1, 2, 4 ...
+OpenMP threads (up to OMP_NUM_THREADS). The accelerations and the angular accelerations are compared to those of
+the all-pairs reference for up to 'max_samples' spheres. One line is printed for each measurement:
+
+	config n strategy threads seconds first_seconds pairs pairs_per_s max_error ok
+
+where 'seconds' is the mean time of one evaluation (repeated for at least min_time seconds), 'first_seconds'
+is the time of the first one (including the build of the Verlet list), 'pairs' is the number of the interacting
+pairs of spheres (each counted once), 'max_error' is the maximum difference from the reference relative to the
+maximum reference value and 'ok' is 1 if it does not exceed 'tolerance'. The all-pairs strategy is only timed
+up to n = allpairs_max. The container mesh is not loaded.
+
+usage: spheres_bench [n_max [min_time]]
+*/
+
+#define main spheres_main
+#include "spheres_friction_angular.c"
+#undef main
+
+#include <float.h>
+
+#ifdef _OPENMP
+	#define wall_time()	omp_get_wtime()
+#else
+	#define wall_time()	((double)clock()/CLOCKS_PER_SEC)
+#endif
+
+#if _DEFAULT_FP_PRECISION == FP_FLOAT
+	#define FLOAT_EPSILON	FLT_EPSILON
+#elif _DEFAULT_FP_PRECISION == FP_DOUBLE
+	#define FLOAT_EPSILON	DBL_EPSILON
+#else
+	#define FLOAT_EPSILON	LDBL_EPSILON
+#endif
+
+const int allpairs_max = 10000;
+const int max_samples = 1000;
+const double tolerance = 1e4*FLOAT_EPSILON;
+
+const char * strategy_name[] = { "all_pairs", "grid", "verlet", "symmetric" };
+const char * config_name[] = { "bed", "fall" };
+
+/* -------------------------------------------------------------- */
+
+static void make_config(int config, int count, FLOAT **y_ptr, FLOAT **color_ptr)
+/* allocates the data for 'count' spheres and sets up the configuration 'config' (0 = bed, 1 = fall) */
+{
+	int i, d;
+	FLOAT spacing = config ? 3.0*r : 2.0*r, jitter = config ? 0.5*r : 0.02*r;
+	int per_row = floor(R/spacing) > 1 ? floor(R/spacing) : 1;
+	FLOAT distance = R/per_row, z0 = config ? h0 : r;
+
+	n = count;
+	if(alloc_data(y_ptr, color_ptr)) {
+		fprintf(stderr, "Not enough memory.\n");
+		exit(2);
+	}
+
+	FLOAT * pos = *y_ptr;
+	FLOAT * vel = pos + 3*n;
+	FLOAT * angvel = vel + 3*n;
+
+	for(i=0;i<n;i++) {
+		VEC(pos,i)[0] = (i%per_row+0.5)*distance;
+		VEC(pos,i)[1] = ((i/per_row)%per_row+0.5)*distance;
+		VEC(pos,i)[2] = z0 + (i/(per_row*per_row))*(config ? spacing : 0.99*spacing);
+		for(d=0;d<3;d++) {
+			VEC(pos,i)[d] += jitter*(randF()-0.5);
+			VEC(vel,i)[d] = (config ? 0.5 : 0.01)*(randF()-0.5);
+			VEC(angvel,i)[d] = (config ? 1.0 : 0.1)*(randF()-0.5);
+		}
+		if(config) VEC(vel,i)[2] -= 1.0;
+
+		(*color_ptr)[i] = VEC(pos,i)[2];
+		set_radius(i, random_radius());
+	}
+	init_grid();
+}
+
+static void reference_rhs(const FLOAT * y, int i, FLOAT * acc_i, FLOAT * angacc_i)
+/* the acceleration and the angular acceleration of the i-th sphere evaluated by rhs() with all pairs */
+{
+	int j;
+	FLOAT mp[3];
+
+	vmov(acc_i, g);
+	vmov(angacc_i, zero_vector);
+	for(j=0;j<n;j++) if(j!=i) sphere_contact(y, i, j, acc_i, angacc_i);
+	for(j=0;j<num_walls;j++) {
+		if(wall_ignored[j]) continue;
+		vmov(mp,VEC(y,i));
+		vsub(mp,wall[j].P);
+		wall_contact(y, i, wall[j].n, - dot(mp,wall[j].n) - radius[i], acc_i, angacc_i);
+	}
+}
+
+static long count_pairs(const FLOAT * y)
+/* the number of the interacting pairs of spheres */
+{
+	int i, k, c, capacity = 0;
+	int * list = NULL;
+	long pairs = 0;
+	FLOAT force[3], torque[3];
+
+	build_grid(y);
+	for(i=0;i<n;i++) {
+		c = grid_neighbours(y, i, 0, 1, NULL);
+		if(c > capacity) {
+			free(list);
+			capacity = 2*c;
+			list = (int *)malloc(capacity*sizeof(int));
+			if(list == NULL) return(-1);
+		}
+		grid_neighbours(y, i, 0, 1, list);
+		for(k=0;k<c;k++) pairs += contact_force(y, i, list[k], force, torque);
+	}
+	free(list);
+	return(pairs);
+}
+
+static double max_error(const FLOAT * dy, const FLOAT * ref, int samples)
+/* the maximum difference of the (angular) accelerations of the samples relative to the maximum reference value */
+{
+	int s, i, d, k;
+	double err[2] = {0,0}, scale[2] = {0,0}, e;
+
+	for(s=0;s<samples;s++) {
+		i = (long)s*n/samples;
+		for(k=0;k<2;k++)
+			for(d=0;d<3;d++) {
+				e = fabsF(dy[3*n*(k+1) + 3*i+d] - ref[6*s + 3*k+d]);
+				if(e > err[k]) err[k] = e;
+				e = fabsF(ref[6*s + 3*k+d]);
+				if(e > scale[k]) scale[k] = e;
+			}
+	}
+	for(k=0;k<2;k++) err[k] = scale[k] > 0 ? err[k]/scale[k] : err[k];
+	return( err[0] > err[1] ? err[0] : err[1] );
+}
+
+static double time_rhs(int threads, const FLOAT * y, FLOAT * dy, double min_time, double * first)
+/* returns the mean time of one evaluation of rhs() by 'threads' threads, the first one is timed separately */
+{
+	double start;
+	int repetitions = 0;
+
+	verlet_n = -1;		/* the positions do not change, so the list must be discarded to time its build */
+	start = wall_time();
+	#pragma omp parallel num_threads(threads)
+	rhs(0, y, dy);
+	*first = wall_time()-start;
+
+	start = wall_time();
+	do {
+		#pragma omp parallel num_threads(threads)
+		rhs(0, y, dy);
+		repetitions++;
+	} while(wall_time()-start < min_time);
+	return( (wall_time()-start)/repetitions );
+}
+
+int main(int argc, char *argv[])
+{
+	int n_max = argc>1 ? atoi(argv[1]) : 1000000;
+	double min_time = argc>2 ? atof(argv[2]) : 0.5;
+	int count, config, strategy, threads, samples, s, q;
+	long pairs;
+	double seconds, first, err;
+	FLOAT * y, * color, * dy, * ref;
+
+	#ifdef _OPENMP
+	 int max_threads = omp_get_max_threads();
+	#else
+	 int max_threads = 1;
+	#endif
+
+	if(n_max<1 || min_time<0) {
+		fprintf(stderr, "usage: %s [n_max [min_time]]\n", argv[0]);
+		return(1);
+	}
+
+	/* the preparation done in main() of the simulator */
+	for(q=0;q<num_walls;q++) {
+		vmult(wall[q].n, 1.0/norm(wall[q].n));
+		wall_ignored[q] = (periodic_x && fabsF(wall[q].n[0]) > ZERO) || (periodic_y && fabsF(wall[q].n[1]) > ZERO);
+	}
+	kin_energy_fraction = COR * COR;
+
+	printf("# r: %g, r_min: %g, verlet_skin: %g, FLOAT size: %d bytes, max. threads: %d, tolerance: %g\n",
+		(double)r, (double)r_min, (double)verlet_skin, (int)sizeof(FLOAT), max_threads, tolerance);
+	printf("# config n strategy threads seconds first_seconds pairs pairs_per_s max_error ok\n");
+
+	for(count=100; count<=n_max; count*=10)
+		for(config=0; config<2; config++) {
+			seed_randF(1);
+			make_config(config, count, &y, &color);
+			samples = n < max_samples ? n : max_samples;
+			dy = (FLOAT *)malloc(9*n*sizeof(FLOAT));
+			ref = (FLOAT *)malloc(6*samples*sizeof(FLOAT));
+			if(dy == NULL || ref == NULL) {
+				fprintf(stderr, "Not enough memory.\n");
+				return(2);
+			}
+
+			#pragma omp parallel for
+			for(s=0;s<samples;s++) reference_rhs(y, (long)s*n/samples, ref+6*s, ref+6*s+3);
+			pairs = count_pairs(y);
+
+			for(strategy=0; strategy<4; strategy++) {
+				if(strategy == 0 && n > allpairs_max) continue;
+				neighbour_search = strategy;
+				for(threads=1; ; threads = 2*threads < max_threads ? 2*threads : max_threads) {
+					seconds = time_rhs(threads, y, dy, min_time, &first);
+					err = max_error(dy, ref, samples);
+					printf("%s %d %s %d %.6e %.6e %ld %.6e %.3e %d\n", config_name[config], n, strategy_name[strategy],
+						threads, seconds, first, pairs, pairs/seconds, err, err <= tolerance);
+					fflush(stdout);
+					if(threads == max_threads) break;
+				}
+			}
+
+			free(dy); free(ref);
+			free_data(y, color);
+		}
+
+	return(0);
+}
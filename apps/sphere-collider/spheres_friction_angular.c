@@ -17,6 +17,8 @@ version with normal (repulsion) forces and frictional froces, including sphere r
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
 #include <time.h>
 #include "mathspec.h"
 
@@ -24,8 +26,11 @@ version with normal (repulsion) forces and frictional froces, including sphere r
 
 // number of spheres (not constant, as it can be overriden by the initial condition)
 int n = 200;
-// sphere radius
+// sphere radius (the largest radius of the generated spheres, see r_min)
 const FLOAT r = 0.1;
+// the radii of the generated spheres are distributed uniformly in [r_min, r] (r_min = r: equal spheres). The mass
+// of each sphere is proportional to its volume, the sphere of radius r having the unit mass (see set_radius()).
+const FLOAT r_min = r;
 // initial height of the lowest sphere
 const FLOAT h0 = 1.0+r;
 // vessel base dimensions
@@ -37,9 +42,31 @@ const FLOAT T = 8.0;
 void icond_2spheres(FLOAT **y_ptr, FLOAT **color_ptr);
 void icond_sparse(FLOAT **y_ptr, FLOAT **color_ptr);
 void icond_dense(FLOAT **y_ptr, FLOAT **color_ptr);
+void icond_none(FLOAT **y_ptr, FLOAT **color_ptr);
+void icond_file(FLOAT **y_ptr, FLOAT **color_ptr);
 // choose the initial condition here:
 void (*icond)(FLOAT **, FLOAT **) = icond_dense;
 
+// initial state file (if not NULL, it replaces the above initial condition; it can also be given as the command
+// line argument). A checkpoint (see below) continues the simulation from its time level and the snapshot numbering
+// goes on. A positions file (a snapshot .csv or lines of "x y z" as read by Intertrack) starts a new simulation
+// from the given positions, e.g. to add a second pour to a settled bed (see icond_file()).
+const char * icond_filename = NULL;
+
+// pouring: insert_count spheres are added to the initial condition in batches of insert_batch spheres every
+// insert_interval seconds, starting at t=0 (0 = no pouring). Each batch is placed on a jittered grid (as in
+// icond_dense) above the highest sphere, but not lower than h0. Choose icond_none to pour into an empty vessel.
+const int insert_count = 0;
+const int insert_batch = 50;
+const FLOAT insert_interval = 0.1;
+
+// sleeping: a sphere whose velocity and surface velocity of rotation stay below sleep_velocity for sleep_time
+// is frozen (it is not moved by the solver, but the others still collide with it) until a faster sphere comes
+// within the interaction distance. The states are updated every sleep_check_interval seconds (0 = no sleeping).
+const FLOAT sleep_velocity = 0;
+const FLOAT sleep_time = 0.2;
+const FLOAT sleep_check_interval = 0.02;
+
 // coefficient of restitution
 const FLOAT COR = 0.4;
 // focusing of the transition from full force when the collision is in its
@@ -58,9 +85,15 @@ const FLOAT p_eps1 = 0.01;
 const FLOAT collision_force_multiplier = 10;
 const FLOAT collision_force_exponent = 150;
 
-// maximum surface distance of interaction
+// maximum surface distance of interaction (of two spheres of radius r, see contact_scale())
 const FLOAT max_surf_dist = r;
 
+// neighbour search: 0 = all pairs, 1 = hierarchical grid (see build_grid()), 2 = Verlet list, 3 = Verlet list of the pairs
+// with the symmetric forces evaluated once per pair (see pair_acc). Not constant, as it is switched by the benchmark.
+int neighbour_search = 1;
+// the skin of the Verlet list (the list is rebuilt when a sphere has moved by more than half of it)
+const FLOAT verlet_skin = 0.3*r;
+
 // gravity acceleration (not constant, as it can be overriden by the initial condition)
 FLOAT g[3] = {0, 0, 0 -9.81};
 
@@ -73,6 +106,13 @@ const FLOAT delta = 0.1;
 const int snapshots = 400;
 const char * filename_base = "snap";
 const char * filename_format = "OUTPUT/%s_%03d.csv";
+// the positions and the radii of the spheres in the last snapshot are also saved for Intertrack (NULL = not saved)
+const char * positions_filename = "OUTPUT/positions.txt";
+
+// checkpoints of the full state (see save_checkpoint()) saved with every checkpoint_interval-th snapshot
+// and with the last one (0 = never)
+const int checkpoint_interval = 50;
+const char * checkpoint_format = "OUTPUT/%s_%03d.chk";
 
 // regularization
 const FLOAT ZERO = 1e-8;
@@ -98,6 +138,27 @@ PLANE wall[] = {
 const int num_walls = sizeof(wall) / sizeof(PLANE);
 /* or the floor (bottom) only */
 //const int num_walls = 1;
+/* or no planes (e.g. with the container mesh) */
+//const int num_walls = 0;
+
+// container mesh: the triangles of an STL (binary or ASCII) or a Wavefront OBJ file (recognized by the extension
+// ".obj") act as walls in addition to the planes above (NULL = no mesh). The contacts with the faces, the edges
+// and the vertices of the triangles use the same forces as the planes. The mesh can represent e.g. a cylindrical
+// vessel, a cap or an inclined bottom (the triangles are two-sided, their orientation does not matter). Its
+// coordinates are multiplied by mesh_scale and shifted by mesh_offset. The mesh is not repeated periodically.
+const char * mesh_filename = NULL;
+const FLOAT mesh_scale = 1.0;
+const FLOAT mesh_offset[3] = {0, 0, 0};
+
+// periodic boundary conditions in the x and y directions with the period R (the vessel base is [0,R]x[0,R]).
+// The walls whose normal has a component in a periodic direction are ignored, each particle interacts with the nearest
+// periodic images of the others and the particles are wrapped into the base before each snapshot.
+// This generates periodic packings for representative volume simulations.
+const int periodic_x = 0;
+const int periodic_y = 0;
+
+/* nonzero for the walls ignored due to the periodic boundary conditions (set in main()) */
+char wall_ignored[sizeof(wall) / sizeof(PLANE)];
 
 /* -------------------------------------------------------------- */
 
@@ -105,8 +166,23 @@ const int num_walls = sizeof(wall) / sizeof(PLANE);
 
 const FLOAT zero_vector[3] = {0,0,0};
 
-/* moment of inertia of a unit-mass solid ball */
-const FLOAT I = 2.0 / 5.0 * r * r;
+/* -------------------------------------------------------------- */
+
+/* properties of the individual spheres (see set_radius()) */
+
+FLOAT * radius;
+FLOAT * mass;				/* the mass of a sphere of radius r is 1 */
+
+/* -------------------------------------------------------------- */
+
+/* pouring and sleeping state (see insert_count and sleep_velocity) */
+
+int n_capacity;				/* the number of spheres the arrays are allocated for (see alloc_data()) */
+int inserted = 0;			/* the number of spheres poured so far */
+FLOAT next_insertion = 0;		/* the time of the next batch */
+FLOAT next_sleep_check = 0;		/* the time of the next update of the sleeping states */
+char * asleep;				/* nonzero for the sleeping spheres */
+FLOAT * quiet_time;			/* how long the velocity of each sphere has been below sleep_velocity */
 
 /* -------------------------------------------------------------- */
 
@@ -143,10 +219,40 @@ static double MPIstart_time, MPInew_start, MPIelapsed_time;
 
 /* -------------------------------------------------------------- */
 
+/*
+state of the pseudo-random number generator (xorshift64*). Unlike rand(), its state can be saved
+in a checkpoint, so that a restarted simulation draws the same numbers.
+*/
+static uint64_t rng_state = 88172645463325252ULL;
+
+void seed_randF(uint64_t seed)
+{
+	/* the state must not be zero */
+	rng_state = seed*0x9E3779B97F4A7C15ULL + 88172645463325252ULL;
+	if(rng_state == 0) rng_state = 88172645463325252ULL;
+}
+
 FLOAT randF()
 /* returns a pseudo-random number between 0 a 1 */
 {
-	return(((FLOAT)rand()) / ((FLOAT)RAND_MAX));
+	rng_state ^= rng_state >> 12;
+	rng_state ^= rng_state << 25;
+	rng_state ^= rng_state >> 27;
+	return( (FLOAT)((rng_state * 2685821657736338717ULL) >> 11) * (1.0/9007199254740992.0) );
+}
+
+FLOAT random_radius()
+/* returns a radius from the distribution of the generated spheres (see r_min) */
+{
+	if(r_min >= r) return(r);
+	return( r_min + (r-r_min)*randF() );
+}
+
+void set_radius(int i, FLOAT rad)
+/* sets the radius and the mass of the i-th sphere (all spheres have the same density) */
+{
+	radius[i] = rad;
+	mass[i] = (rad/r)*(rad/r)*(rad/r);
 }
 
 #define VEC(arg,i) (arg+3*(i))
@@ -216,7 +322,7 @@ a smooth version of a function that basically returns
 kin_energy_fraction for v<0
 */
 {
-	return( kin_energy_fraction + 0.5*(1.0-kin_energy_fraction)*(1.0+tanh(v*dissipation_focusing)) );
+	return( kin_energy_fraction + 0.5*(1.0-kin_energy_fraction)*(1.0+vtanhF(v*dissipation_focusing)) );
 }
 
 static inline FLOAT collision_factor(FLOAT surface_distance)
@@ -239,25 +345,891 @@ static inline FLOAT friction_factor(FLOAT x)
 	return ( x*x*(eps2_3 - eps3_2*x) );
 }
 
+static inline FLOAT unit_inertia(FLOAT rad)
+/* moment of inertia of a unit-mass solid ball of radius rad */
+{
+	return( 2.0 / 5.0 * rad * rad );
+}
+
+static inline FLOAT contact_scale(int i, int j)
+/*
+the ratio of the effective radius r_i*r_j/(r_i+r_j) of the contact of the i-th and the j-th sphere to that of two
+spheres of radius r (j<0 stands for a wall, where the effective radius is r_i). The collision force is defined for
+two spheres of radius r: for other radii, the surface distance is measured relative to this ratio and the force
+is multiplied by its square (the relative contact area). The ratio never exceeds (r_i+r_j)/r.
+*/
+{
+	if(j<0) return( radius[i]/r );
+	return( 2.0*radius[i]*radius[j] / ((radius[i]+radius[j])*r) );
+}
+
+static inline FLOAT reach(FLOAT rad)
+/* the radius of the ball around the center of a sphere of radius rad that contains all its interactions */
+{
+	return( rad*(1.0 + max_surf_dist/r) );
+}
+
+static inline int contact_force(const FLOAT * y, int i, int j, FLOAT * force, FLOAT * torque)
+/*
+calculates the force exerted on the i-th sphere by the j-th sphere (the j-th sphere is subject to the opposite force)
+and the torque divided by the radius, which is the same for both spheres. Returns zero if the spheres do not interact.
+*/
+{
+	FLOAT mp[3], mv[3], mv_tangent[3], sv[3];
+	FLOAT distance, heading, CF, mv_tangent_magnitude, FF, scale;
+	const FLOAT * pos = y;
+	const FLOAT * vel = y + 3*n;
+	const FLOAT * angvel = y + 6*n;
+
+	// mutual position (i-th w.r.t. j-th particle)
+	vmov(mp, VEC(pos,i));
+	vsub(mp, VEC(pos,j));
+	// take the nearest periodic image of the j-th particle
+	if(periodic_x) mp[0] -= R*floorF(mp[0]/R+0.5);
+	if(periodic_y) mp[1] -= R*floorF(mp[1]/R+0.5);
+	distance = norm(mp) + ZERO;
+	// normalize mutual position for further use
+	vmult(mp, 1.0/distance);
+	// calculate the distance between surfaces
+	distance -= radius[i] + radius[j];
+	// ignore spheres that are too far away
+	scale = contact_scale(i,j);
+	if(distance > max_surf_dist*scale) return(0);
+	// the magnitude of the collision force
+	CF = scale*scale*collision_factor(distance/scale);
+	// mutual velocity (of i-th particle w.r.t. j-th particle)
+	vmov(mv, VEC(vel,i));
+	vsub(mv, VEC(vel,j));
+	// derivative of mutual distance w.r.t. time (or projection of mv into the direction mp)
+	// (shows if the particles are moving toward or away from each other)
+	heading = dot(mv,mp);
+	// tangential mutual velocity (of the center of the i-th particle w.r.t. j-th particle)
+	vmov(mv_tangent, mv);
+	vmadd(mv_tangent, -heading, mp);
+
+	// account for surface velocity of rotation of i-th sphere v_tangent = \vec{omega} \times \vec{r}
+	// note that mp points in the OPPOSITE direction than \vec{r}, which is the vector from particle center to the point of contact at the surface
+	cross(sv, VEC(angvel,i), mp);
+	vmadd(mv_tangent, -radius[i], sv);
+	// account for surface velocity of rotation of j-th sphere (here \vec{r} points in the direction of mp)
+	cross(sv, VEC(angvel,j), mp);
+	vmadd(mv_tangent, -radius[j], sv);
+
+	// normalize tangential velocity
+	mv_tangent_magnitude = norm(mv_tangent) + ZERO;
+	vmult(mv_tangent, 1.0/mv_tangent_magnitude);
+	// 1) repulsive force
+	vmov(force, mp);
+	vmult(force, CF * rebound(-heading));
+	// 2) frictional force: calculate the magnitude
+	FF = CF * friction * friction_factor(mv_tangent_magnitude);
+	// ... apply linear impulse (in the direction opposite to mv_tangent!)
+	vmadd(force, -FF , mv_tangent);
+	// ... apply angular impulse
+	// the formula for torque is \tau = \vec{r} \times \vec{F}, but the multiplication by the radius is postponed to the caller.
+	// Note that mv_tangent points in the opposite direction than the tangential force, but so does mp with respect to \vec{r},
+	// so the below cross product calculates the torque with the correct orientation. For the j-th sphere, both mp and
+	// mv_tangent have the opposite direction, so the torque is the same.
+	cross(torque, mp, mv_tangent);
+	vmult(torque, FF);
+	return(1);
+}
+
+static inline FLOAT angular_factor(int i)
+/* the angular acceleration of the i-th sphere per unit torque divided by the radius (see contact_force()) */
+{
+	return( radius[i] / (mass[i]*unit_inertia(radius[i])) );
+}
+
+static inline void sphere_contact(const FLOAT * y, int i, int j, FLOAT * acc_i, FLOAT * angacc_i)
+/* adds the acceleration and the angular acceleration of the i-th sphere induced by the j-th sphere */
+{
+	FLOAT force[3], torque[3];
+
+	if(!contact_force(y, i, j, force, torque)) return;
+	vmadd(acc_i, 1.0/mass[i], force);
+	vmadd(angacc_i, angular_factor(i), torque);
+}
+
+/* -------------------------------------------------------------- */
+
+/*
+hierarchical grid for the neighbour search. The spheres are sorted into levels by their size: the cells of the
+level k have the size 2^k times that of the level 0, and each sphere belongs to the finest level whose cells are
+not smaller than the diameter of its reach (see reach()). At each level k, all spheres that can interact with
+a sphere at the position x then lie in the cells overlapping the box x +- (reach + cell size/2), which are at
+most 3x3x3 cells at the level of the sphere and at the coarser levels. Therefore, each sphere only searches its
+own level and the coarser ones (skipping the empty levels), and the pairs of spheres of different levels are
+only found by the smaller sphere. The forces of such a pair are evaluated once and added to both spheres through
+the buffers of the threads (see pair_acc). The cells of all levels are hashed into one table and the spheres are
+sorted by the table entries (buckets) before each evaluation of the right hand side (see build_grid()). In the
+periodic directions, the cells are stretched to fit the period an integer number of times.
+*/
+
+#define GRID_MAX_LEVELS 16
+
+static int grid_levels;
+static FLOAT max_radius;			/* the largest radius of the spheres present and of those to be poured */
+static FLOAT grid_cell[GRID_MAX_LEVELS][3];	/* the cell dimensions of each level (the cell size is the z dimension) */
+static int grid_period[GRID_MAX_LEVELS][2];	/* the numbers of cells per period R in x and y (0 = not periodic) */
+static unsigned grid_buckets;			/* the size of the hash table (a power of 2) */
+static int * grid_start;			/* the start of each bucket in grid_sorted (grid_buckets+1 entries) */
+static int * grid_sorted;			/* the sphere indices sorted by the buckets */
+static int * grid_coord;			/* the level and the cell coordinates of each sphere (4 entries per sphere) */
+static int grid_count[GRID_MAX_LEVELS];		/* the number of the spheres at each level */
+static int grid_cross;				/* nonzero if more than one level holds spheres */
+static unsigned * grid_bucket;			/* the bucket of each sphere */
+
+void init_grid()
+/* sets up the levels of the hierarchical grid for the radii of the spheres present and of those to be poured */
+{
+	FLOAT rad_min = r_min, rad_max = r;
+	int i, k, d, periodic;
+
+	for(i=0;i<n;i++) {
+		if(radius[i] < rad_min) rad_min = radius[i];
+		if(radius[i] > rad_max) rad_max = radius[i];
+	}
+
+	max_radius = rad_max;
+
+	/* (the size ratio of the spheres is limited to 2^(GRID_MAX_LEVELS-1)) */
+	grid_cell[0][2] = 2*reach(rad_min);
+	for(grid_levels=1; grid_levels<GRID_MAX_LEVELS && grid_cell[grid_levels-1][2] < 2*reach(rad_max); grid_levels++)
+		grid_cell[grid_levels][2] = 2*grid_cell[grid_levels-1][2];
+
+	for(k=0;k<grid_levels;k++)
+		for(d=0;d<2;d++) {
+			periodic = d ? periodic_y : periodic_x;
+			grid_period[k][d] = periodic ? (R >= 2*grid_cell[k][2] ? (int)floorF(R/grid_cell[k][2]) : 1) : 0;
+			grid_cell[k][d] = periodic ? R/grid_period[k][d] : grid_cell[k][2];
+		}
+}
+
+static inline int grid_wrap(int c, int k, int d)
+/* wraps the cell coordinate c in the periodic direction d at the level k */
+{
+	if(d<2 && grid_period[k][d]) {
+		c %= grid_period[k][d];
+		if(c<0) c += grid_period[k][d];
+	}
+	return(c);
+}
+
+static inline unsigned grid_hash(int k, int cx, int cy, int cz)
+{
+	return( ((unsigned)cx*73856093u ^ (unsigned)cy*19349663u ^ (unsigned)cz*83492791u ^ (unsigned)k*2654435761u) & (grid_buckets-1) );
+}
+
+void build_grid(const FLOAT * pos)
+/* sorts the spheres into the buckets of the hierarchical grid (counting sort) */
+{
+	int i, k, d;
+	unsigned b;
+	int * c;
+
+	memset(grid_start, 0, (grid_buckets+1)*sizeof(int));
+	memset(grid_count, 0, sizeof(grid_count));
+	for(i=0;i<n;i++) {
+		c = grid_coord + 4*i;
+		for(k=0; k<grid_levels-1 && grid_cell[k][2] < 2*reach(radius[i]); k++);
+		c[0] = k;
+		grid_count[k]++;
+		for(d=0;d<3;d++) c[1+d] = grid_wrap((int)floorF(VEC(pos,i)[d]/grid_cell[k][d]), k, d);
+		grid_bucket[i] = b = grid_hash(k, c[1], c[2], c[3]);
+		grid_start[b+1]++;
+	}
+	for(b=0;b<grid_buckets;b++) grid_start[b+1] += grid_start[b];
+	/* while the buckets are filled, grid_start[b] moves to the end of the b-th bucket */
+	for(i=0;i<n;i++) grid_sorted[grid_start[grid_bucket[i]]++] = i;
+	for(b=grid_buckets;b>0;b--) grid_start[b] = grid_start[b-1];
+	grid_start[0] = 0;
+
+	for(k=0, grid_cross=-1; k<grid_levels; k++) grid_cross += grid_count[k] > 0;
+	grid_cross = grid_cross > 0;
+}
+
+static inline void grid_range(const FLOAT * x, int k, FLOAT range, int * lo, int * hi)
+/* finds the cells of the level k overlapping the box x +- range (in the periodic directions, each cell of a period at most once) */
+{
+	int d;
+
+	for(d=0;d<3;d++) {
+		lo[d] = (int)floorF((x[d]-range)/grid_cell[k][d]);
+		hi[d] = (int)floorF((x[d]+range)/grid_cell[k][d]);
+		if(d<2 && grid_period[k][d] && hi[d]-lo[d] >= grid_period[k][d]) {
+			lo[d] = 0;
+			hi[d] = grid_period[k][d]-1;
+		}
+	}
+}
+
+static inline void pair_contact(const FLOAT * y, int i, int j, FLOAT * buf)
+/*
+adds the accelerations and the angular accelerations of both spheres of the pair i,j to the buffer buf (see pair_acc).
+The pairs of sleeping spheres are skipped, since rhs() sets their accelerations to zero anyway.
+*/
+{
+	FLOAT force[3], torque[3];
+
+	if((asleep[i] && asleep[j]) || !contact_force(y, i, j, force, torque)) return;
+	vmadd(VEC(buf,2*i), 1.0/mass[i], force);
+	vmadd(VEC(buf,2*j), -1.0/mass[j], force);
+	vmadd(VEC(buf,2*i+1), angular_factor(i), torque);
+	vmadd(VEC(buf,2*j+1), angular_factor(j), torque);
+}
+
+static void grid_contacts(const FLOAT * y, int i, FLOAT * acc_i, FLOAT * angacc_i, FLOAT * buf)
+/*
+adds the accelerations of the i-th sphere induced by the spheres of its own level of the hierarchical grid if buf
+is NULL. Otherwise, adds the accelerations of both spheres of the pairs of the i-th sphere with the spheres of the
+coarser levels to buf (see pair_contact()).
+*/
+{
+	int k, last, p, j, lo[3], hi[3], cx, cy, cz, wx, wy;
+	unsigned b;
+	const int * c;
+
+	if(buf == NULL) k = last = grid_coord[4*i];
+	else {
+		k = grid_coord[4*i]+1;
+		last = grid_levels-1;
+	}
+	for(;k<=last;k++) {
+		if(!grid_count[k]) continue;
+		grid_range(VEC(y,i), k, reach(radius[i]) + 0.5*grid_cell[k][2], lo, hi);
+		for(cz=lo[2];cz<=hi[2];cz++)
+		for(cy=lo[1];cy<=hi[1];cy++)
+		for(cx=lo[0];cx<=hi[0];cx++) {
+			wx = grid_wrap(cx, k, 0);
+			wy = grid_wrap(cy, k, 1);
+			b = grid_hash(k, wx, wy, cz);
+			for(p=grid_start[b];p<grid_start[b+1];p++) {
+				j = grid_sorted[p];
+				c = grid_coord + 4*j;
+				/* skip the spheres of the other cells sharing the bucket */
+				if(j==i || c[0]!=k || c[1]!=wx || c[2]!=wy || c[3]!=cz) continue;
+				if(buf != NULL) pair_contact(y, i, j, buf);
+				else sphere_contact(y, i, j, acc_i, angacc_i);
+			}
+		}
+	}
+}
+
+static int grid_neighbours(const FLOAT * pos, int i, FLOAT margin, int half, int * list)
+/*
+stores the indices of the spheres found in the hierarchical grid whose reach comes closer than margin to the reach
+of the i-th sphere in list and returns their number. Only the own level of the sphere (with the indices greater
+than i if half is nonzero) and the coarser levels are searched, in this order, so that each pair of spheres of
+different levels is found once. If list is NULL, the spheres are only counted.
+*/
+{
+	int k, p, j, count = 0, lo[3], hi[3], cx, cy, cz, wx, wy;
+	unsigned b;
+	const int * c;
+	FLOAT mp[3], limit;
+
+	for(k=grid_coord[4*i];k<grid_levels;k++) {
+		if(!grid_count[k]) continue;
+		grid_range(VEC(pos,i), k, reach(radius[i]) + margin + 0.5*grid_cell[k][2], lo, hi);
+		for(cz=lo[2];cz<=hi[2];cz++)
+		for(cy=lo[1];cy<=hi[1];cy++)
+		for(cx=lo[0];cx<=hi[0];cx++) {
+			wx = grid_wrap(cx, k, 0);
+			wy = grid_wrap(cy, k, 1);
+			b = grid_hash(k, wx, wy, cz);
+			for(p=grid_start[b];p<grid_start[b+1];p++) {
+				j = grid_sorted[p];
+				c = grid_coord + 4*j;
+				if(j==i || (half && j<i && k==grid_coord[4*i]) || c[0]!=k || c[1]!=wx || c[2]!=wy || c[3]!=cz) continue;
+				vmov(mp, VEC(pos,i));
+				vsub(mp, VEC(pos,j));
+				if(periodic_x) mp[0] -= R*floorF(mp[0]/R+0.5);
+				if(periodic_y) mp[1] -= R*floorF(mp[1]/R+0.5);
+				limit = reach(radius[i]) + reach(radius[j]) + margin;
+				if(dot(mp,mp) > limit*limit) continue;
+				if(list != NULL) list[count] = j;
+				count++;
+			}
+		}
+	}
+	return(count);
+}
+
+/* -------------------------------------------------------------- */
+
+/*
+Verlet list: the neighbours of each sphere whose reach is closer than verlet_skin to its own. The list is built
+from the hierarchical grid and it contains all interacting pairs until a sphere moves by verlet_skin/2 from the
+position where the list was built (this is checked before each evaluation of the right hand side). The pairs of
+spheres of different levels of the grid are listed once (see grid_neighbours()). With neighbour_search = 3, all
+pairs are listed once. The forces of the pairs listed once are added to both spheres: the threads accumulate the
+accelerations in their own buffers (pair_acc), which are summed afterwards.
+*/
+
+static int verlet_n = -1;		/* the number of spheres the list has been built for (-1 = no list) */
+static int verlet_half;			/* nonzero if the list contains each pair once */
+static int verlet_rebuild;		/* nonzero if the list is being rebuilt in this evaluation */
+static int * verlet_start;		/* the start of the neighbours of each sphere in verlet_list (n+1 entries) */
+static int * verlet_list = NULL;
+static int verlet_capacity = 0;
+static FLOAT * verlet_pos;		/* the positions of the spheres when the list was built */
+static FLOAT * pair_acc = NULL;		/* the accelerations and the angular accelerations (6 per sphere) of each thread */
+static int pair_acc_threads = 0;
+static int pair_sums;			/* nonzero if the forces of some pairs are evaluated once (see pair_contact()) */
+
+void update_verlet(const FLOAT * pos)
+/* decides whether the Verlet list has to be rebuilt (and if so, sorts the spheres into the grid). This is called by one thread. */
+{
+	int i;
+	FLOAT mp[3];
+
+	verlet_rebuild = verlet_n != n || verlet_half != (neighbour_search == 3);
+	for(i=0; i<n && !verlet_rebuild; i++) {
+		vmov(mp, VEC(pos,i));
+		vsub(mp, VEC(verlet_pos,i));
+		verlet_rebuild = 4*dot(mp,mp) > verlet_skin*verlet_skin;
+	}
+	if(verlet_rebuild) build_grid(pos);
+}
+
+static void alloc_pair_acc(const FLOAT * pos, int threads)
+/*
+allocates the buffers of the forces of the pairs evaluated once (see pair_acc) for 'threads' threads. This is called
+by one thread after the spheres have been sorted into the grid. If the memory is insufficient, the neighbour search
+falls back to the hierarchical grid, or to all pairs if the grid has more levels with spheres.
+*/
+{
+	if(pair_acc_threads >= threads) return;
+	free(pair_acc);
+	pair_acc = (FLOAT *)malloc(6*threads*(size_t)n_capacity*sizeof(FLOAT));
+	pair_acc_threads = pair_acc == NULL ? 0 : threads;
+	if(pair_acc == NULL) {
+		printf("Warning: Not enough memory for the symmetric forces, using %s.\n", grid_cross ? "all pairs" : "the grid");
+		if(neighbour_search >= 2 && !verlet_rebuild) build_grid(pos);
+		neighbour_search = !grid_cross;
+		pair_sums = 0;
+	}
+}
+
+static void alloc_verlet(const FLOAT * pos)
+/*
+finishes the rebuild of the Verlet list after the numbers of the neighbours have been stored in verlet_start[i+1]:
+makes verlet_start the start indices and enlarges verlet_list if needed. This is called by one thread.
+*/
+{
+	int i;
+
+	verlet_start[0] = 0;
+	for(i=0;i<n;i++) verlet_start[i+1] += verlet_start[i];
+	if(verlet_start[n] > verlet_capacity) {
+		free(verlet_list);
+		/* leave some room for the list to grow */
+		verlet_capacity = verlet_start[n] + verlet_start[n]/4;
+		verlet_list = (int *)malloc(verlet_capacity*sizeof(int));
+		if(verlet_list == NULL) {
+			printf("Warning: Not enough memory for the Verlet list, using the grid.\n");
+			verlet_capacity = 0;
+			verlet_n = -1;
+			neighbour_search = 1;
+			pair_sums = grid_cross;
+			return;
+		}
+	}
+	memcpy(verlet_pos, pos, 3*n*sizeof(FLOAT));
+	verlet_n = n;
+	verlet_half = neighbour_search == 3;
+}
+
+static inline void wall_contact(const FLOAT * y, int i, const FLOAT * wn, FLOAT distance, FLOAT * acc_i, FLOAT * angacc_i)
+/*
+adds the acceleration and the angular acceleration of the i-th sphere induced by a wall whose unit normal wn points
+from the center of the sphere to the point of contact, 'distance' being the distance between the surfaces
+*/
+{
+	FLOAT mv_tangent[3], sv[3], torque[3];
+	FLOAT heading, CF, mv_tangent_magnitude, FF, scale;
+	const FLOAT * vel = y + 3*n;
+	const FLOAT * angvel = y + 6*n;
+
+	// ignore the walls that are too far away
+	scale = contact_scale(i,-1);
+	if(distance > max_surf_dist*scale) return;
+	CF = scale*scale*collision_factor(distance/scale) / mass[i];
+	// velocity toward (!) the wall
+	heading = dot(VEC(vel,i),wn);
+	// tangential mutual velocity of the particle w.r.t. the wall surface
+	vmov(mv_tangent, VEC(vel,i));
+	vmadd(mv_tangent, -heading, wn);
+	// account for surface velocity of rotation of i-th sphere
+	// note that here wn points in the SAME direction than \vec{r}
+	cross(sv, VEC(angvel,i), wn);
+	vmadd(mv_tangent, radius[i], sv);
+	// normalize tangential velocity
+	mv_tangent_magnitude = norm(mv_tangent) + ZERO;
+	vmult(mv_tangent, 1.0/mv_tangent_magnitude);
+	// apply repulsive force
+	vmadd(acc_i, - CF * rebound(heading), wn);
+	// calculate magnitude of the frictional force
+	FF = CF * friction * friction_factor(mv_tangent_magnitude);
+	// apply linear impulse of the frictional force (in the direction opposite to mv_tangent!)
+	vmadd(acc_i, -FF, mv_tangent);
+	// apply angular impulse of the frictional force
+	cross(torque, wn, mv_tangent);
+	vmadd(angacc_i, -radius[i]*FF/unit_inertia(radius[i]), torque);	// here, the minus sign must compensate the orientation of mv_tangent
+}
+
+/* -------------------------------------------------------------- */
+
+/*
+container mesh (see mesh_filename). The triangles share the vertices (the coincident vertices of the file are
+welded), so that the edges and the vertices can be identified. The triangles are binned into a static grid
+of cubic cells: each triangle is listed in all cells overlapping its bounding box enlarged by the reach of the
+largest sphere, so a sphere only tests the triangles listed in the cell of its center.
+*/
+
+static int mesh_vertices = 0, mesh_triangles = 0;
+static FLOAT * mesh_vertex;			/* the vertex coordinates (3 per vertex) */
+static int * mesh_triangle;			/* the vertex indices of the triangles (3 per triangle) */
+static FLOAT mesh_origin[3], mesh_cell;		/* the lower corner and the cell size of the triangle index */
+static int mesh_dims[3];			/* the number of cells in each direction */
+static int * mesh_cell_start;			/* the start of each cell in mesh_cell_list (one more entry than cells) */
+static int * mesh_cell_list;			/* the triangle indices listed in the cells */
+
+/* the mesh features touched by a sphere (see mesh_contacts()) */
+typedef enum { MESH_FACE, MESH_EDGE, MESH_VERTEX } MESH_FEATURE;
+
+typedef struct {
+	MESH_FEATURE type;
+	int tri;		/* the triangle */
+	int v[2];		/* the vertex (v[0]) or the edge (v[0]<v[1]) */
+	FLOAT n[3];		/* the unit vector from the center of the sphere to the point of contact */
+	FLOAT distance;		/* the distance between the surfaces */
+} MESH_CONTACT;
+
+/* the maximum number of mesh contacts of one sphere (only the closest ones are kept) */
+#define MESH_MAX_CONTACTS 32
+
+static int closest_point_triangle(const FLOAT * p, const FLOAT * a, const FLOAT * b, const FLOAT * c, FLOAT * q)
+/*
+finds the point q of the triangle abc closest to p (C. Ericson, Real-Time Collision Detection, 5.1.5). Returns
+the feature of the triangle containing q: 0 = face, 1,2,3 = vertex a,b,c, 4,5,6 = edge ab,bc,ca.
+*/
+{
+	FLOAT ab[3], ac[3], bc[3], ap[3], bp[3], cp[3];
+	FLOAT d1, d2, d3, d4, d5, d6, va, vb, vc, v, w, denom;
+
+	vmov(ab,b); vsub(ab,a);
+	vmov(ac,c); vsub(ac,a);
+	vmov(ap,p); vsub(ap,a);
+	d1 = dot(ab,ap); d2 = dot(ac,ap);
+	if(d1 <= 0 && d2 <= 0) { vmov(q,a); return(1); }
+
+	vmov(bp,p); vsub(bp,b);
+	d3 = dot(ab,bp); d4 = dot(ac,bp);
+	if(d3 >= 0 && d4 <= d3) { vmov(q,b); return(2); }
+
+	vc = d1*d4 - d3*d2;
+	if(vc <= 0 && d1 >= 0 && d3 <= 0) {
+		vmov(q,a); vmadd(q, d1/(d1-d3), ab);
+		return(4);
+	}
+
+	vmov(cp,p); vsub(cp,c);
+	d5 = dot(ab,cp); d6 = dot(ac,cp);
+	if(d6 >= 0 && d5 <= d6) { vmov(q,c); return(3); }
+
+	vb = d5*d2 - d1*d6;
+	if(vb <= 0 && d2 >= 0 && d6 <= 0) {
+		vmov(q,a); vmadd(q, d2/(d2-d6), ac);
+		return(6);
+	}
+
+	va = d3*d6 - d5*d4;
+	if(va <= 0 && (d4-d3) >= 0 && (d5-d6) >= 0) {
+		vmov(bc,c); vsub(bc,b);
+		vmov(q,b); vmadd(q, (d4-d3)/((d4-d3)+(d5-d6)), bc);
+		return(5);
+	}
+
+	denom = 1.0 / (va+vb+vc);
+	v = vb*denom;
+	w = vc*denom;
+	vmov(q,a); vmadd(q,v,ab); vmadd(q,w,ac);
+	return(0);
+}
+
+static inline int mesh_has_vertex(int tri, int v)
+/* nonzero if the triangle tri has the vertex v */
+{
+	const int * t = mesh_triangle + 3*tri;
+	return( t[0]==v || t[1]==v || t[2]==v );
+}
+
+static int mesh_superseded(const MESH_CONTACT * c, const MESH_CONTACT * contact, int count)
+/*
+nonzero if the contact c with an edge or a vertex is represented by a closer contact (or by an equally close one
+found earlier) with a triangle sharing a vertex with the feature. This removes the contacts with the edges and
+the vertices of the triangles neighbouring the one that the sphere actually touches (within the interaction
+distance, a sphere on a flat or convex part of the mesh sees many of them) and the copies of the same edge or
+vertex found in several triangles. The contacts with the faces are always kept, so a sphere in a concave corner
+touches all the faces forming the corner.
+*/
+{
+	int k;
+	const MESH_CONTACT * d;
+
+	for(k=0;k<count;k++) {
+		d = contact + k;
+		if(d == c || d->distance > c->distance || (d->distance == c->distance && d > c)) continue;
+		if(mesh_has_vertex(d->tri, c->v[0]) || (c->type == MESH_EDGE && mesh_has_vertex(d->tri, c->v[1]))) return(1);
+	}
+	return(0);
+}
+
+static void mesh_contacts(const FLOAT * y, int i, FLOAT * acc_i, FLOAT * angacc_i)
+/* adds the accelerations of the i-th sphere induced by the triangles of the container mesh */
+{
+	static const int edge_vertex[3][2] = { {0,1}, {1,2}, {2,0} };
+	MESH_CONTACT contact[MESH_MAX_CONTACTS+1], * c;
+	int count = 0, k, p, cell, feature;
+	const int * t;
+	const FLOAT * x = VEC(y,i);
+	FLOAT q[3], distance;
+
+	for(k=0,cell=0;k<3;k++) {
+		p = (int)floorF((x[k]-mesh_origin[k])/mesh_cell);
+		if(p < 0 || p >= mesh_dims[k]) return;
+		cell = cell*mesh_dims[k] + p;
+	}
+
+	for(p=mesh_cell_start[cell]; p<mesh_cell_start[cell+1]; p++) {
+		t = mesh_triangle + 3*mesh_cell_list[p];
+		feature = closest_point_triangle(x, VEC(mesh_vertex,t[0]), VEC(mesh_vertex,t[1]), VEC(mesh_vertex,t[2]), q);
+		c = contact + count;
+		/* the unit vector to the point of contact (undefined if the center lies on the triangle) */
+		vmov(c->n, q);
+		vsub(c->n, x);
+		distance = norm(c->n) + ZERO;
+		c->distance = distance - radius[i];
+		if(c->distance > max_surf_dist*contact_scale(i,-1)) continue;
+		vmult(c->n, 1.0/distance);
+		c->tri = mesh_cell_list[p];
+		if(feature == 0) c->type = MESH_FACE;
+		else if(feature <= 3) {
+			c->type = MESH_VERTEX;
+			c->v[0] = t[feature-1];
+		} else {
+			c->type = MESH_EDGE;
+			c->v[0] = t[edge_vertex[feature-4][0]];
+			c->v[1] = t[edge_vertex[feature-4][1]];
+			if(c->v[0] > c->v[1]) { k = c->v[0]; c->v[0] = c->v[1]; c->v[1] = k; }
+		}
+		/* when the list is full, the new contact (in the spare entry) replaces the farthest one */
+		if(count < MESH_MAX_CONTACTS) count++;
+		else {
+			for(feature=0,k=1;k<count;k++) if(contact[k].distance > contact[feature].distance) feature = k;
+			if(c->distance < contact[feature].distance) contact[feature] = *c;
+		}
+	}
+
+	for(k=0;k<count;k++) {
+		c = contact + k;
+		if(c->type != MESH_FACE && mesh_superseded(c, contact, count)) continue;
+		wall_contact(y, i, c->n, c->distance, acc_i, angacc_i);
+	}
+}
+
+static int compare_vertices(const void * a, const void * b)
+/* lexicographic order of the vertices given by their indices to mesh_vertex */
+{
+	const FLOAT * u = VEC(mesh_vertex, *(const int *)a), * v = VEC(mesh_vertex, *(const int *)b);
+	int k;
+
+	for(k=0;k<3;k++) {
+		if(u[k] < v[k]) return(-1);
+		if(u[k] > v[k]) return(1);
+	}
+	return(0);
+}
+
+static int add_mesh_triangle(const FLOAT * a, const FLOAT * b, const FLOAT * c, int * capacity)
+/* appends the triangle abc (transformed by mesh_scale and mesh_offset) with its own vertices. Returns nonzero on error. */
+{
+	const FLOAT * v[3] = { a, b, c };
+	FLOAT * tmp;
+	int k, d;
+
+	if(mesh_triangles >= *capacity) {
+		*capacity = *capacity ? 2 * *capacity : 1024;
+		tmp = (FLOAT *)realloc(mesh_vertex, 9 * *capacity * sizeof(FLOAT));
+		if(tmp == NULL) return(1);
+		mesh_vertex = tmp;
+	}
+	for(k=0;k<3;k++)
+		for(d=0;d<3;d++) VEC(mesh_vertex, 3*mesh_triangles+k)[d] = mesh_scale*v[k][d] + mesh_offset[d];
+	mesh_triangles++;
+	return(0);
+}
+
+static int read_stl(FILE * f, int * capacity)
+/* reads the triangles of a binary or an ASCII STL file. Returns nonzero on error. */
+{
+	char header[80], word[256];
+	uint32_t count, q;
+	float facet[12];
+	unsigned short attribute;
+	FLOAT v[3][3];
+	long size;
+	int k, d;
+
+	/* a binary file has exactly the size given by the triangle count (it may also begin with "solid") */
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	rewind(f);
+	if(fread(header, 1, 80, f) == 80 && fread(&count, sizeof(uint32_t), 1, f) == 1 && size == 84 + 50*(long)count) {
+		for(q=0;q<count;q++) {
+			if(fread(facet, sizeof(float), 12, f) < 12 || fread(&attribute, 2, 1, f) < 1) return(1);
+			for(k=0;k<3;k++) for(d=0;d<3;d++) v[k][d] = facet[3+3*k+d];
+			if(add_mesh_triangle(v[0], v[1], v[2], capacity)) return(1);
+		}
+		return(0);
+	}
+
+	/* ASCII: only the "vertex x y z" lines matter, three per facet */
+	rewind(f);
+	k = 0;
+	while(fscanf(f, "%255s", word) == 1) {
+		if(strcmp(word, "vertex")) continue;
+		if(fscanf(f, "%" iFTC_g " %" iFTC_g " %" iFTC_g, v[k], v[k]+1, v[k]+2) < 3) return(1);
+		if(++k == 3) {
+			if(add_mesh_triangle(v[0], v[1], v[2], capacity)) return(1);
+			k = 0;
+		}
+	}
+	return(k != 0);
+}
+
+static int read_obj(FILE * f, int * capacity)
+/* reads the faces of a Wavefront OBJ file (the polygons are split into triangle fans). Returns nonzero on error. */
+{
+	char line[4096], * c, * end;
+	FLOAT * v = NULL, * tmp;
+	int count = 0, allocated = 0, k, index[3], error = 0;
+	long l;
+
+	while(!error && fgets(line, sizeof(line), f) != NULL) {
+		if(line[0] == 'v' && line[1] == ' ') {
+			if(count >= allocated) {
+				allocated = allocated ? 2*allocated : 1024;
+				tmp = (FLOAT *)realloc(v, 3*allocated*sizeof(FLOAT));
+				if(tmp == NULL) { error = 1; break; }
+				v = tmp;
+			}
+			if(sscanf(line+2, "%" iFTC_g " %" iFTC_g " %" iFTC_g, VEC(v,count), VEC(v,count)+1, VEC(v,count)+2) < 3) error = 1;
+			count++;
+		} else if(line[0] == 'f' && line[1] == ' ') {
+			/* the vertex indices start from 1, negative ones count from the last vertex (the texture and normal indices after '/' are skipped) */
+			for(c=line+2,k=0; !error; k++) {
+				l = strtol(c, &end, 10);
+				if(end == c) break;
+				for(c=end; *c && *c!=' ' && *c!='\t'; c++);
+				l = l < 0 ? count+l : l-1;
+				if(l < 0 || l >= count) { error = 1; break; }
+				index[k<2 ? k : 2] = (int)l;
+				if(k >= 2) {
+					error = add_mesh_triangle(VEC(v,index[0]), VEC(v,index[1]), VEC(v,index[2]), capacity);
+					index[1] = index[2];
+				}
+			}
+			if(k < 3) error = 1;
+		}
+	}
+	free(v);
+	return(error);
+}
+
+int load_mesh()
+/*
+loads the container mesh from mesh_filename (Wavefront OBJ if the name ends with ".obj", otherwise STL), welds the
+coincident vertices and builds the triangle index for spheres not larger than max_radius. Returns nonzero on error.
+*/
+{
+	FILE * f;
+	int capacity = 0, error, i, j, k, d, lo[3], hi[3], cx, cy, cz, cells, * order, * weld;
+	size_t len = strlen(mesh_filename);
+	FLOAT lower[3], upper[3], range, a[3], b[3], nrm[3], * welded;
+
+	if((f = fopen(mesh_filename, "rb")) == NULL) return(1);
+	if(len > 4 && !strcmp(mesh_filename+len-4, ".obj")) error = read_obj(f, &capacity);
+	else error = read_stl(f, &capacity);
+	fclose(f);
+	if(error || mesh_triangles == 0) return(1);
+
+	/* weld the vertices: sort them and give the equal ones the same index */
+	mesh_vertices = 3*mesh_triangles;
+	order = (int *)malloc(mesh_vertices*sizeof(int));
+	weld = (int *)malloc(mesh_vertices*sizeof(int));
+	welded = (FLOAT *)malloc(3*mesh_vertices*sizeof(FLOAT));
+	mesh_triangle = (int *)malloc(3*mesh_triangles*sizeof(int));
+	if(order == NULL || weld == NULL || welded == NULL || mesh_triangle == NULL) return(1);
+	for(i=0;i<mesh_vertices;i++) order[i] = i;
+	qsort(order, mesh_vertices, sizeof(int), compare_vertices);
+	for(i=0,j=-1;i<mesh_vertices;i++) {
+		if(j < 0 || compare_vertices(order+i, order+i-1)) {
+			j++;
+			vmov(VEC(welded,j), VEC(mesh_vertex,order[i]));
+		}
+		weld[order[i]] = j;
+	}
+	free(mesh_vertex);
+	mesh_vertex = welded;
+	mesh_vertices = j+1;
+
+	/* drop the degenerate triangles */
+	for(i=0,j=0;i<mesh_triangles;i++) {
+		for(k=0;k<3;k++) mesh_triangle[3*j+k] = weld[3*i+k];
+		vmov(a, VEC(mesh_vertex, mesh_triangle[3*j+1])); vsub(a, VEC(mesh_vertex, mesh_triangle[3*j]));
+		vmov(b, VEC(mesh_vertex, mesh_triangle[3*j+2])); vsub(b, VEC(mesh_vertex, mesh_triangle[3*j]));
+		cross(nrm, a, b);
+		if(norm(nrm) > ZERO*ZERO) j++;
+	}
+	mesh_triangles = j;
+	free(order);
+	free(weld);
+	if(mesh_triangles == 0) return(1);
+
+	/* the triangle index: the cell size is the diameter of the reach of the largest sphere */
+	range = reach(max_radius);
+	mesh_cell = 2*range;
+	for(d=0;d<3;d++) {
+		lower[d] = upper[d] = mesh_vertex[d];
+		for(i=1;i<mesh_vertices;i++) {
+			if(VEC(mesh_vertex,i)[d] < lower[d]) lower[d] = VEC(mesh_vertex,i)[d];
+			if(VEC(mesh_vertex,i)[d] > upper[d]) upper[d] = VEC(mesh_vertex,i)[d];
+		}
+	}
+	/* (limit the number of cells for very fine cells) */
+	while(((upper[0]-lower[0]+2*range)/mesh_cell+1) * ((upper[1]-lower[1]+2*range)/mesh_cell+1) * ((upper[2]-lower[2]+2*range)/mesh_cell+1) > 1e7)
+		mesh_cell *= 2;
+	for(cells=1,d=0;d<3;d++) {
+		mesh_origin[d] = lower[d] - range;
+		mesh_dims[d] = (int)floorF((upper[d]-lower[d]+2*range)/mesh_cell) + 1;
+		cells *= mesh_dims[d];
+	}
+	mesh_cell_start = (int *)calloc(cells+1, sizeof(int));
+	if(mesh_cell_start == NULL) return(1);
+
+	/* count the triangles in each cell first, then fill the lists */
+	for(k=0;k<2;k++) {
+		for(i=0;i<mesh_triangles;i++) {
+			for(d=0;d<3;d++) {
+				a[d] = b[d] = VEC(mesh_vertex, mesh_triangle[3*i])[d];
+				for(j=1;j<3;j++) {
+					if(VEC(mesh_vertex, mesh_triangle[3*i+j])[d] < a[d]) a[d] = VEC(mesh_vertex, mesh_triangle[3*i+j])[d];
+					if(VEC(mesh_vertex, mesh_triangle[3*i+j])[d] > b[d]) b[d] = VEC(mesh_vertex, mesh_triangle[3*i+j])[d];
+				}
+				lo[d] = (int)floorF((a[d]-range-mesh_origin[d])/mesh_cell);
+				hi[d] = (int)floorF((b[d]+range-mesh_origin[d])/mesh_cell);
+				if(lo[d] < 0) lo[d] = 0;
+				if(hi[d] >= mesh_dims[d]) hi[d] = mesh_dims[d]-1;
+			}
+			for(cx=lo[0];cx<=hi[0];cx++)
+			for(cy=lo[1];cy<=hi[1];cy++)
+			for(cz=lo[2];cz<=hi[2];cz++) {
+				j = (cx*mesh_dims[1] + cy)*mesh_dims[2] + cz;
+				if(k) mesh_cell_list[mesh_cell_start[j]++] = i;
+				else mesh_cell_start[j+1]++;
+			}
+		}
+		if(k) {
+			/* the starts have moved to the ends of the cells */
+			for(j=cells;j>0;j--) mesh_cell_start[j] = mesh_cell_start[j-1];
+			mesh_cell_start[0] = 0;
+		} else {
+			for(j=0;j<cells;j++) mesh_cell_start[j+1] += mesh_cell_start[j];
+			mesh_cell_list = (int *)malloc((mesh_cell_start[cells] > 0 ? mesh_cell_start[cells] : 1)*sizeof(int));
+			if(mesh_cell_list == NULL) return(1);
+		}
+	}
+	return(0);
+}
+
+/* -------------------------------------------------------------- */
+
 void rhs(FLOAT t,const FLOAT * y, FLOAT * dy_dt)
 /*
 the right hand side of the equation system
 */
 {
-	int i,j;
-	FLOAT mp[3], mv[3], mv_tangent[3], sv[3], torque[3];
-	FLOAT distance, heading, CF, mv_tangent_magnitude, FF;
+	int i,j,p;
+	FLOAT mp[3];
+	FLOAT * buf;
 	// human-understandable aliases for the portions of the arrays y and dy_dt
 	const FLOAT * pos = y;
 	const FLOAT * vel = y + 3*n;
-	const FLOAT * angvel = y + 6*n;
 	FLOAT * acc = dy_dt + 3*n;
 	FLOAT * angacc = dy_dt + 6*n;
 
+	#ifdef _OPENMP
+	 int thread = omp_get_thread_num(), threads = omp_get_num_threads();
+	#else
+	 int thread = 0, threads = 1;
+	#endif
+
+	// sort the particles into the grid (the other threads wait at the end of the single construct)
+	#pragma omp single
+	{
+		if(neighbour_search >= 2) update_verlet(pos);
+		else if(neighbour_search) build_grid(pos);
+		pair_sums = neighbour_search == 3 || (neighbour_search && grid_cross);
+		if(pair_sums) alloc_pair_acc(pos, threads);
+	}
+
+	// rebuild the Verlet list: count the neighbours, allocate the list and fill it in
+	if(neighbour_search >= 2 && verlet_rebuild) {
+		#pragma omp for
+		for(i=0;i<n;i++) verlet_start[i+1] = grid_neighbours(pos, i, verlet_skin, neighbour_search == 3, NULL);
+		#pragma omp single
+		alloc_verlet(pos);
+		if(neighbour_search >= 2) {
+			#pragma omp for
+			for(i=0;i<n;i++) grid_neighbours(pos, i, verlet_skin, neighbour_search == 3, verlet_list + verlet_start[i]);
+		}
+	}
+
+	// evaluate the forces of the pairs found once and add the accelerations of both spheres to the buffer of this thread
+	// (the pairs of spheres of different levels of the grid, or all listed pairs with neighbour_search = 3)
+	if(pair_sums) {
+		buf = pair_acc + 6*(size_t)n*thread;
+		memset(buf, 0, 6*n*sizeof(FLOAT));
+		#pragma omp for
+		for(i=0;i<n;i++)
+			switch(neighbour_search) {
+				case 1:
+					grid_contacts(y, i, NULL, NULL, buf);
+					break;
+				case 2:
+					for(p=verlet_start[i];p<verlet_start[i+1];p++)
+						if(grid_coord[4*verlet_list[p]] != grid_coord[4*i]) pair_contact(y, i, verlet_list[p], buf);
+					break;
+				default:
+					for(p=verlet_start[i];p<verlet_start[i+1];p++) pair_contact(y, i, verlet_list[p], buf);
+			}
+	}
+
 	// calculate acceleration of all particles
 	#pragma omp for
 	for(i=0;i<n;i++) {
 
+		// a sleeping particle does not move (see update_sleeping())
+		if(asleep[i]) {
+			vmov(VEC(dy_dt,i), zero_vector);
+			vmov(VEC(acc,i), zero_vector);
+			vmov(VEC(angacc,i), zero_vector);
+			continue;
+		}
+
 		// derivative of position is velocity
 		vmov(VEC(dy_dt,i), VEC(vel,i));
 		
@@ -267,92 +1239,39 @@ the right hand side of the equation system
 		// initialize angular acceleration to zero
 		vmov(VEC(angacc,i), zero_vector);
 
-		// repulsive & frictional forces between all particle pairs
-		for(j=0;j<n;j++) {
-			if(i==j) continue;
-			// mutual position (i-th w.r.t. j-th particle)
-			vmov(mp, VEC(pos,i));
-			vsub(mp, VEC(pos,j));
-			distance = norm(mp) + ZERO;
-			// normalize mutual position for further use
-			vmult(mp, 1.0/distance);
-			// calculate the distance between surfaces
-			distance -= 2*r;
-			// ignore spheres that are too far away
-			if(distance > max_surf_dist) continue;
-			CF = collision_factor(distance);
-			// mutual velocity (of i-th particle w.r.t. j-th particle)
-			vmov(mv, VEC(vel,i));
-			vsub(mv, VEC(vel,j));
-			// derivative of mutual distance w.r.t. time (or projection of mv into the direction mp)
-			// (shows if the particles are moving toward or away from each other)
-			heading = dot(mv,mp);
-			// tangential mutual velocity (of the center of the i-th particle w.r.t. j-th particle)
-			vmov(mv_tangent, mv);
-			vmadd(mv_tangent, -heading, mp);
-			
-			/*
-			Note: as long as r is the same for all spheres, one could simplify this to first sum
-			both angular velocities and then perform the vector product.
-			*/
-			// account for surface velocity of rotation of i-th sphere v_tangent = \vec{omega} \times \vec{r}
-			// note that mp points in the OPPOSITE direction than \vec{r}, which is the vector from particle center to the point of contact at the surface
-			cross(sv, VEC(angvel,i), mp);
-			vmadd(mv_tangent, -r, sv);
-			// account for surface velocity of rotation of j-th sphere
-			cross(sv, VEC(angvel,j), mp);
-			vmadd(mv_tangent, -r, sv);
-
-			// normalize tangential velocity
-			mv_tangent_magnitude = norm(mv_tangent) + ZERO;
-			vmult(mv_tangent, 1.0/mv_tangent_magnitude);
-			// add the acceleration of the i-th particle induced by the j-th particle:
-			// 1) repulsive force
-			vmadd(VEC(acc,i), CF * rebound(-heading), mp);
-			// 2) frictional force: calculate the magnitude
-			FF = CF * friction * friction_factor(mv_tangent_magnitude);
-			// ... apply linear impulse (in the direction opposite to mv_tangent!)
-			vmadd(VEC(acc,i), -FF , mv_tangent);
-			// ... apply angular impulse
-			// the formula for torque is \tau = \vec{r} \times \vec{F}, but we need to postpone the multiplications by scalars to the next line
-			// Note that mv_tangent points in the opposite direction than the tangential force, but so does mp with respect to \vec{r},
-			// so the below cross product calculates the torque with the correct orientation.
-			cross(torque, mp, mv_tangent);
-			vmadd(VEC(angacc,i), r*FF/I, torque);
+		// repulsive & frictional forces between the particle pairs
+		switch(neighbour_search) {
+			case 0:
+				for(j=0;j<n;j++) if(j!=i) sphere_contact(y, i, j, VEC(acc,i), VEC(angacc,i));
+				break;
+			case 1:
+				grid_contacts(y, i, VEC(acc,i), VEC(angacc,i), NULL);
+				break;
+			case 2:
+				// the pairs of spheres of the same level of the grid (the others are evaluated once above)
+				for(p=verlet_start[i];p<verlet_start[i+1];p++)
+					if(grid_coord[4*verlet_list[p]] == grid_coord[4*i]) sphere_contact(y, i, verlet_list[p], VEC(acc,i), VEC(angacc,i));
 		}
+		// sum the buffers of all threads
+		if(pair_sums)
+			for(p=0;p<threads;p++) {
+				buf = pair_acc + 6*(size_t)n*p;
+				vadd(VEC(acc,i), VEC(buf,2*i));
+				vadd(VEC(angacc,i), VEC(buf,2*i+1));
+			}
 		
 		// repulsive & frictional forces at the walls
 		for(j=0;j<num_walls;j++) {
+			if(wall_ignored[j]) continue;
 			// position w.r.t. the wall reference point
 			vmov(mp,VEC(pos,i));
 			vsub(mp,wall[j].P);
 			// calculate the distance between surfaces
-			distance = - dot(mp,wall[j].n) - r;
-			// ignore the walls that are too far away
-			if(distance > max_surf_dist) continue;
-			CF = collision_factor(distance);
-			// velocity toward (!) the wall
-			heading = dot(VEC(vel,i),wall[j].n);
-			// tangential mutual velocity of the particle w.r.t. the wall surface
-			vmov(mv_tangent, VEC(vel,i));
-			vmadd(mv_tangent, -heading, wall[j].n);
-			// account for surface velocity of rotation of i-th sphere
-			// note that here wall[j].n points in the SAME direction than \vec{r}
-			cross(sv, VEC(angvel,i), wall[j].n);
-			vmadd(mv_tangent, r, sv);
-			// normalize tangential velocity
-			mv_tangent_magnitude = norm(mv_tangent) + ZERO;
-			vmult(mv_tangent, 1.0/mv_tangent_magnitude);
-			// apply repulsive force
-			vmadd(VEC(acc,i), - CF * rebound(heading), wall[j].n);
-			// calculate magnitude of the frictional force
-			FF = CF * friction * friction_factor(mv_tangent_magnitude);
-			// apply linear impulse of the frictional force (in the direction opposite to mv_tangent!)
-			vmadd(VEC(acc,i), -FF, mv_tangent);
-			// apply angular impulse of the frictional force
-			cross(torque, wall[j].n, mv_tangent);
-			vmadd(VEC(angacc,i), -r*FF/I, torque);	// here, the minus sign must compensate the orientation of mv_tangent
+			wall_contact(y, i, wall[j].n, - dot(mp,wall[j].n) - radius[i], VEC(acc,i), VEC(angacc,i));
 		}
+
+		// ... and at the container mesh
+		if(mesh_triangles > 0) mesh_contacts(y, i, VEC(acc,i), VEC(angacc,i));
 	}
 }
 
@@ -372,13 +1291,236 @@ int save_snapshot(int snap, FLOAT *y, FLOAT * color)
 	f = fopen(filename,"w");
 	if(f == NULL) return(-1);
 	// output header
-	fprintf(f,"x,y,z,vx,vy,vz,avx,avy,avz,color\n");
-	// output particle positions & (scalar) particle color
+	fprintf(f,"x,y,z,vx,vy,vz,avx,avy,avz,color,r\n");
+	// output particle positions & (scalar) particle color & radius
 	for(i=0;i<n;i++)
-		fprintf(f,"%f,%f,%f,%f,%f,%f,%f,%f,%f,%f\n", VEC(pos,i)[0], VEC(pos,i)[1], VEC(pos,i)[2], VEC(vel,i)[0], VEC(vel,i)[1], VEC(vel,i)[2], VEC(angvel,i)[0], VEC(angvel,i)[1], VEC(angvel,i)[2], color[i]);
+		fprintf(f,"%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f\n", VEC(pos,i)[0], VEC(pos,i)[1], VEC(pos,i)[2], VEC(vel,i)[0], VEC(vel,i)[1], VEC(vel,i)[2], VEC(angvel,i)[0], VEC(angvel,i)[1], VEC(angvel,i)[2], color[i], radius[i]);
 	fclose(f);
 }
 
+int save_positions(const FLOAT * y)
+/*
+saves the positions and the radii of the spheres to positions_filename in the format read by Intertrack
+("x y z r" on each line). Returns nonzero on error.
+*/
+{
+	FILE * f;
+	int i;
+
+	if((f = fopen(positions_filename,"w")) == NULL) return(1);
+	for(i=0;i<n;i++)
+		fprintf(f,"%.15g\t%.15g\t%.15g\t%.15g\n", VEC(y,i)[0], VEC(y,i)[1], VEC(y,i)[2], radius[i]);
+	return(fclose(f) ? 1 : 0);
+}
+
+/*
+binary checkpoint layout (in the byte order of the machine):
+	char	magic[8]	"SPHCHK3"
+	int32	sizeof(FLOAT)
+	int32	n
+	int32	snap		the index of the last snapshot saved (the loop variable in main())
+	int32	inserted	the number of spheres poured so far
+	double	t, h		the time level and the current time step of the RK solver
+	double	next_insertion, next_sleep_check
+	uint64	rng_state
+	FLOAT	y[9*n]		positions, velocities, angular velocities
+	FLOAT	color[n]
+	FLOAT	radius[n]
+	FLOAT	quiet_time[n]
+	char	asleep[n]
+*/
+static const char checkpoint_magic[8] = "SPHCHK3";
+
+/* the state loaded from a checkpoint by icond_file() (start_snap is -1 for a new simulation) */
+static int start_snap = -1;
+static FLOAT start_t = 0, start_ht = 0;
+
+static int icond_error = 0;		/* nonzero if icond_file() fails */
+
+int save_checkpoint(int snap, FLOAT t, FLOAT h, const FLOAT * y, const FLOAT * color)
+/*
+saves the full state of the simulation to the checkpoint with the number of the snapshot snap+1. The file is
+written under a temporary name first, so that an interrupted job never leaves a truncated checkpoint.
+Returns nonzero on error.
+*/
+{
+	FILE * f;
+	char filename[1024], tmp_filename[1040];
+	int32_t header[4] = { sizeof(FLOAT), n, snap, inserted };
+	double time_level[4] = { t, h, next_insertion, next_sleep_check };
+	int error;
+
+	sprintf(filename, checkpoint_format, filename_base, snap+1);
+	sprintf(tmp_filename, "%s.tmp", filename);
+	if((f = fopen(tmp_filename, "wb")) == NULL) return(1);
+	fwrite(checkpoint_magic, 1, sizeof(checkpoint_magic), f);
+	fwrite(header, sizeof(int32_t), 4, f);
+	fwrite(time_level, sizeof(double), 4, f);
+	fwrite(&rng_state, sizeof(uint64_t), 1, f);
+	fwrite(y, sizeof(FLOAT), 9*n, f);
+	fwrite(color, sizeof(FLOAT), n, f);
+	fwrite(radius, sizeof(FLOAT), n, f);
+	fwrite(quiet_time, sizeof(FLOAT), n, f);
+	fwrite(asleep, 1, n, f);
+	error = ferror(f);
+	if(fclose(f) || error) { remove(tmp_filename); return(1); }
+	return(rename(tmp_filename, filename) ? 1 : 0);
+}
+
+void wrap_periodic(FLOAT * y)
+/* moves the particles that have left the vessel base through a periodic boundary to the opposite side */
+{
+	int i;
+	FLOAT * pos = y;
+
+	for(i=0;i<n;i++) {
+		if(periodic_x) VEC(pos,i)[0] -= R*floorF(VEC(pos,i)[0]/R);
+		if(periodic_y) VEC(pos,i)[1] -= R*floorF(VEC(pos,i)[1]/R);
+	}
+}
+
+void insert_spheres(FLOAT * y, FLOAT * color)
+/*
+adds the next batch of spheres (see insert_count). The velocities and the angular velocities of the spheres
+already present are moved to make room for the new ones in the state vector.
+*/
+{
+	int count = insert_count - inserted < insert_batch ? insert_count - inserted : insert_batch;
+	int balls_per_row = floor(R/(2.5*r));
+	FLOAT distance = R/balls_per_row;
+	FLOAT z_base = h0 - 0.5*distance;
+	int i, k;
+
+	/* start above the highest sphere */
+	for(i=0;i<n;i++) if(VEC(y,i)[2] + distance > z_base) z_base = VEC(y,i)[2] + distance;
+
+	/* the arrays of positions, velocities and angular velocities grow from 3*n to 3*(n+count) each */
+	memmove(y + 6*(n+count), y + 6*n, 3*n*sizeof(FLOAT));
+	memmove(y + 3*(n+count), y + 3*n, 3*n*sizeof(FLOAT));
+	n += count;
+
+	FLOAT * pos = y;
+	FLOAT * vel = y + 3*n;
+	FLOAT * angvel = y + 6*n;
+
+	for(k=0;k<count;k++) {
+		i = n-count+k;
+		VEC(pos,i)[0] = (k%balls_per_row+0.5)*distance + 0.25*r*randF();
+		VEC(pos,i)[1] = ((k/balls_per_row)%balls_per_row+0.5)*distance + 0.25*r*randF();
+		VEC(pos,i)[2] = z_base + (k/(balls_per_row*balls_per_row)+0.5)*distance + 0.25*r*randF();
+
+		/* z coordinate used as color */
+		color[i] = VEC(pos,i)[2];
+		set_radius(i, random_radius());
+
+		vmov(VEC(vel,i), zero_vector);
+		vmov(VEC(angvel,i), zero_vector);
+		asleep[i] = 0;
+		quiet_time[i] = 0;
+	}
+	inserted += count;
+}
+
+void update_sleeping(FLOAT * y)
+/*
+puts the spheres that have been slow for sleep_time to sleep and wakes the sleeping spheres when an awake
+sphere faster than sleep_velocity comes within the interaction distance (see sleep_velocity). The pairs of
+spheres within this distance are found in the hierarchical grid.
+*/
+{
+	int i, j, k, count, capacity = 0;
+	int * list = NULL;
+	FLOAT mp[3];
+	FLOAT * pos = y;
+	FLOAT * vel = y + 3*n;
+	FLOAT * angvel = y + 6*n;
+
+	/* after this, quiet_time is zero exactly for the fast awake spheres */
+	for(i=0;i<n;i++) if(!asleep[i]) {
+		if(norm(VEC(vel,i)) < sleep_velocity && radius[i]*norm(VEC(angvel,i)) < sleep_velocity) quiet_time[i] += sleep_check_interval;
+		else quiet_time[i] = 0;
+	}
+
+	/*
+	mark the sleeping spheres to be woken by 2 (they still count as sleeping until all pairs are checked). Each pair
+	of spheres of different levels of the grid is found by one of the spheres only (see grid_neighbours()), so
+	both spheres of each pair are checked.
+	*/
+	for(i=0;i<n && !asleep[i];i++);
+	if(i<n) {
+		build_grid(pos);
+		for(i=0;i<n;i++) {
+			count = grid_neighbours(pos, i, 0, 0, NULL);
+			if(count > capacity) {
+				free(list);
+				capacity = 2*count;
+				list = (int *)malloc(capacity*sizeof(int));
+				if(list == NULL) {
+					printf("Warning: Not enough memory for the wake test, waking all spheres.\n");
+					for(j=0;j<n;j++) if(asleep[j]) asleep[j] = 2;
+					break;
+				}
+			}
+			grid_neighbours(pos, i, 0, 0, list);
+			for(k=0;k<count;k++) {
+				j = list[k];
+				/* one sphere of the pair has to be asleep and the other one awake and fast */
+				if(asleep[i] ? asleep[j] || quiet_time[j] > 0 : !asleep[j] || quiet_time[i] > 0) continue;
+				vmov(mp, VEC(pos,i));
+				vsub(mp, VEC(pos,j));
+				if(periodic_x) mp[0] -= R*floorF(mp[0]/R+0.5);
+				if(periodic_y) mp[1] -= R*floorF(mp[1]/R+0.5);
+				if(norm(mp) - radius[i] - radius[j] < max_surf_dist*contact_scale(i,j)) {
+					if(asleep[i]) asleep[i] = 2;
+					else asleep[j] = 2;
+				}
+			}
+		}
+		free(list);
+		for(i=0;i<n;i++) if(asleep[i] == 2) {
+			asleep[i] = 0;
+			quiet_time[i] = 0;
+		}
+	}
+
+	for(i=0;i<n;i++) if(!asleep[i] && quiet_time[i] >= sleep_time) {
+		asleep[i] = 1;
+		vmov(VEC(vel,i), zero_vector);
+		vmov(VEC(angvel,i), zero_vector);
+	}
+}
+
+int advance(FLOAT t, RK_MPI_S_SOLUTION * eqSystem, FLOAT * color)
+/*
+solves the system until t. The solution is interrupted to pour the next batch of spheres (the chunk of the
+state vector solved by the RK solver grows) and to update the sleeping states. Returns the return value of
+the last call to RK_MPI_SA_solve().
+*/
+{
+	FLOAT t_next;
+	int q;
+
+	do {
+		t_next = t;
+		if(inserted < insert_count && next_insertion < t_next) t_next = next_insertion;
+		if(sleep_velocity > 0 && next_sleep_check < t_next) t_next = next_sleep_check;
+
+		q = RK_MPI_SA_solve(t_next, eqSystem);
+
+		if(inserted < insert_count && eqSystem->t >= next_insertion) {
+			insert_spheres(eqSystem->x, color);
+			eqSystem->n->chunk_size[0] = 9*n;
+			next_insertion += insert_interval;
+		}
+		if(sleep_velocity > 0 && eqSystem->t >= next_sleep_check) {
+			update_sleeping(eqSystem->x);
+			next_sleep_check += sleep_check_interval;
+		}
+	} while(eqSystem->t < t);
+
+	return(q);
+}
+
 RK_RightHandSide m_rhs()
 /* right hand side meta pointer */
 {
@@ -389,10 +1531,51 @@ RK_RightHandSide m_rhs()
 
 /* versions of the initial conditions */
 
-void alloc_data(FLOAT **y_ptr, FLOAT **color_ptr)
+int alloc_data(FLOAT **y_ptr, FLOAT **color_ptr)
+/*
+allocates the arrays for the n spheres of the initial condition and for the spheres still to be poured.
+Returns nonzero if the memory is insufficient.
+*/
+{
+	n_capacity = n + insert_count - inserted;
+	*y_ptr = (FLOAT *)malloc(9*n_capacity*sizeof(FLOAT));
+	*color_ptr = (FLOAT *)malloc(n_capacity*sizeof(FLOAT));
+	radius = (FLOAT *)malloc(n_capacity*sizeof(FLOAT));
+	mass = (FLOAT *)malloc(n_capacity*sizeof(FLOAT));
+	asleep = (char *)calloc(n_capacity, sizeof(char));
+	quiet_time = (FLOAT *)calloc(n_capacity, sizeof(FLOAT));
+
+	/* the hash table of the grid has at least twice as many buckets as there are spheres */
+	for(grid_buckets=64; grid_buckets<2*(unsigned)n_capacity; grid_buckets*=2);
+	grid_start = (int *)malloc((grid_buckets+1)*sizeof(int));
+	grid_sorted = (int *)malloc(n_capacity*sizeof(int));
+	grid_coord = (int *)malloc(4*n_capacity*sizeof(int));
+	grid_bucket = (unsigned *)malloc(n_capacity*sizeof(unsigned));
+	verlet_start = (int *)malloc((n_capacity+1)*sizeof(int));
+	verlet_pos = (FLOAT *)malloc(3*n_capacity*sizeof(FLOAT));
+	verlet_n = -1;
+
+	return( *y_ptr == NULL || *color_ptr == NULL || radius == NULL || mass == NULL || asleep == NULL || quiet_time == NULL
+		|| grid_start == NULL || grid_sorted == NULL || grid_coord == NULL || grid_bucket == NULL
+		|| verlet_start == NULL || verlet_pos == NULL );
+}
+
+void free_data(FLOAT * y, FLOAT * color)
+/* frees the arrays allocated by alloc_data() and by the neighbour search */
+{
+	free(y); free(color);
+	free(radius); free(mass); free(asleep); free(quiet_time);
+	free(grid_start); free(grid_sorted); free(grid_coord); free(grid_bucket);
+	free(verlet_start); free(verlet_pos); free(verlet_list); free(pair_acc);
+	verlet_list = NULL; verlet_capacity = 0; verlet_n = -1;
+	pair_acc = NULL; pair_acc_threads = 0;
+}
+
+void icond_none(FLOAT **y_ptr, FLOAT **color_ptr)
+/* an empty vessel (the spheres are poured in, see insert_count) */
 {
-	*y_ptr = (FLOAT *)malloc(9*n*sizeof(FLOAT));
-	*color_ptr = (FLOAT *)malloc(n*sizeof(FLOAT));
+	n = 0;
+	alloc_data(y_ptr, color_ptr);
 }
 
 void icond_2spheres(FLOAT **y_ptr, FLOAT **color_ptr)
@@ -419,6 +1602,7 @@ void icond_2spheres(FLOAT **y_ptr, FLOAT **color_ptr)
 
 		/* z coordinate used as color */
 		color[i] = VEC(pos,i)[2];
+		set_radius(i, r);
 
 		vmov(VEC(vel,i), zero_vector);
 		vmov(VEC(angvel,i), zero_vector);
@@ -445,6 +1629,7 @@ void icond_sparse(FLOAT **y_ptr, FLOAT **color_ptr)
 
 		/* z coordinate used as color */
 		color[i] = VEC(pos,i)[2];
+		set_radius(i, random_radius());
 
 		vmov(VEC(vel,i), zero_vector);
 		vmov(VEC(angvel,i), zero_vector);
@@ -482,12 +1667,109 @@ void icond_dense(FLOAT **y_ptr, FLOAT **color_ptr)
 
 		/* z coordinate used as color */
 		color[i] = VEC(pos,i)[2];
+		set_radius(i, random_radius());
 
 		vmov(VEC(vel,i), zero_vector);
 		vmov(VEC(angvel,i), zero_vector);
 	}
 }
 
+static int load_checkpoint(FILE * f, FLOAT **y_ptr, FLOAT **color_ptr)
+/* reads the state from a checkpoint (after the magic string). Returns nonzero on error. */
+{
+	int32_t header[4];
+	double time_level[4];
+	int i;
+
+	if(fread(header, sizeof(int32_t), 4, f) < 4 || header[0] != sizeof(FLOAT) || header[1] < 0 || header[3] < 0) return(1);
+	if(fread(time_level, sizeof(double), 4, f) < 4 || fread(&rng_state, sizeof(uint64_t), 1, f) < 1) return(1);
+
+	n = header[1];
+	inserted = header[3] < insert_count ? header[3] : insert_count;
+	if(alloc_data(y_ptr, color_ptr)) return(1);
+	if(fread(*y_ptr, sizeof(FLOAT), 9*n, f) < (size_t)9*n || fread(*color_ptr, sizeof(FLOAT), n, f) < (size_t)n) return(1);
+	if(fread(radius, sizeof(FLOAT), n, f) < (size_t)n) return(1);
+	for(i=0;i<n;i++) set_radius(i, radius[i]);
+	if(fread(quiet_time, sizeof(FLOAT), n, f) < (size_t)n || fread(asleep, 1, n, f) < (size_t)n) return(1);
+
+	start_snap = header[2];
+	start_t = time_level[0];
+	start_ht = time_level[1];
+	next_insertion = time_level[2];
+	next_sleep_check = time_level[3];
+	return(0);
+}
+
+static int load_positions(FILE * f, FLOAT **y_ptr, FLOAT **color_ptr)
+/*
+reads the positions (and optionally the velocities, the angular velocities and the color) of the spheres from a text
+file with one sphere per line. The values may be separated by commas or white space, so that both the snapshots
+(x,y,z,vx,vy,vz,avx,avy,avz,color[,r]) and the positions files of Intertrack (x y z [r]) can be read. Lines with less
+than three numbers (e.g. the header) are skipped. The color defaults to the z coordinate and the radius to r.
+Returns nonzero on error.
+*/
+{
+	char line[1024], * c;
+	double v[11], rad;
+	int i, k, count = 0;
+
+	/* count the spheres first */
+	while(fgets(line, sizeof(line), f) != NULL) {
+		for(c=line;*c;c++) if(*c==',') *c=' ';
+		if(sscanf(line, "%lf %lf %lf", v, v+1, v+2) == 3) count++;
+	}
+	if(count == 0) return(1);
+	rewind(f);
+
+	n = count;
+	if(alloc_data(y_ptr, color_ptr)) return(1);
+
+	FLOAT * pos = *y_ptr;
+	FLOAT * vel = pos + 3*n;
+	FLOAT * angvel = vel + 3*n;
+	FLOAT * color = *color_ptr;
+
+	for(i=0;i<n && fgets(line, sizeof(line), f) != NULL;) {
+		for(c=line;*c;c++) if(*c==',') *c=' ';
+		k = sscanf(line, "%lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf", v, v+1, v+2, v+3, v+4, v+5, v+6, v+7, v+8, v+9, v+10);
+		if(k < 3) continue;
+		/* the radius is the 4th number of a positions file or the 11th number of a snapshot */
+		rad = r;
+		if(k == 4) { rad = v[3]; k = 3; }
+		else if(k == 11) rad = v[10];
+		if(rad <= 0) return(1);
+		for(;k<9;k++) v[k] = 0;
+		if(k < 10) v[9] = v[2];
+
+		for(k=0;k<3;k++) {
+			VEC(pos,i)[k] = v[k];
+			VEC(vel,i)[k] = v[3+k];
+			VEC(angvel,i)[k] = v[6+k];
+		}
+		set_radius(i, rad);
+		color[i++] = v[9];
+	}
+	return(0);
+}
+
+void icond_file(FLOAT **y_ptr, FLOAT **color_ptr)
+/* loads the initial state from icond_filename: a checkpoint (recognized by the magic string) or a positions file */
+{
+	FILE * f;
+	char magic[sizeof(checkpoint_magic)];
+
+	*y_ptr = *color_ptr = NULL;
+	if((f = fopen(icond_filename, "rb")) == NULL) { icond_error = 1; return; }
+
+	if(fread(magic, 1, sizeof(magic), f) == sizeof(magic) && !memcmp(magic, checkpoint_magic, sizeof(magic)))
+		icond_error = load_checkpoint(f, y_ptr, color_ptr) ? 2 : 0;
+	else {
+		rewind(f);
+		icond_error = load_positions(f, y_ptr, color_ptr) ? 3 : 0;
+	}
+	fclose(f);
+}
+
 /* -------------------------------------------------------------- */
 
 	
@@ -531,14 +1813,38 @@ int main(int argc, char *argv[])
 	multiplication by this big prime number should avoid accidental match of the calculated values.
 
 	*/
-	srand(time(NULL)+101009*MPIrank);
+	seed_randF(time(NULL)+101009*MPIrank);
 	
 	
 	FLOAT * y;		/* the solution - allocated from within icond() */
 	FLOAT * color;	/* a constant scalar value to be mapped to the color of each of the spheres */
 	
+	/* the initial state file can be given on the command line */
+	if(argc > 1) icond_filename = argv[1];
+	if(icond_filename != NULL) icond = icond_file;
+
 	if(MPIrank==0) printf("Initializing...\n");
 	icond(&y, &color);
+	{
+		char * Icond_errors[]= { "Can not open the initial state file.", "Invalid checkpoint file.", "Invalid positions file." };
+		CheckErrorAcrossRanks(icond_error, 1, Icond_errors);
+	}
+	init_grid();
+	if(mesh_filename != NULL) {
+		char * Mesh_errors[]= { "Can not read the container mesh file." };
+		CheckErrorAcrossRanks(load_mesh() ? 1 : 0, 1, Mesh_errors);
+		if(MPIrank==0) printf("Loaded %d triangles of the container mesh from %s.\n", mesh_triangles, mesh_filename);
+	}
+	/* the first batch of spheres is poured at t=0 */
+	if(insert_count > 0 && start_snap < 0) {
+		insert_spheres(y, color);
+		next_insertion = insert_interval;
+	}
+
+	if(MPIrank==0 && start_snap >= 0)
+		printf("Continuing from the checkpoint at t=%f (snapshot %d), %d spheres.\n", start_t, start_snap+1, n);
+	else if(MPIrank==0 && icond_filename != NULL)
+		printf("Loaded %d spheres from %s.\n", n, icond_filename);
 
 	/* normalize the normal vectors of all planes */
 	{
@@ -546,6 +1852,7 @@ int main(int argc, char *argv[])
 		for(q=0;q<num_walls;q++) {
 			nrm = norm(wall[q].n);
 			vmult(wall[q].n, 1.0/nrm);
+			wall_ignored[q] = (periodic_x && fabsF(wall[q].n[0]) > ZERO) || (periodic_y && fabsF(wall[q].n[1]) > ZERO);
 		}
 	}
 
@@ -570,7 +1877,8 @@ int main(int argc, char *argv[])
 		0L	/* steps_total */
 	};
 
-	q=RK_MPI_SA_init(9*n, MPI_COMM_WORLD, 0);
+	/* the solver is initialized for the final number of spheres (see insert_count) */
+	q=RK_MPI_SA_init(9*n_capacity, MPI_COMM_WORLD, 0);
 
 	/* RK solver initialization check - this also represents a barrier in the program flow */
 	{
@@ -597,20 +1905,40 @@ int main(int argc, char *argv[])
 	MPIstart_time=MPI_Wtime();
 	MPIelapsed_time=0;
 
-	for(snap=0; snap<snapshots; snap++)
+	/* continue after the snapshot saved with the checkpoint, with the same time step */
+	if(start_snap >= 0) {
+		eqSystem.t = start_t;
+		eqSystem.h = start_ht;
+	}
+
+	for(snap=start_snap+1; snap<snapshots; snap++)
 	{
 			if(MPIrank==0) {
 				t = (T/(snapshots-1))*snap;
 				printf("Solving until t=%f ....",t); fflush(stdout);
 				MPInew_start=MPI_Wtime();
-				q=RK_MPI_SA_solve(t, &eqSystem);
+				q=advance(t, &eqSystem, color);
 				MPIelapsed_time+=(MPI_Wtime()-MPInew_start);
 				printf("Done. Elapsed wall time: %s, %ld R-K steps (%ld total)\n",
 				format_time(MPIelapsed_time), eqSystem.steps, eqSystem.steps_total);
+				if(insert_count > 0 || sleep_velocity > 0) {
+					int sleeping = 0;
+					for(q=0;q<n;q++) sleeping += asleep[q];
+					printf("%d spheres, %d sleeping.\n", n, sleeping);
+				}
 
 				/* for compatibility with MATLAB code, the numbering starts from 1*/
 				printf("Saving snapshot %d of %d.\n", snap+1, snapshots);
+				wrap_periodic(y);
 				save_snapshot(snap+1, y, color);
+				if(positions_filename != NULL && snap == snapshots-1 && save_positions(y))
+					printf("Warning: Could not save the positions file.\n");
+
+				if(checkpoint_interval > 0 && ((snap+1)%checkpoint_interval == 0 || snap == snapshots-1)) {
+					if(save_checkpoint(snap, eqSystem.t, eqSystem.h, y, color))
+						printf("Warning: Could not save the checkpoint.\n");
+					else printf("Checkpoint saved.\n");
+				}
 			} else {
 				;	// currently, MPI parallelization is not supported
 			}
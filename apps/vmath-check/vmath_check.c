@@ -0,0 +1,148 @@
+/***************************************************************\
+* Accuracy and speed of the vectorized math functions		*
+* (C) 2026 PorousFreezeThaw contributors			*
+* file: vmath_check.c						*
+\***************************************************************/
+
+/*
+Compares the vectorized functions from mathspec.h (vexpF(), vtanhF() ...) with the libm functions on random
+arguments from several intervals. For each function and interval, one line is printed with the maximum and the
+mean error in ULP of FLOAT (with respect to the libm result) and the time per element of both versions:
+
+	function lo hi max_ulp mean_ulp libm_ns vmath_ns speedup
+
+usage: vmath_check [elements [repetitions]]
+
+The accuracy is selected when compiling (see the Makefile). With -D __VMATH_LIBM, both versions are the same.
+*/
+
+#include "common.h"
+#include "mathspec.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <float.h>
+
+#ifdef __OPENMP
+	#include <omp.h>
+	#define wall_time()	omp_get_wtime()
+#else
+	#include <time.h>
+	#define wall_time()	((double)clock()/CLOCKS_PER_SEC)
+#endif
+
+#if defined _OPENMP && _OPENMP >= 201307
+	#define SIMD_LOOP	_Pragma("omp simd")
+#else
+	#define SIMD_LOOP
+#endif
+
+#if _DEFAULT_FP_PRECISION == FP_FLOAT
+	#define FLOAT_EPSILON	FLT_EPSILON
+#elif _DEFAULT_FP_PRECISION == FP_DOUBLE
+	#define FLOAT_EPSILON	DBL_EPSILON
+#else
+	#define FLOAT_EPSILON	LDBL_EPSILON
+#endif
+
+typedef void (*KERNEL)(int, const FLOAT *, FLOAT *);
+
+/* the loops over the arrays of arguments: the libm version and the vectorized version of each function */
+#define KERNELS(name, libm_f, v_f) \
+	static void name##_libm(int n, const FLOAT * x, FLOAT * y) { int i; for(i=0;i<n;i++) y[i] = libm_f(x[i]); } \
+	static void name##_vmath(int n, const FLOAT * x, FLOAT * y) { int i; SIMD_LOOP for(i=0;i<n;i++) y[i] = v_f(x[i]); }
+
+KERNELS(exp, expF, vexpF)
+KERNELS(expm1, expm1F, vexpm1F)
+KERNELS(tanh, tanhF, vtanhF)
+KERNELS(cosh, coshF, vcoshF)
+KERNELS(sqrt, sqrtF, vsqrtF)
+
+struct {
+	const char * name;
+	KERNEL libm, vmath;
+	FLOAT lo, hi;
+} check[] = {
+	{ "exp",	exp_libm,	exp_vmath,	-1.0,	1.0 },
+	{ "exp",	exp_libm,	exp_vmath,	-80.0,	80.0 },
+	{ "expm1",	expm1_libm,	expm1_vmath,	-0.5,	0.5 },
+	{ "expm1",	expm1_libm,	expm1_vmath,	-20.0,	20.0 },
+	{ "tanh",	tanh_libm,	tanh_vmath,	-0.5,	0.5 },
+	{ "tanh",	tanh_libm,	tanh_vmath,	-20.0,	20.0 },
+	{ "cosh",	cosh_libm,	cosh_vmath,	-20.0,	20.0 },
+	{ "sqrt",	sqrt_libm,	sqrt_vmath,	0.0,	1e6 }
+};
+
+static double ulp_error(FLOAT y, FLOAT ref)
+/* the difference of y and ref in the units of the last place of ref */
+{
+	FLOAT a = fabsF(ref);
+
+	if(y == ref) return(0.0);
+	if(a < FLOAT_EPSILON) a = FLOAT_EPSILON;	/* absolute error near zero */
+	return( fabsF(y-ref) / (a*FLOAT_EPSILON) );
+}
+
+static double time_kernel(KERNEL f, int n, int repetitions, const FLOAT * x, FLOAT * y)
+/* returns the time per element in nanoseconds */
+{
+	double t = wall_time();
+	int r;
+
+	for(r=0;r<repetitions;r++) f(n, x, y);
+	return( 1e9*(wall_time()-t)/((double)n*repetitions) );
+}
+
+int main(int argc, char *argv[])
+{
+	int n = argc>1 ? atoi(argv[1]) : 1000000;
+	int repetitions = argc>2 ? atoi(argv[2]) : 20;
+	FLOAT * x, * y, * ref;
+	int c, i;
+
+	if(n<1 || repetitions<1) {
+		fprintf(stderr, "usage: %s [elements [repetitions]]\n", argv[0]);
+		return(1);
+	}
+	x = (FLOAT *)malloc(n*sizeof(FLOAT));
+	y = (FLOAT *)malloc(n*sizeof(FLOAT));
+	ref = (FLOAT *)malloc(n*sizeof(FLOAT));
+	if(x==NULL || y==NULL || ref==NULL) {
+		fprintf(stderr, "Not enough memory.\n");
+		return(2);
+	}
+
+#if defined __VMATH_LIBM
+	printf("# accuracy: libm\n");
+#elif defined __VMATH_RELAXED
+	printf("# accuracy: relaxed\n");
+#else
+	printf("# accuracy: full\n");
+#endif
+	printf("# elements: %d, repetitions: %d, FLOAT size: %d bytes\n", n, repetitions, (int)sizeof(FLOAT));
+	printf("# function lo hi max_ulp mean_ulp libm_ns vmath_ns speedup\n");
+
+	srand(1);
+	for(c=0;c<(int)(sizeof(check)/sizeof(check[0]));c++) {
+		double err, max_err=0.0, sum_err=0.0, t_libm, t_vmath;
+
+		for(i=0;i<n;i++) x[i] = check[c].lo + (check[c].hi-check[c].lo)*((FLOAT)rand()/RAND_MAX);
+
+		check[c].libm(n, x, ref);
+		check[c].vmath(n, x, y);
+		for(i=0;i<n;i++) {
+			err = ulp_error(y[i], ref[i]);
+			sum_err += err;
+			if(err > max_err) max_err = err;
+		}
+
+		t_libm = time_kernel(check[c].libm, n, repetitions, x, y);
+		t_vmath = time_kernel(check[c].vmath, n, repetitions, x, y);
+
+		printf("%s %g %g %.3f %.4f %.3f %.3f %.2f\n", check[c].name, (double)check[c].lo, (double)check[c].hi,
+			max_err, sum_err/n, t_libm, t_vmath, t_libm/t_vmath);
+	}
+
+	free(x); free(y); free(ref);
+	return(0);
+}
@@ -0,0 +1,84 @@
+/***************************************************\
+* Topology-aware MPI rank placement                 *
+* and OpenMP thread affinity                        *
+* (C) 2026 PorousFreezeThaw contributors            *
+* file: MPI_topology.h                              *
+\***************************************************/
+
+#if !defined __MPI_topology
+#define __MPI_topology
+
+#include <mpi.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+Applications with a 1D domain decomposition (slabs) exchange data between the consecutive ranks
+in the virtual rank order. The communication is cheapest if the neighbouring slabs reside on the same
+node (shared memory transport) and preferably on the same socket. MPI_topology_rankmap() therefore
+discovers the node of each rank (by MPI_Comm_split_type() with MPI_COMM_TYPE_SHARED, or by comparing
+the processor names with MPI older than 3.0) and the socket of each rank (from its CPU affinity mask
+and /sys/devices/system/cpu/cpu<N>/topology/physical_package_id on Linux). Then it builds a rank
+permutation (virtual rank -> real rank) in which:
+- the virtual rank 0 is the requested master rank
+- all ranks of a node form a contiguous range of virtual ranks (the master's node comes first,
+  the remaining nodes follow in the order of their lowest real rank)
+- within a node, the ranks are ordered by the socket and then by the real rank
+
+MPI_topology_bind_threads() then pins the OpenMP threads of the calling rank to the CPUs compactly,
+i.e. the threads occupy consecutive hardware threads (in the order socket, core, SMT sibling).
+*/
+
+typedef struct {
+	int node;		/* the node index (0 = the node of the master rank) */
+	int n_nodes;		/* the number of nodes */
+	int node_rank;		/* the position of the rank among the ranks of its node (in the virtual rank order) */
+	int node_size;		/* the number of ranks on the node */
+	int socket;		/* the socket (physical package) of the first CPU the rank may run on (-1 if unknown) */
+	int restricted;		/* nonzero if the ranks of the node have different CPU affinity masks, i.e. they have
+				   already been bound to CPUs by the launcher */
+} MPI_TOPOLOGY;
+
+int MPI_topology_rankmap(MPI_Comm comm, int master_rank, int * rankmap, MPI_TOPOLOGY * info);
+/*
+Builds the rank permutation 'rankmap' (its size must be at least the size of 'comm'): rankmap[i] is the
+real rank (in 'comm') of the virtual rank i. The placement information about the calling rank is stored
+to 'info' (which may be NULL). This is a collective operation over 'comm'. It must be called before any
+communication relying on the virtual rank order takes place.
+
+return codes:
+0	success
+-1	not enough memory (the identity permutation with the master rank swapped with rank 0 is used)
+-2	invalid master rank
+*/
+
+int MPI_topology_bind_threads(int n_threads, const MPI_TOPOLOGY * info, char * report, int report_size);
+/*
+Pins the 'n_threads' OpenMP threads of the calling rank to CPUs. This must be called outside of any
+parallel region. The CPUs are taken from the affinity mask of the rank. If all ranks of the node share
+the same mask (info->restricted==0), its CPUs are split evenly among the info->node_size ranks
+of the node, so that the consecutive ranks get the consecutive CPU ranges. 'info' may be NULL,
+in which case the whole mask is used.
+If there are more threads than CPUs, the CPUs are assigned cyclically.
+
+If the OpenMP runtime is asked to bind the threads itself (by OMP_PROC_BIND set to true, close, spread,
+master or primary, or by any of the OMP_PLACES, GOMP_CPU_AFFINITY or KMP_AFFINITY environment variables),
+nothing is done. OMP_PROC_BIND=false does not prevent the binding: an application that is to leave
+the threads unbound must not call this function (intertrack offers the 'bind_threads 0' parameter).
+
+A human-readable description of the resulting binding is written to 'report' (at most 'report_size'
+characters including the terminating null character).
+
+return codes:
+0	success (the threads have been pinned)
+1	nothing done (binding left to the OpenMP runtime or not supported on this platform)
+-1	the CPU affinity could not be set
+*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif		/* __MPI_topology */
@@ -9,6 +9,7 @@
 #define __RK_Asolver
 
 #include "common.h"
+#include "RK_engine.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -150,6 +151,54 @@ returns nonzero if there a NAN or +-INF occured in the last calculation (upon th
 RK_A_Solve(). This may imply some problem with your equation or too loose setting of delta_.
 */
 
+int RK_A_stiffness(int mode);
+/*
+Sets the stiffness detection mode of RK_A_solve() (see RK_engine.h):
+
+RK_STIFF_OFF	no detection (default)
+RK_STIFF_DETECT	In each time step, the dominant eigenvalue magnitude 'rho' of the Jacobian of the right
+		hand side is estimated from the difference of the stages K3 and K2, which are evaluated
+		at the same time level (Shampine's approach). The product h*rho indicates whether the time
+		step is limited by stability rather than by accuracy. The cost is one extra array and
+		two extra scalar products per time step.
+RK_STIFF_SWITCH	Moreover, after a sequence of time steps limited by stability, the solver switches
+		to the linearly implicit ROS2 Rosenbrock method of order 2. The linear systems are solved
+		by BiCGSTAB with the Jacobian-vector products approximated by finite differences of the right
+		hand side, so no Jacobian is needed. The solver switches back to the Merson scheme as soon
+		as it would be stable with the current time step. Note that the right hand side is called
+		more times per time step by the Rosenbrock method (at least 2 per BiCGSTAB iteration).
+		Requires 8 extra arrays.
+
+The extra arrays are allocated here and freed by RK_A_cleanup(). Each call resets the telemetry.
+
+return codes:
+0	success
+-1	not enough memory (the detection remains OFF)
+-2	invalid mode
+-3	not initialized yet
+*/
+
+void RK_A_get_stiffness(RK_STIFFNESS * info);
+/*
+Stores the stiffness telemetry (cumulative since the last call to RK_A_stiffness()) to 'info'.
+*/
+
+int RK_A_error_norm(int norm, FLOAT atol, FLOAT rtol);
+/*
+Selects the norm of the error estimate compared with 'delta':
+RK_NORM_MAX	the maximum of the error estimates of all elements (the default). A single element
+		with a large error therefore determines the time step of the whole system.
+RK_NORM_RMS	the root mean square of the error estimates of all elements, each of them divided
+		by atol+rtol*|x| (x is the value of the element at the beginning of the time step).
+		The time step is then controlled by the aggregate accuracy, so that it is not
+		limited by a few noisy elements. With this norm, 'delta' is dimensionless and it
+		is usually set to 1.
+
+return codes:
+0	success
+-2	invalid norm or tolerances (negative, or both zero with RK_NORM_RMS)
+*/
+
 int RK_A_solve(FLOAT final_time, RK_SOLUTION * system);
 /*
 Performs the ODE system integration up to the time level 'final_time', using the
@@ -170,6 +219,42 @@ return codes:
 -5	system dimension is greater than the maximum dimension passed to RK_A_init()
 */
 
+/* ========================================== */
+/* solver contexts */
+
+/*
+All the functions above operate on a default solver context, which is internal to the module.
+Independent equation systems (e.g. the members of an ensemble or several coupled models) can be
+integrated concurrently by different threads, each of them using its own context created by
+RK_A_ctx_create(). The functions RK_A_ctx_xxx(ctx,...) behave exactly as RK_A_xxx(...), except that they
+operate on the context 'ctx'. Different contexts may be used simultaneously by different threads, a
+single context may not.
+*/
+
+typedef struct RK_A_context RK_A_CTX;
+
+RK_A_CTX * RK_A_ctx_create(int max_system_dimension, int * error);
+/*
+creates a new context and allocates its auxiliary arrays. The return code of the initialization
+(see RK_A_init()) is stored to 'error' unless it is NULL. Returns NULL on failure.
+*/
+
+int RK_A_ctx_destroy(RK_A_CTX * ctx);
+/*
+frees the context and all its arrays
+
+return codes:
+0	success
+-3	'ctx' is NULL
+*/
+
+void RK_A_ctx_handle_NAN(RK_A_CTX * ctx, int hN);
+int RK_A_ctx_check_NAN(RK_A_CTX * ctx);
+int RK_A_ctx_stiffness(RK_A_CTX * ctx, int mode);
+void RK_A_ctx_get_stiffness(RK_A_CTX * ctx, RK_STIFFNESS * info);
+int RK_A_ctx_error_norm(RK_A_CTX * ctx, int norm, FLOAT atol, FLOAT rtol);
+int RK_A_ctx_solve(RK_A_CTX * ctx, FLOAT final_time, RK_SOLUTION * system);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,153 @@
+/***************************************************\
+* 4th order Runge - Kutta solver                    *
+* Merson's modification with adaptive time stepping *
+* - batched version for many small systems          *
+* (C) 2026 PorousFreezeThaw contributors            *
+* file: RK_Bsolver.h                                *
+\***************************************************/
+
+#if !defined __RK_Bsolver
+#define __RK_Bsolver
+
+#include "common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+The batched Runge - Kutta solver integrates a large number of independent equation systems in the form
+Dx=f(t,x), all of them having the same dimension n. Each system has its own time level and its own
+adaptively controlled time step (using the same Merson scheme and the same step control as RK_A_solve()).
+Typical applications are pointwise problems, e.g. local reaction substeps in each grid cell or ODEs
+attached to individual particles, where a separate call to RK_A_solve() for each system would be
+dominated by the overhead.
+
+MEMORY LAYOUT:
+The systems are grouped into batches of RK_B_LANES systems. The solution of one batch occupies n*RK_B_LANES
+consecutive elements of the array 'x', where the j-th element of the l-th system of the batch is stored
+at the position j*RK_B_LANES+l. In other words, the same component of all systems in the batch is stored
+contiguously, so that the right hand side as well as the solver itself can process all systems
+of the batch at once using SIMD instructions. The last batch is padded by unused systems if n_systems
+is not divisible by RK_B_LANES. The array 'x' must therefore have RK_B_SIZE(n,n_systems) elements and
+the element j of the system s is x[RK_B_INDEX(n,s,j)]. The padding systems are reset to zero by the solver
+and their results are meaningless.
+
+Finished systems (i.e. those that have already reached the final time, as well as the padding systems)
+stay in the batch with a zero time step until all systems of the batch have finished. They are masked out
+of the solution update and of the step control. The right hand side is still evaluated for them, which
+keeps the SIMD lanes full.
+
+ABOUT THE RIGHT HAND SIDE FUNCTION (referred to as 'f' here):
+'f' has 4 arguments: 'f(t,x,dest,first_system)' and is called for one batch at a time. 't' is the array
+of RK_B_LANES time levels of the systems in the batch (they are generally different). 'x' and 'dest' point
+to n*RK_B_LANES elements in the layout described above. 'f' must fill 'dest' with the values of the right
+hand side. 'first_system' is the index of the first system of the batch (a multiple of RK_B_LANES), so that
+the system s=first_system+l can access its own parameters (e.g. the properties of the grid cell or the
+particle). Note that s may exceed n_systems-1 for the padding systems of the last batch. A typical
+right hand side looks like this:
+
+	void f(const FLOAT * t, const FLOAT * x, FLOAT * dest, int first_system)
+	{
+		int l;
+		#pragma omp simd
+		for(l=0;l<RK_B_LANES;l++) {
+			dest[0*RK_B_LANES+l] = ... x[0*RK_B_LANES+l] ... x[1*RK_B_LANES+l] ...
+			dest[1*RK_B_LANES+l] = ...
+		}
+	}
+
+With OpenMP, the batches are distributed among the threads and 'f' is called by multiple threads
+concurrently for different batches. 'f' must therefore be thread safe and it must NOT contain any
+work sharing directives. 'f' must not suppose that 'x' has any relationship with the location of the
+solution in the RK_B_SOLUTION structure !!!
+*/
+
+/*
+The number of systems in one batch. It should be a multiple of the SIMD vector length (in FLOATs).
+The module and the application must be compiled with the same value.
+*/
+#ifndef RK_B_LANES
+	#define RK_B_LANES	8
+#endif
+
+/* the number of elements of the solution array for 'n_systems' systems of dimension 'n' */
+#define RK_B_SIZE(n,n_systems)	( (((n_systems)+RK_B_LANES-1)/RK_B_LANES) * (n) * RK_B_LANES )
+
+/* the position of the element 'j' of the system 's' in the solution array */
+#define RK_B_INDEX(n,s,j)	( ((s)/RK_B_LANES) * (n) * RK_B_LANES + (j) * RK_B_LANES + (s)%RK_B_LANES )
+
+/* pointer to the right hand side */
+typedef void (*RK_B_RightHandSide)(const FLOAT *,const FLOAT *,FLOAT *,int);
+
+typedef struct {
+	int n;						/* dimension of each system */
+	int n_systems;					/* the number of systems */
+	FLOAT * t;					/* the current time levels of all systems ('n_systems' elements) */
+	FLOAT * x;					/* pointer to the solutions in the batched layout
+							   (RK_B_SIZE(n,n_systems) elements) */
+	RK_B_RightHandSide f;				/* the right hand side */
+
+	FLOAT * h;					/* the current time steps of all systems ('n_systems' elements).
+							   If h[s]==0, the initial time step is calculated from the value
+							   of 'final_time-t[s]'. Upon return, h[s] contains the last
+							   estimated time step before the final trimmed time step, as with
+							   RK_A_solve(). */
+	FLOAT h_min;					/* the minimum allowed time step for rejection (see RK_Asolver.h) */
+	FLOAT delta;					/* the maximum desired relative error */
+
+	long * steps;					/* the numbers of successful time steps of all systems ('n_systems'
+							   elements, increased by the solver). NULL if not needed. */
+	long steps_total;				/* the number of time steps of all batches, including the unsuccessful
+							   ones (useful for statistics & debugging). The user must reset it. */
+} RK_B_SOLUTION;
+
+int RK_B_init(int max_system_dimension);
+/*
+allocates memory for auxiliary arrays that allow solution of equation systems with dimension smaller than
+or equal to 'max_system_dimension'. With OpenMP, each thread gets its own auxiliary arrays. The number
+of threads used by RK_B_solve() is limited by the value of omp_get_max_threads() at the time of this call.
+
+NOTE: If you want to start another computation with greater system dimension, you must call RK_B_cleanup()
+before you can pass a greater value to RK_B_init().
+
+return codes:
+0	success
+-1	not enough memory
+-2	invalid system dimension
+-3	already initialized
+*/
+
+int RK_B_cleanup(void);
+/* Frees memory allocated by RK_B_init()
+
+return codes:
+0	success
+-3	not initialized yet
+*/
+
+int RK_B_solve(FLOAT final_time, RK_B_SOLUTION * system);
+/*
+Integrates all systems from their individual time levels t[s] up to the common time level 'final_time',
+using the Merson's modification of the fourth order Runge-Kutta scheme with adaptive time stepping
+controlled separately for each system. With OpenMP, the batches are processed in parallel (call this
+function outside of any parallel region).
+
+NAN handling is always ON: If NANs or +-INF appear in the error estimate of a system, its time step is
+divided by 10 and the step is repeated. If the time step becomes too small, the integration of that system
+is stopped and its time level t[s] is left below 'final_time'. The other systems are not affected.
+
+return codes:
+0	success
+-2	inavalid 'system' specification
+-3	not initialized yet
+-4	break: cannot adjust time step - permanent occurrence of NANs in some of the systems
+	(they can be identified by t[s]!=final_time)
+-5	system dimension is greater than the maximum dimension passed to RK_B_init()
+*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif		/* __RK_Bsolver */
@@ -14,6 +14,7 @@
 #define __RK_MPI_Asolver
 
 #include "common.h"
+#include "RK_engine.h"
 #include <mpi.h>
 
 /* MPI data type for the FLOAT data type (note the two underscores in MPI__FLOAT) */
@@ -32,6 +33,7 @@
 #define RKA_CMD_FINISHED	8
 #define RKA_CMD_NEXTFINISH	16
 #define RKA_CMD_BREAK		32
+#define RKA_CMD_SWITCH		64
 
 #ifdef __cplusplus
 extern "C" {
@@ -304,6 +306,62 @@ RK_MPI_A_Solve(). This may imply some problem with your equation or too loose se
 NOTE: This function works on all processes involved in the calculation
 */
 
+int RK_MPI_A_stiffness(int mode);
+/*
+Sets the stiffness detection mode of RK_MPI_A_solve() (see RK_engine.h):
+
+RK_STIFF_OFF	no detection (default)
+RK_STIFF_DETECT	In each time step, the dominant eigenvalue magnitude 'rho' of the Jacobian of the right
+		hand side is estimated from the difference of the stages K3 and K2, which are evaluated
+		at the same time level (Shampine's approach). The product h*rho indicates whether the time
+		step is limited by stability rather than by accuracy. The cost is one extra array and
+		two extra scalar products per time step.
+RK_STIFF_SWITCH	Moreover, after a sequence of time steps limited by stability, the solver switches
+		to the linearly implicit ROS2 Rosenbrock method of order 2. The linear systems are solved
+		by BiCGSTAB with the Jacobian-vector products approximated by finite differences of the right
+		hand side, so no Jacobian is needed. The solver switches back to the Merson scheme as soon
+		as it would be stable with the current time step. Note that the right hand side is called
+		more times per time step by the Rosenbrock method (at least 2 per BiCGSTAB iteration).
+		Requires 8 extra arrays.
+
+The extra arrays are allocated here and freed by RK_MPI_A_cleanup(). Each call resets the telemetry.
+
+NOTE: This function must be called by all processes involved in the calculation.
+
+return codes:
+0	success
+-1	not enough memory (the detection remains OFF)
+-2	invalid mode
+-3	not initialized yet
+*/
+
+void RK_MPI_A_get_stiffness(RK_STIFFNESS * info);
+/*
+Stores the stiffness telemetry (cumulative since the last call to RK_MPI_A_stiffness()) to 'info'.
+The telemetry is only maintained by the master process.
+*/
+
+int RK_MPI_A_error_norm(int norm, FLOAT atol, FLOAT rtol);
+/*
+Selects the norm of the error estimate compared with 'delta':
+RK_NORM_MAX	the maximum of the error estimates of all elements (the default). A single element
+		with a large error therefore determines the time step of the whole system.
+RK_NORM_RMS	the root mean square of the error estimates of all elements, each of them divided
+		by atol+rtol*|x| (x is the value of the element at the beginning of the time step).
+		The time step is then controlled by the aggregate accuracy, so that it is not
+		limited by a few noisy elements. With this norm, 'delta' is dimensionless and it
+		is usually set to 1. Note that the sum of squares depends on the order of summation,
+		so that the results may differ slightly with different numbers of ranks or threads.
+The mean value is taken over the elements of all blocks in all ranks.
+
+WARNING: This function works on the master process only !!! The settings are broadcast to the other
+ranks at the beginning of the calculation.
+
+return codes:
+0	success
+-2	invalid norm or tolerances (negative, or both zero with RK_NORM_RMS)
+*/
+
 int RK_MPI_A_solve(FLOAT final_time, RK_MPI_SOLUTION * system);
 /*
 Performs the ODE system integration up to the time level 'final_time', using the
@@ -328,6 +386,46 @@ return codes:
 -6	error in one of the other processes
 */
 
+/* ========================================== */
+/* solver contexts */
+
+/*
+All the functions above operate on a default solver context, which is internal to the module.
+Independent equation systems (e.g. the members of an ensemble or several coupled models) can be
+integrated concurrently by different threads, each of them using its own context created by
+RK_MPI_A_ctx_create(). The functions RK_MPI_A_ctx_xxx(ctx,...) behave exactly as RK_MPI_A_xxx(...),
+except that they operate on the context 'ctx'. Different contexts may be used simultaneously by
+different threads, a single context may not.
+
+Each context performs collective operations on the communicator passed to RK_MPI_A_ctx_create().
+The contexts used concurrently must therefore have different communicators (e.g. obtained
+by MPI_Comm_dup() or MPI_Comm_split()) and MPI must be initialized with MPI_THREAD_MULTIPLE.
+*/
+
+typedef struct RK_MPI_A_context RK_MPI_A_CTX;
+
+RK_MPI_A_CTX * RK_MPI_A_ctx_create(int max_block_size, MPI_Comm comm, int master_rank, int * error);
+/*
+creates a new context and allocates its auxiliary arrays. The return code of the initialization
+(see RK_MPI_A_init()) is stored to 'error' unless it is NULL. Returns NULL on failure.
+*/
+
+int RK_MPI_A_ctx_destroy(RK_MPI_A_CTX * ctx);
+/*
+frees the context and all its arrays
+
+return codes:
+0	success
+-3	'ctx' is NULL
+*/
+
+void RK_MPI_A_ctx_handle_NAN(RK_MPI_A_CTX * ctx, int hN);
+int RK_MPI_A_ctx_check_NAN(RK_MPI_A_CTX * ctx);
+int RK_MPI_A_ctx_stiffness(RK_MPI_A_CTX * ctx, int mode);
+void RK_MPI_A_ctx_get_stiffness(RK_MPI_A_CTX * ctx, RK_STIFFNESS * info);
+int RK_MPI_A_ctx_error_norm(RK_MPI_A_CTX * ctx, int norm, FLOAT atol, FLOAT rtol);
+int RK_MPI_A_ctx_solve(RK_MPI_A_CTX * ctx, FLOAT final_time, RK_MPI_SOLUTION * system);
+
 #ifdef __cplusplus
 }
 #endif
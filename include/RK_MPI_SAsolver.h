@@ -15,6 +15,7 @@
 #define __RK_MPI_SAsolver
 
 #include "common.h"
+#include "RK_engine.h"
 #include <mpi.h>
 
 /* MPI data type for the FLOAT data type (note the two underscores in MPI__FLOAT) */
@@ -33,6 +34,7 @@
 #define RKA_CMD_FINISHED	8
 #define RKA_CMD_NEXTFINISH	16
 #define RKA_CMD_BREAK		32
+#define RKA_CMD_SWITCH		64
 
 #ifdef __cplusplus
 extern "C" {
@@ -191,6 +193,10 @@ typedef struct {
 	FLOAT * chunk_eps_mult;				/* multiplier of the relative error (eps) for the
 							   current chunk. By this, different parts of the
 							   equation system can be given different error tolerance. */
+	FLOAT * chunk_atol;				/* the absolute tolerances of the chunks used by the
+							   RK_NORM_RMS error norm (see RK_MPI_SA_error_norm() ).
+							   If NULL, the default tolerance applies. */
+	FLOAT * chunk_rtol;				/* the relative tolerances of the chunks (the same as above) */
 } RK_MEM_DIST;
 
 typedef struct __struct_RK_MPI_S_SOLUTION {
@@ -288,6 +294,29 @@ typedef struct __struct_RK_MPI_S_SOLUTION {
 							   the unsuccessful ones (useful for statistics & debugging) */
 } RK_MPI_S_SOLUTION;
 
+/*
+The OpenMP work sharing setup of the hybrid solver versions. It can be measured by RK_MPI_SA_autotune()
+and applied by RK_MPI_SA_set_tuning().
+*/
+typedef struct {
+	int threading;					/* the work sharing strategy of the solver loops: RK_THREADS_INNER,
+							   RK_THREADS_OUTER or RK_THREADS_COLLAPSED (see RK_engine.h).
+							   Only the module RK_MPI_SAsolver_hybrid_auto can switch
+							   between them at run time. The MPI-only version uses
+							   RK_THREADS_NONE. */
+	int schedule;					/* the OpenMP loop schedule kind (the value of omp_sched_t) used by all
+							   loops with schedule(runtime), including those in the right hand side.
+							   0 means that the schedule is left unchanged (i.e. OMP_SCHEDULE applies
+							   to the right hand side). Until a schedule is set, the solver loops
+							   use the default (static) schedule. */
+	int chunk;					/* the chunk size of the schedule (0 = default chunk size) */
+	double time;					/* the measured wall time of one right hand side evaluation and
+							   stage update (set by RK_MPI_SA_autotune() only) */
+} RK_TUNING;
+
+/* the maximum number of candidate setups measured by RK_MPI_SA_autotune() */
+#define RK_TUNING_MAX_CANDIDATES	32
+
 int RK_MPI_SA_init(int max_block_size, MPI_Comm comm, int master_rank);
 /*
 allocates memory for auxiliary arrays. All chunks solved within the current node must fit into the
@@ -354,6 +383,64 @@ RK_MPI_SA_Solve(). This may imply some problem with your equation or too loose s
 NOTE: This function works on all processes involved in the calculation
 */
 
+int RK_MPI_SA_stiffness(int mode);
+/*
+Sets the stiffness detection mode of RK_MPI_SA_solve() (see RK_engine.h):
+
+RK_STIFF_OFF	no detection (default)
+RK_STIFF_DETECT	In each time step, the dominant eigenvalue magnitude 'rho' of the Jacobian of the right
+		hand side is estimated from the difference of the stages K3 and K2, which are evaluated
+		at the same time level (Shampine's approach). The product h*rho indicates whether the time
+		step is limited by stability rather than by accuracy. The cost is one extra array and
+		two extra scalar products per time step.
+RK_STIFF_SWITCH	Moreover, after a sequence of time steps limited by stability, the solver switches
+		to the linearly implicit ROS2 Rosenbrock method of order 2. The linear systems are solved
+		by BiCGSTAB with the Jacobian-vector products approximated by finite differences of the right
+		hand side, so no Jacobian is needed. The solver switches back to the Merson scheme as soon
+		as it would be stable with the current time step. Note that the right hand side is called
+		more times per time step by the Rosenbrock method (at least 2 per BiCGSTAB iteration).
+		Requires 8 extra arrays.
+
+The extra arrays are allocated here and freed by RK_MPI_SA_cleanup(). Each call resets the telemetry.
+
+NOTE: This function must be called by all processes involved in the calculation.
+
+return codes:
+0	success
+-1	not enough memory (the detection remains OFF)
+-2	invalid mode
+-3	not initialized yet
+*/
+
+void RK_MPI_SA_get_stiffness(RK_STIFFNESS * info);
+/*
+Stores the stiffness telemetry (cumulative since the last call to RK_MPI_SA_stiffness()) to 'info'.
+The telemetry is only maintained by the master process.
+*/
+
+int RK_MPI_SA_error_norm(int norm, FLOAT atol, FLOAT rtol);
+/*
+Selects the norm of the error estimate compared with 'delta':
+RK_NORM_MAX	the maximum of the error estimates of all elements (the default). A single element
+		with a large error therefore determines the time step of the whole system.
+RK_NORM_RMS	the root mean square of the error estimates of all elements, each of them divided
+		by atol+rtol*|x| (x is the value of the element at the beginning of the time step).
+		The time step is then controlled by the aggregate accuracy, so that it is not
+		limited by a few noisy elements. With this norm, 'delta' is dimensionless and it
+		is usually set to 1. Note that the sum of squares depends on the order of summation,
+		so that the results may differ slightly with different numbers of ranks or threads.
+The tolerances 'atol' and 'rtol' apply to all chunks unless the chunk_atol and chunk_rtol arrays
+are given in RK_MEM_DIST (e.g. to give each variable of the system its own tolerances).
+The mean value is taken over the elements of all chunks in all ranks.
+
+WARNING: This function works on the master process only !!! The settings are broadcast to the other
+ranks at the beginning of the calculation.
+
+return codes:
+0	success
+-2	invalid norm or tolerances (negative, or both zero with RK_NORM_RMS)
+*/
+
 int RK_MPI_SA_check_mem(RK_MEM_DIST * n);
 /*
 Checks whether the given system memory distribution is defined correctly.
@@ -367,6 +454,49 @@ return codes:
 -7	number of chunks is negative or zero
 */
 
+int RK_MPI_SA_set_tuning(const RK_TUNING * tuning);
+/*
+Applies the given OpenMP work sharing setup. The schedule is set by omp_set_schedule(), so it affects
+all loops with schedule(runtime) executed by the calling thread afterwards, including those in the right
+hand side. Call this function in all ranks.
+
+return codes:
+0	success
+-1	the requested strategy is not available in this solver module (the modules other than
+	RK_MPI_SAsolver_hybrid_auto only support their own strategy). Nothing has been changed.
+*/
+
+void RK_MPI_SA_get_tuning(RK_TUNING * tuning);
+/*
+Stores the current OpenMP work sharing setup to 'tuning' ('time' is set to 0).
+*/
+
+int RK_MPI_SA_autotune(RK_MPI_S_SOLUTION * system, int iterations, RK_TUNING * best, RK_TUNING * all, int * n_all);
+/*
+Finds the fastest OpenMP work sharing setup for the given system. For each candidate combination of the
+work sharing strategy (all strategies in RK_MPI_SAsolver_hybrid_auto, the built-in one otherwise),
+the loop schedule and the chunk size, 'iterations' evaluations of the right hand side followed by
+a stage update (i.e. the work of one Merson stage) are timed. The slowest rank determines the time
+of a candidate. The fastest candidate is applied by RK_MPI_SA_set_tuning() and stored to 'best'.
+If 'all' is not NULL, the results of all candidates (at most RK_TUNING_MAX_CANDIDATES) are stored
+there and their number is stored to '*n_all'.
+
+The right hand side is evaluated at the time level 'system->t' and the solution 'system->x' is not
+modified by the solver (only the auxiliary arrays are used). However, the right hand side may still
+modify the auxiliary nodes (holes between the chunks) as usual.
+
+Call this function in all ranks, after the system has been set up (in the same way as RK_MPI_SA_solve()).
+The choice is made by the master rank and broadcast to the other ranks.
+
+return codes:
+0	success
+-1	not enough memory
+-2	invalid 'system' specification or 'iterations'<=0
+-3	not initialized yet
+-5	last chunk exceeds available memory
+-6	error in one of the other processes
+*/
+
 int RK_MPI_SA_solve(FLOAT final_time, RK_MPI_S_SOLUTION * system);
 /*
 Performs the ODE system integration up to the time level 'final_time', using the
@@ -391,6 +521,55 @@ return codes:
 -6	error in one of the other processes
 */
 
+/* ========================================== */
+/* solver contexts */
+
+/*
+All the functions above operate on a default solver context, which is internal to the module.
+Independent equation systems (e.g. the members of an ensemble or several coupled models) can be
+integrated concurrently by different threads, each of them using its own context created by
+RK_MPI_SA_ctx_create(). The functions RK_MPI_SA_ctx_xxx(ctx,...) behave exactly as RK_MPI_SA_xxx(...),
+except that they operate on the context 'ctx'. Different contexts may be used simultaneously by
+different threads, a single context may not.
+
+Each context performs collective operations on the communicator passed to RK_MPI_SA_ctx_create().
+The contexts used concurrently must therefore have different communicators (e.g. obtained
+by MPI_Comm_dup() or MPI_Comm_split()) and MPI must be initialized with MPI_THREAD_MULTIPLE.
+
+The hybrid OpenMP versions open a parallel region in RK_MPI_SA_ctx_solve(). If it is called from inside
+a parallel region, the calculation only runs in the calling thread unless nested parallelism
+is enabled (see omp_set_max_active_levels()). The loop schedule set by RK_MPI_SA_ctx_set_tuning()
+is remembered by the context and applied by each call to RK_MPI_SA_ctx_solve().
+*/
+
+typedef struct RK_MPI_SA_context RK_MPI_SA_CTX;
+
+RK_MPI_SA_CTX * RK_MPI_SA_ctx_create(int max_block_size, MPI_Comm comm, int master_rank, int * error);
+/*
+creates a new context and allocates its auxiliary arrays. The return code of the initialization
+(see RK_MPI_SA_init()) is stored to 'error' unless it is NULL. Returns NULL on failure.
+*/
+
+int RK_MPI_SA_ctx_destroy(RK_MPI_SA_CTX * ctx);
+/*
+frees the context and all its arrays
+
+return codes:
+0	success
+-3	'ctx' is NULL
+*/
+
+int RK_MPI_SA_ctx_check_mem(RK_MPI_SA_CTX * ctx, RK_MEM_DIST * n);
+void RK_MPI_SA_ctx_handle_NAN(RK_MPI_SA_CTX * ctx, int hN);
+int RK_MPI_SA_ctx_check_NAN(RK_MPI_SA_CTX * ctx);
+int RK_MPI_SA_ctx_stiffness(RK_MPI_SA_CTX * ctx, int mode);
+void RK_MPI_SA_ctx_get_stiffness(RK_MPI_SA_CTX * ctx, RK_STIFFNESS * info);
+int RK_MPI_SA_ctx_error_norm(RK_MPI_SA_CTX * ctx, int norm, FLOAT atol, FLOAT rtol);
+int RK_MPI_SA_ctx_set_tuning(RK_MPI_SA_CTX * ctx, const RK_TUNING * tuning);
+void RK_MPI_SA_ctx_get_tuning(RK_MPI_SA_CTX * ctx, RK_TUNING * tuning);
+int RK_MPI_SA_ctx_autotune(RK_MPI_SA_CTX * ctx, RK_MPI_S_SOLUTION * system, int iterations, RK_TUNING * best, RK_TUNING * all, int * n_all);
+int RK_MPI_SA_ctx_solve(RK_MPI_SA_CTX * ctx, FLOAT final_time, RK_MPI_S_SOLUTION * system);
+
 #ifdef __cplusplus
 }
 #endif
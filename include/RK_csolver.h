@@ -99,6 +99,37 @@ return codes:
 -5	system dimension is greater than the maximum dimension passed to RK_A_init()
 */
 
+/* ========================================== */
+/* solver contexts */
+
+/*
+All the functions above operate on a default solver context, which is internal to the module.
+Independent equation systems (e.g. the members of an ensemble or several coupled models) can be
+integrated concurrently by different threads, each of them using its own context created by
+RK_c_ctx_create(). The functions RK_c_ctx_xxx(ctx,...) behave exactly as RK_c_xxx(...), except that they
+operate on the context 'ctx'. Different contexts may be used simultaneously by different threads, a
+single context may not.
+*/
+
+typedef struct RK_c_context RK_c_CTX;
+
+RK_c_CTX * RK_c_ctx_create(int max_system_dimension, int * error);
+/*
+creates a new context and allocates its auxiliary arrays. The return code of the initialization
+(see RK_c_init()) is stored to 'error' unless it is NULL. Returns NULL on failure.
+*/
+
+int RK_c_ctx_destroy(RK_c_CTX * ctx);
+/*
+frees the context and all its arrays
+
+return codes:
+0	success
+-3	'ctx' is NULL
+*/
+
+int RK_c_ctx_solve(RK_c_CTX * ctx, int steps, RK_SOLUTION * system);
+
 #ifdef __cplusplus
 }
 #endif
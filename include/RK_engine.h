@@ -0,0 +1,131 @@
+/***************************************************\
+* Runge - Kutta solver engine                       *
+* compile-time policy definitions                   *
+*                                                   *
+* this file is part of                              *
+* DDLBF (Digithell Dynamic Load Balancing Facility) *
+*                                                   *
+* (C) 2005-2015 Pavel Strachota                     *
+* (C) 2026 PorousFreezeThaw contributors            *
+* file: RK_engine.h                                 *
+\***************************************************/
+
+#if !defined __RK_engine
+#define __RK_engine
+
+/*
+All Runge - Kutta solver modules (RK_solver, RK_csolver, RK_Asolver, RK_MPI_Asolver,
+RK_MPI_SAsolver and its hybrid OpenMP versions) share a single implementation in
+modules/RK_engine/RK_engine.c. The engine is never compiled on its own. Instead, each
+solver module is a thin wrapper that includes its own public header, selects the policies
+listed below by defining the corresponding macros and then #includes the engine source.
+The public headers and the function names of the individual modules remain unchanged.
+
+All the state of a solver module is kept in a context structure 'struct RK_FN(context)'. The public
+functions of a module operate on a default context internal to the module, while their 'ctx_'
+counterparts (e.g. RK_MPI_SA_ctx_solve) operate on a context created by the ctx_create function.
+
+The following macros must be defined by the wrapper before the engine is included:
+
+RK_COMM		communication policy
+		RK_COMM_NONE	serial solver, the init function has the form
+				init(int max_system_dimension)
+		RK_COMM_MPI	MPI parallel solver, the init function has the form
+				init(int max_block_size, MPI_Comm comm, int master_rank)
+				All program flow controlling decisions are made by the
+				master rank and broadcast to the other ranks.
+
+RK_THREADING	OpenMP work sharing policy
+		RK_THREADS_NONE		no OpenMP directives at all
+		RK_THREADS_INNER	the whole time loop runs in a parallel region, the loops
+					over the elements of each chunk are work-shared
+					(suitable for a small amount of large chunks)
+		RK_THREADS_OUTER	the whole time loop runs in a parallel region, the loop
+					over the chunks is work-shared
+					(suitable for a large amount of small chunks)
+		RK_THREADS_COLLAPSED	the whole time loop runs in a parallel region, the chunks
+					are concatenated into one virtual index range which is split
+					evenly among the threads regardless of the chunk boundaries
+					(suitable for chunks of strongly varying size)
+		RK_THREADS_RUNTIME	any of the three strategies above, selected at run time
+					(see the set_tuning and autotune functions of RK_MPI_SAsolver.h).
+					The loops of the INNER and OUTER strategies use schedule(runtime)
+					once a schedule has been set, the default schedule before.
+					The default strategy is OUTER.
+		With any policy other than RK_THREADS_NONE, the right hand side is called
+		BY ALL THREADS and it must use orphaned OpenMP directives for work sharing.
+
+RK_MEMORY	memory layout of the solution
+		RK_MEM_DENSE	the solution is a contiguous array of 'int n' elements
+		RK_MEM_SPARSE	the solution is split into chunks described by RK_MEM_DIST
+				(see RK_MPI_SAsolver.h). The solution structure also contains
+				the 'delta_mode' and 'steps_total' members.
+
+RK_SCHEME	the integration scheme
+		RK_SCHEME_MERSON	Merson's 4th order scheme with adaptive time stepping,
+					solve(FLOAT final_time, solution *)
+		RK_SCHEME_RK4		the standard 4th order scheme with a fixed time step,
+					solve(int steps, solution *)
+		RK_SCHEME_RK4_LOWMEM	the same scheme as RK_SCHEME_RK4, optimized for memory
+					consumption (3 auxiliary arrays instead of 5)
+
+RK_SOLUTION_TYPE	the name of the structure type describing the solved system
+RK_FN(name)		expands 'name' to the public function name of the module
+			(e.g. RK_FN(solve) -> RK_MPI_SA_solve)
+
+Optionally:
+
+RK_CALLBACKS	define it if the solution structure contains the 'Service_Callback' and
+		'DDLBF_Rearrange' members (only used by RK_SCHEME_MERSON)
+
+The public header of a module using RK_COMM_MPI must define the RKA_CMD_* commands
+(including RKA_CMD_SWITCH) as well as MPI__FLOAT.
+*/
+
+#define RK_COMM_NONE		0
+#define RK_COMM_MPI		1
+
+#define RK_THREADS_NONE		0
+#define RK_THREADS_INNER	1
+#define RK_THREADS_OUTER	2
+#define RK_THREADS_COLLAPSED	3
+#define RK_THREADS_RUNTIME	4
+
+#define RK_MEM_DENSE		0
+#define RK_MEM_SPARSE		1
+
+#define RK_SCHEME_MERSON	0
+#define RK_SCHEME_RK4		1
+#define RK_SCHEME_RK4_LOWMEM	2
+
+/* ========================================== */
+
+/*
+Stiffness detection modes of the Merson solvers (see the stiffness function in RK_MPI_SAsolver.h,
+RK_MPI_Asolver.h and RK_Asolver.h)
+*/
+#define RK_STIFF_OFF		0	/* no stiffness detection (default) */
+#define RK_STIFF_DETECT		1	/* estimate the stiffness in each time step and report it */
+#define RK_STIFF_SWITCH		2	/* moreover, switch to the Rosenbrock method while the problem is stiff */
+
+/*
+Error norms of the Merson solvers (see the error_norm function in RK_MPI_SAsolver.h, RK_MPI_Asolver.h
+and RK_Asolver.h)
+*/
+#define RK_NORM_MAX		0	/* the maximum of the error estimates of all elements (default) */
+#define RK_NORM_RMS		1	/* the root mean square of the error estimates scaled by atol+rtol*|x| */
+
+/* the stiffness telemetry of the Merson solvers */
+typedef struct {
+	double rho;			/* the last estimate of the dominant eigenvalue magnitude of the Jacobian */
+	double h_rho;			/* the product of rho and the time step. The Merson scheme is only
+					   stable for h_rho below approx. 3.5 */
+	int stiff;			/* nonzero while the Rosenbrock method is in use */
+	long stiff_steps;		/* the number of successful time steps with h_rho above the stiffness threshold */
+	long rosenbrock_steps;		/* the number of successful time steps performed by the Rosenbrock method */
+	long switches;			/* the number of switches between the Merson and the Rosenbrock method */
+	long krylov_iterations;		/* the total number of iterations of the linear solver (Rosenbrock method) */
+	long krylov_failures;		/* the number of time steps rejected because the linear solver failed */
+} RK_STIFFNESS;
+
+#endif		/* __RK_engine */
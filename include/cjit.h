@@ -0,0 +1,87 @@
+/***************************************************\
+* CJIT: run-time compilation of generated C code    *
+* into cached shared objects                        *
+* (C) 2026 PorousFreezeThaw contributors            *
+* file: cjit.h                                      *
+\***************************************************/
+
+#if !defined __cjit
+#define __cjit
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+CJIT lets an application generate C source code at run time (e.g. from formulas given in a parameter
+file), compile it by the local C compiler into a shared object and bind the functions defined there.
+The compiled objects are cached: the shared object is named after a 64-bit FNV-1a hash of the source
+code, the compiler command, the compiler flags and the machine type, so that a code that has already
+been compiled once is loaded without invoking the compiler again.
+
+The cache directory may be shared by several processes (e.g. MPI ranks on a cluster with a shared
+file system): each process compiles into a temporary file of its own and then renames it atomically
+to the final name. Nodes with a node-local cache directory simply compile the code themselves.
+
+The compiler is invoked through the command processor (system()) as
+
+	<compiler> CJIT_FLAGS -o <object> <source> -lm
+
+where 'compiler' may contain additional options (e.g. "gcc -march=native"). The generated source,
+the compiler output (.log) and the shared object are kept in the cache directory as
+cjit_<hash>.c, cjit_<hash>.log and cjit_<hash>.so.
+
+IMPORTANT: On some systems, you must link your program with -ldl in order to use this module.
+*/
+
+#define CJIT_FLAGS	"-O2 -fPIC -shared"
+
+typedef unsigned long long CJIT_HASH;
+
+CJIT_HASH cjit_hash(const char * source, const char * compiler);
+/*
+returns the hash identifying the shared object compiled from 'source' by 'compiler'
+*/
+
+int cjit_build(const char * source, const char * compiler, const char * cache_dir, char * so_path, int so_path_size);
+/*
+makes sure that the shared object compiled from 'source' exists in 'cache_dir' and stores its path
+to 'so_path' (at most 'so_path_size' characters including the terminating null character).
+If 'compiler' is NULL or empty, "cc" is used. If 'cache_dir' is NULL or empty, the current working
+directory is used.
+
+return codes:
+0	success, the source has been compiled
+1	success, the shared object has been found in the cache
+-1	invalid arguments (e.g. the paths are too long or contain single quotes)
+-2	the source code could not be written to the cache directory
+-3	the command processor is not available
+-4	compilation failed (the compiler output is in the .log file next to 'so_path')
+*/
+
+void * cjit_open(const char * so_path);
+/*
+loads the shared object 'so_path' and resolves all its symbols. Returns a handle or NULL on error.
+*/
+
+void * cjit_symbol(void * handle, const char * name);
+/*
+returns the address of the function (or variable) 'name' defined in the loaded shared object 'handle'
+or NULL if there is no such symbol
+*/
+
+const char * cjit_error(void);
+/*
+returns a human-readable description of the last error of cjit_open() or cjit_symbol()
+*/
+
+void cjit_close(void * handle);
+/*
+unloads the shared object. The pointers obtained by cjit_symbol() must not be used any more.
+*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif		/* __cjit */
@@ -43,6 +43,7 @@ NOTE:	1) only the most common functions are defined here
 	#define cosf(x)		( (float) cos ((float)(x)) )
 	#define coshf(x)	( (float) cosh ((float)(x)) )
 	#define expf(x)		( (float) exp ((float)(x)) )
+	#define expm1f(x)	( (float) expm1 ((float)(x)) )
 	#define fabsf(x)	( (float) fabs ((float)(x)) )
 	#define floorf(x)	( (float) floor ((float)(x)) )
 	#define logf(x)		( (float) log ((float)(x)) )
@@ -70,6 +71,7 @@ NOTE:	1) only the most common functions are defined here
 	#define cosl(x)		( (long double) cos ((long double)(x)) )
 	#define coshl(x)	( (long double) cosh ((long double)(x)) )
 	#define expl(x)		( (long double) exp ((long double)(x)) )
+	#define expm1l(x)	( (long double) expm1 ((long double)(x)) )
 	#define fabsl(x)	( (long double) fabs ((long double)(x)) )
 	#define floorl(x)	( (long double) floor ((long double)(x)) )
 	#define logl(x)		( (long double) log ((long double)(x)) )
@@ -107,6 +109,7 @@ to always use these names instead of the standard functions.
 	#define cosF		cosf
 	#define coshF		coshf
 	#define expF		expf
+	#define expm1F		expm1f
 	#define fabsF		fabsf
 	#define floorF		floorf
 	#define logF		logf
@@ -133,6 +136,7 @@ to always use these names instead of the standard functions.
 	#define cosF		cos
 	#define coshF		cosh
 	#define expF		exp
+	#define expm1F		expm1
 	#define fabsF		fabs
 	#define floorF		floor
 	#define logF		log
@@ -159,6 +163,7 @@ to always use these names instead of the standard functions.
 	#define cosF		cosl
 	#define coshF		coshl
 	#define expF		expl
+	#define expm1F		expm1l
 	#define fabsF		fabsl
 	#define floorF		floorl
 	#define logF		logl
@@ -178,4 +183,149 @@ to always use these names instead of the standard functions.
 	#define copysignF	copysignl
 #endif
 
+/*
+Vectorizable versions of the transcendental functions used in the hot loops (the 'v' prefix, FLOAT arguments).
+Unlike the libm calls, they are inlined and free of branches and function calls, so that the loops that call them
+(e.g. marked by "omp simd") can be vectorized. The accuracy is selected at compile time:
+
+	(default) ............	full accuracy (a few ULP of FLOAT)
+	-D __VMATH_RELAXED ...	relaxed accuracy (about 1e-8 relative error in double, 3e-6 in float precision)
+	-D __VMATH_LIBM ......	the libm functions are called instead (use this to compare the results)
+
+The errors with respect to libm and the speed are measured by apps/vmath-check. Overflow, underflow (including
+the subnormal results), infinities and NaN are handled as by libm. vsqrtF() is the correctly rounded square root
+in all cases: the compiler vectorizes it as long as it need not set errno (-fno-math-errno). For the 'long double'
+FLOAT type, the libm functions are always used.
+*/
+
+#if defined _OPENMP && _OPENMP >= 201307
+	#define VMATH_DECLARE_SIMD	_Pragma("omp declare simd notinbranch")
+#else
+	#define VMATH_DECLARE_SIMD
+#endif
+
+#if !defined __VMATH_LIBM && (_DEFAULT_FP_PRECISION == FP_DOUBLE || _DEFAULT_FP_PRECISION == FP_FLOAT)
+
+#include <stdint.h>
+
+/*
+exp(x) = 2^n * exp(r), where n is the nearest integer to x/ln(2) and |r| <= ln(2)/2. ln(2) is split into two
+parts (Cody & Waite) so that r is exact. expm1(r) is the Taylor polynomial of the degree __VMATH_DEGREE, whose
+truncation error on this interval is below the rounding error (or the relaxed tolerance). 2^n is assembled
+in the exponent bits of two factors 2^(n/2) and 2^(n-n/2), so that their product overflows or underflows
+exactly like exp(x) does.
+
+NOTE:	The arguments are limited by selecting copysign(bound,x) rather than a constant bound. With a constant,
+	the compiler (gcc) propagates it through the whole function and the branches thus created prevent
+	the vectorization.
+*/
+#if _DEFAULT_FP_PRECISION == FP_DOUBLE
+	typedef uint64_t __vmath_bits;
+	typedef int32_t __vmath_int;
+	#define __VMATH_MANT	52
+	#define __VMATH_BIAS	1023
+	#define __VMATH_NMAX	1077.0				/* exp(x) is 0 or infinity beyond n = +-NMAX */
+	#define __VMATH_LN2_HI	6.93147180369123816490e-01
+	#define __VMATH_LN2_LO	1.90821492927058770002e-10
+	#ifdef __VMATH_RELAXED
+		#define __VMATH_DEGREE	7
+	#else
+		#define __VMATH_DEGREE	13
+	#endif
+#else
+	typedef uint32_t __vmath_bits;
+	typedef int32_t __vmath_int;
+	#define __VMATH_MANT	23
+	#define __VMATH_BIAS	127
+	#define __VMATH_NMAX	151.0f
+	#define __VMATH_LN2_HI	6.93145751953125e-01f
+	#define __VMATH_LN2_LO	1.42860676533018704e-06f
+	#ifdef __VMATH_RELAXED
+		#define __VMATH_DEGREE	5
+	#else
+		#define __VMATH_DEGREE	7
+	#endif
+#endif
+
+/* 1/k! for k = 0 ... 13 */
+static const FLOAT __vmath_inv_fact[14] = {
+	1.0, 1.0, 1.0/2, 1.0/6, 1.0/24, 1.0/120, 1.0/720, 1.0/5040, 1.0/40320, 1.0/362880,
+	1.0/3628800, 1.0/39916800, 1.0/479001600, 1.0/6227020800.0
+};
+
+static inline FLOAT __vexp_reduce(FLOAT x, FLOAT * s1, FLOAT * s2)
+/* splits exp(x) into s1 * s2 * (1 + p) and returns p = expm1(r) */
+{
+	FLOAT y = x * (FLOAT)1.44269504088896340736;
+	FLOAT r, p;
+	__vmath_int n, n1;
+	union { FLOAT f; __vmath_bits b; } b1, b2;
+	int k;
+
+	y = fabsF(y) > __VMATH_NMAX ? copysignF(__VMATH_NMAX, y) : y;
+	n = (__vmath_int)(y + copysignF((FLOAT)0.5, y));
+	n1 = n/2;
+
+	/* r is NaN if x is; beyond the range of n, it is limited for the polynomial to remain finite */
+	r = (x - n*__VMATH_LN2_HI) - n*__VMATH_LN2_LO;
+	r = fabsF(r) > (FLOAT)0.5 ? copysignF((FLOAT)0.5, r) : r;
+
+	b1.b = (__vmath_bits)(n1 + __VMATH_BIAS) << __VMATH_MANT;
+	b2.b = (__vmath_bits)(n - n1 + __VMATH_BIAS) << __VMATH_MANT;
+	*s1 = b1.f;
+	*s2 = b2.f;
+
+	for(p=__vmath_inv_fact[__VMATH_DEGREE],k=__VMATH_DEGREE-1;k>0;k--) p = p*r + __vmath_inv_fact[k];
+	return(p*r);
+}
+
+VMATH_DECLARE_SIMD
+static inline FLOAT vexpF(FLOAT x)
+{
+	FLOAT s1, s2, p = __vexp_reduce(x, &s1, &s2);
+
+	return( s1 * (s2 + s2*p) );
+}
+
+VMATH_DECLARE_SIMD
+static inline FLOAT vexpm1F(FLOAT x)
+/* exp(x) - 1: for |x| <= ln(2)/2, n is 0 and the result is the polynomial itself */
+{
+	FLOAT s1, s2, p = __vexp_reduce(x, &s1, &s2);
+	FLOAT s = s1*s2;
+
+	return( s*p + (s - (FLOAT)1.0) );
+}
+
+VMATH_DECLARE_SIMD
+static inline FLOAT vtanhF(FLOAT x)
+/* tanh(|x|) = -expm1(-2|x|) / (2 + expm1(-2|x|)) */
+{
+	FLOAT e = vexpm1F((FLOAT)-2.0*fabsF(x));
+
+	return( copysignF(-e/((FLOAT)2.0+e), x) );
+}
+
+VMATH_DECLARE_SIMD
+static inline FLOAT vcoshF(FLOAT x)
+{
+	FLOAT e = vexpF(fabsF(x));
+
+	return( (FLOAT)0.5*(e + (FLOAT)1.0/e) );
+}
+
+VMATH_DECLARE_SIMD
+static inline FLOAT vsqrtF(FLOAT x)
+{
+	return( sqrtF(x) );
+}
+
+#else
+	#define vexpF(x)	expF(x)
+	#define vexpm1F(x)	expm1F(x)
+	#define vtanhF(x)	tanhF(x)
+	#define vcoshF(x)	coshF(x)
+	#define vsqrtF(x)	sqrtF(x)
+#endif
+
 #endif
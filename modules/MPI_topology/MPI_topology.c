@@ -0,0 +1,366 @@
+/***************************************************\
+* Topology-aware MPI rank placement                 *
+* and OpenMP thread affinity                        *
+* (C) 2026 PorousFreezeThaw contributors            *
+* file: MPI_topology.c                              *
+\***************************************************/
+
+/* the CPU affinity interface of the GNU C library (sched_getaffinity(), CPU_SET() etc.) */
+#define _GNU_SOURCE
+
+#include "common.h"
+#include "MPI_topology.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#ifdef __linux__
+	#include <sched.h>
+	#include <unistd.h>
+#endif
+
+#ifdef _OPENMP
+	#include <omp.h>
+#endif
+
+/* ========================================== */
+/* CPU topology discovery */
+
+#ifdef __linux__
+
+static int read_topology_value(int cpu, const char * name)
+/* reads /sys/devices/system/cpu/cpu<cpu>/topology/<name>. Returns -1 if not available */
+{
+	char path[256];
+	FILE * f;
+	int value=-1;
+
+	sprintf(path, "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, name);
+	if((f=fopen(path,"r")) == NULL) return(-1);
+	if(fscanf(f, "%d", &value) != 1) value=-1;
+	fclose(f);
+	return(value);
+}
+
+typedef struct {
+	int cpu, socket, core;
+} CPU_INFO;
+
+static int compare_cpus(const void * a, const void * b)
+/* the compact order: socket, core, hardware thread */
+{
+	const CPU_INFO * A=(const CPU_INFO *)a, * B=(const CPU_INFO *)b;
+
+	if(A->socket != B->socket) return(A->socket - B->socket);
+	if(A->core != B->core) return(A->core - B->core);
+	return(A->cpu - B->cpu);
+}
+
+static CPU_INFO * list_cpus(const cpu_set_t * mask, int * count)
+/* lists the CPUs in 'mask' in the compact order. Returns NULL if there is not enough memory */
+{
+	CPU_INFO * cpus;
+	int cpu, n=0;
+
+	if((cpus=(CPU_INFO *)malloc((CPU_COUNT(mask)+1)*sizeof(CPU_INFO))) == NULL) return(NULL);
+
+	for(cpu=0;cpu<CPU_SETSIZE;cpu++)
+		if(CPU_ISSET(cpu, mask)) {
+			cpus[n].cpu=cpu;
+			cpus[n].socket=read_topology_value(cpu, "physical_package_id");
+			cpus[n].core=read_topology_value(cpu, "core_id");
+			n++;
+		}
+
+	qsort(cpus, n, sizeof(CPU_INFO), compare_cpus);
+	*count=n;
+	return(cpus);
+}
+
+#endif		/* __linux__ */
+
+static void get_placement(int * socket, int * first_cpu, int * n_cpus)
+/* finds the first CPU the calling process may run on, its socket and the number of CPUs in the affinity mask */
+{
+	*socket=-1;
+	*first_cpu=-1;
+	*n_cpus=0;
+
+#ifdef __linux__
+	{
+		cpu_set_t mask;
+		int cpu;
+
+		if(sched_getaffinity(0, sizeof(mask), &mask)) return;
+
+		for(cpu=0;cpu<CPU_SETSIZE;cpu++)
+			if(CPU_ISSET(cpu, &mask)) {
+				*socket=read_topology_value(cpu, "physical_package_id");
+				*first_cpu=cpu;
+				break;
+			}
+
+		*n_cpus=CPU_COUNT(&mask);
+	}
+#endif
+}
+
+/* ========================================== */
+/* rank map */
+
+typedef struct {
+	int rank;		/* the real rank */
+	int node_key;		/* the lowest real rank on the same node */
+	int socket;
+	int first_cpu;		/* the first CPU and the number of CPUs in the affinity mask */
+	int n_cpus;
+	int group;		/* the sort key: 0 for the master's node, 1 otherwise */
+	int master_socket;	/* the sort key: 0 for the master's socket, 1 otherwise (master's node only) */
+	int is_master;		/* the sort key */
+} RANK_INFO;
+
+#define RANK_INFO_INTS	5	/* the number of members exchanged among the ranks */
+
+static int compare_ranks(const void * a, const void * b)
+{
+	const RANK_INFO * A=(const RANK_INFO *)a, * B=(const RANK_INFO *)b;
+
+	if(A->group != B->group) return(A->group - B->group);
+	if(A->node_key != B->node_key) return(A->node_key - B->node_key);
+	if(A->is_master != B->is_master) return(B->is_master - A->is_master);
+	if(A->master_socket != B->master_socket) return(A->master_socket - B->master_socket);
+	if(A->socket != B->socket) return(A->socket - B->socket);
+	return(A->rank - B->rank);
+}
+
+static int node_key(MPI_Comm comm, int rank, int procs, int * alloc_error)
+/* returns the lowest real rank running on the same node as the calling rank */
+{
+	int key=rank;
+
+#if MPI_VERSION >= 3
+	MPI_Comm node_comm;
+
+	(void)procs; (void)alloc_error;
+	MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node_comm);
+	MPI_Allreduce(&rank, &key, 1, MPI_INT, MPI_MIN, node_comm);
+	MPI_Comm_free(&node_comm);
+#else
+	/* compare the processor names */
+	char name[MPI_MAX_PROCESSOR_NAME];
+	char * names;
+	int length, i;
+
+	memset(name, 0, sizeof(name));
+	MPI_Get_processor_name(name, &length);
+
+	names=(char *)malloc((size_t)procs*MPI_MAX_PROCESSOR_NAME);
+	if(names==NULL) *alloc_error=1;
+
+	/* all ranks must take part in the collective operation or none of them */
+	MPI_Allreduce(alloc_error, &i, 1, MPI_INT, MPI_MAX, comm);
+	if(i) *alloc_error=1;
+	else {
+		MPI_Allgather(name, MPI_MAX_PROCESSOR_NAME, MPI_CHAR, names, MPI_MAX_PROCESSOR_NAME, MPI_CHAR, comm);
+		for(i=0;i<procs;i++)
+			if(!strncmp(names+(size_t)i*MPI_MAX_PROCESSOR_NAME, name, MPI_MAX_PROCESSOR_NAME)) { key=i; break; }
+		free(names);
+	}
+#endif
+
+	return(key);
+}
+
+int MPI_topology_rankmap(MPI_Comm comm, int master_rank, int * rankmap, MPI_TOPOLOGY * info)
+{
+	int rank, procs, i;
+	int mine[RANK_INFO_INTS], * all;
+	RANK_INFO * ranks;
+	int alloc_error=0, any_alloc_error;
+
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &procs);
+
+	if(master_rank<0 || master_rank>=procs) return(-2);
+
+	/* the fallback (and the initial state for the single rank case) */
+	for(i=0;i<procs;i++) rankmap[i]=i;
+	rankmap[master_rank]=0;
+	rankmap[0]=master_rank;
+
+	mine[0]=rank;
+	mine[1]=node_key(comm, rank, procs, &alloc_error);
+	get_placement(mine+2, mine+3, mine+4);
+
+	if(info != NULL) {
+		/* the placement is unknown if the topology-aware map cannot be built */
+		info->node=0; info->n_nodes=1;
+		info->node_rank=0; info->node_size=1;
+		info->socket=mine[2];
+		info->restricted=0;
+	}
+
+	all=(int *)malloc((size_t)procs*RANK_INFO_INTS*sizeof(int));
+	ranks=(RANK_INFO *)malloc((size_t)procs*sizeof(RANK_INFO));
+	if(all==NULL || ranks==NULL) alloc_error=1;
+
+	/* either all ranks use the topology-aware map or none of them */
+	MPI_Allreduce(&alloc_error, &any_alloc_error, 1, MPI_INT, MPI_MAX, comm);
+	if(any_alloc_error) {
+		free(all); free(ranks);
+		return(-1);
+	}
+
+	MPI_Allgather(mine, RANK_INFO_INTS, MPI_INT, all, RANK_INFO_INTS, MPI_INT, comm);
+
+	for(i=0;i<procs;i++) {
+		ranks[i].rank=all[RANK_INFO_INTS*i];
+		ranks[i].node_key=all[RANK_INFO_INTS*i+1];
+		ranks[i].socket=all[RANK_INFO_INTS*i+2];
+		ranks[i].first_cpu=all[RANK_INFO_INTS*i+3];
+		ranks[i].n_cpus=all[RANK_INFO_INTS*i+4];
+	}
+	for(i=0;i<procs;i++) {
+		ranks[i].is_master=(i==master_rank);
+		ranks[i].group=(ranks[i].node_key!=ranks[master_rank].node_key);
+		ranks[i].master_socket=(ranks[i].group==0 && ranks[i].socket!=ranks[master_rank].socket);
+	}
+
+	qsort(ranks, procs, sizeof(RANK_INFO), compare_ranks);
+
+	for(i=0;i<procs;i++) rankmap[i]=ranks[i].rank;
+
+	if(info != NULL) {
+		int node=-1, node_rank=0, my_node=0, my_node_key=mine[1];
+
+		info->node_size=0;
+		for(i=0;i<procs;i++) {
+			if(i==0 || ranks[i].node_key!=ranks[i-1].node_key) { node++; node_rank=0; }
+			if(ranks[i].node_key==my_node_key) {
+				if(ranks[i].rank==rank) { my_node=node; info->node_rank=node_rank; }
+				/* the ranks sharing the same affinity mask have not been bound by the launcher */
+				if(ranks[i].first_cpu!=mine[3] || ranks[i].n_cpus!=mine[4]) info->restricted=1;
+				info->node_size++;
+			}
+			node_rank++;
+		}
+		info->node=my_node;
+		info->n_nodes=node+1;
+	}
+
+	free(all);
+	free(ranks);
+	return(0);
+}
+
+/* ========================================== */
+/* thread affinity */
+
+#ifdef __linux__
+
+static void print_cpu_ranges(char * dest, int dest_size, const int * cpu, int n)
+/* prints the list of CPU numbers as a comma separated list of ranges (e.g. "0-3,8,10-11") */
+{
+	int i=0, used=0;
+
+	*dest=0;
+	while(i<n && used<dest_size) {
+		int j=i;
+		while(j+1<n && cpu[j+1]==cpu[j]+1) j++;
+		if(j>i) used+=snprintf(dest+used, dest_size-used, "%s%d-%d", i ? "," : "", cpu[i], cpu[j]);
+		else used+=snprintf(dest+used, dest_size-used, "%s%d", i ? "," : "", cpu[i]);
+		i=j+1;
+	}
+}
+
+#endif		/* __linux__ */
+
+static int proc_bind_requested(const char * value)
+/* returns nonzero if the value of OMP_PROC_BIND asks for binding (its first policy is true, close, spread, master or primary) */
+{
+	const char * policy[] = { "true", "close", "spread", "master", "primary" };
+	char first[16];
+	int i;
+
+	while(isspace((unsigned char)*value)) value++;
+	for(i=0; i<15 && value[i] && value[i]!=',' && !isspace((unsigned char)value[i]); i++) first[i]=tolower((unsigned char)value[i]);
+	first[i]=0;
+	for(i=0;i<(int)(sizeof(policy)/sizeof(policy[0]));i++)
+		if(!strcmp(first, policy[i])) return(1);
+	return(0);
+}
+
+int MPI_topology_bind_threads(int n_threads, const MPI_TOPOLOGY * info, char * report, int report_size)
+{
+	const char * omp_binding[] = { "OMP_PROC_BIND", "OMP_PLACES", "GOMP_CPU_AFFINITY", "KMP_AFFINITY" };
+	const char * value;
+	int i;
+
+	/* OMP_PROC_BIND=FALSE (as set by the Run scripts) does not request binding */
+	for(i=0;i<(int)(sizeof(omp_binding)/sizeof(omp_binding[0]));i++)
+		if((value=getenv(omp_binding[i])) != NULL && (i>0 || proc_bind_requested(value))) {
+			snprintf(report, report_size, "threads bound by the OpenMP runtime (%s=%s)", omp_binding[i], value);
+			return(1);
+		}
+
+#ifdef __linux__
+	{
+		cpu_set_t mask;
+		CPU_INFO * cpus;
+		int * thread_cpu;
+		int n_cpus, first, count, failed=0;
+		char ranges[512];
+
+		if(n_threads<1) n_threads=1;
+
+		if(sched_getaffinity(0, sizeof(mask), &mask) || (cpus=list_cpus(&mask, &n_cpus)) == NULL || n_cpus==0) {
+			snprintf(report, report_size, "threads not bound (cannot obtain the CPU affinity mask)");
+			return(-1);
+		}
+
+		/* the range of CPUs for this rank */
+		first=0; count=n_cpus;
+		if(info != NULL && !info->restricted && info->node_size>1) {
+			first=(int)((long)info->node_rank*n_cpus/info->node_size);
+			count=(int)((long)(info->node_rank+1)*n_cpus/info->node_size)-first;
+			if(count<=0) { first=info->node_rank%n_cpus; count=1; }
+		}
+
+		if((thread_cpu=(int *)malloc(n_threads*sizeof(int))) == NULL) {
+			free(cpus);
+			snprintf(report, report_size, "threads not bound (not enough memory)");
+			return(-1);
+		}
+		for(i=0;i<n_threads;i++) thread_cpu[i]=cpus[first+i%count].cpu;
+
+		#pragma omp parallel num_threads(n_threads) reduction(+:failed)
+		{
+			cpu_set_t thread_mask;
+#ifdef _OPENMP
+			int t=omp_get_thread_num();
+#else
+			int t=0;
+#endif
+			CPU_ZERO(&thread_mask);
+			CPU_SET(thread_cpu[t], &thread_mask);
+			/* with the pid 0, the affinity of the calling thread is set */
+			if(sched_setaffinity(0, sizeof(thread_mask), &thread_mask)) failed++;
+		}
+
+		print_cpu_ranges(ranges, sizeof(ranges), thread_cpu, n_threads);
+		snprintf(report, report_size, "%s%d thread%s bound to CPU%s %s (socket %d)",
+			failed ? "FAILED: " : "", n_threads, n_threads>1 ? "s" : "", n_threads>1 ? "s" : "",
+			ranges, cpus[first].socket);
+
+		free(thread_cpu);
+		free(cpus);
+		return(failed ? -1 : 0);
+	}
+#else
+	(void)n_threads; (void)info;
+	snprintf(report, report_size, "threads not bound (not supported on this platform)");
+	return(1);
+#endif
+}
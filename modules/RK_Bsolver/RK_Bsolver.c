@@ -0,0 +1,262 @@
+/***************************************************\
+* 4th order Runge - Kutta solver                    *
+* Merson's modification with adaptive time stepping *
+* - batched version for many small systems          *
+* (C) 2026 PorousFreezeThaw contributors            *
+* file: RK_Bsolver.c                                *
+\***************************************************/
+
+/*
+The batches are independent and they are distributed among the OpenMP threads dynamically, since
+the number of time steps may differ a lot from one batch to another. Within a batch, all loops run
+over the RK_B_LANES systems in the innermost position, with per-system values of the time step,
+the error estimate etc. kept in small arrays. The loops are marked by "omp simd" if the compiler
+supports OpenMP 4.0. Otherwise, they are simple enough to be vectorized automatically.
+*/
+
+#include "common.h"
+#include "mathspec.h"
+#include "RK_Bsolver.h"
+
+#include <stdlib.h>
+
+#ifdef __OPENMP
+	#include <omp.h>
+#endif
+
+/* the loop over the systems of a batch */
+#if defined _OPENMP && _OPENMP >= 201307
+	#define LANE_LOOP	_Pragma("omp simd") for(l=0;l<RK_B_LANES;l++)
+#else
+	#define LANE_LOOP	for(l=0;l<RK_B_LANES;l++)
+#endif
+
+/* a loop over all elements of the batch: 'j' is the component, 'l' is the system and 'i' is the position */
+#define BATCH_SWEEP(...)	for(j=0;j<n;j++) { const int o=j*RK_B_LANES; LANE_LOOP { const int i=o+l; __VA_ARGS__; } }
+
+/* the number of auxiliary arrays per thread (K1,K3,K4,K5,aux) */
+#define AUX_ARRAYS	5
+
+static int max_n=0;			/* the maximum system dimension */
+static int n_threads=1;			/* the number of threads the auxiliary arrays have been allocated for */
+static FLOAT * workspace=NULL;		/* AUX_ARRAYS arrays of max_n*RK_B_LANES elements for each thread */
+
+int RK_B_init(int max_system_dimension)
+{
+	if(max_n) return(-3);
+	if(max_system_dimension<=0) return(-2);
+
+#ifdef __OPENMP
+	n_threads=omp_get_max_threads();
+#else
+	n_threads=1;
+#endif
+
+	workspace=(FLOAT *)malloc((size_t)n_threads*AUX_ARRAYS*max_system_dimension*RK_B_LANES*sizeof(FLOAT));
+	if(workspace==NULL) return(-1);
+
+	max_n=max_system_dimension;
+	return(0);
+}
+
+int RK_B_cleanup(void)
+{
+	if(!max_n) return(-3);
+	free(workspace);
+	workspace=NULL;
+	max_n=0;
+	return(0);
+}
+
+static int RK_B_solve_batch(FLOAT final_time, RK_B_SOLUTION * system, int batch, FLOAT * ws, long * steps_total)
+/*
+integrates the systems of one batch up to 'final_time'. 'ws' are the auxiliary arrays of the calling thread.
+Returns nonzero if some of the systems had to be stopped due to NANs.
+*/
+{
+	const int n=system->n;
+	const int first=batch*RK_B_LANES;
+	const size_t nL=(size_t)n*RK_B_LANES;
+
+	const FLOAT delta=system->delta;
+	const FLOAT h_min=system->h_min;
+
+	FLOAT * x = system->x + batch*nL;
+	FLOAT *K1=ws, *K3=ws+nL, *K4=ws+2*nL, *K5=ws+3*nL, *aux=ws+4*nL;
+	FLOAT *K2=K3;		/* we don't have to remember K2 */
+
+	/* the state of the individual systems */
+	FLOAT t[RK_B_LANES];		/* time level */
+	FLOAT h[RK_B_LANES];		/* time step (0 for finished systems) */
+	FLOAT h_est[RK_B_LANES];	/* the last time step estimate before trimming (stored to system->h) */
+	char finishing[RK_B_LANES];	/* nonzero if the current time step has been trimmed to reach final_time */
+	char active[RK_B_LANES];	/* nonzero for the systems that have not finished yet */
+
+	/* per-system auxiliary values of the current time step */
+	FLOAT ts[RK_B_LANES];		/* the time level of the current stage */
+	FLOAT h3[RK_B_LANES], h6[RK_B_LANES], h8[RK_B_LANES];
+	FLOAT eps[RK_B_LANES];		/* the error estimate (maximum over the components) */
+	FLOAT eps_sum[RK_B_LANES];	/* the sum of the components' errors (only used to detect NANs and +-INF) */
+	FLOAT h_upd[RK_B_LANES];	/* h/3 for accepted steps, 0 otherwise (the update mask) */
+
+	int n_active=0, failed=0;
+	int l, j;
+
+	for(l=0;l<RK_B_LANES;l++) {
+		const int s=first+l;
+		finishing[l]=0;
+		if(s<system->n_systems) {
+			t[l]=system->t[s];
+			h[l]=system->h[s];
+			active[l]=(t[l]!=final_time);
+		} else {
+			/* padding system */
+			t[l]=final_time;
+			active[l]=0;
+			for(j=0;j<n;j++) x[j*RK_B_LANES+l]=0.0;
+		}
+		h_est[l]=h[l];
+
+		if(active[l]) {
+			/* automatically reverse and also perform initial adjustment */
+			if((final_time>t[l] && h[l]<0) || (final_time<t[l] && h[l]>0)) h[l]*=-1;
+			if(h[l]==0 || fabsF(final_time-t[l])<=fabsF(h[l])) {
+				h[l]=final_time-t[l];
+				finishing[l]=1;
+			}
+			n_active++;
+		} else h[l]=0.0;
+	}
+
+	while(n_active) {
+		(*steps_total)++;
+
+		LANE_LOOP {
+			h3[l]=h[l]/3.0; h6[l]=h[l]/6.0; h8[l]=h[l]/8.0;
+		}
+
+	/* K1 --------------------------------------- */
+
+		system->f(t,x,K1,first);
+
+	/* K2 --------------------------------------- */
+
+		LANE_LOOP ts[l]=t[l]+h3[l];
+		BATCH_SWEEP( aux[i] = K1[i]*h3[l] + x[i] )
+		system->f(ts,aux,K2,first);
+
+	/* K3 --------------------------------------- */
+
+		BATCH_SWEEP( aux[i] = ( K1[i] + K2[i] )*h6[l] + x[i] )
+		system->f(ts,aux,K3,first);
+
+	/* K4 --------------------------------------- */
+
+		LANE_LOOP ts[l]=t[l]+0.5*h[l];
+		BATCH_SWEEP( aux[i] = ( K1[i] + 3.0 * K3[i] )*h8[l] + x[i] )
+		system->f(ts,aux,K4,first);
+
+	/* K5 --------------------------------------- */
+
+		LANE_LOOP ts[l]=t[l]+h[l];
+		BATCH_SWEEP( aux[i] = ( 0.5 * K1[i] - 1.5 * K3[i] + 2.0 * K4[i] )*h[l] + x[i] )
+		system->f(ts,aux,K5,first);
+
+	/* ========================================== */
+
+		/* calculate the error estimates of all systems */
+		LANE_LOOP { eps[l]=0.0; eps_sum[l]=0.0; }
+		BATCH_SWEEP(
+			FLOAT e = fabsF( 0.2 * K1[i] - 0.9 * K3[i] + 0.8 * K4[i] - 0.1 * K5[i] );
+			eps[l] = (e>eps[l]) ? e : eps[l];
+			eps_sum[l] += e
+		)
+
+		/* step control of the individual systems (the same logic as in RK_A_solve()) */
+		for(l=0;l<RK_B_LANES;l++) {
+			FLOAT new_h;
+
+			h_upd[l]=0.0;
+			if(!active[l]) continue;
+
+			if(! isfinite(eps_sum[l])) {
+				/* NAN or +-INF: try again with a smaller time step unless it is already too small */
+				if(h[l]/(final_time-t[l])<1e-11) {
+					active[l]=0;
+					h[l]=0.0;
+					n_active--;
+					failed=1;
+				} else {
+					h[l]/=10;
+					finishing[l]=0;
+				}
+				continue;
+			}
+
+			new_h = ((eps[l]>0.0) ? powF((delta/eps[l]),0.2)*0.8 : 2.0) * h[l];	/* double the time step if eps==0 */
+
+			if(eps[l]<delta || fabsF(h[l])<h_min) {
+				/* the step is successful */
+				h_upd[l]=h3[l];
+
+				if(finishing[l]) {
+					t[l]=final_time;
+					active[l]=0;
+					h[l]=0.0;
+					n_active--;
+				} else {
+					t[l]+=h[l];
+					if(fabsF(final_time-t[l]) <= fabsF(new_h)) {
+						h_est[l]=new_h;
+						h[l]=final_time-t[l];
+						finishing[l]=1;
+					} else h[l]=new_h;
+				}
+				if(system->steps != NULL) system->steps[first+l]++;
+			} else {
+				/* retry with a smaller time step (it cannot pass after final_time) */
+				h[l]=new_h;
+				finishing[l]=0;
+			}
+		}
+
+		/* update the solution x:=x+h/3*( (K1+K5)/2 + 2*K4 ) of the successful systems only */
+		BATCH_SWEEP( x[i] = (h_upd[l]!=0.0) ? x[i] + h_upd[l]*( 0.5 * ( K1[i] + K5[i] ) + 2.0 * K4[i] ) : x[i] )
+	}
+
+	for(l=0;l<RK_B_LANES && first+l<system->n_systems;l++) {
+		system->t[first+l]=t[l];
+		system->h[first+l]=h_est[l];
+	}
+
+	return(failed);
+}
+
+int RK_B_solve(FLOAT final_time, RK_B_SOLUTION * system)
+{
+	int n_batches, batch;
+	int failed=0;
+	long steps_total=0;
+
+	if(max_n==0) return(-3);
+
+	if(system==NULL) return(-2);
+	if(system->n<=0 || system->n_systems<0 || system->t==NULL || system->x==NULL || system->h==NULL || system->f==NULL || system->delta<=0) return(-2);
+
+	if(system->n>max_n) return(-5);
+
+	n_batches=(system->n_systems+RK_B_LANES-1)/RK_B_LANES;
+
+	#pragma omp parallel for num_threads(n_threads) schedule(dynamic) reduction(+:steps_total) reduction(|:failed)
+	for(batch=0;batch<n_batches;batch++) {
+#ifdef __OPENMP
+		FLOAT * ws = workspace + (size_t)omp_get_thread_num()*AUX_ARRAYS*max_n*RK_B_LANES;
+#else
+		FLOAT * ws = workspace;
+#endif
+		failed |= RK_B_solve_batch(final_time, system, batch, ws, &steps_total);
+	}
+
+	system->steps_total+=steps_total;
+	return(failed ? -4 : 0);
+}
@@ -0,0 +1,43 @@
+/***************************************************************\
+* 4th order Runge - Kutta solver                                *
+* Merson's modification with adaptive time stepping             *
+* - hybrid OpenMP / M P I  version with block resizing support  *
+* - supports SPARSE system distribution in memory               *
+*                                                               *
+* this file is part of                                          *
+* DDLBF (Digithell Dynamic Load Balancing Facility)             *
+*                                                               *
+* (C) 2026 PorousFreezeThaw contributors                        *
+* file: RK_MPI_SAsolver_hybrid3.c                               *
+\***************************************************************/
+
+/*
+OpenMP note:
+
+OpenMP parallelization of this RK/Merson solver consists in enclosing the whole time
+iteration loop into an OpenMP parallel region. The right hand side is called within
+the loop BY ALL THREADS! The user is responsible for using OpenMP orphaned directives
+inside the right hand side to implement the appropriate work sharing!
+
+IMPORTANT ADVICE:
+
+This version concatenates all chunks into one index range and splits it evenly among
+the threads when calculating the coefficients Ki. Use this version if the sizes
+of the chunks vary strongly, so that neither of the previous versions balances well.
+*/
+
+#include "common.h"
+
+/* the header file is shared with the MPI-only version (RK_MPI_SAsolver.c) */
+#include "RK_MPI_SAsolver.h"
+
+/* the solver is implemented by the common RK engine (see RK_engine.h) */
+#define RK_COMM			RK_COMM_MPI
+#define RK_THREADING		RK_THREADS_COLLAPSED
+#define RK_MEMORY		RK_MEM_SPARSE
+#define RK_SCHEME		RK_SCHEME_MERSON
+#define RK_CALLBACKS
+#define RK_SOLUTION_TYPE	RK_MPI_S_SOLUTION
+#define RK_FN(name)		RK_MPI_SA_##name
+
+#include "../RK_engine/RK_engine.c"
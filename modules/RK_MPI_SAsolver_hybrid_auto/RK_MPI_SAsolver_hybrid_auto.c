@@ -0,0 +1,46 @@
+/***************************************************************\
+* 4th order Runge - Kutta solver                                *
+* Merson's modification with adaptive time stepping             *
+* - hybrid OpenMP / M P I  version with block resizing support  *
+* - supports SPARSE system distribution in memory               *
+*                                                               *
+* this file is part of                                          *
+* DDLBF (Digithell Dynamic Load Balancing Facility)             *
+*                                                               *
+* (C) 2026 PorousFreezeThaw contributors                        *
+* file: RK_MPI_SAsolver_hybrid_auto.c                           *
+\***************************************************************/
+
+/*
+OpenMP note:
+
+OpenMP parallelization of this RK/Merson solver consists in enclosing the whole time
+iteration loop into an OpenMP parallel region. The right hand side is called within
+the loop BY ALL THREADS! The user is responsible for using OpenMP orphaned directives
+inside the right hand side to implement the appropriate work sharing!
+
+IMPORTANT ADVICE:
+
+This version can switch between the work sharing strategies of the versions hybrid
+(inner loops), hybrid2 (outer loops) and hybrid3 (collapsed loops) at run time.
+Use RK_MPI_SA_autotune() to select the fastest one for the actual system, or
+RK_MPI_SA_set_tuning() to select it manually. The default strategy is the one of
+the hybrid2 version, with the default loop schedule, so that the untuned solver
+behaves like hybrid2. Once a schedule is set, the solver loops use schedule(runtime).
+*/
+
+#include "common.h"
+
+/* the header file is shared with the MPI-only version (RK_MPI_SAsolver.c) */
+#include "RK_MPI_SAsolver.h"
+
+/* the solver is implemented by the common RK engine (see RK_engine.h) */
+#define RK_COMM			RK_COMM_MPI
+#define RK_THREADING		RK_THREADS_RUNTIME
+#define RK_MEMORY		RK_MEM_SPARSE
+#define RK_SCHEME		RK_SCHEME_MERSON
+#define RK_CALLBACKS
+#define RK_SOLUTION_TYPE	RK_MPI_S_SOLUTION
+#define RK_FN(name)		RK_MPI_SA_##name
+
+#include "../RK_engine/RK_engine.c"
@@ -0,0 +1,1938 @@
+/***************************************************************\
+* 4th order Runge - Kutta solver engine                         *
+* - Merson's modification with adaptive time stepping           *
+* - standard scheme with fixed time step                        *
+* - serial, M P I  or hybrid OpenMP / M P I  versions           *
+* - supports DENSE and SPARSE system distribution in memory     *
+*                                                               *
+* this file is part of                                          *
+* DDLBF (Digithell Dynamic Load Balancing Facility)             *
+*                                                               *
+* (C) 2005-2015 Pavel Strachota                                 *
+* (C) 2026 PorousFreezeThaw contributors                        *
+* file: RK_engine.c                                             *
+\***************************************************************/
+
+/*
+This file is NOT a standalone module. It is #included by the solver module wrappers
+(RK_solver.c, RK_csolver.c, RK_Asolver.c, RK_MPI_Asolver.c, RK_MPI_SAsolver*.c) after they
+have included their public header and selected the compile-time policies. See RK_engine.h
+for the description of the policies.
+
+OpenMP note:
+
+With any threading policy other than RK_THREADS_NONE, the whole time iteration loop is enclosed
+into an OpenMP parallel region. The right hand side is called within the loop BY ALL THREADS!
+The user is responsible for using OpenMP orphaned directives inside the right hand side
+to implement the appropriate work sharing!
+
+Reentrancy note:
+
+The engine has no mutable file scope variables except for the default context. The state
+of a calculation is kept in a context structure (see below), so that several contexts may be
+integrated concurrently by different threads.
+*/
+
+#if !defined RK_COMM || !defined RK_THREADING || !defined RK_MEMORY || !defined RK_SCHEME
+	#error "RK_engine.c must be included by a solver module wrapper that defines the policies (see RK_engine.h)"
+#endif
+
+#include "RK_engine.h"
+
+/* force inclusion of ISO C99 declarations and definitions */
+#define _ISOC99_SOURCE
+
+/*
+Define this if your library is not C99 compliant (e.g. the isfinite() function is not defined).
+If defined, the NAN handling is not compiled in at all. This means that you can use the functions
+that control NAN handling, but you will never encounter that a NAN has occurred.
+This flag can also be defined through a compiler option (see the settings.mk file).
+*/
+/* #define __DISABLE_NAN_HANDLING */
+
+
+#include <stdlib.h>
+#include "mathspec.h"
+
+#if RK_THREADING != RK_THREADS_NONE && defined __OPENMP
+	#include <omp.h>
+#endif
+
+/*
+
+ - All computations using Runge - Kutta solver are performed in FLOAT precision
+   (see common.h)
+
+ - The equation system is defined on arrays
+   Dx=f(t,x) where x and f are arrays with n elements
+
+*/
+
+/* commands from the master rank (can be ORed) - the serial headers do not define them */
+#if !defined RKA_CMD_UPDATE
+	#define RKA_CMD_h_TOO_SMALL	1
+	#define RKA_CMD_NAN		2
+	#define RKA_CMD_UPDATE		4
+	#define RKA_CMD_FINISHED	8
+	#define RKA_CMD_NEXTFINISH	16
+	#define RKA_CMD_BREAK		32
+	#define RKA_CMD_SWITCH		64
+#endif
+
+
+/* ========================================== */
+/* communication policy */
+
+#if RK_COMM == RK_COMM_MPI
+
+#define RK_MASTER				(ctx->rank==ctx->master)
+#define RK_BCAST(buf,count,type)		MPI_Bcast(buf,count,type,ctx->master,ctx->comm)
+#define RK_REDUCE(src,dst,count,type,op)	MPI_Reduce(src,dst,count,type,op,ctx->master,ctx->comm)
+#define RK_ALLREDUCE(src,dst,count,type,op)	MPI_Allreduce(src,dst,count,type,op,ctx->comm)
+
+#else
+
+/* a single process is always the master and all collective operations are trivial */
+#define RK_MASTER				1
+#define RK_BCAST(buf,count,type)
+#define RK_REDUCE(src,dst,count,type,op)	(*(dst) = *(src))
+#define RK_ALLREDUCE(src,dst,count,type,op)	(*(dst) = *(src))
+
+#endif
+
+
+/* ========================================== */
+/* solver context */
+
+/*
+All the state of the solver is kept in a context structure. The public functions without the 'ctx_'
+prefix operate on the default context RK_default_ctx, the 'ctx_' functions on a context created
+by the ctx_create function. The macros and the functions below refer to the current context as 'ctx'.
+*/
+
+#define RK_CTX		struct RK_FN(context)
+
+RK_CTX {
+	int max_n;				/* maximum dimension of the equation system (0 = not initialized) */
+
+#if RK_COMM == RK_COMM_MPI
+	MPI_Comm comm;				/* the communicator incorporating all processes in the calculation */
+	int rank;				/* the rank of the current process */
+	int procs;				/* total number of processes in the MPI universe */
+	int master;				/* the rank of the master process ( set by the init function )*/
+#endif
+
+#if RK_THREADING == RK_THREADS_COLLAPSED || RK_THREADING == RK_THREADS_RUNTIME
+	int * chunk_offset;			/* chunk_offset[k] = total size of chunks 0 .. k-1 */
+	int chunk_offset_size;			/* allocated number of elements of chunk_offset */
+#endif
+#if RK_THREADING == RK_THREADS_RUNTIME
+	int threading;				/* the strategy selected at run time (the same in all threads) */
+#endif
+#if RK_COMM == RK_COMM_MPI && RK_MEMORY == RK_MEM_SPARSE
+	int schedule, chunk;			/* the loop schedule set by set_tuning (schedule 0 = not set) */
+#endif
+
+#if RK_SCHEME == RK_SCHEME_MERSON
+	FLOAT * K1, *K3, *K4, *K5;		/* for K1,(K2,)K3,K4,K5 auxiliary arrays */
+	FLOAT * aux;				/* auxiliary array for f arguments */
+
+	int handle_NAN;				/* nonzero if NAN and +-INF handling is enabled */
+	int last_NAN;				/* nonzero if NAN or +-INF occurred during last calculation */
+
+	int error_norm;				/* RK_NORM_MAX or RK_NORM_RMS */
+	FLOAT atol, rtol;			/* the default tolerances of RK_NORM_RMS */
+
+	/*
+	stiffness detection and the Rosenbrock method - the arrays are allocated by the stiffness function:
+	K2s (RK_STIFF_DETECT and RK_STIFF_SWITCH) keeps K2 apart from K3 for the stiffness estimate,
+	the remaining arrays (RK_STIFF_SWITCH only) are used by the BiCGSTAB linear solver
+	*/
+	FLOAT * K2s;
+	FLOAT * kr_r, *kr_rhat, *kr_p, *kr_v, *kr_s, *kr_t, *kr_w;
+
+	int stiffness_mode;			/* the stiffness detection mode */
+	int rosenbrock;				/* nonzero while the Rosenbrock method is in use */
+	int stiff_count;			/* the number of consecutive successful steps indicating the opposite
+						   method (i.e. stiffness for Merson, nonstiffness for Rosenbrock) */
+	int stiff_count_miss;			/* the number of successful steps since the last such step */
+	RK_STIFFNESS stiffness_info;		/* the telemetry (relevant in the master rank only) */
+
+	FLOAT dot_local, dot_global;		/* the scalar products of the linear solver (shared by the threads) */
+
+#elif RK_SCHEME == RK_SCHEME_RK4
+	FLOAT * K1, *K2, *K3, *K4;		/* K1,K2,K3,K4 auxiliary arrays */
+	FLOAT * aux;				/* auxiliary array for f arguments */
+
+#elif RK_SCHEME == RK_SCHEME_RK4_LOWMEM
+	/*
+	The real memory location for the coefficients Ki (i=1,2,3,4) is either K_a or K_b.
+	x__ holds the solution from the previous time level.
+	*/
+	FLOAT * K_a, *K_b, *x__;
+
+#else
+	#error "unknown RK_SCHEME policy"
+#endif
+};
+
+/* the context of the functions without the 'ctx_' prefix (all other members are zero) */
+#if RK_THREADING == RK_THREADS_RUNTIME
+static RK_CTX RK_default_ctx = { .threading=RK_THREADS_OUTER };
+#else
+static RK_CTX RK_default_ctx;
+#endif
+
+/* the loop schedule of the context applies to the parallel regions opened by the calling thread */
+#if RK_COMM == RK_COMM_MPI && RK_MEMORY == RK_MEM_SPARSE && RK_THREADING != RK_THREADS_NONE && defined __OPENMP
+	#define RK_APPLY_SCHEDULE()	{ if(ctx->schedule) omp_set_schedule((omp_sched_t)ctx->schedule,ctx->chunk); }
+#else
+	#define RK_APPLY_SCHEDULE()
+#endif
+
+
+/* ========================================== */
+/* threading policy */
+
+#if RK_THREADING == RK_THREADS_NONE
+	#define RK_OMP_PARALLEL
+	#define RK_OMP_SINGLE
+	#define RK_OMP_CRITICAL
+	#define RK_OMP_BARRIER
+#else
+	#define RK_OMP_PARALLEL		_Pragma("omp parallel default(shared)")
+	#define RK_OMP_SINGLE		_Pragma("omp single")
+	#define RK_OMP_CRITICAL		_Pragma("omp critical")
+	#define RK_OMP_BARRIER		_Pragma("omp barrier")
+#endif
+
+/*
+RK_SWEEP(STATEMENT) executes STATEMENT for all elements of the solution, i.e. for all indices 'i'
+of all chunks 'k'. The statement may refer to both 'i' and 'k'. All threads must encounter RK_SWEEP.
+When it finishes, all threads have completed their part of the work (there is an implicit barrier).
+
+The individual work sharing strategies are defined first. Once a loop schedule has been set (see
+the set_tuning function), the loops of the run time selectable strategies use schedule(runtime), so
+that their schedule can be tuned together with the schedule of the right hand side loops (see the
+autotune function). Until then, they use the default schedule like the fixed strategies.
+*/
+
+#define RK_SWEEP_SERIAL(...) \
+	for(int k=0;k<n_chunks;k++) { \
+		int i_end=c_start[k]+c_size[k]; \
+		for(int i=c_start[k];i<i_end;i++) __VA_ARGS__; \
+	}
+
+#define RK_SWEEP_INNER(SCHEDULE,...) \
+	for(int k=0;k<n_chunks;k++) { \
+		int i_end=c_start[k]+c_size[k]; \
+		_Pragma(SCHEDULE) \
+		for(int i=c_start[k];i<i_end;i++) __VA_ARGS__; \
+	}
+
+#define RK_SWEEP_OUTER(SCHEDULE,...) \
+	_Pragma(SCHEDULE) \
+	for(int k=0;k<n_chunks;k++) { \
+		int i_end=c_start[k]+c_size[k]; \
+		for(int i=c_start[k];i<i_end;i++) __VA_ARGS__; \
+	}
+
+#if RK_THREADING == RK_THREADS_COLLAPSED || RK_THREADING == RK_THREADS_RUNTIME
+
+static int RK_chunk_offsets(RK_CTX * ctx, int n_chunks, const int * c_size)
+/*
+builds the ctx->chunk_offset array for the current memory distribution
+
+return codes:
+0	success
+-1	not enough memory
+*/
+{
+	int k;
+
+	int * chunk_offset;
+
+	if(n_chunks+1 > ctx->chunk_offset_size) {
+		int * p=(int *)realloc(ctx->chunk_offset,(n_chunks+1)*sizeof(int));
+		if(p==NULL) return(-1);
+		ctx->chunk_offset=p;
+		ctx->chunk_offset_size=n_chunks+1;
+	}
+	chunk_offset=ctx->chunk_offset;
+	chunk_offset[0]=0;
+	for(k=0;k<n_chunks;k++) chunk_offset[k+1]=chunk_offset[k]+c_size[k];
+	return(0);
+}
+
+static void RK_collapsed_range(const int * chunk_offset, int n_chunks, int * k_first, int * g_lo, int * g_hi)
+/*
+determines the part [g_lo,g_hi) of the concatenated index range of all chunks that belongs
+to the calling thread and the chunk k_first containing its first element
+(chunk_offset is the array built by RK_chunk_offsets)
+*/
+{
+#ifdef __OPENMP
+	int threads=omp_get_num_threads(), id=omp_get_thread_num();
+#else
+	int threads=1, id=0;
+#endif
+	long total=chunk_offset[n_chunks];
+	int lo=0, hi=n_chunks, mid;
+
+	*g_lo=(int)(total*id/threads);
+	*g_hi=(int)(total*(id+1)/threads);
+
+	/* binary search: the chunk offsets are strictly increasing */
+	while(hi-lo>1) {
+		mid=(lo+hi)/2;
+		if(chunk_offset[mid] <= *g_lo) lo=mid; else hi=mid;
+	}
+	*k_first=lo;
+}
+
+#define RK_SWEEP_COLLAPSED(...) \
+	{ \
+		const int * chunk_offset=ctx->chunk_offset; \
+		int k_first, g_lo, g_hi; \
+		RK_collapsed_range(chunk_offset,n_chunks,&k_first,&g_lo,&g_hi); \
+		for(int k=k_first;k<n_chunks && chunk_offset[k]<g_hi;k++) { \
+			int i_beg=c_start[k] + ((g_lo>chunk_offset[k]) ? g_lo-chunk_offset[k] : 0); \
+			int i_end=c_start[k] + ((g_hi<chunk_offset[k+1]) ? g_hi-chunk_offset[k] : c_size[k]); \
+			for(int i=i_beg;i<i_end;i++) __VA_ARGS__; \
+		} \
+	} \
+	_Pragma("omp barrier")
+
+	#define RK_CHUNKS_PREPARE()	RK_chunk_offsets(ctx,n_chunks,c_size)
+#else
+	#define RK_CHUNKS_PREPARE()	0
+#endif
+
+#if RK_THREADING == RK_THREADS_NONE
+	#define RK_SWEEP(...)	RK_SWEEP_SERIAL(__VA_ARGS__)
+#elif RK_THREADING == RK_THREADS_INNER
+	#define RK_SWEEP(...)	RK_SWEEP_INNER("omp for",__VA_ARGS__)
+#elif RK_THREADING == RK_THREADS_OUTER
+	#define RK_SWEEP(...)	RK_SWEEP_OUTER("omp for",__VA_ARGS__)
+#elif RK_THREADING == RK_THREADS_COLLAPSED
+	#define RK_SWEEP(...)	RK_SWEEP_COLLAPSED(__VA_ARGS__)
+#elif RK_THREADING == RK_THREADS_RUNTIME
+	#if RK_COMM == RK_COMM_MPI && RK_MEMORY == RK_MEM_SPARSE
+		#define RK_SCHEDULE_SET	(ctx->schedule)
+	#else
+		#define RK_SCHEDULE_SET	1
+	#endif
+	#define RK_SWEEP(...) \
+		if(ctx->threading==RK_THREADS_INNER) { \
+			if(RK_SCHEDULE_SET) { RK_SWEEP_INNER("omp for schedule(runtime)",__VA_ARGS__) } \
+			else { RK_SWEEP_INNER("omp for",__VA_ARGS__) } \
+		} else if(ctx->threading==RK_THREADS_OUTER) { \
+			if(RK_SCHEDULE_SET) { RK_SWEEP_OUTER("omp for schedule(runtime)",__VA_ARGS__) } \
+			else { RK_SWEEP_OUTER("omp for",__VA_ARGS__) } \
+		} else { RK_SWEEP_COLLAPSED(__VA_ARGS__) }
+#else
+	#error "unknown RK_THREADING policy"
+#endif
+
+
+/* ========================================== */
+/* memory policy */
+
+/*
+RK_CHUNKS_DECLARE declares the chunk description variables n_chunks, c_start[], c_size[]
+and c_eps_mult[] used by RK_SWEEP. RK_CHUNKS_SET(n) points them to the system memory layout n.
+A dense system is treated as a single chunk.
+*/
+#if RK_MEMORY == RK_MEM_SPARSE
+
+	#define RK_CHUNKS_DECLARE \
+		int n_chunks=0; \
+		const int * c_start=NULL, * c_size=NULL; \
+		const FLOAT * c_eps_mult=NULL;
+
+	#define RK_CHUNKS_SET(n) \
+		{ n_chunks=(n)->n_chunks; c_start=(n)->chunk_start; c_size=(n)->chunk_size; c_eps_mult=(n)->chunk_eps_mult; }
+
+	/* the end of the last chunk determines the memory needed */
+	#define RK_MEM_END(n)	((n)->chunk_start[(n)->n_chunks-1]+(n)->chunk_size[(n)->n_chunks-1])
+
+#elif RK_MEMORY == RK_MEM_DENSE
+
+	#define RK_CHUNKS_DECLARE \
+		const int n_chunks=1; \
+		const int dense_start=0; \
+		const FLOAT dense_eps_mult=1.0; \
+		const int * c_start=&dense_start, * c_size=&n; \
+		const FLOAT * c_eps_mult=&dense_eps_mult;
+
+	/* c_size points to n directly, so nothing needs to be done */
+	#define RK_CHUNKS_SET(n)
+
+	#define RK_MEM_END(n)	(n)
+
+#else
+	#error "unknown RK_MEMORY policy"
+#endif
+
+
+/* ========================================== */
+/* auxiliary arrays of the scheme */
+
+#if RK_SCHEME == RK_SCHEME_MERSON
+
+#define RK_ARRAYS		{ &ctx->K1, &ctx->K3, &ctx->K4, &ctx->K5, &ctx->aux }
+#define RK_KRYLOV_ARRAYS	{ &ctx->kr_r, &ctx->kr_rhat, &ctx->kr_p, &ctx->kr_v, &ctx->kr_s, &ctx->kr_t, &ctx->kr_w }
+
+/*
+The Merson scheme is stable for h*rho below 3.55 on the negative real axis. The problem is considered
+stiff if h*rho exceeds RK_STIFF_THRESHOLD in RK_STIFF_STEPS successful steps, interrupted by less than
+RK_STIFF_MISS other steps (the same heuristics as used by Hairer & Wanner for DOPRI5). The Rosenbrock method
+is abandoned when the Merson scheme would be stable with the time step proposed by the Rosenbrock method
+in RK_STIFF_STEPS consecutive steps.
+*/
+#define RK_STIFF_THRESHOLD	3.2
+#define RK_STIFF_STEPS		15
+#define RK_STIFF_MISS		6
+
+/* the parameters of the ROS2 method (Verwer et al., 1999) and of the linear solver */
+#define RK_ROS_GAMMA		1.7071067811865475	/* 1+1/sqrt(2) */
+#define RK_KRYLOV_MAXIT		200			/* the maximum number of BiCGSTAB iterations */
+#define RK_KRYLOV_TOL		1e-6			/* the relative residual required */
+#define RK_FD_EPS		1.4901161193847656e-8	/* sqrt of the double precision machine epsilon */
+
+static void RK_stiffness_free(RK_CTX * ctx)
+{
+	FLOAT ** arrays[] = RK_KRYLOV_ARRAYS;
+	int j, count = sizeof(arrays)/sizeof(arrays[0]);
+
+	free(ctx->K2s); ctx->K2s=NULL;
+	if(ctx->kr_r!=NULL)
+		for(j=0;j<count;j++) free(*arrays[j]);
+	ctx->kr_r=NULL;
+	ctx->stiffness_mode=RK_STIFF_OFF;
+	ctx->rosenbrock=0;
+}
+
+/*
+RK_ERROR_SWEEP(ERR) accumulates the error estimates ERR (an expression of 'i' and 'k', multiplied
+by c_eps_mult[k]) of the elements of the calling thread to eps_thread:
+RK_NORM_MAX	the maximum of the estimates
+RK_NORM_RMS	the sum of the squares of the estimates divided by atol+rtol*|x[i]|
+(the tolerances of the chunk k are c_atol[k] and c_rtol[k] or the defaults of the context)
+With NAN handling ON, NAN_thread is set instead if an estimate is NAN or +-INF.
+*/
+#define RK_ATOL(k)		((c_atol!=NULL) ? c_atol[k] : ctx->atol)
+#define RK_RTOL(k)		((c_rtol!=NULL) ? c_rtol[k] : ctx->rtol)
+
+#define RK_ERROR_MAX(NAN_CHECK,...) \
+	RK_SWEEP({ \
+		FLOAT e = c_eps_mult[k] * (__VA_ARGS__); \
+		NAN_CHECK if(e>eps_thread) eps_thread=e; \
+	})
+
+#define RK_ERROR_RMS(NAN_CHECK,...) \
+	RK_SWEEP({ \
+		FLOAT e = c_eps_mult[k] * (__VA_ARGS__) / ( RK_ATOL(k) + RK_RTOL(k)*fabsF(x[i]) ); \
+		NAN_CHECK eps_thread += e*e; \
+	})
+
+#define RK_NAN_CHECK	if(! isfinite(e)) NAN_thread=1; else
+
+#ifndef __DISABLE_NAN_HANDLING
+	#define RK_ERROR_SWEEP(...) \
+		if(ctx->handle_NAN) { \
+			if(ctx->error_norm==RK_NORM_RMS) { RK_ERROR_RMS(RK_NAN_CHECK,__VA_ARGS__) } \
+			else { RK_ERROR_MAX(RK_NAN_CHECK,__VA_ARGS__) } \
+		} else { \
+			if(ctx->error_norm==RK_NORM_RMS) { RK_ERROR_RMS(,__VA_ARGS__) } \
+			else { RK_ERROR_MAX(,__VA_ARGS__) } \
+		}
+#else
+	#define RK_ERROR_SWEEP(...) \
+		if(ctx->error_norm==RK_NORM_RMS) { RK_ERROR_RMS(,__VA_ARGS__) } \
+		else { RK_ERROR_MAX(,__VA_ARGS__) }
+#endif
+
+/* RK_TOLERANCES_SET(n) points c_atol and c_rtol to the tolerances of the chunks of the system memory layout n */
+#if RK_MEMORY == RK_MEM_SPARSE
+	#define RK_TOLERANCES_SET(n)	{ c_atol=(n)->chunk_atol; c_rtol=(n)->chunk_rtol; }
+#else
+	#define RK_TOLERANCES_SET(n)
+#endif
+
+static FLOAT RK_global_size(RK_CTX * ctx, int n_chunks, const int * c_size)
+/*
+returns the total number of elements of the system in all ranks (the mean value of RK_NORM_RMS
+is taken over them). This is a collective operation.
+*/
+{
+	FLOAT local=0.0, global;
+	int k;
+
+	(void)ctx;	/* only used by the MPI version */
+	for(k=0;k<n_chunks;k++) local+=c_size[k];
+	RK_ALLREDUCE(&local,&global,1,MPI__FLOAT,MPI_SUM);
+	return(global);
+}
+
+#elif RK_SCHEME == RK_SCHEME_RK4
+
+#define RK_ARRAYS	{ &ctx->K1, &ctx->K2, &ctx->K3, &ctx->K4, &ctx->aux }
+
+#elif RK_SCHEME == RK_SCHEME_RK4_LOWMEM
+
+#define RK_ARRAYS	{ &ctx->K_a, &ctx->K_b, &ctx->x__ }
+
+#endif
+
+
+/* ========================================== */
+
+#if RK_COMM == RK_COMM_MPI
+static int RK_context_init(RK_CTX * ctx, int max_block_size, MPI_Comm comm, int master_rank)
+#else
+static int RK_context_init(RK_CTX * ctx, int max_block_size)
+#endif
+/*
+allocates memory for auxiliary arrays. The system (all chunks solved within the current process
+in the sparse case) must fit into a continuous block of memory of 'max_block_size' elements.
+The MPI version initializes the RK solver so that it can perform a parallel calculation in the group
+of processes specified by the communicator 'comm'. 'master_rank' determines the rank that will be
+responsible for the calculation progress on all processes.
+
+NOTE: If you want to start another computation with a greater block size, you must call
+the cleanup function before you can pass a greater value to the init function.
+
+return codes:
+0	success
+-1	not enough memory
+-2	invalid system dimension
+-3	already initialized
+-4	MPI not initialized
+*/
+{
+	FLOAT ** arrays[] = RK_ARRAYS;
+	int j, count = sizeof(arrays)/sizeof(arrays[0]);
+
+#if RK_COMM == RK_COMM_MPI
+	int rank, procs;
+	if(MPI_Comm_rank(comm,&rank)!=MPI_SUCCESS || MPI_Comm_size(comm,&procs)!=MPI_SUCCESS) return(-4);
+#endif
+
+	size_t size=max_block_size*sizeof(FLOAT);
+	if(ctx->max_n) return(-3);
+	if(max_block_size<=0) return(-2);
+
+	for(j=0;j<count;j++)
+		if((*arrays[j]=(FLOAT *)malloc(size)) == NULL) {
+			while(j--) free(*arrays[j]);
+			*arrays[0]=NULL;
+			return(-1);
+		}
+
+	ctx->max_n=max_block_size;
+#if RK_SCHEME == RK_SCHEME_MERSON
+	ctx->last_NAN=0;
+#endif
+
+#if RK_COMM == RK_COMM_MPI
+	ctx->comm=comm;
+	ctx->rank=rank;
+	ctx->procs=procs;
+	ctx->master=master_rank;
+#endif
+	return(0);
+}
+
+static int RK_context_cleanup(RK_CTX * ctx)
+/* Frees memory allocated by RK_context_init
+
+return codes:
+0	success
+-3	not initialized yet
+*/
+{
+	FLOAT ** arrays[] = RK_ARRAYS;
+	int j, count = sizeof(arrays)/sizeof(arrays[0]);
+
+	if(ctx->max_n==0 || *arrays[0]==NULL) return(-3);
+
+	for(j=0;j<count;j++) free(*arrays[j]);
+	*arrays[0]=NULL;
+
+#if RK_SCHEME == RK_SCHEME_MERSON
+	RK_stiffness_free(ctx);
+#endif
+
+#if RK_THREADING == RK_THREADS_COLLAPSED || RK_THREADING == RK_THREADS_RUNTIME
+	free(ctx->chunk_offset); ctx->chunk_offset=NULL;
+	ctx->chunk_offset_size=0;
+#endif
+
+	ctx->max_n=0;
+	return(0);
+}
+
+#if RK_COMM == RK_COMM_MPI
+int RK_FN(init)(int max_block_size, MPI_Comm comm, int master_rank)
+{
+	return(RK_context_init(&RK_default_ctx,max_block_size,comm,master_rank));
+}
+#else
+int RK_FN(init)(int max_block_size)
+{
+	return(RK_context_init(&RK_default_ctx,max_block_size));
+}
+#endif
+
+int RK_FN(cleanup)(void)
+{
+	return(RK_context_cleanup(&RK_default_ctx));
+}
+
+#if RK_COMM == RK_COMM_MPI
+RK_CTX * RK_FN(ctx_create)(int max_block_size, MPI_Comm comm, int master_rank, int * error)
+#else
+RK_CTX * RK_FN(ctx_create)(int max_block_size, int * error)
+#endif
+/*
+creates a new context and initializes it in the same way as RK_context_init does. The return code
+of the initialization is stored to 'error' unless it is NULL. Returns NULL on failure.
+*/
+{
+	RK_CTX * ctx=(RK_CTX *)calloc(1,sizeof(RK_CTX));
+	int code=-1;
+
+	if(ctx!=NULL) {
+#if RK_THREADING == RK_THREADS_RUNTIME
+		ctx->threading=RK_THREADS_OUTER;
+#endif
+#if RK_COMM == RK_COMM_MPI
+		code=RK_context_init(ctx,max_block_size,comm,master_rank);
+#else
+		code=RK_context_init(ctx,max_block_size);
+#endif
+		if(code) {
+			free(ctx);
+			ctx=NULL;
+		}
+	}
+
+	if(error!=NULL) *error=code;
+	return(ctx);
+}
+
+int RK_FN(ctx_destroy)(RK_CTX * ctx)
+/*
+frees the context created by the ctx_create function together with all its arrays
+
+return codes:
+0	success
+-3	'ctx' is NULL
+*/
+{
+	if(ctx==NULL) return(-3);
+	RK_context_cleanup(ctx);
+	free(ctx);
+	return(0);
+}
+
+#if RK_MEMORY == RK_MEM_SPARSE
+
+int RK_FN(ctx_check_mem)(RK_CTX * ctx, RK_MEM_DIST * n)
+/*
+Checks whether the system memory distribution is defined correctly. For the chunk placement rules,
+see the definition of RK_MEM_DIST.
+
+return codes:
+0	success
+-3	not initialized yet
+-5	last chunk exceeds the maximum allowed space (specified by the call to the init function)
+-6	invalid chunk specification (bad chunk order, overlapping chunks or nonpositive chunk length)
+-7	number of chunks is negative or zero
+*/
+{
+	int n_chunks=n->n_chunks;
+
+	int offset=0, prev_offset, i;
+
+	if(ctx->max_n==0) return(-3);
+
+	if(n_chunks<=0) return(-7);
+
+	/* at the beginning of each iteration, offset points to the first available offset where the chunk may start */
+	for(i=0;i<n_chunks;i++) {
+		prev_offset=offset;
+		offset = n->chunk_start[i];
+		if(offset<prev_offset) return(-6);
+		prev_offset=offset;
+		offset += n->chunk_size[i];
+		if(offset<=prev_offset) return(-6);
+	}
+	if(offset>ctx->max_n) return(-5);
+
+	return(0);
+}
+
+int RK_FN(check_mem)(RK_MEM_DIST * n)
+{
+	return(RK_FN(ctx_check_mem)(&RK_default_ctx,n));
+}
+
+#endif		/* RK_MEM_SPARSE */
+
+
+#if RK_SCHEME == RK_SCHEME_MERSON
+
+void RK_FN(ctx_handle_NAN)(RK_CTX * ctx, int hN)
+/*
+Turns the NAN and +-INF handling ON/OFF.
+Pass a nonzero value to turn it ON, pass 0 to turn it OFF.
+
+By default, the NAN handling is disabled: Under special circumstances
+(very singular right side and extremely long initial time step) NANs or +-INF may
+appear during the solution and the relative error eps (compared to delta_) will
+then be undefined. Hence, there will be no means of obtaining the new value of the
+time step and most likely the solver will get stuck in an infinite loop. NAN handling
+finds such cases and automatically retries with a 10 times smaller time step, until
+the NANs stop to occur. If the obtained time step is extremely small so that the calculation
+would take hours, the solver breaks the calculation and reports an error.
+
+NOTE: You can only use NAN handling when the SIGFPE signal raising is disabled.
+(and by default it is) See the C library documentation for details.
+
+NOTE:	NAN handling requires the C library to be ISO C99 compliant.
+
+WARNING: In the MPI versions, this function works on the master process only !!!
+*/
+{
+ ctx->handle_NAN=(hN==0)?0:1;
+}
+
+void RK_FN(handle_NAN)(int hN)
+{
+	RK_FN(ctx_handle_NAN)(&RK_default_ctx,hN);
+}
+
+int RK_FN(ctx_check_NAN)(RK_CTX * ctx)
+/*
+returns nonzero if there a NAN or +-INF occurred in the last calculation (upon the last call to
+the solve function). This may imply some problem with your equation or too loose setting of delta.
+
+NOTE: This function works on all processes involved in the calculation
+*/
+{
+ return(ctx->last_NAN);
+}
+
+int RK_FN(check_NAN)()
+{
+	return(RK_FN(ctx_check_NAN)(&RK_default_ctx));
+}
+
+int RK_FN(ctx_stiffness)(RK_CTX * ctx, int mode)
+/*
+Sets the stiffness detection mode (RK_STIFF_OFF, RK_STIFF_DETECT or RK_STIFF_SWITCH, see RK_engine.h)
+and allocates the additional arrays needed: 1 array for RK_STIFF_DETECT, 8 arrays for RK_STIFF_SWITCH.
+The arrays are freed by the cleanup function. The telemetry is reset.
+
+return codes:
+0	success
+-1	not enough memory (stiffness detection is OFF)
+-2	invalid mode
+-3	not initialized yet
+*/
+{
+	size_t size=ctx->max_n*sizeof(FLOAT);
+
+	if(ctx->max_n==0) return(-3);
+	if(mode!=RK_STIFF_OFF && mode!=RK_STIFF_DETECT && mode!=RK_STIFF_SWITCH) return(-2);
+
+	RK_stiffness_free(ctx);
+	ctx->stiffness_info=(RK_STIFFNESS){ 0.0, 0.0, 0, 0L, 0L, 0L, 0L, 0L };
+	ctx->stiff_count=ctx->stiff_count_miss=0;
+
+	if(mode==RK_STIFF_OFF) return(0);
+
+	if((ctx->K2s=(FLOAT *)malloc(size)) == NULL) return(-1);
+
+	if(mode==RK_STIFF_SWITCH) {
+		FLOAT ** arrays[] = RK_KRYLOV_ARRAYS;
+		int j, count = sizeof(arrays)/sizeof(arrays[0]);
+
+		for(j=0;j<count;j++)
+			if((*arrays[j]=(FLOAT *)malloc(size)) == NULL) {
+				while(j--) free(*arrays[j]);
+				*arrays[0]=NULL;
+				RK_stiffness_free(ctx);
+				return(-1);
+			}
+	}
+
+	ctx->stiffness_mode=mode;
+	return(0);
+}
+
+int RK_FN(stiffness)(int mode)
+{
+	return(RK_FN(ctx_stiffness)(&RK_default_ctx,mode));
+}
+
+void RK_FN(ctx_get_stiffness)(RK_CTX * ctx, RK_STIFFNESS * info)
+/*
+Stores the stiffness telemetry to 'info'. The values are cumulative since the last call
+to the stiffness function.
+*/
+{
+	*info=ctx->stiffness_info;
+	info->stiff=ctx->rosenbrock;
+}
+
+void RK_FN(get_stiffness)(RK_STIFFNESS * info)
+{
+	RK_FN(ctx_get_stiffness)(&RK_default_ctx,info);
+}
+
+int RK_FN(ctx_error_norm)(RK_CTX * ctx, int norm, FLOAT atol, FLOAT rtol)
+/*
+Selects the norm of the error estimate (RK_NORM_MAX or RK_NORM_RMS, see RK_engine.h) and the default
+absolute and relative tolerances used by RK_NORM_RMS. The estimate of each element is divided
+by atol+rtol*|x| and the root mean square over all elements of the system is compared with delta.
+
+WARNING: In the MPI versions, this function works on the master process only !!!
+
+return codes:
+0	success
+-2	invalid norm or tolerances (negative, or both zero with RK_NORM_RMS)
+*/
+{
+	if(norm!=RK_NORM_MAX && norm!=RK_NORM_RMS) return(-2);
+	if(atol<0.0 || rtol<0.0 || (norm==RK_NORM_RMS && atol==0.0 && rtol==0.0)) return(-2);
+
+	ctx->error_norm=norm;
+	ctx->atol=atol;
+	ctx->rtol=rtol;
+	return(0);
+}
+
+int RK_FN(error_norm)(int norm, FLOAT atol, FLOAT rtol)
+{
+	return(RK_FN(ctx_error_norm)(&RK_default_ctx,norm,atol,rtol));
+}
+
+
+#if RK_COMM == RK_COMM_MPI && RK_MEMORY == RK_MEM_SPARSE
+
+#if RK_THREADING != RK_THREADS_NONE && defined __OPENMP
+/* the candidate loop schedules tried by the autotune function: { omp_sched_t, chunk size (0 = default) } */
+static const int RK_schedules[][2] = {
+	{ omp_sched_static, 0 },
+	{ omp_sched_static, 1 },
+	{ omp_sched_dynamic, 1 },
+	{ omp_sched_dynamic, 4 },
+	{ omp_sched_dynamic, 16 },
+	{ omp_sched_guided, 0 }
+};
+#endif
+
+int RK_FN(ctx_set_tuning)(RK_CTX * ctx, const RK_TUNING * tuning)
+/*
+Applies the given OpenMP work sharing setup (strategy and loop schedule). The loop schedule is also
+remembered in the context and applied again by each call to the solve function, so that the contexts
+used by different threads may have different schedules.
+
+return codes:
+0	success
+-1	the requested strategy is not available in this solver module
+*/
+{
+#if RK_THREADING == RK_THREADS_RUNTIME
+	if(tuning->threading!=RK_THREADS_INNER && tuning->threading!=RK_THREADS_OUTER && tuning->threading!=RK_THREADS_COLLAPSED) return(-1);
+	ctx->threading=tuning->threading;
+#else
+	if(tuning->threading!=RK_THREADING) return(-1);
+#endif
+
+	if(tuning->schedule) {
+		ctx->schedule=tuning->schedule;
+		ctx->chunk=tuning->chunk;
+	}
+	RK_APPLY_SCHEDULE()
+	return(0);
+}
+
+int RK_FN(set_tuning)(const RK_TUNING * tuning)
+{
+	return(RK_FN(ctx_set_tuning)(&RK_default_ctx,tuning));
+}
+
+void RK_FN(ctx_get_tuning)(RK_CTX * ctx, RK_TUNING * tuning)
+/*
+Stores the current OpenMP work sharing setup to 'tuning'.
+*/
+{
+#if RK_THREADING == RK_THREADS_RUNTIME
+	tuning->threading=ctx->threading;
+#else
+	tuning->threading=RK_THREADING;
+#endif
+
+#if RK_THREADING != RK_THREADS_NONE && defined __OPENMP
+	if(ctx->schedule) {
+		tuning->schedule=ctx->schedule;
+		tuning->chunk=ctx->chunk;
+	} else {
+		omp_sched_t kind;
+		omp_get_schedule(&kind,&tuning->chunk);
+		tuning->schedule=(int)kind;
+	}
+#else
+	(void)ctx;
+	tuning->schedule=0;
+	tuning->chunk=0;
+#endif
+	tuning->time=0.0;
+}
+
+void RK_FN(get_tuning)(RK_TUNING * tuning)
+{
+	RK_FN(ctx_get_tuning)(&RK_default_ctx,tuning);
+}
+
+int RK_FN(ctx_autotune)(RK_CTX * ctx, RK_SOLUTION_TYPE * system, int iterations, RK_TUNING * best, RK_TUNING * all, int * n_all)
+/*
+Measures the time of 'iterations' right hand side evaluations, each followed by a stage update,
+for all candidate work sharing setups, and applies the fastest one. The solution x is not modified
+by the solver, K1 and aux serve as scratch arrays.
+
+return codes:
+0	success
+-1	not enough memory
+-2	invalid 'system' specification or 'iterations'<=0
+-3	not initialized yet
+-5	last chunk exceeds available memory
+-6	error in one of the other processes
+*/
+{
+	RK_TUNING candidate[RK_TUNING_MAX_CANDIDATES];
+	int n_candidates=0, best_candidate=0, c;
+
+	int error_code=0;
+	int errcode_from_others;
+
+	if(system==NULL) return(-2);
+	RK_MEM_DIST * n = system->n;
+	RK_CHUNKS_DECLARE
+	(void)c_eps_mult;
+
+	/* the time level and the time step are taken from the master rank */
+	FLOAT t = system->t;
+	FLOAT h3 = system->h/3.0;
+
+	FLOAT *x = system->x;
+	FLOAT * const K1 = ctx->K1, * const aux = ctx->aux;
+
+	RK_RightHandSide f=NULL;
+	if(system->meta_f != NULL) f=system->meta_f();
+
+	/* the same checks as in the solve function */
+	if(n==NULL) error_code=(-5);
+	else {
+		if(RK_MEM_END(n) > ctx->max_n) error_code=(-5);
+		else {
+			RK_CHUNKS_SET(n)
+			if(RK_CHUNKS_PREPARE()) error_code=(-1);
+		}
+	}
+
+	if(ctx->max_n==0) error_code=(-3);
+
+	if(x==NULL || system->meta_f==NULL || iterations<=0) error_code=(-2);
+
+	RK_ALLREDUCE(&error_code,&errcode_from_others,1,MPI_INT,MPI_MIN);
+	if(error_code) return(error_code);
+	if(errcode_from_others<0) return(-6);
+
+	RK_BCAST(&t,1,MPI__FLOAT);
+	RK_BCAST(&h3,1,MPI__FLOAT);
+
+	/* assemble the list of candidate setups */
+	{
+#if RK_THREADING == RK_THREADS_RUNTIME
+		const int strategies[] = { RK_THREADS_INNER, RK_THREADS_OUTER, RK_THREADS_COLLAPSED };
+#else
+		const int strategies[] = { RK_THREADING };
+#endif
+		int st;
+
+		for(st=0;st<(int)(sizeof(strategies)/sizeof(strategies[0]));st++) {
+#if RK_THREADING != RK_THREADS_NONE && defined __OPENMP
+			int sc;
+			for(sc=0;sc<(int)(sizeof(RK_schedules)/sizeof(RK_schedules[0]));sc++) {
+				candidate[n_candidates].threading=strategies[st];
+				candidate[n_candidates].schedule=RK_schedules[sc][0];
+				candidate[n_candidates].chunk=RK_schedules[sc][1];
+				n_candidates++;
+			}
+#else
+			candidate[n_candidates].threading=strategies[st];
+			candidate[n_candidates].schedule=0;
+			candidate[n_candidates].chunk=0;
+			n_candidates++;
+#endif
+		}
+	}
+
+	/* measure all candidates (in the same order in all ranks, as the right hand side may communicate) */
+	for(c=0;c<n_candidates;c++) {
+		double start_time=0.0, elapsed, max_elapsed;
+
+		RK_FN(ctx_set_tuning)(ctx,candidate+c);
+
+		RK_OMP_PARALLEL
+		for(int rep=-1;rep<iterations;rep++) {	/* the first iteration is a warm-up and it is not timed */
+			if(rep==0) {
+				RK_OMP_SINGLE
+				{
+					MPI_Barrier(ctx->comm);
+					start_time=MPI_Wtime();
+				}
+			}
+
+			f(t,x,K1);
+			RK_SWEEP( aux[i] = K1[i]*h3 + x[i] )
+		}
+
+		elapsed=(MPI_Wtime()-start_time)/iterations;
+
+		/* the slowest rank determines the speed of the whole calculation */
+		RK_ALLREDUCE(&elapsed,&max_elapsed,1,MPI_DOUBLE,MPI_MAX);
+		candidate[c].time=max_elapsed;
+	}
+
+	/* the master rank decides */
+	if(RK_MASTER)
+		for(c=1;c<n_candidates;c++)
+			if(candidate[c].time < candidate[best_candidate].time) best_candidate=c;
+
+	RK_BCAST(&best_candidate,1,MPI_INT);
+
+	RK_FN(ctx_set_tuning)(ctx,candidate+best_candidate);
+
+	if(best!=NULL) *best=candidate[best_candidate];
+	if(all!=NULL) {
+		for(c=0;c<n_candidates;c++) all[c]=candidate[c];
+		*n_all=n_candidates;
+	}
+	return(0);
+}
+
+int RK_FN(autotune)(RK_SOLUTION_TYPE * system, int iterations, RK_TUNING * best, RK_TUNING * all, int * n_all)
+{
+	return(RK_FN(ctx_autotune)(&RK_default_ctx,system,iterations,best,all,n_all));
+}
+
+#endif		/* RK_COMM_MPI && RK_MEM_SPARSE */
+
+/* ========================================== */
+/* the linear solver of the Rosenbrock method */
+
+/*
+RK_DOT(RESULT,EXPRESSION) sums EXPRESSION over all elements of the solution (in all ranks) and stores
+the sum to RESULT in all threads. All threads must encounter RK_DOT. The partial sums are collected
+in the members dot_local and dot_global of the context, which are shared by the threads.
+*/
+#define RK_DOT(RESULT,...) \
+	{ \
+		FLOAT dot_thread=0.0; \
+		RK_OMP_SINGLE \
+		ctx->dot_local=0.0; \
+		RK_SWEEP( dot_thread += (__VA_ARGS__) ) \
+		RK_OMP_CRITICAL \
+		ctx->dot_local+=dot_thread; \
+		RK_OMP_BARRIER \
+		RK_OMP_SINGLE \
+		RK_ALLREDUCE(&ctx->dot_local,&ctx->dot_global,1,MPI__FLOAT,MPI_SUM); \
+		RESULT=ctx->dot_global; \
+	}
+
+/*
+RK_JV(OUT,IN,W) computes OUT = J*IN, where J is the Jacobian of the right hand side at (t,x), by a finite
+difference: J*IN = ( f(t,x+sigma*IN) - f0 ) / sigma. W is the auxiliary array for the argument of f
+and xx is the squared norm of x. OUT and IN must not be the same array.
+*/
+#define RK_JV(OUT,IN,W) \
+	{ \
+		FLOAT in_norm2, sigma; \
+		RK_DOT(in_norm2, IN[i]*IN[i]) \
+		sigma = (in_norm2>0.0) ? RK_FD_EPS*(1.0+sqrtF(xx))/sqrtF(in_norm2) : 1.0; \
+		RK_SWEEP( W[i] = x[i] + sigma*IN[i] ) \
+		f(t,W,OUT); \
+		RK_SWEEP( OUT[i] = (OUT[i]-f0[i])/sigma ) \
+	}
+
+static int RK_krylov(RK_CTX * ctx, FLOAT t, const FLOAT * x, const FLOAT * f0, FLOAT xx, RK_RightHandSide f, FLOAT gh,
+			FLOAT * sol, const FLOAT * b, int n_chunks, const int * c_start, const int * c_size)
+/*
+solves the linear system (I - gh*J) sol = b by the matrix-free BiCGSTAB method, starting from zero,
+where J is the Jacobian of f at (t,x) and f0=f(t,x). xx is the squared norm of x. All threads must call
+this function. All decisions are based on the globally reduced scalar products, so that all threads
+in all ranks follow the same path.
+
+Returns the number of iterations or -1 if the method has not converged (or has broken down).
+*/
+{
+	FLOAT * const kr_r=ctx->kr_r, * const kr_rhat=ctx->kr_rhat, * const kr_p=ctx->kr_p, * const kr_v=ctx->kr_v;
+	FLOAT * const kr_s=ctx->kr_s, * const kr_t=ctx->kr_t, * const kr_w=ctx->kr_w;
+	FLOAT bb, rho, rho_old=1.0, alpha=1.0, omega=1.0, beta, tmp, tt, ts;
+	int it;
+
+	RK_SWEEP({ sol[i]=0.0; kr_r[i]=b[i]; kr_rhat[i]=b[i]; kr_p[i]=0.0; kr_v[i]=0.0; })
+	RK_DOT(bb, b[i]*b[i])
+	if(bb==0.0) return(0);
+	if(!isfinite(bb)) return(-1);
+
+	for(it=1;it<=RK_KRYLOV_MAXIT;it++) {
+		RK_DOT(rho, kr_rhat[i]*kr_r[i])
+		if(rho==0.0 || !isfinite(rho)) return(-1);
+
+		beta=(rho/rho_old)*(alpha/omega);
+		RK_SWEEP( kr_p[i] = kr_r[i] + beta*(kr_p[i]-omega*kr_v[i]) )
+
+		/* v = A p */
+		RK_JV(kr_v,kr_p,kr_w)
+		RK_SWEEP( kr_v[i] = kr_p[i] - gh*kr_v[i] )
+
+		RK_DOT(tmp, kr_rhat[i]*kr_v[i])
+		if(tmp==0.0) return(-1);
+		alpha=rho/tmp;
+
+		RK_SWEEP( kr_s[i] = kr_r[i] - alpha*kr_v[i] )
+		RK_DOT(tmp, kr_s[i]*kr_s[i])
+		if(tmp <= RK_KRYLOV_TOL*RK_KRYLOV_TOL*bb) {
+			RK_SWEEP( sol[i] += alpha*kr_p[i] )
+			return(it);
+		}
+
+		/* t = A s */
+		RK_JV(kr_t,kr_s,kr_w)
+		RK_SWEEP( kr_t[i] = kr_s[i] - gh*kr_t[i] )
+
+		RK_DOT(tt, kr_t[i]*kr_t[i])
+		RK_DOT(ts, kr_t[i]*kr_s[i])
+		if(tt==0.0 || ts==0.0) return(-1);
+		omega=ts/tt;
+
+		RK_SWEEP({ sol[i] += alpha*kr_p[i] + omega*kr_s[i]; kr_r[i] = kr_s[i] - omega*kr_t[i]; })
+		RK_DOT(tmp, kr_r[i]*kr_r[i])
+		if(tmp <= RK_KRYLOV_TOL*RK_KRYLOV_TOL*bb) return(it);
+
+		rho_old=rho;
+	}
+	return(-1);
+}
+
+int RK_FN(ctx_solve)(RK_CTX * ctx, FLOAT final_time, RK_SOLUTION_TYPE * system)
+/*
+Performs the ODE system integration up to the time level 'final_time', using the
+Merson's modification of the fourth order Runge-Kutta scheme with adaptive
+time stepping. The number of iterations necessary to reach the 'final_time'
+depends on the behavior of the equation system itself.
+
+The system actually solved is defined in the 'system' structure.
+The block of the evolving solution is always stored in the array pointed to by 'system->x'.
+The current time level is stored in 'system->t' and it is updated at the end of the calculation,
+as well as the current time step 'system->h'.
+
+NOTE: The 'final_time' parameter is ignored on all other ranks than the master rank.
+
+return codes:
+0	success
+1	interrupted by the service callback
+-1	not enough memory (RK_THREADS_COLLAPSED and RK_THREADS_RUNTIME only)
+-2	invalid 'system' specification
+-3	not initialized yet
+-4	break: cannot adjust time step - permanent occurrence of NANs. (only if NAN handling is ON)
+-5	the system exceeds available memory
+-6	error in one of the other processes
+*/
+{
+	int command=0;
+
+	int error_code=0;		/* for error code negotiation between the master ranks and the rest*/
+	int errcode_from_others;
+	int return_value=0;		/* for return value specification before breaking from the OpenMP parallel region */
+
+	/* this simplifies the notation in the formulas and also saves some time */
+	if(system==NULL) return(-2);
+#if RK_MEMORY == RK_MEM_SPARSE
+	RK_MEM_DIST * n = system->n;
+	int delta_mode = (int)system->delta_mode;
+#else
+	int n = system->n;
+#endif
+	RK_CHUNKS_DECLARE
+
+	/* this initialization is relevant in the master rank only */
+	FLOAT t = system->t;
+	FLOAT h = system->h;
+	FLOAT new_h;
+	FLOAT h_min = system->h_min;
+	FLOAT delta = system->delta;
+
+	FLOAT *x = system->x;
+	FLOAT * const K1 = ctx->K1, * const K3 = ctx->K3, * const K4 = ctx->K4, * const K5 = ctx->K5;
+	FLOAT * const aux = ctx->aux, * const K2s = ctx->K2s, * const kr_w = ctx->kr_w;
+
+	/*
+	obtain the right hand side - here we have different order of commands than in a purely serial
+	code, since we can't return immediately in the case of error. The error codes are collected
+	to the master rank several lines below.
+	*/
+	RK_RightHandSide f=NULL;
+	if(system->meta_f != NULL) f=system->meta_f();
+
+	/*
+	The order of the tests determines the "priority" of error codes. In fact, the order of
+	the tests can be arbitrary, none of the tests requires success of the previous one.
+	*/
+#if RK_MEMORY == RK_MEM_SPARSE
+	if(n==NULL) error_code=(-5);
+	else
+#endif
+	{
+		if(RK_MEM_END(n) > ctx->max_n) error_code=(-5);
+		else {
+			RK_CHUNKS_SET(n)
+			if(RK_CHUNKS_PREPARE()) error_code=(-1);
+		}
+	}
+
+	if(ctx->max_n==0) error_code=(-3);
+
+	if(x==NULL || system->meta_f==NULL) error_code=(-2);
+
+	if(RK_MASTER && delta<=0) error_code=(-2);
+
+	/*
+	NOTE:	MPI_Allreduce is used here instead of the following two step interaction:
+		1) MPI_Reduce to the master rank
+		2) MPI_Bcast from the master that would specify a command to the other ranks
+	*/
+
+	RK_ALLREDUCE(&error_code,&errcode_from_others,1,MPI_INT,MPI_MIN);
+	if(error_code) return(error_code);	/* return the error of the current rank */
+
+	/* errcode_from_others is <0 if any of the processes encountered an error */
+	/* and since we have passed here, we know that the error didn't occur in this process */
+	if(errcode_from_others<0) return(-6);
+
+	/* we don't have to remember K2 unless the stiffness is estimated */
+	FLOAT * K2=(ctx->stiffness_mode!=RK_STIFF_OFF) ? K2s : K3;
+
+	/* stiffness estimate: the squared norms of the differences K3-K2 and K2-K1 */
+	FLOAT stiff_num_local, stiff_den_local, stiff_num=0.0, stiff_den=0.0;
+	FLOAT ros_rho=0.0;		/* the dominant eigenvalue estimate of the Rosenbrock method */
+	int krylov_failed=0;		/* nonzero if the linear solver of the Rosenbrock method has failed */
+
+	/* auxiliary time step variables to hold the expression (h/2), (h/3), (h/6), (h/8) */
+	FLOAT h2,h3,h6,h8;
+
+	/* the error */
+	FLOAT eps,max_eps;
+
+	/* NAN handling communication variables */
+	int NAN_occurred_local;
+	int NAN_occurred_global;
+
+	/* the tolerances of the chunks and the total number of elements (RK_NORM_RMS only) */
+	const FLOAT * c_atol=NULL, * c_rtol=NULL;
+	FLOAT n_total=1.0;
+
+	ctx->last_NAN=0;
+
+	/* automatically reverse and also perform initial adjustment */
+	if(RK_MASTER) {
+		if((final_time>t && h<0) || (final_time<t && h>0)) h*=-1;
+		if(h==0 || fabsF(final_time-t)<=fabsF(h)) {
+			h=final_time-t;
+			command |= RKA_CMD_FINISHED;
+		}
+	}
+
+	/* set NAN handling and the error norm to the same state on all ranks */
+	RK_BCAST(&ctx->handle_NAN,1,MPI_INT);
+	RK_BCAST(&ctx->error_norm,1,MPI_INT);
+	RK_BCAST(&ctx->atol,1,MPI__FLOAT);
+	RK_BCAST(&ctx->rtol,1,MPI__FLOAT);
+
+	RK_TOLERANCES_SET(n)
+	if(ctx->error_norm==RK_NORM_RMS) n_total=RK_global_size(ctx,n_chunks,c_size);
+
+	/* broadcast these values from the master rank to all other ranks */
+	/* (Multiple calls are inefficient. However, this all occurs only once, so we can afford that) */
+	RK_BCAST(&final_time,1,MPI__FLOAT);
+	RK_BCAST(&t,1,MPI__FLOAT);
+	RK_BCAST(&h,1,MPI__FLOAT);
+	RK_BCAST(&delta,1,MPI__FLOAT);
+#if RK_MEMORY == RK_MEM_SPARSE
+	RK_BCAST(&delta_mode,1,MPI_INT);
+#endif
+
+	/*
+	I M P O R T A N T
+	-----------------
+	The calculation of the new time step as well as other simple calculations are
+	performed indvidually by each process in order to minimize interactions. However, this
+	may cause slight differences in results caused by different platforms, different
+	optimizations etc.
+	In order to maintain program flow consistency, all PROGRAM FLOW CONTROLLING CONDITIONS
+	based on a comparison of floating point values are performed by the master rank only.
+	The master rank then sends commands to other ranks. This is the safest way to control
+	the whole cluster.
+	*/
+
+	RK_APPLY_SCHEDULE()
+
+	RK_OMP_PARALLEL
+	while(1) {
+		/* these are private to each thread as they are declared inside the parallel region */
+		FLOAT eps_thread=0.0;
+		int NAN_thread=0;
+		FLOAT stiff_num_thread=0.0, stiff_den_thread=0.0;
+
+		RK_OMP_SINGLE
+		{
+			h2=h/2.0; h3=h/3.0; h6=h/6.0; h8=h/8.0;
+
+			NAN_occurred_local=0;
+			eps=0.0;
+			stiff_num_local=stiff_den_local=0.0;
+		}	/* OMP single */
+
+		if(ctx->rosenbrock) {
+
+		/*
+		The linearly implicit ROS2 method (Verwer et al., 1999) of order 2 with the embedded first order
+		solution x+h*k1 for the error estimate:
+			(I - gamma*h*J) k1 = f(t,x)
+			(I - gamma*h*J) k2 = f(t+h,x+h*k1) - 2*k1
+			x := x + h*(1.5*k1 + 0.5*k2)
+		The stages k1 and k2 are stored in K3 and K4, f(t,x) in K1. The Jacobian J at (t,x) is only
+		accessed through the Jacobian-vector products approximated by finite differences.
+		*/
+			const FLOAT * f0=K1;
+			FLOAT xx, jv_norm2, rho_est=0.0;
+			int it1, it2=-1;
+
+			f(t,x,K1);
+			RK_DOT(xx, x[i]*x[i])
+
+			/*
+			one power iteration per time step for the dominant eigenvalue estimate (the vector
+			is kept in K2s and it is initialized by the last stage difference K3-K2 of Merson)
+			*/
+			RK_JV(aux,K2s,kr_w)
+			RK_DOT(jv_norm2, aux[i]*aux[i])
+			if(jv_norm2>0.0 && isfinite(jv_norm2)) {
+				FLOAT scale=1.0/sqrtF(jv_norm2);
+				RK_DOT(rho_est, K2s[i]*K2s[i])
+				rho_est=sqrtF(jv_norm2/rho_est);
+				RK_SWEEP( K2s[i] = aux[i]*scale )
+			} else {
+				RK_SWEEP( K2s[i] = f0[i] )
+			}
+
+			/* the first stage */
+			it1=RK_krylov(ctx,t,x,f0,xx,f,RK_ROS_GAMMA*h,K3,K1,n_chunks,c_start,c_size);
+
+			/* the second stage */
+			if(it1>=0) {
+				RK_SWEEP( aux[i] = K3[i]*h + x[i] )
+				f(t+h,aux,K5);
+				RK_SWEEP( K5[i] -= 2.0*K3[i] )
+				it2=RK_krylov(ctx,t,x,f0,xx,f,RK_ROS_GAMMA*h,K4,K5,n_chunks,c_start,c_size);
+			}
+
+			RK_OMP_SINGLE
+			{
+				krylov_failed=(it1<0 || it2<0);
+				ros_rho=rho_est;
+				ctx->stiffness_info.krylov_iterations += (it1>0 ? it1 : 0) + (it2>0 ? it2 : 0);
+				if(krylov_failed) ctx->stiffness_info.krylov_failures++;
+			}	/* OMP single */
+
+			/*
+			calculate the error estimate: h*0.5*|k1+k2| is the local error. For compatibility with the
+			Merson scheme (where eps*h/3 is the local error), 1.5*|k1+k2| is used
+			*/
+			if(!krylov_failed) {
+				RK_ERROR_SWEEP( 1.5 * fabsF( K3[i] + K4[i] ) )
+			}
+
+		} else {
+
+			/*
+			NOTE:
+			The construction of the Ki coefficients will be direct from the right hand side f.
+			(f will store its results directly to the Ki arrays). Multiplication by the time
+			step h will be performed as soon as it is necessary (where the coefficients are
+			further used).
+			*/
+
+		/* K1 --------------------------------------- */
+
+			/* calculate K1 */
+			f(t,x,K1);
+
+		/* K2 --------------------------------------- */
+
+			/* calculate x+K1*h/3 needed as parameter to f when calculating K2 */
+			RK_SWEEP( aux[i] = K1[i]*h3 + x[i] )
+
+			/* calculate K2 */
+			f(t+h3,aux,K2);
+
+		/* K3 --------------------------------------- */
+
+			/* calculate x+(K1+K2)*h/6 needed as parameter to f when calculating K3 */
+			RK_SWEEP( aux[i] = ( K1[i] + K2[i] )*h6 + x[i] )
+
+			/* calculate K3 */
+			f(t+h3,aux,K3);
+
+		/* K4 --------------------------------------- */
+
+			/* calculate x+(K1+3*K3)*h/8 needed as parameter to f when calculating K4 */
+			if(ctx->stiffness_mode!=RK_STIFF_OFF) {
+				/*
+				K2 and K3 are evaluated at the same time level, with the arguments differing by h/6*(K2-K1).
+				Hence |K3-K2| / |h/6*(K2-K1)| estimates the dominant eigenvalue magnitude of the Jacobian.
+				*/
+				RK_SWEEP({
+					aux[i] = ( K1[i] + 3.0 * K3[i] )*h8 + x[i];
+					stiff_num_thread += (K3[i]-K2[i])*(K3[i]-K2[i]);
+					stiff_den_thread += (K2[i]-K1[i])*(K2[i]-K1[i]);
+				})
+			} else {
+				RK_SWEEP( aux[i] = ( K1[i] + 3.0 * K3[i] )*h8 + x[i] )
+			}
+
+			/* calculate K4 */
+			f(t+h2,aux,K4);
+
+		/* K5 --------------------------------------- */
+
+			/* calculate x+(0.5*K1-1.5*K3+2*K4)*h needed as parameter to f when calculating K5 */
+			RK_SWEEP( aux[i] = ( 0.5 * K1[i] - 1.5 * K3[i] + 2.0 * K4[i] )*h + x[i] )
+
+			/* calculate K5 */
+			f(t+h,aux,K5);
+
+		/* ========================================== */
+
+			/* calculate the error estimate (each thread processes its own part, including NAN and +-INF handling) */
+			RK_ERROR_SWEEP( fabsF( 0.2 * K1[i] - 0.9 * K3[i] + 0.8 * K4[i] - 0.1 * K5[i] ) )
+
+		}
+
+		/* perform the reduction over the threads */
+		RK_OMP_CRITICAL
+		{
+			if(ctx->error_norm==RK_NORM_RMS) eps+=eps_thread;
+			else if(eps_thread>eps) eps=eps_thread;
+			if(NAN_thread) NAN_occurred_local=1;
+			stiff_num_local+=stiff_num_thread;
+			stiff_den_local+=stiff_den_thread;
+		}
+
+		/*
+		There is no barrier for the threads that pass through a critical section! We have to put an explicit
+		barrier here to ensure that eps contains the complete maximum before one of the threads uses it
+		in the following OMP SINGLE block.
+		*/
+		RK_OMP_BARRIER
+
+	/* now as we have the new epsilon, the decision making and MPI communication is only done by one thread */
+		RK_OMP_SINGLE
+		{
+#if RK_MEMORY == RK_MEM_SPARSE
+			system->steps_total++;
+#endif
+
+#ifndef __DISABLE_NAN_HANDLING
+			if(ctx->handle_NAN) {
+				/* report the NAN occurrence to the master */
+				RK_REDUCE(&NAN_occurred_local,&NAN_occurred_global,1,MPI_INT,MPI_BOR);
+
+				/* now NAN_occurred_global is 1 if a NAN has occurred in any of the ranks, and 0 otherwise */
+				if(RK_MASTER)
+					if(NAN_occurred_global) {
+						command |= RKA_CMD_NAN;
+						/* only the master decides whether the time step is already too small for
+						   further division */
+						if(h/(final_time-t)<1e-11)
+							command |= RKA_CMD_h_TOO_SMALL;
+					}
+			}
+#endif
+
+		/* ========================================== */
+			/*
+			transfer the error to all ranks, since they need it to calculate new h
+			(even though only the master decides what to do)
+			*/
+			if(ctx->error_norm==RK_NORM_RMS) {
+				RK_ALLREDUCE(&eps,&max_eps,1,MPI__FLOAT,MPI_SUM);
+				max_eps=sqrtF(max_eps/n_total);
+			} else RK_ALLREDUCE(&eps,&max_eps,1,MPI__FLOAT,MPI_MAX);
+
+			/* collect the stiffness estimate in the master rank */
+			if(ctx->stiffness_mode!=RK_STIFF_OFF && !ctx->rosenbrock) {
+				RK_REDUCE(&stiff_num_local,&stiff_num,1,MPI__FLOAT,MPI_SUM);
+				RK_REDUCE(&stiff_den_local,&stiff_den,1,MPI__FLOAT,MPI_SUM);
+			}
+
+		/* ========================================== */
+			/* compare the error with delta (the error desired) and prepare a new time step */
+			/* (this happens even though there was a NAN - in that case it has no sense) */
+
+#if RK_MEMORY == RK_MEM_SPARSE
+			if(delta_mode == DELTA_LOCAL) max_eps *= fabsF(h3);
+#endif
+
+			/* the error estimate of the Rosenbrock method is of lower order */
+			new_h = ((max_eps>0.0) ? powF((delta/max_eps),ctx->rosenbrock ? 0.5 : 0.2)*0.8 : 2.0) * h;	/* double the time step if max_eps==0 */
+
+			/* if the linear solver has failed, retry with a half time step */
+			if(ctx->rosenbrock && krylov_failed) new_h = 0.5*h;
+
+			/*
+			ONLY the master rank must decide whether the next step will be (a candidate for ) the last one
+			(that is, whether the new h is greater than the distance from the final time) before the
+			command is broadcast to the cluster. That's why the new time step has been calculated above.
+
+			Note that other ranks don't perform the following comparison! They look for the
+			RKA_CMD_NEXTFINISH command instead!
+
+			However, this issue must be taken into account only if the current time step will
+			be successful (the relative error is acceptable and no NANs occured). Otherwise, the next
+			time step will be a retry and it will surely be smaller than the current one. It will
+			therefore not pass after final_time PROVIDED THAT the current time step does not pass
+			after final_time. (This is an inductive condition. The first step of the induction
+			is performed before the loop begins, where the time step is truncated if necessary.)
+			*/
+
+			if(RK_MASTER && !(ctx->rosenbrock && krylov_failed))
+				if(max_eps<delta || fabsF(h)<h_min) {
+					/*
+					this means the error is acceptable (either eps is in tolerance or the time step is
+					too short - see the description of h_min) => the step should be successful (This says
+					nothing about NANs - however, NANs are treated completely separately in the command
+					interpretation section below, so we don't have to care about them here)
+					*/
+					command |= RKA_CMD_UPDATE;
+
+					/* notice the addition of the current h here: we're talking about the NEXT step */
+					if( fabsF(final_time-(t+h)) <= fabsF(new_h) )
+						command |= RKA_CMD_NEXTFINISH;
+				}
+
+			/*
+			stiffness detection: only the successful steps count. The switch to the Rosenbrock method
+			is performed after RK_STIFF_STEPS consecutive steps limited by stability (allowing a few
+			isolated misses, since Merson keeps h_rho oscillating around its stability limit). The switch
+			back is performed after RK_STIFF_STEPS consecutive steps the Merson scheme would be stable with.
+			*/
+			if(RK_MASTER && ctx->stiffness_mode!=RK_STIFF_OFF && (command & RKA_CMD_UPDATE) && !(command & RKA_CMD_NAN)) {
+				int beyond;
+
+				if(ctx->rosenbrock) {
+					ctx->stiffness_info.rho = ros_rho;
+					ctx->stiffness_info.rosenbrock_steps++;
+				} else ctx->stiffness_info.rho = (stiff_den>0.0) ? sqrtF(stiff_num/stiff_den)/fabsF(h6) : 0.0;
+				ctx->stiffness_info.h_rho = ctx->stiffness_info.rho*fabsF(h);
+				if(ctx->stiffness_info.h_rho > RK_STIFF_THRESHOLD) ctx->stiffness_info.stiff_steps++;
+
+				/* the Rosenbrock method is judged by the time step it is going to take */
+				beyond = ctx->rosenbrock ? (ctx->stiffness_info.rho*fabsF(new_h) <= RK_STIFF_THRESHOLD) : (ctx->stiffness_info.h_rho > RK_STIFF_THRESHOLD);
+				if(beyond) {
+					ctx->stiff_count++;
+					ctx->stiff_count_miss=0;
+				} else if(ctx->rosenbrock || ++ctx->stiff_count_miss >= RK_STIFF_MISS) ctx->stiff_count=0;
+
+				if(ctx->stiffness_mode==RK_STIFF_SWITCH && ctx->stiff_count>=RK_STIFF_STEPS) {
+					command |= RKA_CMD_SWITCH;
+					ctx->stiff_count=ctx->stiff_count_miss=0;
+					ctx->stiffness_info.switches++;
+				}
+			}
+
+			/* ========================================== */
+
+			/* broadcast the command to all ranks */
+			RK_BCAST(&command,1,MPI_INT);
+
+			/* ========================================== */
+
+		}	/* OMP single */
+
+		/* handle commands (performed by all ranks and all threads) */
+
+#ifndef __DISABLE_NAN_HANDLING
+		/* testing handle_NAN here would be useless - the following will never be true with handle_NAN==0 */
+		if(command & RKA_CMD_NAN) {
+			/* h is very small - perhaps we can't reach a suitable time step at all => stop */
+			if(command & RKA_CMD_h_TOO_SMALL) {
+				RK_OMP_SINGLE
+				{
+					ctx->last_NAN=1;
+					system->t=t;
+					return_value = -4;
+				}
+				break;		/* leaving a parallel region by "return" is not allowed. But all threads can break from the while loop... */
+			}
+
+			RK_OMP_SINGLE
+			{
+				ctx->last_NAN=1;
+
+				/* try again with a smaller time step */
+				h/=10;
+				command=0;	/* of course, this is useful for the master rank only */
+			}	/* OMP single */
+		} else
+#endif
+		{
+
+		/* no NANs */
+			if(command & RKA_CMD_UPDATE) {
+				/* okay - the error is acceptable */
+				if(ctx->rosenbrock) {
+					/* update the solution x:=x+h*(1.5*k1+0.5*k2) */
+					RK_SWEEP( x[i] += h*( 1.5 * K3[i] + 0.5 * K4[i] ) )
+				} else {
+					/* update the solution x:=x+h/3*( (K1+K5)/2 + 2*K4 ) */
+					RK_SWEEP( x[i] += h3*( 0.5 * ( K1[i] + K5[i] ) + 2.0 * K4[i] ) )
+				}
+
+				if(command & RKA_CMD_SWITCH) {
+					/* the initial vector of the power iteration is the last stage difference K3-K2 */
+					if(!ctx->rosenbrock) {
+						RK_SWEEP( K2s[i] = K3[i] - K2s[i] )
+					}
+					RK_OMP_SINGLE
+					ctx->rosenbrock = !ctx->rosenbrock;
+				}
+
+				RK_OMP_SINGLE
+				{
+					t+=h;
+					system->steps++;
+
+#ifdef RK_CALLBACKS
+					/* Invoke the service callback if one is defined. */
+
+					if(system->Service_Callback != NULL) {
+						/* make the current values of t and h available to the service callback */
+						system->t = t;
+						system->h = h;
+						/*
+						the following test is done in all ranks. However, the result in the master rank
+						is the one that matters as consequently the command broadcast is performed again.
+						*/
+						if(system->Service_Callback(final_time, system)) command |= RKA_CMD_BREAK;
+					}
+
+					/* ========================================== */
+
+					/* broadcast the command to all ranks again in case it has been changed by the service callback */
+					RK_BCAST(&command,1,MPI_INT);
+
+					/* ========================================== */
+#endif
+				}	/* OMP single */
+
+				if(command & RKA_CMD_FINISHED) break;	/* already at the end of the interval => end */
+
+				if(command & RKA_CMD_BREAK) {	/* interrupted by the service callback (in rank 0) */
+					RK_OMP_SINGLE
+					{
+						system->t=t;		/* update time level variable accessible to the caller */
+						system->h=new_h;	/* begin with the updated h upon next call */
+						return_value = 1;
+					}
+					break;
+				}
+
+				/*
+				Now the new time level has been successfully calculated, so we may rearrange the blocks...
+				NOTE:	It is clear that all ranks must cooperate on the data rearrangement. This means,
+					no data is exchanged between ranks i and j before they have finished writing
+					down the new time level and called DDLBF_Rearrange(). No call to MPI_Barrier()
+					is therefore necessary in your callback function in order to ensure that the
+					correct data is already available. It may however be necessary to make a barrier
+					in DDLBF_Rearrange() because of internal logic of data rearrangement.
+
+				NOTE:	In fact, there are no fundamental problems that would prevent us from calling
+					the callback at the beginning of each time level caculation instead of here.
+					In that case, we could call it even if the previous time step was unsuccessful.
+					However, this would invoke DDLBF_Rearrange() also at the very beginning
+					of the calculation, which we usually don't want.
+
+				NOTE:	The call to DDLBF_Rearrange() is always single-threaded.
+				*/
+				RK_OMP_SINGLE
+				{
+#ifdef RK_CALLBACKS
+					if(system->DDLBF_Rearrange != NULL) {
+						n = system->n = system->DDLBF_Rearrange(n);	/* return of NULL is not checked */
+						RK_CHUNKS_SET(n)
+						RK_TOLERANCES_SET(n)
+						if(ctx->error_norm==RK_NORM_RMS) n_total=RK_global_size(ctx,n_chunks,c_size);
+						if(RK_CHUNKS_PREPARE()) return_value = -1;
+					}
+#endif
+
+					/* possibly alter the right hand side for the next time step */
+					f=system->meta_f();
+				}
+
+				if(return_value) break;
+			}
+
+			/*
+			if there is a RKA_CMD_NEXTFINISH command issued, the RKA_CMD_UPDATE has been issued too
+			(see above). This lets us place the following condition outside the RKA_CMD_UPDATE
+			condition above even though it logically belongs there. Here it is easier to set the command
+			for the next iteration.
+			*/
+
+			RK_OMP_SINGLE
+			{
+				if(command & RKA_CMD_NEXTFINISH) {
+					/*
+					this ensures that a reasonable time step will be stored to system->h to be
+					prepared for a continued calculation. If we did this at return from the function,
+					we would store the already truncated time step, which is undesirable.
+					NOTE:	It does not matter whether we use h or new_h here, since they are
+						probably very similar.
+					*/
+					system->h=new_h;
+					h=final_time-t;
+					command=RKA_CMD_FINISHED; /* next step will be the last (if it's successful) */
+				} else {
+					command=0;
+					h=new_h;
+				}
+			}
+		}
+
+	/* ========================================== */
+
+	}	/* while(1) & OMP parallel */
+
+	if(!return_value)	system->t=t;		/* update time level variable accessible to the caller (this happens in all ranks) */
+	return(return_value);
+}
+
+int RK_FN(solve)(FLOAT final_time, RK_SOLUTION_TYPE * system)
+{
+	return(RK_FN(ctx_solve)(&RK_default_ctx,final_time,system));
+}
+
+#else		/* RK_SCHEME_RK4, RK_SCHEME_RK4_LOWMEM */
+
+int RK_FN(ctx_solve)(RK_CTX * ctx, int steps, RK_SOLUTION_TYPE * system)
+/*
+Performs 'steps' iterations using the fourth order "standard" Runge - Kutta method.
+The memory optimized version (RK_SCHEME_RK4_LOWMEM) needs less auxiliary arrays,
+but it is a bit slower than the straightforward implementation.
+
+The system actually solved is defined in the 'system' structure.
+The evolving solution is always stored in the array pointed to by 'system->x'. The current time level
+is stored in 'system->t' and it is updated at the end of the calculation. The time step is defined
+by 'system->h'.
+
+NOTE: No communication is necessary with a fixed time step. In the MPI versions, each rank
+advances its own block of the solution.
+
+return codes:
+0	success
+-1	not enough memory (RK_THREADS_COLLAPSED and RK_THREADS_RUNTIME only)
+-2	invalid input data
+-3	not initialized yet
+-5	system dimension is greater than the maximum dimension passed to the init function
+*/
+{
+	/* this simplifies the notation in the formulas and also saves some time */
+	if(system==NULL) return(-2);
+#if RK_MEMORY == RK_MEM_SPARSE
+	RK_MEM_DIST * n = system->n;
+#else
+	int n = system->n;
+#endif
+	RK_CHUNKS_DECLARE
+
+	FLOAT t=system->t;
+	FLOAT h=system->h;
+	FLOAT *x=system->x;
+#if RK_SCHEME == RK_SCHEME_RK4
+	FLOAT * const K1=ctx->K1, * const K2=ctx->K2, * const K3=ctx->K3, * const K4=ctx->K4, * const aux=ctx->aux;
+#else
+	FLOAT * const K_a=ctx->K_a, * const K_b=ctx->K_b, * const x__=ctx->x__;
+#endif
+	if(ctx->max_n==0) return(-3);
+#if RK_MEMORY == RK_MEM_SPARSE
+	if(n==NULL) return(-2);
+#endif
+	if(RK_MEM_END(n)>ctx->max_n) return(-5);
+
+	if(x==NULL || system->meta_f==NULL || h==0 || steps<=0) return(-2);
+	RK_RightHandSide f=system->meta_f();
+
+	RK_CHUNKS_SET(n)
+	if(RK_CHUNKS_PREPARE()) return(-1);
+	(void)c_eps_mult;	/* no error estimate with a fixed time step */
+
+	/* auxiliary time variable to hold the expression (t+h/2) */
+	FLOAT th2;
+
+	/* auxiliary time step variables to hold the expressions (h/2), (h/6) and (h/3) */
+	FLOAT h2=h/2, h6=h/6;
+#if RK_SCHEME == RK_SCHEME_RK4_LOWMEM
+	FLOAT h3=h/3;
+#endif
+
+	RK_APPLY_SCHEDULE()
+
+	RK_OMP_PARALLEL
+	for(int step=0;step<steps;step++) {	/* each thread counts the steps on its own */
+
+		RK_OMP_SINGLE
+		{ th2=t+h2; }
+
+	/*
+	NOTE:
+	The construction of the Ki coefficients will be direct from the right hand side f.
+	(f will store its results directly to the Ki arrays). Multiplication by the time
+	step h will be performed as soon as it is necessary (where the coefficients are
+	further used).
+	*/
+
+#if RK_SCHEME == RK_SCHEME_RK4
+
+	/* K1 --------------------------------------- */
+
+		/* calculate K1 */
+		f(t,x,K1);
+
+	/* K2 --------------------------------------- */
+
+		/* calculate x+K1*h/2 needed as parameter to f when calculating K2 */
+		RK_SWEEP( aux[i] = K1[i]*h2 + x[i] )
+
+		/* calculate K2 */
+		f(th2,aux,K2);
+
+	/* K3 --------------------------------------- */
+
+		/* calculate x+K2*h/2 needed as parameter to f when calculating K3 */
+		RK_SWEEP( aux[i] = K2[i]*h2 + x[i] )
+
+		/* calculate K3 */
+		f(th2,aux,K3);
+
+	/* K4 --------------------------------------- */
+
+		/* calculate x+K3*h needed as parameter to f when calculating K4 */
+		RK_SWEEP( aux[i] = K3[i]*h + x[i] )
+
+		/* now we don't need the original value of t any more */
+		RK_OMP_SINGLE
+		{ t+=h; }
+
+		/* calculate K4 */
+		f(t,aux,K4);
+
+		/* ---------------------------------- */
+
+		/* finally update x:=x+h/6*(K1+2*K2+2*K3+K4) */
+		RK_SWEEP( x[i] += h6*( K1[i] + 2 * K2[i] + 2 * K3[i] + K4[i] ) )
+
+#else	/* RK_SCHEME_RK4_LOWMEM */
+
+		/*
+		The next iteration will be constructed gradually.
+		(of course this is a bit slower than immediate final calculation,
+		 but it takes less memory)
+		*/
+
+		/* save old solution */
+		RK_SWEEP( x__[i] = x[i] )
+
+	/* K1 --------------------------------------- */
+
+		/* calculate K1 (stored in K_a) */
+		f(t,x__,K_a);
+
+		/* update x:=x__+h/6*(K1) and calculate x__+K1*h/2 needed as parameter to f when calculating K2 */
+		RK_SWEEP({
+			x[i] += h6 * K_a[i];
+			K_a[i] = K_a[i]*h2 + x__[i];
+		})
+
+	/* K2 --------------------------------------- */
+
+		/* calculate K2 (stored in K_b) */
+		f(th2,K_a,K_b);
+
+		/* update x:=x__+h/6*(K1+2*K2) and calculate x__+K2*h/2 needed as parameter to f when calculating K3 */
+		RK_SWEEP({
+			x[i] += h3 * K_b[i];
+			K_b[i] = K_b[i]*h2 + x__[i];
+		})
+
+	/* K3 --------------------------------------- */
+
+		/* calculate K3 (stored in K_a) */
+		f(th2,K_b,K_a);
+
+		/* the update by K3 will go together with K4 */
+
+	/* K4 --------------------------------------- */
+
+		/* calculate x+K3*h needed as parameter to f when calculating K4 */
+		/* now we don't need the original values of the array x__ anymore */
+		RK_SWEEP( x__[i] += K_a[i] * h )
+
+		/* now we don't need the original value of t any more */
+		RK_OMP_SINGLE
+		{ t+=h; }
+
+		/* calculate K4 (stored in K_b) */
+		f(t,x__,K_b);	/* here t is already (original) t+h */
+
+		/* ---------------------------------- */
+
+		/* finally update x:=x__+h/6*(K1+2*K2+2*K3+K4) */
+		RK_SWEEP( x[i] += h6*(2 * K_a[i] + K_b[i]) )
+
+#endif
+
+	/* ------------------------------------------ */
+		/* possibly alter the right hand side for the next time step */
+		RK_OMP_SINGLE
+		{ f=system->meta_f(); }
+	}	/* for & OMP parallel */
+
+	system->t=t;		/* update time level variable accessible to the caller */
+	return(0);
+}
+
+int RK_FN(solve)(int steps, RK_SOLUTION_TYPE * system)
+{
+	return(RK_FN(ctx_solve)(&RK_default_ctx,steps,system));
+}
+
+#endif		/* RK_SCHEME */
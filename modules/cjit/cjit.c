@@ -0,0 +1,128 @@
+/***************************************************\
+* CJIT: run-time compilation of generated C code    *
+* into cached shared objects                        *
+* (C) 2026 PorousFreezeThaw contributors            *
+* file: cjit.c                                      *
+\***************************************************/
+
+/* POSIX interfaces (dlopen(), getpid(), uname() etc.) */
+#define _GNU_SOURCE
+
+#include "cjit.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/utsname.h>
+
+#define DEFAULT_COMPILER	"cc"
+#define MAX_PATH		4096
+
+/* ========================================== */
+
+static CJIT_HASH fnv1a(CJIT_HASH h, const char * s)
+/* continues the 64-bit FNV-1a hash 'h' by the string 's' including its terminating null character */
+{
+	do {
+		h ^= (unsigned char)*s;
+		h *= 0x100000001b3ULL;
+	} while(*(s++));
+	return(h);
+}
+
+CJIT_HASH cjit_hash(const char * source, const char * compiler)
+{
+	CJIT_HASH h = 0xcbf29ce484222325ULL;
+	struct utsname un;
+
+	if(compiler==NULL || *compiler==0) compiler=DEFAULT_COMPILER;
+
+	h = fnv1a(h, compiler);
+	h = fnv1a(h, CJIT_FLAGS);
+	/* objects compiled e.g. with -march=native must not be shared among different machines */
+	if(uname(&un)==0) h = fnv1a(h, un.machine);
+	return(fnv1a(h, source));
+}
+
+/* ========================================== */
+
+int cjit_build(const char * source, const char * compiler, const char * cache_dir, char * so_path, int so_path_size)
+{
+	char base[MAX_PATH-32];		/* the cache directory and the base name of the files */
+	char tmp_src[MAX_PATH], tmp_so[MAX_PATH], tmp_log[MAX_PATH], path[MAX_PATH];
+	char * cmd;
+	FILE * f;
+	int pid, status, l;
+
+	if(source==NULL || so_path==NULL) return(-1);
+	if(compiler==NULL || *compiler==0) compiler=DEFAULT_COMPILER;
+	if(cache_dir==NULL || *cache_dir==0) cache_dir=".";
+	/* the paths are single-quoted on the command line */
+	if(strchr(cache_dir,'\'')!=NULL) return(-1);
+
+	l = snprintf(base, sizeof(base), "%s/cjit_%016llx", cache_dir, cjit_hash(source, compiler));
+	if(l<0 || l>=(int)sizeof(base) || l+4>=so_path_size) return(-1);
+	sprintf(so_path, "%s.so", base);
+
+	/* cache lookup */
+	if(access(so_path, R_OK)==0) return(1);
+
+	/* the temporary files are unique to this process */
+	pid = (int)getpid();
+	sprintf(tmp_src, "%s.%d.c", base, pid);
+	sprintf(tmp_so, "%s.%d.so", base, pid);
+	sprintf(tmp_log, "%s.%d.log", base, pid);
+
+	if((f=fopen(tmp_src, "w"))==NULL) return(-2);
+	if(fputs(source, f)<0) { fclose(f); remove(tmp_src); return(-2); }
+	if(fclose(f)!=0) { remove(tmp_src); return(-2); }
+
+	if(system(NULL)==0) { remove(tmp_src); return(-3); }
+
+	l = strlen(compiler) + strlen(CJIT_FLAGS) + 3*MAX_PATH + 64;
+	if((cmd=(char *)malloc(l))==NULL) { remove(tmp_src); return(-1); }
+	sprintf(cmd, "%s " CJIT_FLAGS " -o '%s' '%s' -lm > '%s' 2>&1", compiler, tmp_so, tmp_src, tmp_log);
+	status = system(cmd);
+	free(cmd);
+
+	/* keep the source and the compiler output for inspection */
+	sprintf(path, "%s.c", base); rename(tmp_src, path);
+	sprintf(path, "%s.log", base); rename(tmp_log, path);
+
+	if(status==-1 || !WIFEXITED(status) || WEXITSTATUS(status)!=0 || access(tmp_so, R_OK)!=0) {
+		remove(tmp_so);
+		return(-4);
+	}
+
+	/* publish the shared object atomically */
+	if(rename(tmp_so, so_path)!=0) { remove(tmp_so); return(-2); }
+	return(0);
+}
+
+/* ========================================== */
+
+void * cjit_open(const char * so_path)
+{
+	return(dlopen(so_path, RTLD_NOW | RTLD_LOCAL));
+}
+
+void * cjit_symbol(void * handle, const char * name)
+{
+	if(handle==NULL) return(NULL);
+	return(dlsym(handle, name));
+}
+
+const char * cjit_error(void)
+{
+	const char * e = dlerror();
+	return(e==NULL ? "no error" : e);
+}
+
+void cjit_close(void * handle)
+{
+	if(handle!=NULL) dlclose(handle);
+}